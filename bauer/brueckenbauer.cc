@@ -784,7 +784,7 @@ DBG_MESSAGE("bridge_builder_t::build()", "end not ok");
 
 	if(desc->get_waytype() == road_wt)
 	{
-		welt->set_recheck_road_connexions();
+		welt->set_recheck_road_connexions(gr->get_pos().get_2d());
 	}
 	return NULL;
 }
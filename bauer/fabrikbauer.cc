@@ -436,7 +436,7 @@ void factory_builder_t::distribute_attractions(int max_number)
 
 	}
 	// update an open map
-	reliefkarte_t::get_karte()->calc_map_size();
+	reliefkarte_t::get_karte()->calc_map();
 }
 
 /**
@@ -690,7 +690,7 @@ int factory_builder_t::build_link(koord3d* parent, const factory_desc_t* info, s
 		DBG_MESSAGE("factory_builder_t::build_link()","update karte");
 
 		// update the map if needed
-		reliefkarte_t::get_karte()->calc_map_size();
+		reliefkarte_t::get_karte()->calc_map();
 
 		INT_CHECK( "fabrikbauer 730" );
 
@@ -1237,7 +1237,7 @@ next_ware_check:
 					if(nr > 0)
 					{
 						fabrik_t *our_fab = fabrik_t::get_fab( pos.get_2d() );
-						reliefkarte_t::get_karte()->calc_map_size();
+						reliefkarte_t::get_karte()->calc_map();
 						// tell the player
 						if(tell_me)
 						{
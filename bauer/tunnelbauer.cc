@@ -416,7 +416,7 @@ const char *tunnel_builder_t::build( player_t *player, koord pos, const tunnel_d
 
 	if(desc->get_waytype() == road_wt)
 	{
-		welt->set_recheck_road_connexions();
+		welt->set_recheck_road_connexions(gr->get_pos().get_2d());
 	}
 	return NULL;
 }
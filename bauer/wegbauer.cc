@@ -2692,6 +2692,12 @@ void way_builder_t::build_road()
 		}
 		welt->set_recheck_road_connexions();
 	} // for
+
+	if(get_count() > 0) {
+		// the private car routes of the cities at both ends change the most
+		welt->set_recheck_road_connexions(route[0].get_2d());
+		welt->set_recheck_road_connexions(route[get_count()-1].get_2d());
+	}
 }
 
 
@@ -1930,6 +1930,7 @@ sint64 grund_t::neuen_weg_bauen(weg_t *weg, ribi_t::ribi ribi, player_t *player,
 			// add
 			weg->set_ribi(ribi);
 			weg->set_pos(pos);
+			way_graph_t::mark_dirty(weg);
 			objlist.add( weg );
 			flags |= has_way1;
 		}
@@ -1946,6 +1947,7 @@ sint64 grund_t::neuen_weg_bauen(weg_t *weg, ribi_t::ribi ribi, player_t *player,
 			objlist.add(weg);
 			weg->set_ribi(ribi);
 			weg->set_pos(pos);
+			way_graph_t::mark_dirty(weg);
 			flags |= has_way2;
 			if(ist_uebergang())
 			{
@@ -0,0 +1,233 @@
+/*
+ * This file is part of the Simutrans-Extended project under the Artistic License.
+ * (see LICENSE.txt)
+ */
+
+#include <algorithm>
+#include <string.h>
+
+#include "private_car_route_table.h"
+#include "../../tpl/vector_tpl.h"
+
+
+static const sint8 next_hop_dz_bias = 16;
+
+
+bool private_car_route_table_t::encode(koord3d here, koord3d next_tile, uint8 &next_hop)
+{
+	if(  next_tile == koord3d::invalid  ) {
+		next_hop = 0;
+		return true;
+	}
+	const sint16 dz = next_tile.z - here.z;
+	if(  dz < -next_hop_dz_bias  ||  dz >= next_hop_dz_bias  ) {
+		return false;
+	}
+	const koord diff = next_tile.get_2d() - here.get_2d();
+	for(  uint8 i = 0;  i < 4;  i++  ) {
+		if(  diff == koord::nsew[i]  ) {
+			next_hop = (uint8)((i + 1) | ((dz + next_hop_dz_bias) << 3));
+			return true;
+		}
+	}
+	return false;
+}
+
+
+koord3d private_car_route_table_t::decode(koord3d here, uint8 next_hop)
+{
+	const uint8 dir = next_hop & 7;
+	if(  dir == 0  ) {
+		return koord3d::invalid;
+	}
+	const koord next = here.get_2d() + koord::nsew[dir - 1];
+	return koord3d(next, (sint8)(here.z + (next_hop >> 3) - next_hop_dz_bias));
+}
+
+
+uint32 private_car_route_table_t::lower_bound(koord dest) const
+{
+	uint32 first = 0;
+	uint32 len = count;
+	while(  len > 0  ) {
+		const uint32 half = len / 2;
+		if(  less(entries[first + half].destination, dest)  ) {
+			first += half + 1;
+			len -= half + 1;
+		}
+		else {
+			len = half;
+		}
+	}
+	return first;
+}
+
+
+const private_car_route_table_t::entry_t *private_car_route_table_t::find(koord dest) const
+{
+	if(  unresolved  ||  count == 0  ) {
+		return NULL;
+	}
+	const uint32 i = lower_bound(dest);
+	return i < count  &&  entries[i].destination == dest ? entries + i : NULL;
+}
+
+
+koord3d private_car_route_table_t::get(koord dest, koord3d here) const
+{
+	const entry_t *e = find(dest);
+	return e ? decode(here, e->next_hop) : koord3d::invalid;
+}
+
+
+bool private_car_route_table_t::set(koord dest, koord3d here, koord3d next_tile)
+{
+	uint8 next_hop;
+	if(  !encode(here, next_tile, next_hop)  ) {
+		return false;
+	}
+
+	lock();
+	if(  unresolved  ) {
+		// cannot happen after loading has finished
+		unlock();
+		return false;
+	}
+	const uint32 i = lower_bound(dest);
+	if(  i < count  &&  entries[i].destination == dest  ) {
+		entries[i].next_hop = next_hop;
+		unlock();
+		return true;
+	}
+	if(  count == capacity  ) {
+		const uint32 new_capacity = capacity < 4 ? 4 : capacity * 2;
+		entry_t *new_entries = new entry_t[new_capacity];
+		if(  count > 0  ) {
+			memcpy(new_entries, entries, sizeof(entry_t) * count);
+		}
+		delete [] entries;
+		entries = new_entries;
+		capacity = new_capacity;
+	}
+	memmove(entries + i + 1, entries + i, sizeof(entry_t) * (count - i));
+	entries[i].destination = dest;
+	entries[i].next_hop = next_hop;
+	count++;
+	unlock();
+	return true;
+}
+
+
+koord3d private_car_route_table_t::remove(koord dest, koord3d here)
+{
+	koord3d next_tile = koord3d::invalid;
+	lock();
+	if(  !unresolved  &&  count > 0  ) {
+		const uint32 i = lower_bound(dest);
+		if(  i < count  &&  entries[i].destination == dest  ) {
+			next_tile = decode(here, entries[i].next_hop);
+			count--;
+			memmove(entries + i, entries + i + 1, sizeof(entry_t) * (count - i));
+			if(  count == 0  ) {
+				delete [] entries;
+				entries = NULL;
+				capacity = 0;
+			}
+		}
+	}
+	unlock();
+	return next_tile;
+}
+
+
+void private_car_route_table_t::get_destinations(vector_tpl<koord> &dests)
+{
+	lock();
+	if(  !unresolved  ) {
+		for(  uint32 i = 0;  i < count;  i++  ) {
+			dests.append(entries[i].destination);
+		}
+	}
+	unlock();
+}
+
+
+void private_car_route_table_t::clear()
+{
+	if(  unresolved  ) {
+		delete [] loaded;
+		unresolved = false;
+	}
+	else {
+		delete [] entries;
+	}
+	entries = NULL;
+	count = 0;
+	capacity = 0;
+}
+
+
+void private_car_route_table_t::append_loaded(koord dest, koord3d next_tile)
+{
+	if(  !unresolved  ) {
+		clear();
+		unresolved = true;
+	}
+	if(  count == capacity  ) {
+		const uint32 new_capacity = capacity < 4 ? 4 : capacity * 2;
+		loaded_route_t *new_loaded = new loaded_route_t[new_capacity];
+		for(  uint32 i = 0;  i < count;  i++  ) {
+			new_loaded[i] = loaded[i];
+		}
+		delete [] loaded;
+		loaded = new_loaded;
+		capacity = new_capacity;
+	}
+	loaded[count].destination = dest;
+	loaded[count].next_tile = next_tile;
+	count++;
+}
+
+
+void private_car_route_table_t::resolve_loaded(koord3d here)
+{
+	if(  !unresolved  ) {
+		return;
+	}
+	loaded_route_t *const routes = loaded;
+	const uint32 routes_count = count;
+
+	entries = routes_count > 0 ? new entry_t[routes_count] : NULL;
+	capacity = routes_count;
+	count = 0;
+	unresolved = false;
+
+	for(  uint32 i = 0;  i < routes_count;  i++  ) {
+		uint8 next_hop;
+		// routes which do not lead to a neighbour tile are corrupt and will be found again
+		if(  encode(here, routes[i].next_tile, next_hop)  ) {
+			entries[count].destination = routes[i].destination;
+			entries[count].next_hop = next_hop;
+			count++;
+		}
+	}
+	delete [] routes;
+
+	std::stable_sort(entries, entries + count, [](const entry_t &a, const entry_t &b) { return less(a.destination, b.destination); });
+	// keep the last of duplicate destinations, like repeated set() calls would
+	uint32 n = 0;
+	for(  uint32 i = 0;  i < count;  i++  ) {
+		if(  n > 0  &&  entries[n - 1].destination == entries[i].destination  ) {
+			entries[n - 1] = entries[i];
+		}
+		else {
+			entries[n++] = entries[i];
+		}
+	}
+	count = n;
+	if(  count == 0  ) {
+		delete [] entries;
+		entries = NULL;
+		capacity = 0;
+	}
+}
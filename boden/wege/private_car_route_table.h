@@ -0,0 +1,135 @@
+/*
+ * This file is part of the Simutrans-Extended project under the Artistic License.
+ * (see LICENSE.txt)
+ */
+
+#ifndef BODEN_WEGE_PRIVATE_CAR_ROUTE_TABLE_H
+#define BODEN_WEGE_PRIVATE_CAR_ROUTE_TABLE_H
+
+
+#include "../../simtypes.h"
+#include "../../dataobj/koord.h"
+#include "../../dataobj/koord3d.h"
+
+#ifdef MULTI_THREAD
+#include <atomic>
+#endif
+
+template <class T> class vector_tpl;
+
+
+/**
+ * Compact destination -> next hop table for the private car routes of one road tile.
+ *
+ * The next tile of a private car route is always a neighbour of the tile holding
+ * the table, so it is stored relative to that tile in a single byte: a 3 bit
+ * direction (none or an index into koord::nsew) and the height difference.
+ * Entries are kept sorted by destination in one flat array, so a table costs
+ * six bytes per destination instead of a hashtable with 101 bags per tile.
+ *
+ * Writers from the private car route threads never take a mutex: concurrent
+ * set/remove calls on the same tile are serialised by an atomic flag embedded
+ * in the table. Readers only ever use the set which is not being written
+ * (see weg_t::private_car_routes_currently_reading_element).
+ */
+class private_car_route_table_t
+{
+public:
+	struct entry_t
+	{
+		koord destination;
+		/// bits 0-2: 0 = destination reached, otherwise 1 + index into koord::nsew
+		/// bits 3-7: height difference to the next tile, biased by 16
+		uint8 next_hop;
+	};
+
+	typedef const entry_t* const_iterator;
+
+private:
+	/// Route as it is stored in the savegame. The position of the way is not yet
+	/// known while it is being loaded, so these are only encoded in resolve_loaded().
+	struct loaded_route_t
+	{
+		koord destination;
+		koord3d next_tile;
+	};
+
+	union
+	{
+		entry_t *entries;
+		loaded_route_t *loaded;
+	};
+	uint32 count;
+	uint32 capacity;
+	bool unresolved;
+
+#ifdef MULTI_THREAD
+	std::atomic_flag write_guard;
+
+	void lock() { while(write_guard.test_and_set(std::memory_order_acquire)) { } }
+	void unlock() { write_guard.clear(std::memory_order_release); }
+#else
+	void lock() { }
+	void unlock() { }
+#endif
+
+	/// @returns index of the first entry whose destination is not smaller than dest
+	uint32 lower_bound(koord dest) const;
+
+	const entry_t *find(koord dest) const;
+
+	static bool less(koord a, koord b) { return a.y < b.y || (a.y == b.y && a.x < b.x); }
+
+	static bool encode(koord3d here, koord3d next_tile, uint8 &next_hop);
+	static koord3d decode(koord3d here, uint8 next_hop);
+
+	private_car_route_table_t(const private_car_route_table_t&);
+	private_car_route_table_t& operator=(const private_car_route_table_t&);
+
+public:
+	private_car_route_table_t() : entries(NULL), count(0), capacity(0), unresolved(false)
+	{
+#ifdef MULTI_THREAD
+		write_guard.clear();
+#endif
+	}
+
+	~private_car_route_table_t() { clear(); }
+
+	uint32 get_count() const { return unresolved ? 0 : count; }
+	bool empty() const { return get_count() == 0; }
+
+	const_iterator begin() const { return unresolved ? NULL : entries; }
+	const_iterator end() const { return unresolved ? NULL : entries + count; }
+
+	bool is_contained(koord dest) const { return find(dest) != NULL; }
+
+	/// @returns the next tile towards dest as seen from here, or koord3d::invalid
+	/// if there is no route or here is the destination.
+	koord3d get(koord dest, koord3d here) const;
+
+	/// @returns the next tile stored in entry e of the table at here
+	static koord3d get_next_tile(const entry_t &e, koord3d here) { return decode(here, e.next_hop); }
+
+	/// Adds or replaces the route to dest. Safe to call from several threads at once.
+	/// @returns false if next_tile is neither invalid nor a neighbour of here.
+	bool set(koord dest, koord3d here, koord3d next_tile);
+
+	/// Removes the route to dest. Safe to call from several threads at once.
+	/// @returns the next tile of the removed route, or koord3d::invalid
+	koord3d remove(koord dest, koord3d here);
+
+	/// Appends all destinations of this table to dests (taking the write guard).
+	void get_destinations(vector_tpl<koord> &dests);
+
+	void clear();
+
+	/// Stores a route read from a savegame; resolve_loaded() must be called
+	/// once the position of the way is known.
+	void append_loaded(koord dest, koord3d next_tile);
+
+	/// Converts the routes stored by append_loaded() into the compact form.
+	void resolve_loaded(koord3d here);
+};
+
+#endif
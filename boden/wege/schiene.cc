@@ -40,12 +40,14 @@ bool schiene_t::show_reservations = false;
 schiene_t::schiene_t(waytype_t waytype) : weg_t (waytype)
 {
 	reserved = convoihandle_t();
+	reserved_tiles_index = 0;
 }
 
 
 schiene_t::schiene_t() : weg_t(track_wt)
 {
 	reserved = convoihandle_t();
+	reserved_tiles_index = 0;
 	type = block;
 	set_desc(schiene_t::default_schiene);
 }
@@ -54,11 +56,66 @@ schiene_t::schiene_t() : weg_t(track_wt)
 schiene_t::schiene_t(loadsave_t *file) : weg_t(track_wt)
 {
 	reserved = convoihandle_t();
+	reserved_tiles_index = 0;
 	type = block;
 	rdwr(file);
 }
 
 
+schiene_t::~schiene_t()
+{
+	// do not leave a dangling pointer in the reservation index
+	set_reserved( convoihandle_t() );
+}
+
+
+bool schiene_t::is_reservation_indexed() const
+{
+	if(  !reserved.is_bound()  ) {
+		return false;
+	}
+	const vector_tpl<schiene_t *> &tiles = reserved->access_reserved_tiles();
+	return reserved_tiles_index < tiles.get_count()  &&  tiles[reserved_tiles_index] == this;
+}
+
+
+void schiene_t::set_reserved(convoihandle_t c)
+{
+	if(  reserved == c  &&  (!c.is_bound()  ||  is_reservation_indexed())  ) {
+		return;
+	}
+	if(  is_reservation_indexed()  ) {
+		// move the last tile of the index into our place
+		vector_tpl<schiene_t *> &tiles = reserved->access_reserved_tiles();
+		schiene_t *const last = tiles.back();
+		tiles[reserved_tiles_index] = last;
+		last->reserved_tiles_index = reserved_tiles_index;
+		tiles.pop_back();
+	}
+	reserved = c;
+	if(  reserved.is_bound()  ) {
+		vector_tpl<schiene_t *> &tiles = reserved->access_reserved_tiles();
+		reserved_tiles_index = tiles.get_count();
+		tiles.append( this );
+	}
+}
+
+
+void schiene_t::index_loaded_reservations()
+{
+	FOR(vector_tpl<weg_t *>, const way, weg_t::get_alle_wege()) {
+		if(  way->is_rail_type()  ||  way->get_waytype() == air_wt  ) {
+			schiene_t *const sch = (schiene_t *)way;
+			if(  sch->reserved.get_id() != 0  &&  !sch->reserved.is_bound()  ) {
+				// reserved by a convoy, which was not loaded
+				sch->reserved = convoihandle_t();
+			}
+			sch->set_reserved( sch->reserved );
+		}
+	}
+}
+
+
 void schiene_t::cleanup(player_t *)
 {
 	// removes reservation
@@ -221,7 +278,7 @@ bool schiene_t::reserve(convoihandle_t c, ribi_t::ribi dir, reservation_type t,
 			// is already done, but show that this is reservable.
 			return true;
 		}
-		reserved = c;
+		set_reserved(c);
 		type = t;
 		direction = dir;
 
@@ -267,7 +324,7 @@ bool schiene_t::unreserve(convoihandle_t c)
 {
 	// is this tile reserved by us?
 	if(reserved.is_bound()  &&  reserved==c) {
-		reserved = convoihandle_t();
+		set_reserved( convoihandle_t() );
 		if(schiene_t::show_reservations) {
 			set_flag( obj_t::dirty );
 		}
@@ -290,7 +347,7 @@ bool schiene_t::unreserve(vehicle_t*)
 		return true;
 	}
 //	if(!welt->lookup(get_pos())->suche_obj(v->get_typ())) {
-		reserved = convoihandle_t();
+		set_reserved( convoihandle_t() );
 		if(schiene_t::show_reservations) {
 			set_flag( obj_t::dirty );
 		}
@@ -411,7 +468,11 @@ void schiene_t::rdwr(loadsave_t *file)
 			}
 		}
 		file->rdwr_short(reserved_index);
-		reserved.set_id(reserved_index);
+		if (file->is_loading())
+		{
+			// added to the index of the convoy by index_loaded_reservations()
+			reserved.set_id(reserved_index);
+		}
 
 		uint8 t = (uint8)type;
 		file->rdwr_byte(t);
@@ -31,6 +31,12 @@ protected:
 	*/
 	convoihandle_t reserved;
 
+	/**
+	 * Position of this tile in the reservation index of the reserving convoy.
+	 * @see convoi_t::access_reserved_tiles
+	 */
+	uint32 reserved_tiles_index;
+
 	// The type of reservation
 	reservation_type type;
 
@@ -43,6 +49,14 @@ protected:
 
 	bool is_type_rail_type(waytype_t wt) { return wt == track_wt || wt == monorail_wt || wt == maglev_wt || wt == tram_wt || wt == narrowgauge_wt; }
 
+	/**
+	 * Sets the reserving convoy and moves this tile to its reservation index
+	 */
+	void set_reserved(convoihandle_t c);
+
+	/// @return true, if this tile is in the reservation index of the reserving convoy
+	bool is_reservation_indexed() const;
+
 public:
 	static const way_desc_t *default_schiene;
 
@@ -56,6 +70,15 @@ public:
 
 	schiene_t();
 
+	virtual ~schiene_t();
+
+	/**
+	 * Adds the reservations read from a savegame to the reservation index
+	 * of their convoys, and drops those of convoys which do not exist.
+	 * Must be called after the convoys are loaded.
+	 */
+	static void index_loaded_reservations();
+
 	/// @author prissi
 	void info(cbuffer_t &buf) const OVERRIDE;
 
@@ -58,7 +58,6 @@
 #ifdef MULTI_THREAD
 #include "../../utils/simthread.h"
 static pthread_mutex_t weg_calc_image_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
-static pthread_mutexattr_t mutex_attributes;
 #endif
 
 
@@ -68,6 +67,8 @@ static pthread_mutexattr_t mutex_attributes;
  */
 vector_tpl <weg_t *> alle_wege;
 
+thread_local vector_tpl<weg_t::pending_private_car_route_t> *weg_t::private_car_route_outbox = NULL;
+
 /**
  * Get list of all ways
  * @author Hj. Malthaner
@@ -359,10 +360,6 @@ void weg_t::init()
 	degraded = false;
 	remaining_wear_capacity = 100000000;
 	replacement_way = NULL;
-#ifdef MULTI_THREAD
-	pthread_mutexattr_init(&mutex_attributes);
-	pthread_mutex_init(&private_car_store_route_mutex, &mutex_attributes);
-#endif
 }
 
 
@@ -374,6 +371,7 @@ weg_t::~weg_t()
 		welt->await_private_car_threads();
 #endif
 		delete_all_routes_from_here();
+		way_graph_t::mark_dirty(this);
 
 		alle_wege.remove(this);
 		player_t *player = get_owner();
@@ -388,9 +386,6 @@ weg_t::~weg_t()
 			player_t::add_maintenance(player, -maint, desc->get_finance_waytype());
 		}
 	}
-#ifdef MULTI_THREAD
-	pthread_mutex_destroy(&private_car_store_route_mutex);
-#endif
 }
 
 
@@ -542,10 +537,10 @@ void weg_t::rdwr(loadsave_t *file)
 				{
 					uint32 private_car_routes_count = private_car_routes[i].get_count();
 					file->rdwr_long(private_car_routes_count);
-					FOR(private_car_route_map, element, private_car_routes[i])
+					FOR(private_car_route_map, const& element, private_car_routes[i])
 					{
-						koord destination = element.key;
-						koord3d next_tile = element.value;
+						koord destination = element.destination;
+						koord3d next_tile = private_car_route_map::get_next_tile(element, get_pos());
 
 						destination.rdwr(file);
 						next_tile.rdwr(file);
@@ -564,9 +559,8 @@ void weg_t::rdwr(loadsave_t *file)
 						destination.rdwr(file);
 						koord3d next_tile;
 						next_tile.rdwr(file);
-						bool put_succeeded = private_car_routes[i].put(destination, next_tile);
-						assert(put_succeeded);
-						(void)put_succeeded;
+						// The position of this way is only known in finish_rd()
+						private_car_routes[i].append_loaded(destination, next_tile);
 					}
 				}
 				if (route_array_number == 1)
@@ -698,7 +692,7 @@ void weg_t::info(cbuffer_t & buf) const
 			FOR(private_car_route_map, const& route, private_car_routes[private_car_routes_currently_reading_element])
 			{
 
-				const grund_t* gr = welt->lookup_kartenboden(route.key);
+				const grund_t* gr = welt->lookup_kartenboden(route.destination);
 				const gebaeude_t* building = gr ? gr->get_building() : NULL;
 				if (building)
 				{
@@ -709,8 +703,8 @@ void weg_t::info(cbuffer_t & buf) const
 #endif
 				}
 
-				const stadt_t* city = welt->get_city(route.key);
-				if (city && route.key == city->get_townhall_road())
+				const stadt_t* city = welt->get_city(route.destination);
+				if (city && route.destination == city->get_townhall_road())
 				{
 					cities_count++;
 #ifdef DEBUG
@@ -1564,6 +1558,15 @@ void weg_t::check_diagonal()
  * @author hsiegeln
  */
 void weg_t::new_month()
+{
+	if(!new_month_local())
+	{
+		wear_way(desc->get_monthly_base_wear());
+	}
+}
+
+
+bool weg_t::new_month_local()
 {
 	for (int type=0; type<MAX_WAY_STATISTICS; type++) {
 		for (int month=MAX_WAY_STAT_MONTHS-1; month>0; month--) {
@@ -1578,13 +1581,37 @@ void weg_t::new_month()
 		}
 		travel_times[0][type] = 0;
 	}
-	wear_way(desc->get_monthly_base_wear());
+
+	// Renewing or degrading the way charges the owner and changes the way,
+	// so these are left to wear_way() on the calling thread.
+	const uint32 wear = desc->get_monthly_base_wear();
+	if(wear && remaining_wear_capacity != UINT32_MAX_VALUE)
+	{
+		if(remaining_wear_capacity > wear)
+		{
+			if(remaining_wear_capacity - wear < desc->get_wear_capacity() / welt->get_settings().get_way_degradation_fraction())
+			{
+				return false;
+			}
+		}
+		else if(!is_degraded())
+		{
+			return false;
+		}
+	}
+	wear_way(wear);
+	return true;
 }
 
 
 // correct speed and maintenance
 void weg_t::finish_rd()
 {
+	for (uint32 i = 0; i < 2; i++)
+	{
+		private_car_routes[i].resolve_loaded(get_pos());
+	}
+
 	player_t *player=get_owner();
 	if(player && desc)
 	{
@@ -1887,20 +1914,46 @@ signal_t *weg_t::get_signal(ribi_t::ribi direction_of_travel) const
 	else return NULL;
 }
 
-void weg_t::add_private_car_route(koord destination, koord3d next_tile)
+void weg_t::commit_private_car_routes(const vector_tpl<pending_private_car_route_t> &routes)
 {
-#ifdef MULTI_THREAD
-	int error = pthread_mutex_lock(&private_car_store_route_mutex);
-	assert(error == 0);
-	(void)error;
-#endif
-	private_car_routes[get_private_car_routes_currently_writing_element()].set(destination, next_tile);
+	FOR(vector_tpl<pending_private_car_route_t>, const& route, routes)
+	{
+		// Look the way up again: it may have been removed since the route was found.
+		const grund_t* gr = welt->lookup(route.pos);
+		weg_t* const w = gr ? gr->get_weg(road_wt) : NULL;
+		if (w)
+		{
+			w->set_private_car_route(route.destination, route.next_tile);
+		}
+	}
+}
 
-	//private_car_routes_std[get_private_car_routes_currently_writing_element()].emplace(destination, next_tile); // Old performance test - but this was worse than the Simutrans type
-#ifdef MULTI_THREAD
-	error = pthread_mutex_unlock(&private_car_store_route_mutex);
-	assert(error == 0);
-#endif
+void weg_t::set_private_car_route(koord destination, koord3d next_tile)
+{
+	private_car_route_table_t &routes = private_car_routes[get_private_car_routes_currently_writing_element()];
+	if (!routes.set(destination, get_pos(), next_tile))
+	{
+		// The table only holds neighbouring tiles. Do not leave an outdated hop behind,
+		// as cars would follow it to the wrong tile.
+		const koord3d pos = get_pos();
+		dbg->error("weg_t::set_private_car_route()", "Cannot store the route to %i,%i at %i,%i,%i via %i,%i,%i", destination.x, destination.y, pos.x, pos.y, pos.z, next_tile.x, next_tile.y, next_tile.z);
+		routes.remove(destination, get_pos());
+	}
+}
+
+void weg_t::add_private_car_route(koord destination, koord3d next_tile)
+{
+	if (private_car_route_outbox)
+	{
+		pending_private_car_route_t route;
+		route.pos = get_pos();
+		route.destination = destination;
+		route.next_tile = next_tile;
+		private_car_route_outbox->append(route);
+		return;
+	}
+	// The table serialises concurrent writers itself, so no mutex is needed here.
+	set_private_car_route(destination, next_tile);
 #ifdef DEBUG_PRIVATE_CAR_ROUTES
 	calc_image();
 #endif
@@ -1912,16 +1965,12 @@ void weg_t::delete_all_routes_from_here(bool reading_set)
 
 	if (!private_car_routes[routes_index].empty())
 	{
+		// This must be done in a two stage process as the delete_route_to function will affect the very table being iterated.
 		vector_tpl<koord> destinations_to_delete;
-		FOR(private_car_route_map, const& route, private_car_routes[routes_index])
-		{
-			koord dest = route.key;
-			destinations_to_delete.append(dest);
-		}
+		private_car_routes[routes_index].get_destinations(destinations_to_delete);
 
 		FOR(vector_tpl<koord>, dest, destinations_to_delete)
 		{
-			// This must be done in a two stage process to avoid memory corruption as the delete_route_to function will affect the very hashtable being iterated.
 			delete_route_to(dest, reading_set);
 		}
 	}
@@ -1932,8 +1981,6 @@ void weg_t::delete_all_routes_from_here(bool reading_set)
 
 void weg_t::delete_route_to(koord destination, bool reading_set)
 {
-	const uint32 routes_index = reading_set ? private_car_routes_currently_reading_element : get_private_car_routes_currently_writing_element();
-
 	koord3d next_tile = get_pos();
 	koord3d this_tile = next_tile;
 	while (next_tile != koord3d::invalid && next_tile != koord3d(0, 0, 0))
@@ -1946,8 +1993,7 @@ void weg_t::delete_route_to(koord destination, bool reading_set)
 			weg_t* const w = gr->get_weg(road_wt);
 			if (w)
 			{
-				next_tile = w->private_car_routes[routes_index].get(destination);
-				w->remove_private_car_route(destination, reading_set);
+				next_tile = w->remove_private_car_route(destination, reading_set);
 			}
 		}
 		if (this_tile == next_tile)
@@ -1958,20 +2004,8 @@ void weg_t::delete_route_to(koord destination, bool reading_set)
 	}
 }
 
-void weg_t::remove_private_car_route(koord destination, bool reading_set)
+koord3d weg_t::remove_private_car_route(koord destination, bool reading_set)
 {
 	const uint32 routes_index = reading_set ? private_car_routes_currently_reading_element : get_private_car_routes_currently_writing_element();
-#ifdef MULTI_THREAD
-	int error = pthread_mutex_lock(&private_car_store_route_mutex);
-	assert(error == 0);
-	(void)error;
-#endif
-	private_car_routes[routes_index].remove(destination);
-	//private_car_routes_std[routes_index].erase(destination); // Old test - but this was much slower than the Simutrans hashtable.
-#ifdef MULTI_THREAD
-	error = pthread_mutex_unlock(&private_car_store_route_mutex);
-	assert(error == 0);
-	(void)error;
-#endif
-
+	return private_car_routes[routes_index].remove(destination, get_pos());
 }
@@ -7,19 +7,15 @@
 #define BODEN_WEGE_WEG_H
 
 
-#if 0
-// This was slower than the Simutrans koordhashtable
-#include <unordered_map>
-#endif
-
 #include "../../display/simimg.h"
 #include "../../simtypes.h"
 #include "../../simobj.h"
 #include "../../descriptor/way_desc.h"
 #include "../../dataobj/koord3d.h"
+#include "../../dataobj/way_graph.h"
 #include "../../tpl/minivec_tpl.h"
-#include "../../tpl/koordhashtable_tpl.h"
 #include "../../simskin.h"
+#include "private_car_route_table.h"
 
 #ifdef MULTI_THREAD
 #include "../../utils/simthread.h"
@@ -32,7 +28,6 @@ class player_t;
 class signal_t;
 class gebaeude_t;
 class stadt_t;
-class unordered_map;
 template <class T> class vector_tpl;
 
 
@@ -219,10 +214,6 @@ private:
 	// Whether the way is in a degraded state.
 	bool degraded:1;
 
-#ifdef MULTI_THREAD
-	pthread_mutex_t private_car_store_route_mutex;
-#endif
-
 protected:
 
 	enum image_type { image_flat, image_slope, image_diagonal, image_switch };
@@ -254,17 +245,42 @@ public:
 	minivec_tpl<gebaeude_t*> connected_buildings;
 
 	// Likewise, out of caution, put this here for the same reason.
-	typedef koordhashtable_tpl<koord, koord3d> private_car_route_map;
-	//typedef std::unordered_map<koord, koord3d> private_car_route_map_2;
+	typedef private_car_route_table_t private_car_route_map;
 	private_car_route_map private_car_routes[2];
-	//private_car_route_map_2 private_car_routes_std[2];
 	static uint32 private_car_routes_currently_reading_element;
 	static uint32 get_private_car_routes_currently_writing_element() { return private_car_routes_currently_reading_element == 1 ? 0 : 1; }
 
+	/// A private car route found by a route search which has yet to be stored in the writing set.
+	struct pending_private_car_route_t
+	{
+		koord3d pos;
+		koord destination;
+		koord3d next_tile;
+	};
+
+	/// If set, add_private_car_route() appends to this instead of writing to the route tables,
+	/// so that route searches running in parallel can be committed in a deterministic order.
+	static thread_local vector_tpl<pending_private_car_route_t> *private_car_route_outbox;
+
+	/// Stores routes collected in an outbox in the writing set. Single threaded only.
+	static void commit_private_car_routes(const vector_tpl<pending_private_car_route_t> &routes);
+
 	void add_private_car_route(koord dest, koord3d next_tile);
+
+private:
+	/// Stores a route in the writing set, removing the old route to dest if next_tile cannot be stored.
+	void set_private_car_route(koord dest, koord3d next_tile);
+
+public:
+
+	/// Whether the set currently used for reading has a route to dest.
+	bool has_private_car_route(koord dest) const { return private_car_routes[private_car_routes_currently_reading_element].is_contained(dest); }
+	/// The next tile towards dest in the set currently used for reading, or koord3d::invalid.
+	koord3d get_private_car_route(koord dest) const { return private_car_routes[private_car_routes_currently_reading_element].get(dest, get_pos()); }
 private:
 	/// Set the boolean value to true to modify the set currently used for reading (this must ONLY be done when this is called from a single threaded part of the code).
-	void remove_private_car_route(koord dest, bool reading_set = false);
+	/// @returns the next tile of the removed route, or koord3d::invalid
+	koord3d remove_private_car_route(koord dest, bool reading_set = false);
 public:
 	static void swap_private_car_routes_currently_reading_element() { private_car_routes_currently_reading_element = private_car_routes_currently_reading_element == 0 ? 1 : 0; }
 
@@ -387,7 +403,7 @@ public:
 	* zur Reparatur muß folgen).
 	* @param ribi Richtungsbits
 	*/
-	void ribi_add(ribi_t::ribi ribi) { this->ribi |= (uint8)ribi;}
+	void ribi_add(ribi_t::ribi ribi) { this->ribi |= (uint8)ribi; way_graph_t::mark_dirty(this); }
 
 	/**
 	* Remove direction bits (ribi) on a way.
@@ -397,7 +413,7 @@ public:
 	* zur Reparatur muß folgen).
 	* @param ribi Richtungsbits
 	*/
-	void ribi_rem(ribi_t::ribi ribi) { this->ribi &= (uint8)~ribi;}
+	void ribi_rem(ribi_t::ribi ribi) { this->ribi &= (uint8)~ribi; way_graph_t::mark_dirty(this); }
 
 	/**
 	* Set direction bits (ribi) for the way.
@@ -407,7 +423,7 @@ public:
 	* zur Reparatur muß folgen).
 	* @param ribi Richtungsbits
 	*/
-	void set_ribi(ribi_t::ribi ribi) { this->ribi = (uint8)ribi;}
+	void set_ribi(ribi_t::ribi ribi) { this->ribi = (uint8)ribi; way_graph_t::mark_dirty(this); }
 
 	/**
 	* Get the unmasked direction bits (ribi) for the way (without signals or other ribi changer).
@@ -424,7 +440,7 @@ public:
 	* damit Fahrzeuge nicht "von hinten" über Ampeln fahren können.
 	* @param ribi Richtungsbits
 	*/
-	void set_ribi_maske(ribi_t::ribi ribi) { ribi_maske = (uint8)ribi; }
+	void set_ribi_maske(ribi_t::ribi ribi) { ribi_maske = (uint8)ribi; way_graph_t::mark_dirty(this); }
 	ribi_t::ribi get_ribi_maske() const { return (ribi_t::ribi)ribi_maske; }
 
 	/**
@@ -454,6 +470,14 @@ public:
 	*/
 	void new_month();
 
+	/**
+	 * The part of new_month() which only changes this way: rolls the statistics
+	 * and applies the monthly wear, unless the wear renews or degrades the way.
+	 * Safe to run for several ways at once.
+	 * @returns false if the monthly wear is still to be applied with wear_way()
+	 */
+	bool new_month_local();
+
 	void check_diagonal();
 
 	void count_sign();
@@ -56,6 +56,7 @@ sint32 env_t::server_frames_ahead = 4;
 sint32 env_t::additional_client_frames_behind = 4;
 sint32 env_t::network_frames_per_step = 4;
 uint32 env_t::server_sync_steps_between_checks = 24;
+uint32 env_t::world_hash_sync_steps = 0;
 bool env_t::pause_server_no_clients = false;
 
 std::string env_t::nickname = "";
@@ -71,6 +71,10 @@ public:
 	/// @see karte_t::interactive()
 	static uint32 server_sync_steps_between_checks;
 
+	/// hash the world state (to find desyncs) every this number of sync_steps, 0 = off
+	/// @see world_hash_t
+	static uint32 world_hash_sync_steps;
+
 	/// when true, restore the windows from a savegame
 	static bool restore_UI;
 
@@ -23,6 +23,9 @@
 
 #include <zlib.h>
 #include <bzlib.h>
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
 
 #define INVALID_RDWR_ID (-1)
 
@@ -189,16 +192,62 @@ struct file_descriptors_t {
 	gzFile gzfp;
 	BZFILE *bzfp;
 	int bse;
-	file_descriptors_t() : fp(NULL), gzfp(NULL), bzfp(NULL), bse(BZ_OK+1) {}
+	loadsave_source_t *source; // loading: read instead of fp, not owned
+#ifdef USE_ZSTD
+	ZSTD_CCtx *zcctx;
+	ZSTD_DCtx *zdctx;
+	char *zbuf;          // saving: one compressed frame, loading: compressed data read from fp or source
+	size_t zbuf_size;
+	ZSTD_inBuffer zin;   // loading: the part of zbuf not yet decompressed
+	size_t zpending;     // loading: last hint of the decompressor, 0 at the end of a frame
+	char *zstage;        // saving: collects unbuffered writes up to a full frame
+	size_t zstage_len;
+	bool zeof;
+	bool zerror;
+#endif
+	file_descriptors_t() : fp(NULL), gzfp(NULL), bzfp(NULL), bse(BZ_OK+1), source(NULL)
+	{
+#ifdef USE_ZSTD
+		zcctx = NULL;
+		zdctx = NULL;
+		zbuf = NULL;
+		zbuf_size = 0;
+		zin.src = NULL;
+		zin.size = zin.pos = 0;
+		zpending = 0;
+		zstage = NULL;
+		zstage_len = 0;
+		zeof = zerror = false;
+#endif
+	}
 };
 
 
 loadsave_t::mode_t loadsave_t::save_mode = bzip2;	// default to use for saving
+#ifdef USE_ZSTD
+loadsave_t::mode_t loadsave_t::autosave_mode = zstd;	// default to use for autosaving
+#else
 loadsave_t::mode_t loadsave_t::autosave_mode = zipped;	// default to use for autosaving
+#endif
+int loadsave_t::save_zstd_level = 9;
+int loadsave_t::autosave_zstd_level = 1;
+
+
+bool loadsave_t::is_mode_supported(mode_t mode)
+{
+#ifdef USE_ZSTD
+	(void)mode;
+	return true;
+#else
+	return (mode & zstd) == 0;
+#endif
+}
+
 
 loadsave_t::loadsave_t() : filename()
 {
 	mode = 0;
+	zstd_level = save_zstd_level;
 	saving = false;
 	buffered = false;
 	fd = new file_descriptors_t();
@@ -221,6 +270,13 @@ void loadsave_t::set_buffered(bool enable)
 			buf_pos[0] = buf_pos[1] = 0;
 			buf_len[0] = buf_len[1] = 0;
 			ls_buf[0] = new char[LS_BUF_SIZE];
+#ifdef USE_ZSTD
+			if(  saving  &&  is_zstd()  &&  fd->zstage_len>0  ) {
+				// the header was written unbuffered
+				zstd_write_frame(fd->zstage, fd->zstage_len);
+				fd->zstage_len = 0;
+			}
+#endif
 #ifdef MULTI_THREAD
 			ls_buf[1] = new char[LS_BUF_SIZE]; // second buffer only when multithreaded
 
@@ -289,9 +345,26 @@ bool loadsave_t::rd_open(const char *filename_utf8 )
 		if(  buf[0]=='B'  &&  buf[1]=='Z'  ) {
 			mode = bzip2;
 		}
+		else if(  (uint8)buf[0]==0x28  &&  (uint8)buf[1]==0xB5  &&  (uint8)buf[2]==0x2F  &&  (uint8)buf[3]==0xFD  ) {
+			// magic number of a zstd frame
+			mode = zstd;
+		}
 		fseek(fd->fp,0,SEEK_SET);
 	}
 
+	if(  mode==zstd  ) {
+#ifdef USE_ZSTD
+		if(  !zstd_rd_open(buf, NULL, 0)  ) {
+			close();
+			return false;
+		}
+#else
+		dbg->error("loadsave_t::rd_open()", "%s is compressed with zstd, which is not supported by this build.", filename_utf8);
+		close();
+		return false;
+#endif
+	}
+
 	if(  mode==bzip2  ) {
 		fd->bse = BZ_OK+1;
 		fd->bzfp = NULL;
@@ -315,7 +388,7 @@ bool loadsave_t::rd_open(const char *filename_utf8 )
 		}
 	}
 
-	if(  mode!=bzip2  ) {
+	if(  mode!=bzip2  &&  mode!=zstd  ) {
 		fclose(fd->fp);
 		// and now with zlib ...
 		fd->gzfp = gzopen(filename, "rb");
@@ -324,6 +397,76 @@ bool loadsave_t::rd_open(const char *filename_utf8 )
 		}
 		gzgets(fd->gzfp, buf, 512);
 	}
+	return rd_header(buf, filename);
+}
+
+
+bool loadsave_t::rd_open(loadsave_source_t *source)
+{
+	close();
+
+	version = 0;
+	mode = zstd;
+	extended_version = 0;
+	extended_revision = 0;
+#ifdef USE_ZSTD
+	// only zstd can be decompressed while the data arrives, so check its magic number first
+	uint8 magic[4];
+	size_t len = 0;
+	while(  len<sizeof(magic)  ) {
+		const size_t n = source->read(magic + len, sizeof(magic) - len);
+		if(  n==0  ) {
+			return false;
+		}
+		len += n;
+	}
+	if(  magic[0]!=0x28  ||  magic[1]!=0xB5  ||  magic[2]!=0x2F  ||  magic[3]!=0xFD  ) {
+		return false;
+	}
+
+	fd->source = source;
+	char buf[512];
+	if(  !zstd_rd_open(buf, magic, sizeof(magic))  ) {
+		close();
+		return false;
+	}
+	return rd_header(buf, "");
+#else
+	(void)source;
+	return false;
+#endif
+}
+
+
+#ifdef USE_ZSTD
+bool loadsave_t::zstd_rd_open(char *buf, const uint8 *read_ahead, size_t read_ahead_len)
+{
+	fd->zdctx = ZSTD_createDCtx();
+	fd->zbuf_size = ZSTD_DStreamInSize();
+	fd->zbuf = new char[fd->zbuf_size];
+	fd->zin.src = fd->zbuf;
+	fd->zin.size = fd->zin.pos = 0;
+	if(  read_ahead_len>0  ) {
+		memcpy(fd->zbuf, read_ahead, read_ahead_len);
+		fd->zin.size = read_ahead_len;
+	}
+	fd->zpending = 0;
+	fd->zeof = fd->zerror = false;
+	memset(buf, 0, 512);
+	if(  fd->zdctx==NULL  ||  zstd_read(buf, sizeof(SAVEGAME_PREFIX))!=(int)sizeof(SAVEGAME_PREFIX)  ) {
+		return false;
+	}
+	// get the rest of the string
+	for (int i = sizeof(SAVEGAME_PREFIX); (uint8)buf[i - 1] >= 32 && i<511; i++) {
+		buf[i] = lsgetc();
+	}
+	return true;
+}
+#endif
+
+
+bool loadsave_t::rd_header(char *buf, const char *filename)
+{
 	saving = false;
 
 	if (strstart(buf, SAVEGAME_PREFIX)) {
@@ -414,6 +557,10 @@ void loadsave_t::rdwr_string(std::string &s) {
 
 bool loadsave_t::wr_open(const char *filename_utf8, mode_t m, const char *pak_extension, const char *savegame_version, const char *savegame_version_ex, const char *)
 {
+	if(  !is_mode_supported(m)  ) {
+		dbg->warning("loadsave_t::wr_open()", "Save mode %d is not supported by this build, using zipped instead.", m);
+		m = (mode_t)((m & xml) | zipped);
+	}
 	mode = m;
 	close();
 
@@ -439,6 +586,26 @@ bool loadsave_t::wr_open(const char *filename_utf8, mode_t m, const char *pak_ex
 			}
 		}
 	}
+#ifdef USE_ZSTD
+	else if(  is_zstd()  ) {
+		fd->fp = fopen(filename, "wb");
+		if(  fd->fp  ) {
+			fd->zcctx = ZSTD_createCCtx();
+			if(  fd->zcctx==NULL  ) {
+				fclose(fd->fp);
+				fd->fp = NULL;
+				return false;
+			}
+			ZSTD_CCtx_setParameter(fd->zcctx, ZSTD_c_compressionLevel, zstd_level);
+			ZSTD_CCtx_setParameter(fd->zcctx, ZSTD_c_checksumFlag, 1);
+			fd->zbuf_size = ZSTD_compressBound(LS_BUF_SIZE);
+			fd->zbuf = new char[fd->zbuf_size];
+			fd->zstage = new char[LS_BUF_SIZE];
+			fd->zstage_len = 0;
+			fd->zerror = false;
+		}
+	}
+#endif
 	else {
 		// uncompressed xml should be here ...
 		assert(  mode==xml  );
@@ -552,6 +719,25 @@ const char *loadsave_t::close()
 		fd->bzfp = fd->fp = NULL;
 		fd->bse = BZ_STREAM_END;
 	}
+#ifdef USE_ZSTD
+	if(  is_zstd()  ) {
+		if(  saving  &&  fd->fp  &&  fd->zstage_len>0  ) {
+			zstd_write_frame(fd->zstage, fd->zstage_len);
+			fd->zstage_len = 0;
+		}
+		if(  fd->zerror  ) {
+			success = "zstd error";
+		}
+		ZSTD_freeCCtx(fd->zcctx);
+		ZSTD_freeDCtx(fd->zdctx);
+		fd->zcctx = NULL;
+		fd->zdctx = NULL;
+		delete [] fd->zbuf;
+		delete [] fd->zstage;
+		fd->zbuf = fd->zstage = NULL;
+		fd->zin.size = fd->zin.pos = 0;
+	}
+#endif
 	if(  !is_bzip2()  &&  !is_zipped()  &&  fd->fp  ) {
 		int err_no = ferror(fd->fp);
 		fclose(fd->fp);
@@ -560,6 +746,7 @@ const char *loadsave_t::close()
 		}
 	}
 	fd->fp = NULL;
+	fd->source = NULL;
 
 	return success;
 }
@@ -573,7 +760,27 @@ const char *loadsave_t::close()
  */
 bool loadsave_t::is_eof()
 {
-	if(  is_bzip2()  ) {
+	if(  is_zstd()  ) {
+#ifdef USE_ZSTD
+		bool r;
+		if(  buffered  ) {
+#ifdef MULTI_THREAD
+			pthread_mutex_lock(&loadsave_mutex);
+#endif
+			r = buf_pos[0]>=buf_len[0]  &&  buf_pos[1]>=buf_len[1]  &&  (fd->zeof  ||  fd->zerror);
+#ifdef MULTI_THREAD
+			pthread_mutex_unlock(&loadsave_mutex);
+#endif
+		}
+		else {
+			r = fd->zeof  ||  fd->zerror;
+		}
+		return r;
+#else
+		return true;
+#endif
+	}
+	else if(  is_bzip2()  ) {
 		if(  buffered  ) {
 			bool r;
 #ifdef MULTI_THREAD
@@ -669,6 +876,25 @@ size_t loadsave_t::write(const void *buf, size_t len)
 			assert(fd->bse==BZ_OK);
 			return len;
 		}
+#ifdef USE_ZSTD
+		else if(  is_zstd()  ) {
+			// collect into frames of the same size as the buffered ones
+			const char *src = (const char *)buf;
+			size_t left = len;
+			while(  left>0  ) {
+				const size_t n = min(left, (size_t)LS_BUF_SIZE-fd->zstage_len);
+				memcpy(fd->zstage+fd->zstage_len, src, n);
+				fd->zstage_len += n;
+				src += n;
+				left -= n;
+				if(  fd->zstage_len==LS_BUF_SIZE  ) {
+					zstd_write_frame(fd->zstage, fd->zstage_len);
+					fd->zstage_len = 0;
+				}
+			}
+			return len;
+		}
+#endif
 		else {
 			return fwrite(buf, 1, len, fd->fp);
 		}
@@ -676,6 +902,79 @@ size_t loadsave_t::write(const void *buf, size_t len)
 }
 
 
+#ifdef USE_ZSTD
+bool loadsave_t::zstd_write_frame(const char *buf, size_t len)
+{
+	if(  len==0  ||  fd->zerror  ) {
+		return !fd->zerror;
+	}
+	// Each frame stands on its own, so they could also be decompressed independently.
+	const size_t n = ZSTD_compress2(fd->zcctx, fd->zbuf, fd->zbuf_size, buf, len);
+	if(  ZSTD_isError(n)  ) {
+		dbg->error("loadsave_t::zstd_write_frame()", "compression failed: %s", ZSTD_getErrorName(n));
+		fd->zerror = true;
+		return false;
+	}
+	if(  fwrite(fd->zbuf, 1, n, fd->fp)!=n  ) {
+		fd->zerror = true;
+		return false;
+	}
+	return true;
+}
+
+
+int loadsave_t::zstd_read(void *buf, size_t len)
+{
+	ZSTD_outBuffer out = { buf, len, 0 };
+	bool eof = false;
+	bool error = false;
+
+	while(  out.pos<out.size  ) {
+		if(  fd->zin.pos==fd->zin.size  ) {
+			const size_t n = fd->source ? fd->source->read(fd->zbuf, fd->zbuf_size) : fread(fd->zbuf, 1, fd->zbuf_size, fd->fp);
+			if(  n==0  ) {
+				if(  fd->zpending!=0  ) {
+					// the decoder may still hold some output
+					const size_t before = out.pos;
+					fd->zpending = ZSTD_decompressStream(fd->zdctx, &out, &fd->zin);
+					if(  !ZSTD_isError(fd->zpending)  &&  out.pos>before  ) {
+						continue;
+					}
+					// the last frame is incomplete
+					error = true;
+				}
+				eof = true;
+				break;
+			}
+			fd->zin.size = n;
+			fd->zin.pos = 0;
+		}
+		fd->zpending = ZSTD_decompressStream(fd->zdctx, &out, &fd->zin);
+		if(  ZSTD_isError(fd->zpending)  ) {
+			dbg->error("loadsave_t::zstd_read()", "decompression failed: %s", ZSTD_getErrorName(fd->zpending));
+			error = true;
+			break;
+		}
+	}
+
+#ifdef MULTI_THREAD
+	// the load thread calls this while the main thread checks is_eof()
+	if(  buffered  ) {
+		pthread_mutex_lock(&loadsave_mutex);
+	}
+#endif
+	fd->zeof |= eof;
+	fd->zerror |= error;
+#ifdef MULTI_THREAD
+	if(  buffered  ) {
+		pthread_mutex_unlock(&loadsave_mutex);
+	}
+#endif
+	return error ? -1 : (int)out.pos;
+}
+#endif
+
+
 void loadsave_t::flush_buffer(int buf_num)
 {
 	int bse = fd->bse;
@@ -686,6 +985,11 @@ void loadsave_t::flush_buffer(int buf_num)
 		BZ2_bzWrite( &bse, fd->bzfp, ls_buf[buf_num], buf_pos[buf_num]);
 		assert(bse==BZ_OK);
 	}
+#ifdef USE_ZSTD
+	else if(  is_zstd()  ) {
+		zstd_write_frame(ls_buf[buf_num], buf_pos[buf_num]);
+	}
+#endif
 	else {
 		fwrite(ls_buf[buf_num], 1, buf_pos[buf_num], fd->fp);
 	}
@@ -754,6 +1058,12 @@ size_t loadsave_t::read(void *buf, size_t len)
 			}
 			return fd->bse==BZ_OK ? len : 0;
 		}
+#ifdef USE_ZSTD
+		else if(  is_zstd()  ) {
+			const int r = zstd_read(buf, len);
+			return r>0 ? r : 0;
+		}
+#endif
 		else {
 			return gzread(fd->gzfp, buf, len);
 		}
@@ -778,6 +1088,11 @@ int loadsave_t::fill_buffer(int buf_num)
 			r = 0;
 		}
 	}
+#ifdef USE_ZSTD
+	else if(  is_zstd()  ) {
+		r = zstd_read(ls_buf[buf_num], LS_BUF_SIZE);
+	}
+#endif
 	else {
 		r = gzread(fd->gzfp, ls_buf[buf_num], LS_BUF_SIZE);
 	}
@@ -15,6 +15,23 @@
 class plainstring;
 struct file_descriptors_t;
 
+
+/**
+* Supplies a savegame which is loaded while it arrives, e.g. over the network
+* (see loadsave_t::rd_open(loadsave_source_t*)).
+*/
+class loadsave_source_t
+{
+public:
+	virtual ~loadsave_source_t() {}
+
+	/**
+	* Waits for up to len bytes. May be called from the load thread.
+	* @returns the number of bytes read, 0 at the end of the data or in case of error
+	*/
+	virtual size_t read(void *buf, size_t len) = 0;
+};
+
 /**
 * loadsave_t:
 *
@@ -23,6 +40,7 @@ struct file_descriptors_t;
 * Hj. Malthaner, 16-Feb-2002, added zlib compression support
 * </p>
 * Can now read and write 3 formats: text, binary and zipped
+* (and compressed by bzip2 or, if compiled with USE_ZSTD, zstd)
 * Input format is automatically detected.
 * Output format has a default, changeable with set_savemode, but can be
 * overwritten in wr_open.
@@ -33,7 +51,7 @@ struct file_descriptors_t;
 
 class loadsave_t {
 public:
-	enum mode_t { text = 1, xml = 2, binary = 0, zipped = 4, xml_zipped = 6, bzip2 = 8, xml_bzip2 = 10 };
+	enum mode_t { text = 1, xml = 2, binary = 0, zipped = 4, xml_zipped = 6, bzip2 = 8, xml_bzip2 = 10, zstd = 16, xml_zstd = 18 };
 
 private:
 	int mode;
@@ -47,6 +65,7 @@ private:
 	uint32 extended_version;
 	uint32 extended_revision; // Secondary saved game identifier for changing the save format without changing the major version.
 	int ident;		// only for XML formatting
+	int zstd_level;	// compression level when writing zstd
 	char pak_extension[256];	// name of the pak folder during savetime
 
 	std::string filename;	// the current name ...
@@ -61,6 +80,25 @@ private:
 	size_t write(const void * buf, size_t len);
 	size_t read(void *buf, size_t len);
 
+	/**
+	* zstd streams are written as one independent frame per buffer. Frames are
+	* compressed on the save thread while the main thread fills the other buffer.
+	* @returns false in case of error
+	*/
+	bool zstd_write_frame(const char *buf, size_t len);
+
+	/// decompresses up to len bytes, @returns the number of bytes or -1 in case of error
+	int zstd_read(void *buf, size_t len);
+
+	/**
+	* Starts decompressing zstd, with the first read_ahead_len bytes of the data
+	* already read, and reads the version string of the savegame into buf[512].
+	*/
+	bool zstd_rd_open(char *buf, const uint8 *read_ahead, size_t read_ahead_len);
+
+	/// parses the version string in buf and reads the rest of the header
+	bool rd_header(char *buf, const char *filename);
+
 	void rdwr_xml_number(sint64 &s, const char *typ);
 
 	loadsave_t(const loadsave_t&);
@@ -82,18 +120,32 @@ public:
 
 	static mode_t save_mode;	// default to use for saving
 	static mode_t autosave_mode; // default to use for autosaves and network mode client temp saves
+	static int save_zstd_level;     // zstd compression level for saving
+	static int autosave_zstd_level; // faster zstd compression level for autosaves and network mode client temp saves
 	static combined_version int_version(const char *version_text, int *mode, char *pak);
 
 	loadsave_t();
 	~loadsave_t();
 
 	bool rd_open(const char *filename);
+
+	/**
+	* Reads the savegame from source while it arrives. Only zstd savegames can be read
+	* this way; for others this returns false after consuming the first bytes of source.
+	*/
+	bool rd_open(loadsave_source_t *source);
 	bool wr_open(const char *filename, mode_t mode, const char *pak_extension, const char *savegame_version, const char *savegame_version_ex, const char *savegame_revision_ex);
 	const char *close();
 
 	static void set_savemode(mode_t mode) { save_mode = mode; }
 	static void set_autosavemode(mode_t mode) { autosave_mode = mode; }
 
+	/// @returns whether this build can read and write mode
+	static bool is_mode_supported(mode_t mode);
+
+	/// compression level of the next wr_open() in zstd mode
+	void set_zstd_level(int level) { zstd_level = level; }
+
 	/**
 	* Checks end-of-file
 	* @author Hj. Malthaner
@@ -106,6 +158,7 @@ public:
 	bool is_saving() const { return saving; }
 	bool is_zipped() const { return mode&zipped; }
 	bool is_bzip2() const { return mode&bzip2; }
+	bool is_zstd() const { return mode&zstd; }
 	bool is_xml() const { return mode&xml; }
 	uint32 get_version() const { return version; }
 	uint32 get_extended_version() const { return extended_version; }
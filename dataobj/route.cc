@@ -25,6 +25,7 @@
 #include "../obj/gebaeude.h"
 #include "../obj/roadsign.h"
 #include "environment.h"
+#include "way_graph.h"
 
 // define USE_VALGRIND_MEMCHECK to make
 // valgrind aware of the memory pool for A* nodes
@@ -36,13 +37,10 @@
 // if defined, print some profiling informations into the file
 //#define DEBUG_ROUTES
 
-// binary heap, the fastest
-#include "../tpl/binary_heap_tpl.h"
-
-
-#ifdef DEBUG_ROUTES
+#include "../bauer/vehikelbauer.h"
+#include "../descriptor/vehicle_desc.h"
 #include "../sys/simsys.h"
-#endif
+#include "../vehicle/simvehicle.h"
 
 bool route_t::suspend_private_car_routing = false;
 
@@ -125,6 +123,7 @@ bool route_t::append_straight_route(karte_t *welt, koord3d dest )
 thread_local uint32 route_t::MAX_STEP=0;
 thread_local uint32 route_t::max_used_steps=0;
 thread_local route_t::ANode *route_t::_nodes[MAX_NODES_ARRAY];
+thread_local route_t::node_queue_t *route_t::_queues[MAX_NODES_ARRAY];
 thread_local bool route_t::_nodes_in_use[MAX_NODES_ARRAY]; // semaphores, since we only have few nodes arrays in memory
 
 void route_t::INIT_NODES(uint32 max_route_steps, const koord &world_size)
@@ -132,6 +131,7 @@ void route_t::INIT_NODES(uint32 max_route_steps, const koord &world_size)
 	for (int i = 0; i < MAX_NODES_ARRAY; ++i)
 	{
 		_nodes[i] = NULL;
+		_queues[i] = NULL;
 		_nodes_in_use[i] = false;
 	}
 
@@ -141,6 +141,8 @@ void route_t::INIT_NODES(uint32 max_route_steps, const koord &world_size)
 	for (int i = 0; i < MAX_NODES_ARRAY; ++i)
 	{
 		_nodes[i] = new ANode[MAX_STEP + 4 + 2];
+		// the open list keeps its buckets between searches, so it stops allocating after the first few
+		_queues[i] = new node_queue_t();
 	}
 }
 
@@ -153,18 +155,25 @@ void route_t::TERM_NODES(void *)
 		{
 			delete [] _nodes[i];
 			_nodes[i] = NULL;
+			delete _queues[i];
+			_queues[i] = NULL;
 			_nodes_in_use[i] = false;
 		}
 	}
 }
 
-uint8 route_t::GET_NODES(ANode **nodes)
+uint8 route_t::GET_NODES(ANode **nodes, node_queue_t **queue)
 {
 	for (int i = 0; i < MAX_NODES_ARRAY; ++i)
 		if (!_nodes_in_use[i])
 		{
 			_nodes_in_use[i] = true;
 			*nodes = _nodes[i];
+			if (queue)
+			{
+				_queues[i]->clear();
+				*queue = _queues[i];
+			}
 			return i;
 		}
 	dbg->fatal("GET_NODE","called while list in use");
@@ -205,11 +214,6 @@ bool route_t::find_route(karte_t *welt, const koord3d start, test_driver_t *tdri
 	// nothing in lists
 	marker_t& marker = marker_t::instance(welt->get_size().x, welt->get_size().y, karte_t::marker_index);
 
-	binary_heap_tpl <ANode *> queue;
-
-	// nothing in lists
-	queue.clear();
-
 	// we clear it here probably twice: does not hurt ...
 	route.clear();
 
@@ -220,7 +224,9 @@ bool route_t::find_route(karte_t *welt, const koord3d start, test_driver_t *tdri
 	}
 
 	ANode *nodes;
-	uint8 ni = GET_NODES(&nodes);
+	node_queue_t *open;
+	uint8 ni = GET_NODES(&nodes, &open);
+	node_queue_t &queue = *open;
 
 #ifdef USE_VALGRIND_MEMCHECK
 	VALGRIND_MAKE_MEM_UNDEFINED(nodes, sizeof(ANode)*MAX_STEP);
@@ -240,7 +246,7 @@ bool route_t::find_route(karte_t *welt, const koord3d start, test_driver_t *tdri
 	tmp->dir = 0;
 
 	// start in open
-	queue.insert(tmp);
+	queue.insert(tmp->get_key(), tmp);
 
 	const grund_t* gr = NULL;
 	sint32 bridge_tile_count = 0;
@@ -615,7 +621,7 @@ bool route_t::find_route(karte_t *welt, const koord3d start, test_driver_t *tdri
 				k->dir = current_dir;
 
 				// insert here
-				queue.insert(k);
+				queue.insert(k->get_key(), k);
 			}
 		}
 
@@ -728,10 +734,10 @@ route_t::route_result_t route_t::intern_calc_route(karte_t *welt, const koord3d
 		INIT_NODES(welt->get_settings().get_max_route_steps(), welt->get_size());
 	}
 
-	binary_heap_tpl <ANode *> queue;
-
 	ANode *nodes;
-	uint8 ni = GET_NODES(&nodes);
+	node_queue_t *open;
+	uint8 ni = GET_NODES(&nodes, &open);
+	node_queue_t &queue = *open;
 
 #ifdef USE_VALGRIND_MEMCHECK
 	VALGRIND_MAKE_MEM_UNDEFINED(nodes, sizeof(ANode)*MAX_STEP);
@@ -758,9 +764,7 @@ route_t::route_result_t route_t::intern_calc_route(karte_t *welt, const koord3d
 	const grund_t* avoid_ground = welt->lookup(avoid_tile);
 	marker.mark(avoid_ground);
 
-	// clear the queue (should be empty anyhow)
-	queue.clear();
-	queue.insert(tmp);
+	queue.insert(tmp->get_key(), tmp);
 	ANode* new_top = NULL;
 
 	const uint8 enforce_weight_limits = welt->get_settings().get_enforce_weight_limits();
@@ -1058,12 +1062,12 @@ route_t::route_result_t route_t::intern_calc_route(karte_t *welt, const koord3d
 					// do not put in queue if the new node is the best one
 					topnode_f = new_f;
 					if (new_top) {
-						queue.insert(new_top);
+						queue.insert(new_top->get_key(), new_top);
 					}
 					new_top = k;
 				}
 				else {
-					queue.insert(k);
+					queue.insert(k->get_key(), k);
 				}
 			}
 		}
@@ -1217,6 +1221,40 @@ void route_t::postprocess_water_route(karte_t *welt)
 }
 
 
+route_t::route_result_t route_t::intern_calc_route_on_way_graph(karte_t *welt, const koord3d start, const koord3d ziel, test_driver_t* const tdriver, const sint32 max_speed, const sint64 max_cost, const uint32 axle_load, const uint32 convoy_weight, bool is_tall, const sint32 tile_length)
+{
+	const uint16 min_distance = welt->get_settings().get_way_graph_min_distance();
+	const way_graph_t *graph = way_graph_t::get_graph(tdriver->get_waytype());
+	vector_tpl<koord3d> waypoints;
+	if(  min_distance == 0  ||  graph == NULL  ||  shortest_distance(start.get_2d(), ziel.get_2d()) < min_distance  ||  !graph->find_waypoints(welt, start, ziel, waypoints)  ) {
+		return intern_calc_route(welt, start, ziel, tdriver, max_speed, max_cost, axle_load, convoy_weight, is_tall, tile_length, koord3d::invalid);
+	}
+	waypoints.append(ziel);
+
+	route.clear();
+	uint32 route_max_axle_load = MAXUINT32;
+	uint32 route_max_convoy_weight = MAXUINT32;
+	koord3d leg_start = start;
+	koord3d avoid_tile = koord3d::invalid;
+	route_t leg;
+	FOR(vector_tpl<koord3d>, const& waypoint, waypoints) {
+		if(  leg.intern_calc_route(welt, leg_start, waypoint, tdriver, max_speed, max_cost, axle_load, convoy_weight, is_tall, tile_length, avoid_tile) != valid_route  ) {
+			// the graph does not know about the vehicle: search the whole route instead
+			return intern_calc_route(welt, start, ziel, tdriver, max_speed, max_cost, axle_load, convoy_weight, is_tall, tile_length, koord3d::invalid);
+		}
+		route_max_axle_load = min(route_max_axle_load, leg.max_axle_load);
+		route_max_convoy_weight = min(route_max_convoy_weight, leg.max_convoy_weight);
+		// do not turn back at the junction
+		avoid_tile = leg.get_count() >= 2 ? leg.at(leg.get_count() - 2) : koord3d::invalid;
+		append(&leg);
+		leg_start = waypoint;
+	}
+	max_axle_load = route_max_axle_load;
+	max_convoy_weight = route_max_convoy_weight;
+	return valid_route;
+}
+
+
 /* searches route, uses intern_calc_route() for distance between stations
  * handles only driving in stations by itself
  * corrected 12/2005 for station search
@@ -1236,11 +1274,34 @@ void route_t::postprocess_water_route(karte_t *welt)
 	}
 //	INT_CHECK("route 336");
 
+	if(  max_recorded_queries.load(std::memory_order_relaxed) > 0  ) {
+		recorded_query_t query;
+		query.start = start;
+		query.ziel = ziel;
+		query.waytype = tdriver->get_waytype();
+		query.max_speed = max_khm;
+		query.axle_load = axle_load;
+		query.convoy_weight = convoy_weight;
+		query.max_len = max_len;
+		query.max_cost = max_cost;
+		query.avoid_tile = avoid_tile;
+		query.direction = direction;
+		query.is_tall = is_tall;
+		query.flags = flags;
+		record_query(query);
+	}
+
 #ifdef DEBUG_ROUTES
 	// profiling for routes ...
 	long ms=dr_time();
 #endif
-	route_result_t ok = intern_calc_route(welt, start, ziel, tdriver, max_khm, max_cost, axle_load, convoy_weight, is_tall, max_len, avoid_tile, direction, flags);
+	route_result_t ok;
+	if(  flags == use_way_graph  &&  avoid_tile == koord3d::invalid  &&  direction == ribi_t::all  ) {
+		ok = intern_calc_route_on_way_graph(welt, start, ziel, tdriver, max_khm, max_cost, axle_load, convoy_weight, is_tall, max_len);
+	}
+	else {
+		ok = intern_calc_route(welt, start, ziel, tdriver, max_khm, max_cost, axle_load, convoy_weight, is_tall, max_len, avoid_tile, direction, flags);
+	}
 #ifdef DEBUG_ROUTES
 	if(tdriver->get_waytype()==water_wt) {DBG_DEBUG("route_t::calc_route()","route from %d,%d to %d,%d with %i steps in %u ms found.",start.x, start.y, ziel.x, ziel.y, route.get_count()-1, dr_time()-ms );}
 #endif
@@ -1380,3 +1441,92 @@ void route_t::rdwr(loadsave_t *file)
 	}
 }
 
+
+vector_tpl<route_t::recorded_query_t> route_t::recorded_queries;
+std::atomic<uint32> route_t::max_recorded_queries(0);
+#ifdef MULTI_THREAD
+pthread_mutex_t route_t::recorded_queries_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+void route_t::record_queries(uint32 max_queries)
+{
+#ifdef MULTI_THREAD
+	pthread_mutex_lock(&recorded_queries_mutex);
+#endif
+	recorded_queries.clear();
+	recorded_queries.resize(max_queries);
+	max_recorded_queries = max_queries;
+#ifdef MULTI_THREAD
+	pthread_mutex_unlock(&recorded_queries_mutex);
+#endif
+}
+
+
+void route_t::record_query(const recorded_query_t &query)
+{
+#ifdef MULTI_THREAD
+	pthread_mutex_lock(&recorded_queries_mutex);
+#endif
+	if(  recorded_queries.get_count() < max_recorded_queries  ) {
+		recorded_queries.append(query);
+		if(  recorded_queries.get_count() == max_recorded_queries  ) {
+			// recording is complete
+			max_recorded_queries = 0;
+		}
+	}
+#ifdef MULTI_THREAD
+	pthread_mutex_unlock(&recorded_queries_mutex);
+#endif
+}
+
+
+uint32 route_t::replay_recorded_queries(karte_t *welt, uint32 passes)
+{
+	if(  recorded_queries.empty()  ) {
+		dbg->message("route_t::replay_recorded_queries()", "no queries recorded");
+		return 0;
+	}
+
+	// one default vehicle per waytype, like the way remover uses for its searches
+	vehicle_t *drivers[air_wt + 1];
+	for(  int i = 0;  i <= air_wt;  i++  ) {
+		drivers[i] = NULL;
+	}
+	FOR(vector_tpl<recorded_query_t>, const& q, recorded_queries) {
+		// other searches (e.g. powerlines) do not use vehicles
+		if(  q.waytype <= ignore_wt  ||  q.waytype > air_wt  ||  q.waytype == overheadlines_wt  ||  drivers[q.waytype]  ) {
+			continue;
+		}
+		vehicle_desc_t *desc = new vehicle_desc_t(q.waytype, 500, vehicle_desc_t::diesel);
+		drivers[q.waytype] = vehicle_builder_t::build(q.start, welt->get_public_player(), NULL, desc);
+		drivers[q.waytype]->set_flag(obj_t::not_on_map);
+	}
+
+	uint32 valid = 0;
+	uint32 tiles = 0;
+	const uint32 ms = dr_time();
+	for(  uint32 pass = 0;  pass < passes;  pass++  ) {
+		FOR(vector_tpl<recorded_query_t>, const& q, recorded_queries) {
+			if(  q.waytype <= ignore_wt  ||  q.waytype > air_wt  ||  !drivers[q.waytype]  ) {
+				continue;
+			}
+			route_t route;
+			if(  route.intern_calc_route(welt, q.start, q.ziel, drivers[q.waytype], q.max_speed, q.max_cost, q.axle_load, q.convoy_weight, q.is_tall, q.max_len, q.avoid_tile, q.direction, q.flags) == valid_route  ) {
+				valid++;
+				tiles += route.get_count();
+			}
+		}
+	}
+	const uint32 elapsed = dr_time() - ms;
+	dbg->message("route_t::replay_recorded_queries()", "%u passes of %u queries took %u ms (%u valid routes, %u tiles)", passes, recorded_queries.get_count(), elapsed, valid, tiles);
+
+	for(  int i = 0;  i <= air_wt;  i++  ) {
+		if(  drivers[i]  ) {
+			const vehicle_desc_t *desc = drivers[i]->get_desc();
+			delete drivers[i];
+			delete desc;
+		}
+	}
+	return elapsed;
+}
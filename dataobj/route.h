@@ -7,11 +7,14 @@
 #define DATAOBJ_ROUTE_H
 
 
+#include <atomic>
+
 #include "../simdebug.h"
 
 #include "../dataobj/koord3d.h"
 
 #include "../tpl/vector_tpl.h"
+#include "../tpl/radix_heap_tpl.h"
 
 #include "../utils/simthread.h"
 
@@ -33,7 +36,8 @@ private:
 public:
 	typedef enum { no_route = 0, valid_route = 1, valid_route_halt_too_short = 3, route_too_complex = 4, no_control_tower = 5 } route_result_t;
 
-	enum find_route_flags { none, private_car_checker, choose_signal, simple_cost };
+	/// use_way_graph: as none, but long searches are guided by the junction graph (see way_graph_t)
+	enum find_route_flags { none, private_car_checker, choose_signal, simple_cost, use_way_graph };
 
 private:
 
@@ -43,6 +47,13 @@ private:
 	 */
 	route_result_t intern_calc_route(karte_t *w, koord3d start, koord3d ziel, test_driver_t* const tdriver, const sint32 max_kmh, const sint64 max_cost, const uint32 axle_load, const uint32 convoy_weight, bool is_tall, const sint32 tile_length, const koord3d avoid_tile, uint8 start_dir = ribi_t::all, find_route_flags flags = none);
 
+	/**
+	 * Long route search: finds junctions along the route on the way graph and
+	 * searches tile by tile between them. Falls back to a plain search if
+	 * there is no graph, the route is too short, or a leg cannot be found.
+	 */
+	route_result_t intern_calc_route_on_way_graph(karte_t *w, koord3d start, koord3d ziel, test_driver_t* const tdriver, const sint32 max_kmh, const sint64 max_cost, const uint32 axle_load, const uint32 convoy_weight, bool is_tall, const sint32 tile_length);
+
 protected:
 	koord3d_vector_t route;           // The coordinates for the vehicle route
 
@@ -79,22 +90,72 @@ public:
 
 		/// sort nodes first with respect to f, then with respect to g
 		inline bool operator <= (const ANode &k) const { return f==k.f ? g<=k.g : f<=k.f; }
+
+		/// the same order as a single integer key for the open list
+		inline uint64 get_key() const { return ((uint64)f << 32) | g; }
+	};
+
+	/// open list of the searches; one per node array, reused for every search
+	typedef radix_heap_tpl<ANode *> node_queue_t;
+
+	/// A calc_route() query as recorded by record_queries()
+	struct recorded_query_t
+	{
+		koord3d start;
+		koord3d ziel;
+		waytype_t waytype;
+		sint32 max_speed;
+		uint32 axle_load;
+		uint32 convoy_weight;
+		sint32 max_len;
+		sint64 max_cost;
+		koord3d avoid_tile;
+		uint8 direction;
+		bool is_tall;
+		find_route_flags flags;
 	};
 
 private:
 	static const uint8 MAX_NODES_ARRAY = 2;
 	static thread_local ANode *_nodes[MAX_NODES_ARRAY];
+	static thread_local node_queue_t *_queues[MAX_NODES_ARRAY];
 	static thread_local bool _nodes_in_use[MAX_NODES_ARRAY]; // semaphores, since we only have few nodes arrays in memory
+
+	static vector_tpl<recorded_query_t> recorded_queries;
+	/// checked by calc_route() without the mutex, so reading it must not race with record_query()
+	static std::atomic<uint32> max_recorded_queries;
+#ifdef MULTI_THREAD
+	static pthread_mutex_t recorded_queries_mutex;
+#endif
+
+	static void record_query(const recorded_query_t &query);
+
 public:
 	static thread_local uint32 MAX_STEP;
 	static thread_local uint32 max_used_steps;
 	static void INIT_NODES(uint32 max_route_steps, const koord &world_size);
-	static uint8 GET_NODES(ANode **nodes);
+	/// reserves a node array and, if queue is given, the (empty) open list belonging to it
+	static uint8 GET_NODES(ANode **nodes, node_queue_t **queue = NULL);
 	static void RELEASE_NODES(uint8 nodes_index);
 	static void TERM_NODES(void* args = NULL);
 
 	static bool suspend_private_car_routing;
 
+	/**
+	 * Micro benchmark of the route search: the next @p max_queries calls of
+	 * calc_route() are recorded (any earlier recording is discarded).
+	 */
+	static void record_queries(uint32 max_queries);
+
+	static uint32 get_recorded_query_count() { return recorded_queries.get_count(); }
+
+	/**
+	 * Runs the recorded queries @p passes times with a default vehicle of the
+	 * recorded waytype as test driver and logs the time taken.
+	 * @returns the time in ms
+	 */
+	static uint32 replay_recorded_queries(karte_t *welt, uint32 passes);
+
 	const koord3d_vector_t &get_route() const { return route; }
 
 	uint32 get_max_axle_load() const { return max_axle_load; }
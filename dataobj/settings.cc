@@ -174,6 +174,7 @@ settings_t::settings_t() :
 
 	max_route_steps = 1000000;
 	max_choose_route_steps = 200;
+	way_graph_min_distance = 0;
 	max_transfers = 9;
 	max_hops = 2000;
 
@@ -1903,6 +1904,15 @@ void settings_t::rdwr(loadsave_t *file)
 				industry_density_proportion_override = 0;
 			}
 		}
+
+		if (file->get_extended_version() >= 15 || (file->get_extended_version() == 14 && file->get_extended_revision() >= 33))
+		{
+			file->rdwr_short(way_graph_min_distance);
+		}
+		else if (file->is_loading())
+		{
+			way_graph_min_distance = 0;
+		}
 	}
 
 
@@ -2065,6 +2075,7 @@ void settings_t::parse_simuconf(tabfile_t& simuconf, sint16& disp_width, sint16&
 	env_t::additional_client_frames_behind = contents.get_int("additional_client_frames_behind", env_t::additional_client_frames_behind);
 	env_t::network_frames_per_step = contents.get_int("server_frames_per_step", env_t::network_frames_per_step );
 	env_t::server_sync_steps_between_checks = contents.get_int("server_frames_between_checks", env_t::server_sync_steps_between_checks );
+	env_t::world_hash_sync_steps = contents.get_int("world_hash_frames", env_t::world_hash_sync_steps );
 	env_t::pause_server_no_clients = contents.get_int("pause_server_no_clients", env_t::pause_server_no_clients );
 	env_t::server_save_game_on_quit = contents.get_int("server_save_game_on_quit", env_t::server_save_game_on_quit );
 	env_t::reload_and_save_on_quit = contents.get_int("reload_and_save_on_quit", env_t::reload_and_save_on_quit );
@@ -2256,6 +2267,7 @@ void settings_t::parse_simuconf(tabfile_t& simuconf, sint16& disp_width, sint16&
 
 	max_route_steps = contents.get_int("max_route_steps", max_route_steps );
 	max_choose_route_steps = contents.get_int("max_choose_route_steps", max_choose_route_steps );
+	way_graph_min_distance = contents.get_int("way_graph_min_distance", way_graph_min_distance );
 	max_hops = contents.get_int("max_hops", max_hops );
 	max_transfers = contents.get_int("max_transfers", max_transfers );
 
@@ -2991,6 +3003,15 @@ void settings_t::parse_simuconf(tabfile_t& simuconf, sint16& disp_width, sint16&
 	else if(strcmp(str, "xml_bzip2") == 0) {
 		loadsave_t::set_savemode(loadsave_t::xml_bzip2 );
 	}
+	else if(strcmp(str, "zstd") == 0  ||  strcmp(str, "xml_zstd") == 0) {
+		const loadsave_t::mode_t mode = strcmp(str, "zstd") == 0 ? loadsave_t::zstd : loadsave_t::xml_zstd;
+		if(  loadsave_t::is_mode_supported(mode)  ) {
+			loadsave_t::set_savemode( mode );
+		}
+		else {
+			dbg->warning("settings_t::parse_simuconf()", "saveformat: %s is not supported by this build.", str);
+		}
+	}
 
 	str = contents.get("autosaveformat" );
 	while (*str == ' ') str++;
@@ -3012,6 +3033,18 @@ void settings_t::parse_simuconf(tabfile_t& simuconf, sint16& disp_width, sint16&
 	else if(strcmp(str, "xml_bzip2") == 0) {
 		loadsave_t::set_autosavemode(loadsave_t::xml_bzip2 );
 	}
+	else if(strcmp(str, "zstd") == 0  ||  strcmp(str, "xml_zstd") == 0) {
+		const loadsave_t::mode_t mode = strcmp(str, "zstd") == 0 ? loadsave_t::zstd : loadsave_t::xml_zstd;
+		if(  loadsave_t::is_mode_supported(mode)  ) {
+			loadsave_t::set_autosavemode( mode );
+		}
+		else {
+			dbg->warning("settings_t::parse_simuconf()", "autosaveformat: %s is not supported by this build.", str);
+		}
+	}
+
+	loadsave_t::save_zstd_level = contents.get_int("save_zstd_level", loadsave_t::save_zstd_level );
+	loadsave_t::autosave_zstd_level = contents.get_int("autosave_zstd_level", loadsave_t::autosave_zstd_level );
 
 	/*
 	 * Default resolution
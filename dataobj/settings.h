@@ -248,6 +248,10 @@ private:
 	// maximum length for route search at signs/signals
 	sint32 max_choose_route_steps;
 
+	// vehicle route searches of at least this straight line distance (in tiles)
+	// are guided by the junction graph of the ways (see way_graph_t); 0 = never
+	uint16 way_graph_min_distance;
+
 	// max steps for good routing
 	sint32 max_hops;
 
@@ -863,6 +867,7 @@ public:
 
 	sint32 get_max_route_steps() const { return max_route_steps; }
 	sint32 get_max_choose_route_steps() const { return max_choose_route_steps; }
+	uint16 get_way_graph_min_distance() const { return way_graph_min_distance; }
 	sint32 get_max_hops() const { return max_hops; }
 	sint32 get_max_transfers() const { return max_transfers; }
 
@@ -0,0 +1,489 @@
+/*
+ * This file is part of the Simutrans-Extended project under the Artistic License.
+ * (see LICENSE.txt)
+ */
+
+#include <algorithm>
+
+#include "way_graph.h"
+#include "../simworld.h"
+#include "../simplan.h"
+#include "../boden/grund.h"
+#include "../boden/wege/weg.h"
+#include "../tpl/radix_heap_tpl.h"
+
+
+way_graph_t *way_graph_t::graphs[narrowgauge_wt + 1];
+
+
+namespace {
+	/// Search state of find_waypoints(), kept per thread and reused.
+	/// States are node index * 4 + index of the direction of arrival.
+	struct search_memory_t
+	{
+		vector_tpl<uint32> cost;
+		vector_tpl<uint32> parent;
+		vector_tpl<uint32> stamp;   ///< state is valid in this generation
+		vector_tpl<uint32> closed;  ///< state was expanded in this generation
+		radix_heap_tpl<uint32> open;
+		uint32 generation;
+
+		search_memory_t() : generation(0) {}
+
+		void init(uint32 states)
+		{
+			if(  stamp.get_count() < states  ) {
+				cost.set_count(states);
+				parent.set_count(states);
+				stamp.set_count(states);
+				closed.set_count(states);
+				generation = 0;
+			}
+			if(  generation == 0  ) {
+				// new memory or generation overflow
+				for(  uint32 i = 0;  i < stamp.get_count();  i++  ) {
+					stamp[i] = 0;
+					closed[i] = 0;
+				}
+			}
+			generation++;
+			open.clear();
+		}
+	};
+
+	static thread_local search_memory_t search_memory;
+
+	static const uint32 NO_PARENT = 0xFFFFFFFFu;
+	static const uint32 TARGET = 0xFFFFFFFEu;
+
+	/// limit for chains of tiles, only reached on inconsistent ways
+	static const uint32 MAX_TRACE_LENGTH = 1u << 24;
+
+	static uint8 nsew_index(ribi_t::ribi dir)
+	{
+		for(  uint8 i = 0;  i < 4;  i++  ) {
+			if(  ribi_t::nsew[i] == dir  ) {
+				return i;
+			}
+		}
+		return 0;
+	}
+
+	/// the reverse of nsew[i] is nsew[i^1]
+	static inline uint8 reverse_index(uint8 i) { return i ^ 1; }
+}
+
+
+sint32 way_graph_t::index_of(const koord3d &pos) const
+{
+	uint32 first = 0;
+	uint32 len = nodes.get_count();
+	while(  len > 0  ) {
+		const uint32 half = len / 2;
+		if(  less(nodes[first + half].pos, pos)  ) {
+			first += half + 1;
+			len -= half + 1;
+		}
+		else {
+			len = half;
+		}
+	}
+	return first < nodes.get_count()  &&  nodes[first].pos == pos ? (sint32)first : -1;
+}
+
+
+const weg_t *way_graph_t::get_way(const grund_t *gr) const
+{
+	const weg_t *w = gr->get_weg(waytype);
+	return w  &&  w->get_ribi_unmasked() != ribi_t::none ? w : NULL;
+}
+
+
+bool way_graph_t::trace(const grund_t *gr, uint8 dir, trace_t &t) const
+{
+	// as in route_t::intern_calc_route(): one way signs, but signals on tracks can be passed backwards
+	const bool signals_pass = waytype != road_wt;
+	const koord3d origin = gr->get_pos();
+	const weg_t *w = get_way(gr);
+
+	t.length = 0;
+	t.blocked = false;
+	t.blocked_back = false;
+	while(  t.length < MAX_TRACE_LENGTH  ) {
+		const ribi_t::ribi d = ribi_t::nsew[dir];
+		// driving the other way, we would enter this tile against d
+		if(  (w->get_ribi_maske() & ribi_t::reverse_single(d))  &&  !(signals_pass  &&  w->has_signal())  ) {
+			t.blocked_back = true;
+		}
+
+		grund_t *to;
+		if(  !gr->get_neighbour(to, waytype, d)  ) {
+			return false;
+		}
+		const weg_t *next = get_way(to);
+		if(  next == NULL  ||  (next->get_ribi_unmasked() & ribi_t::reverse_single(d)) == 0  ) {
+			return false;
+		}
+		t.length++;
+		if(  (next->get_ribi_maske() & d)  &&  !(signals_pass  &&  next->has_signal())  ) {
+			t.blocked = true;
+		}
+
+		const ribi_t::ribi ribi = next->get_ribi_unmasked();
+		if(  is_node(ribi)  ) {
+			t.end = to->get_pos();
+			t.arrival = dir;
+			return true;
+		}
+		if(  to->get_pos() == origin  ) {
+			// a loop without any junction
+			return false;
+		}
+		dir = nsew_index(ribi & ~ribi_t::reverse_single(d));
+		gr = to;
+		w = next;
+	}
+	return false;
+}
+
+
+void way_graph_t::init_node(const grund_t *gr, ribi_t::ribi ribi, node_t &node) const
+{
+	node.pos = gr->get_pos();
+	node.ribi = ribi;
+	for(  uint8 i = 0;  i < 4;  i++  ) {
+		edge_t &e = node.edges[i];
+		trace_t t;
+		if(  (ribi & ribi_t::nsew[i])  &&  trace(gr, i, t)  ) {
+			e.to = t.end;
+			e.length = t.length;
+			e.arrival = t.arrival;
+			e.blocked = t.blocked;
+		}
+		else {
+			e.to = koord3d::invalid;
+			e.length = 0;
+			e.arrival = 0;
+			e.blocked = true;
+		}
+	}
+}
+
+
+void way_graph_t::build(karte_t *welt)
+{
+	nodes.clear();
+	dirty.clear();
+	FOR(vector_tpl<weg_t *>, const w, weg_t::get_alle_wege()) {
+		if(  w->get_waytype() != waytype  ||  !is_node(w->get_ribi_unmasked())  ) {
+			continue;
+		}
+		const grund_t *gr = welt->lookup(w->get_pos());
+		if(  gr == NULL  ||  gr->get_weg(waytype) != w  ) {
+			// not (yet) on the map
+			continue;
+		}
+		node_t node;
+		init_node(gr, w->get_ribi_unmasked(), node);
+		nodes.append(node);
+	}
+	std::sort(nodes.begin(), nodes.end(), [](const node_t &a, const node_t &b) { return less(a.pos, b.pos); });
+	built = true;
+	DBG_MESSAGE("way_graph_t::build()", "%u nodes for waytype %i", nodes.get_count(), waytype);
+}
+
+
+void way_graph_t::repair(karte_t *welt)
+{
+	// The node state can only change on changed tiles. New ways are only
+	// marked once placed, but their neighbours were marked when connecting.
+	vector_tpl<koord3d> area;
+	FOR(vector_tpl<koord3d>, const& pos, dirty) {
+		area.append(pos);
+		for(  uint8 i = 0;  i < 4;  i++  ) {
+			if(  const planquadrat_t *pl = welt->access(pos.get_2d() + koord::nsew[i])  ) {
+				for(  uint32 j = 0;  j < pl->get_boden_count();  j++  ) {
+					const grund_t *gr = pl->get_boden_bei(j);
+					if(  gr->get_weg(waytype)  ) {
+						area.append(gr->get_pos());
+					}
+				}
+			}
+		}
+	}
+	std::sort(area.begin(), area.end(), less);
+	area.set_count((uint32)(std::unique(area.begin(), area.end()) - area.begin()));
+
+	// Every edge through the area ends in a node which is reached by following
+	// the chains from the area: these are recomputed, as well as the area itself.
+	vector_tpl<koord3d> changed(area.get_count() * 2);
+	FOR(vector_tpl<koord3d>, const& pos, area) {
+		changed.append(pos);
+		const grund_t *gr = welt->lookup(pos);
+		const weg_t *w = gr ? get_way(gr) : NULL;
+		if(  w == NULL  ||  is_node(w->get_ribi_unmasked())  ) {
+			continue;
+		}
+		for(  uint8 i = 0;  i < 4;  i++  ) {
+			trace_t t;
+			if(  (w->get_ribi_unmasked() & ribi_t::nsew[i])  &&  trace(gr, i, t)  ) {
+				changed.append(t.end);
+			}
+		}
+	}
+	std::sort(changed.begin(), changed.end(), less);
+	changed.set_count((uint32)(std::unique(changed.begin(), changed.end()) - changed.begin()));
+
+	vector_tpl<node_t> updated;
+	FOR(vector_tpl<koord3d>, const& pos, changed) {
+		const grund_t *gr = welt->lookup(pos);
+		const weg_t *w = gr ? get_way(gr) : NULL;
+		if(  w  &&  is_node(w->get_ribi_unmasked())  ) {
+			node_t node;
+			init_node(gr, w->get_ribi_unmasked(), node);
+			updated.append(node);
+		}
+	}
+
+	// merge the recomputed nodes into the unchanged ones
+	vector_tpl<node_t> merged(nodes.get_count() + updated.get_count());
+	uint32 c = 0;
+	uint32 u = 0;
+	FOR(vector_tpl<node_t>, const& node, nodes) {
+		while(  c < changed.get_count()  &&  less(changed[c], node.pos)  ) {
+			c++;
+		}
+		if(  c < changed.get_count()  &&  changed[c] == node.pos  ) {
+			// replaced or removed
+			continue;
+		}
+		while(  u < updated.get_count()  &&  less(updated[u].pos, node.pos)  ) {
+			merged.append(updated[u++]);
+		}
+		merged.append(node);
+	}
+	while(  u < updated.get_count()  ) {
+		merged.append(updated[u++]);
+	}
+	swap(nodes, merged);
+	dirty.clear();
+}
+
+
+const way_graph_t *way_graph_t::get_graph(waytype_t wt)
+{
+	if(  !is_supported(wt)  ) {
+		return NULL;
+	}
+	const way_graph_t *g = graphs[wt];
+	return g  &&  g->built  &&  g->dirty.empty() ? g : NULL;
+}
+
+
+void way_graph_t::mark_dirty(const weg_t *w)
+{
+	const waytype_t wt = w->get_waytype();
+	if(  !is_supported(wt)  ||  graphs[wt] == NULL  ||  !graphs[wt]->built  ) {
+		return;
+	}
+	const koord3d pos = w->get_pos();
+	if(  pos == koord3d::invalid  ) {
+		// not yet placed, will be marked when it is
+		return;
+	}
+#ifdef MULTI_THREAD_CONVOYS
+	// the convoy threads read the graph and dirty while searching, and in network games
+	// whether a convoy searches before or after the graph becomes dirty must not depend on timing
+	world()->await_convoy_threads();
+#endif
+	graphs[wt]->dirty.append(pos);
+}
+
+
+void way_graph_t::update(karte_t *welt)
+{
+	const bool enabled = welt->get_settings().get_way_graph_min_distance() > 0;
+	for(  int i = 0;  i <= narrowgauge_wt;  i++  ) {
+		const waytype_t wt = (waytype_t)i;
+		if(  !is_supported(wt)  ) {
+			continue;
+		}
+		if(  !enabled  ) {
+			delete graphs[wt];
+			graphs[wt] = NULL;
+			continue;
+		}
+		if(  graphs[wt] == NULL  ) {
+			graphs[wt] = new way_graph_t(wt);
+		}
+		way_graph_t *g = graphs[wt];
+		// repairing gives the same graph as building, so choose whatever is faster
+		if(  !g->built  ||  g->dirty.get_count() > g->nodes.get_count() / 4 + 1024  ) {
+			g->build(welt);
+		}
+		else if(  !g->dirty.empty()  ) {
+			g->repair(welt);
+		}
+	}
+}
+
+
+void way_graph_t::reset()
+{
+	for(  int i = 0;  i <= narrowgauge_wt;  i++  ) {
+		delete graphs[i];
+		graphs[i] = NULL;
+	}
+}
+
+
+bool way_graph_t::find_waypoints(karte_t *welt, koord3d start, koord3d ziel, vector_tpl<koord3d> &waypoints) const
+{
+	const grund_t *start_gr = welt->lookup(start);
+	const grund_t *ziel_gr = welt->lookup(ziel);
+	const weg_t *start_way = start_gr ? get_way(start_gr) : NULL;
+	const weg_t *ziel_way = ziel_gr ? get_way(ziel_gr) : NULL;
+	if(  start_way == NULL  ||  ziel_way == NULL  ||  nodes.empty()  ) {
+		return false;
+	}
+
+	// the nodes from which the target can be reached, the direction to leave them and the remaining length
+	struct target_t { sint32 node; sint8 exit; uint32 length; };
+	target_t targets[4];
+	uint8 target_count = 0;
+	// states at which the chains from ziel end, to detect start and ziel on the same chain
+	uint32 ziel_ends[4] = { NO_PARENT, NO_PARENT, NO_PARENT, NO_PARENT };
+	const sint32 ziel_node = index_of(ziel);
+	if(  ziel_node >= 0  ) {
+		targets[target_count].node = ziel_node;
+		targets[target_count].exit = -1;
+		targets[target_count].length = 0;
+		target_count++;
+	}
+	else {
+		for(  uint8 i = 0;  i < 4;  i++  ) {
+			trace_t t;
+			if(  (ziel_way->get_ribi_unmasked() & ribi_t::nsew[i])  &&  trace(ziel_gr, i, t)  ) {
+				ziel_ends[i] = (uint32)index_of(t.end) * 4 + t.arrival;
+				const sint32 n = t.blocked_back ? -1 : index_of(t.end);
+				if(  n >= 0  ) {
+					targets[target_count].node = n;
+					targets[target_count].exit = reverse_index(t.arrival);
+					targets[target_count].length = t.length;
+					target_count++;
+				}
+			}
+		}
+	}
+	if(  target_count == 0  ) {
+		return false;
+	}
+
+	search_memory_t &m = search_memory;
+	m.init(nodes.get_count() * 4);
+	const uint32 generation = m.generation;
+	const koord ziel2d = ziel.get_2d();
+
+	// states are only entered with a better cost; the distance heuristic never overestimates the tiles left
+	auto relax = [&](uint32 state, uint32 new_cost, uint32 from, const koord3d &pos) {
+		if(  m.stamp[state] != generation  ||  new_cost < m.cost[state]  ) {
+			m.stamp[state] = generation;
+			m.cost[state] = new_cost;
+			m.parent[state] = from;
+			m.open.insert((uint64)new_cost + shortest_distance(pos.get_2d(), ziel2d), state);
+		}
+	};
+
+	const sint32 start_node = index_of(start);
+	if(  start_node >= 0  ) {
+		const node_t &node = nodes[start_node];
+		for(  uint8 i = 0;  i < 4;  i++  ) {
+			const edge_t &e = node.edges[i];
+			const sint32 n = e.to != koord3d::invalid  &&  !e.blocked ? index_of(e.to) : -1;
+			if(  n >= 0  ) {
+				const uint32 state = (uint32)n * 4 + e.arrival;
+				relax(state, e.length, NO_PARENT, e.to);
+			}
+		}
+	}
+	else {
+		for(  uint8 i = 0;  i < 4;  i++  ) {
+			trace_t t;
+			if(  (start_way->get_ribi_unmasked() & ribi_t::nsew[i])  &&  trace(start_gr, i, t)  ) {
+				const sint32 n = index_of(t.end);
+				const uint32 state = (uint32)n * 4 + t.arrival;
+				for(  uint8 j = 0;  j < 4;  j++  ) {
+					if(  n >= 0  &&  ziel_ends[j] == state  ) {
+						// both on the same chain towards this node, nothing to split
+						return false;
+					}
+				}
+				if(  n >= 0  &&  !t.blocked  ) {
+					relax(state, t.length, NO_PARENT, t.end);
+				}
+			}
+		}
+	}
+
+	uint32 best_cost = 0xFFFFFFFFu;
+	uint32 best_state = NO_PARENT;
+	while(  !m.open.empty()  ) {
+		const uint32 state = m.open.pop();
+		if(  state == TARGET  ) {
+			break;
+		}
+		if(  m.closed[state] == generation  ) {
+			continue;
+		}
+		m.closed[state] = generation;
+
+		const uint32 n = state / 4;
+		const uint8 arrival = state % 4;
+		const node_t &node = nodes[n];
+		// no reversing on the spot, as in the tile search
+		const ribi_t::ribi exits = node.ribi & ~ribi_t::reverse_single(ribi_t::nsew[arrival]);
+
+		for(  uint8 i = 0;  i < target_count;  i++  ) {
+			if(  targets[i].node == (sint32)n  &&  (targets[i].exit < 0  ||  (exits & ribi_t::nsew[targets[i].exit]))  ) {
+				const uint32 total = m.cost[state] + targets[i].length;
+				if(  total < best_cost  ) {
+					best_cost = total;
+					best_state = state;
+					m.open.insert(total, TARGET);
+				}
+			}
+		}
+
+		for(  uint8 i = 0;  i < 4;  i++  ) {
+			const edge_t &e = node.edges[i];
+			if(  (exits & ribi_t::nsew[i]) == 0  ||  e.blocked  ||  e.to == koord3d::invalid  ) {
+				continue;
+			}
+			const sint32 next = index_of(e.to);
+			if(  next >= 0  ) {
+				const uint32 next_state = (uint32)next * 4 + e.arrival;
+				const uint32 next_cost = m.cost[state] + e.length;
+				relax(next_state, next_cost, state, e.to);
+			}
+		}
+	}
+
+	if(  best_state == NO_PARENT  ) {
+		return false;
+	}
+
+	// walk back to collect the junctions and their distance from the start
+	vector_tpl<uint32> path;
+	for(  uint32 state = best_state;  state != NO_PARENT;  state = m.parent[state]  ) {
+		path.append(state);
+	}
+	uint32 last = 0;
+	for(  uint32 i = path.get_count();  i-- > 0;  ) {
+		const uint32 distance = m.cost[path[i]];
+		if(  distance - last >= LEG_LENGTH  &&  best_cost - distance >= LEG_LENGTH / 2  ) {
+			waypoints.append(nodes[path[i] / 4].pos);
+			last = distance;
+		}
+	}
+	return !waypoints.empty();
+}
@@ -0,0 +1,136 @@
+/*
+ * This file is part of the Simutrans-Extended project under the Artistic License.
+ * (see LICENSE.txt)
+ */
+
+#ifndef DATAOBJ_WAY_GRAPH_H
+#define DATAOBJ_WAY_GRAPH_H
+
+
+#include "../simtypes.h"
+#include "koord3d.h"
+#include "ribi.h"
+#include "../tpl/vector_tpl.h"
+
+class karte_t;
+class grund_t;
+class weg_t;
+
+
+/**
+ * Junction graph of the ways of one waytype, used to guide long vehicle
+ * route searches.
+ *
+ * Every way tile which is not a plain straight or curve (junctions and dead
+ * ends) is a node. The chains of tiles between two nodes are collapsed into
+ * edges, so a search from coast to coast only visits the junctions. The
+ * route found on the graph is then split into legs between junctions, which
+ * route_t searches tile by tile (see route_t::calc_route()).
+ *
+ * The graph only holds what does not depend on the vehicle (connections,
+ * lengths and one way signs). Changes to ways mark their tiles dirty, and
+ * update() repairs the affected nodes in the next step, while no convoy is
+ * searching. A repaired graph is identical to a newly built one, so joining
+ * clients which build it on loading make the same choices as the server.
+ */
+class way_graph_t
+{
+public:
+	struct edge_t
+	{
+		koord3d to;       ///< node at the other end, koord3d::invalid if there is no edge
+		uint32 length;    ///< in tiles
+		uint8 arrival;    ///< index into ribi_t::nsew of the last step onto to
+		bool blocked;     ///< a one way sign forbids to drive along
+	};
+
+	struct node_t
+	{
+		koord3d pos;
+		ribi_t::ribi ribi;
+		edge_t edges[4];  ///< indexed like ribi_t::nsew
+	};
+
+	/// route searches are split into legs of about this many tiles
+	static const uint32 LEG_LENGTH = 128;
+
+private:
+	/// Result of following a chain of tiles from one tile to the next node
+	struct trace_t
+	{
+		koord3d end;
+		uint32 length;
+		uint8 arrival;
+		bool blocked;       ///< one way sign against the direction of the trace
+		bool blocked_back;  ///< one way sign against the opposite direction
+	};
+
+	const waytype_t waytype;
+
+	/// sorted by position (see less())
+	vector_tpl<node_t> nodes;
+
+	/// positions of ways changed since the last update()
+	vector_tpl<koord3d> dirty;
+
+	bool built;
+
+	static way_graph_t *graphs[narrowgauge_wt + 1];
+
+	explicit way_graph_t(waytype_t wt) : waytype(wt), built(false) {}
+
+	static bool less(const koord3d &a, const koord3d &b)
+	{
+		return a.y < b.y || (a.y == b.y && (a.x < b.x || (a.x == b.x && a.z < b.z)));
+	}
+
+	static bool is_node(ribi_t::ribi ribi) { return ribi != ribi_t::none && !ribi_t::is_twoway(ribi); }
+
+	/// @returns the index of the node at pos or -1
+	sint32 index_of(const koord3d &pos) const;
+
+	/// @returns the way of our type on gr, if it is connected to anything
+	const weg_t *get_way(const grund_t *gr) const;
+
+	/// Follows the tiles from gr in direction nsew[dir] up to the next node.
+	/// @returns false if the chain is broken or is a loop without nodes
+	bool trace(const grund_t *gr, uint8 dir, trace_t &t) const;
+
+	void init_node(const grund_t *gr, ribi_t::ribi ribi, node_t &node) const;
+
+	void build(karte_t *welt);
+	void repair(karte_t *welt);
+
+	way_graph_t(const way_graph_t&);
+	way_graph_t& operator=(const way_graph_t&);
+
+public:
+	static bool is_supported(waytype_t wt)
+	{
+		return wt == road_wt || wt == track_wt || wt == monorail_wt || wt == maglev_wt || wt == narrowgauge_wt;
+	}
+
+	/// @returns the graph for wt if it is complete and up to date, else NULL
+	static const way_graph_t *get_graph(waytype_t wt);
+
+	/// Notes that the connections or signs of w changed.
+	static void mark_dirty(const weg_t *w);
+
+	/// Builds, repairs or drops the graphs as configured. Must not run
+	/// concurrently to route searches.
+	static void update(karte_t *welt);
+
+	/// Drops all graphs, e.g. when the positions of the ways change.
+	static void reset();
+
+	uint32 get_node_count() const { return nodes.get_count(); }
+
+	/**
+	 * Searches the graph from start to ziel and appends junctions along the
+	 * route to waypoints, about LEG_LENGTH tiles apart (excluding start and ziel).
+	 * @returns false if there is no route on the graph or it is too short to split
+	 */
+	bool find_waypoints(karte_t *welt, koord3d start, koord3d ziel, vector_tpl<koord3d> &waypoints) const;
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+ * This file is part of the Simutrans-Extended project under the Artistic License.
+ * (see LICENSE.txt)
+ */
+
+#include <stdio.h>
+
+#include "world_hash.h"
+#include "../simworld.h"
+#include "../simplan.h"
+#include "../simconvoi.h"
+#include "../simhalt.h"
+#include "../simfab.h"
+#include "../simcity.h"
+#include "../simobj.h"
+#include "../boden/grund.h"
+#include "../player/simplay.h"
+#include "../player/finance.h"
+
+
+namespace {
+	/// FNV-1a over 32 bit words
+	inline uint32 mix(uint32 hash, uint32 value)
+	{
+		return (hash ^ value) * 16777619u;
+	}
+
+	inline uint32 mix64(uint32 hash, sint64 value)
+	{
+		return mix( mix(hash, (uint32)value), (uint32)((uint64)value >> 32) );
+	}
+
+	const uint32 hash_start = 2166136261u;
+
+	inline uint32 pack_koord(koord k)
+	{
+		return ((uint32)(uint16)k.x << 16) | (uint16)k.y;
+	}
+}
+
+
+world_hash_t::world_hash_t() :
+	sync_step(0),
+	chunks_x(0)
+{
+	for(  uint8 i = 0;  i < MAX_PARTS;  i++  ) {
+		part_hash[i] = 0;
+	}
+}
+
+
+void world_hash_t::add_leaf(uint8 part, uint32 key, uint32 hash)
+{
+	leaf_t leaf;
+	leaf.key = key;
+	leaf.hash = hash;
+	leaves[part].append(leaf);
+	part_hash[part] = mix( mix(part_hash[part], key), hash );
+}
+
+
+void world_hash_t::calc(karte_t *welt, uint32 sync_step)
+{
+	this->sync_step = sync_step;
+	for(  uint8 i = 0;  i < MAX_PARTS;  i++  ) {
+		part_hash[i] = hash_start;
+		leaves[i].clear();
+	}
+
+	// tiles and the objects on them, by chunk
+	const sint16 size_x = welt->get_size().x;
+	const sint16 size_y = welt->get_size().y;
+	chunks_x = karte_t::get_plan_chunks(size_x);
+	const uint32 chunks_y = karte_t::get_plan_chunks(size_y);
+	for(  uint32 cy = 0;  cy < chunks_y;  cy++  ) {
+		for(  uint32 cx = 0;  cx < chunks_x;  cx++  ) {
+			uint32 hash = hash_start;
+			const sint16 end_y = min( size_y, (sint16)((cy + 1) << PLAN_CHUNK_SHIFT) );
+			const sint16 end_x = min( size_x, (sint16)((cx + 1) << PLAN_CHUNK_SHIFT) );
+			for(  sint16 y = cy << PLAN_CHUNK_SHIFT;  y < end_y;  y++  ) {
+				for(  sint16 x = cx << PLAN_CHUNK_SHIFT;  x < end_x;  x++  ) {
+					const planquadrat_t *plan = welt->access_nocheck(x, y);
+					for(  uint32 i = 0;  i < plan->get_boden_count();  i++  ) {
+						const grund_t *gr = plan->get_boden_bei(i);
+						hash = mix( hash, ((uint32)(uint8)gr->get_hoehe() << 24) | ((uint32)gr->get_typ() << 16) | ((uint32)gr->get_grund_hang() << 8) | gr->get_top() );
+						for(  uint8 n = 0;  n < gr->get_top();  n++  ) {
+							const obj_t *obj = gr->obj_bei(n);
+							hash = mix( hash, ((uint32)(uint8)obj->get_typ() << 24) | ((uint32)(uint8)obj->get_player_nr() << 16) | ((uint32)(uint8)obj->get_xoff() << 8) | (uint8)obj->get_yoff() );
+						}
+					}
+				}
+			}
+			add_leaf( PART_TILES, cy * chunks_x + cx, hash );
+		}
+	}
+
+	FOR(vector_tpl<convoihandle_t>, const cnv, welt->convoys()) {
+		const koord3d pos = cnv->get_pos();
+		uint32 hash = hash_start;
+		hash = mix( hash, pack_koord(pos.get_2d()) );
+		hash = mix( hash, ((uint32)(uint8)pos.z << 24) | ((uint32)cnv->get_state() << 8) | cnv->get_vehicle_count() );
+		hash = mix( hash, cnv->get_akt_speed() );
+		hash = mix( hash, cnv->get_loading_level() );
+		hash = mix64( hash, cnv->get_jahresgewinn() );
+		hash = mix64( hash, cnv->get_total_distance_traveled() );
+		add_leaf( PART_CONVOYS, cnv.get_id(), hash );
+	}
+
+	FOR(vector_tpl<halthandle_t>, const halt, haltestelle_t::get_alle_haltestellen()) {
+		uint32 hash = hash_start;
+		hash = mix( hash, pack_koord(halt->get_basis_pos()) );
+		hash = mix64( hash, halt->get_finance_history(0, HALT_WAITING) );
+		hash = mix64( hash, halt->get_finance_history(0, HALT_HAPPY) );
+		hash = mix64( hash, halt->get_finance_history(0, HALT_UNHAPPY) );
+		hash = mix64( hash, halt->get_finance_history(0, HALT_NOROUTE) );
+		for(  uint8 i = 0;  i < 3;  i++  ) {
+			hash = mix( hash, halt->get_capacity(i) );
+		}
+		add_leaf( PART_HALTS, halt.get_id(), hash );
+	}
+
+	FOR(vector_tpl<fabrik_t*>, const fab, welt->get_fab_list()) {
+		uint32 hash = hash_start;
+		for(  uint32 i = 0;  i < fab->get_input().get_count();  i++  ) {
+			hash = mix( hash, fab->get_input()[i].menge );
+		}
+		for(  uint32 i = 0;  i < fab->get_output().get_count();  i++  ) {
+			hash = mix( hash, fab->get_output()[i].menge );
+		}
+		add_leaf( PART_FACTORIES, pack_koord(fab->get_pos().get_2d()), hash );
+	}
+
+	FOR(weighted_vector_tpl<stadt_t*>, const city, welt->get_cities()) {
+		uint32 hash = hash_start;
+		hash = mix( hash, city->get_einwohner() );
+		hash = mix( hash, city->get_buildings() );
+		add_leaf( PART_CITIES, pack_koord(city->get_pos()), hash );
+	}
+
+	for(  uint8 i = 0;  i < MAX_PLAYER_COUNT;  i++  ) {
+		if(  player_t *player = welt->get_player(i)  ) {
+			add_leaf( PART_PLAYERS, i, mix64( hash_start, player->get_finance()->get_account_balance() ) );
+		}
+	}
+
+	// 0 is reserved for "not calculated"
+	for(  uint8 i = 0;  i < MAX_PARTS;  i++  ) {
+		if(  part_hash[i] == 0  ) {
+			part_hash[i] = 1;
+		}
+	}
+}
+
+
+const char *world_hash_t::get_part_name(uint8 part)
+{
+	static const char *const names[MAX_PARTS] = { "tiles", "convoys", "halts", "factories", "cities", "players" };
+	return part < MAX_PARTS ? names[part] : "unknown";
+}
+
+
+bool world_hash_t::dump(const char *filename) const
+{
+	FILE *file = fopen( filename, "w" );
+	if(  !file  ) {
+		return false;
+	}
+
+	fprintf( file, "sync_step=%u\n", sync_step );
+	for(  uint8 part = 0;  part < MAX_PARTS;  part++  ) {
+		fprintf( file, "%s %08x\n", get_part_name(part), part_hash[part] );
+		FOR(vector_tpl<leaf_t>, const& leaf, leaves[part]) {
+			switch(  part  ) {
+				case PART_TILES:
+					// the top left tile of the chunk
+					fprintf( file, "\t%u,%u %08x\n", (leaf.key % chunks_x) << PLAN_CHUNK_SHIFT, (leaf.key / chunks_x) << PLAN_CHUNK_SHIFT, leaf.hash );
+					break;
+				case PART_FACTORIES:
+				case PART_CITIES:
+					fprintf( file, "\t%u,%u %08x\n", leaf.key >> 16, leaf.key & 0xFFFF, leaf.hash );
+					break;
+				default:
+					fprintf( file, "\t%u %08x\n", leaf.key, leaf.hash );
+			}
+		}
+	}
+	fclose( file );
+	return true;
+}
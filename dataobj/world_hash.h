@@ -0,0 +1,82 @@
+/*
+ * This file is part of the Simutrans-Extended project under the Artistic License.
+ * (see LICENSE.txt)
+ */
+
+#ifndef DATAOBJ_WORLD_HASH_H
+#define DATAOBJ_WORLD_HASH_H
+
+
+#include "../simtypes.h"
+#include "../tpl/vector_tpl.h"
+
+class karte_t;
+
+
+/**
+ * Hash of the world state, used to find where a network game went out of sync.
+ *
+ * The world is split into parts (the tiles, convoys, halts ...). Every part
+ * is made of leaves (a chunk of PLAN_CHUNK_SIZE^2 tiles, one convoy, one
+ * halt ...), whose hashes are rolled up into one hash per part. The part
+ * hashes travel in the checklist_t, so a mismatch tells the subsystem which
+ * diverged. The leaf hashes are only kept locally: on a mismatch both sides
+ * write them to a file (see dump()), and comparing the two files gives the
+ * first chunk or entity which differs.
+ */
+class world_hash_t
+{
+public:
+	enum part_t {
+		PART_TILES = 0,
+		PART_CONVOYS,
+		PART_HALTS,
+		PART_FACTORIES,
+		PART_CITIES,
+		PART_PLAYERS,
+		MAX_PARTS
+	};
+
+	struct leaf_t
+	{
+		uint32 key;
+		uint32 hash;
+	};
+
+private:
+	/// sync step at which the hashes were calculated, 0 for none
+	uint32 sync_step;
+
+	uint32 part_hash[MAX_PARTS];
+	vector_tpl<leaf_t> leaves[MAX_PARTS];
+
+	/// for the keys of the tile chunks
+	uint32 chunks_x;
+
+	void add_leaf(uint8 part, uint32 key, uint32 hash);
+
+public:
+	world_hash_t();
+
+	/**
+	 * Hashes the whole world. Since this visits every tile, it is only
+	 * done every env_t::world_hash_sync_steps sync steps.
+	 * The convoy threads must not be running.
+	 */
+	void calc(karte_t *welt, uint32 sync_step);
+
+	uint32 get_sync_step() const { return sync_step; }
+
+	/// never 0, as 0 marks a hash which was not calculated (see checklist_t)
+	uint32 get_part_hash(uint8 part) const { return part_hash[part]; }
+
+	static const char *get_part_name(uint8 part);
+
+	/**
+	 * Writes the hashes of all leaves into a text file, one per line
+	 * @return false if the file could not be written
+	 */
+	bool dump(const char *filename) const;
+};
+
+#endif
@@ -45,8 +45,9 @@ public:
 	image_id imageid; ///< set by register_image()
 	uint8 zoomable;   ///< some images may not be zoomed i.e. icons
 	PIXVAL *data;     ///< RLE encoded image data
+	bool mapped;      ///< data points into a pak file in memory and must not be freed
 
-	image_t(size_t len_ = 0) : data(NULL)
+	image_t(size_t len_ = 0) : data(NULL), mapped(false)
 	{
 		if (len_) {
 			alloc(len_);
@@ -55,14 +56,30 @@ public:
 
 	~image_t()
 	{
-		delete[] data;
+		if (!mapped) {
+			delete[] data;
+		}
 	}
 
 	void alloc(size_t len_)
 	{
-		delete[] data;
+		if (!mapped) {
+			delete[] data;
+		}
 		data = new PIXVAL[len_];
 		len = len_;
+		mapped = false;
+	}
+
+	/// uses pixels, which stay in memory as long as the image, instead of a copy
+	void set_mapped_data(PIXVAL *pixels, size_t len_)
+	{
+		if (!mapped) {
+			delete[] data;
+		}
+		data = pixels;
+		len = len_;
+		mapped = true;
 	}
 
 	static image_t* copy_image(const image_t& other);
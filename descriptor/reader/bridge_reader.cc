@@ -30,16 +30,12 @@ bool bridge_reader_t::successfully_loaded() const
 	return bridge_builder_t::successfully_loaded();
 }
 
-obj_desc_t * bridge_reader_t::read_node(FILE *fp, obj_node_info_t &node)
+obj_desc_t * bridge_reader_t::read_node(char *desc_buf, obj_node_info_t &/*node*/)
 {
 	// DBG_DEBUG("bridge_reader_t::read_node()", "called");
-	ALLOCA(char, desc_buf, node.size);
 
 	bridge_desc_t *desc = new bridge_desc_t();
 
-	// Hajo: Read data
-	fread(desc_buf, node.size, 1, fp);
-
 	char * p = desc_buf;
 
 	// Hajo: old versions of PAK files have no version stamp.
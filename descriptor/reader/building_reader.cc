@@ -26,15 +26,10 @@ struct old_btyp
 };
 
 
-obj_desc_t * tile_reader_t::read_node(FILE *fp, obj_node_info_t &node)
+obj_desc_t * tile_reader_t::read_node(char *desc_buf, obj_node_info_t &/*node*/)
 {
-	ALLOCA(char, desc_buf, node.size);
-
 	building_tile_desc_t *desc = new building_tile_desc_t();
 
-	// Hajo: Read data
-	fread(desc_buf, node.size, 1, fp);
-
 	char * p = desc_buf;
 
 	// Hajo: old versions of PAK files have no version stamp.
@@ -209,15 +204,10 @@ bool building_reader_t::successfully_loaded() const
 }
 
 
-obj_desc_t * building_reader_t::read_node(FILE *fp, obj_node_info_t &node)
+obj_desc_t * building_reader_t::read_node(char *desc_buf, obj_node_info_t &node)
 {
-	ALLOCA(char, desc_buf, node.size);
-
 	building_desc_t *desc = new building_desc_t();
 
-	// Hajo: Read data
-	fread(desc_buf, node.size, 1, fp);
-
 	char * p = desc_buf;
 	// Hajo: old versions of PAK files have no version stamp.
 	// But we know, the highest bit was always cleared.
@@ -27,7 +27,7 @@ public:
 
 	obj_type get_type() const OVERRIDE { return obj_citycar; }
 	char const* get_type_name() const OVERRIDE { return "citycar"; }
-	obj_desc_t* read_node(FILE*, obj_node_info_t&) OVERRIDE;
+	obj_desc_t* read_node(char*, obj_node_info_t&) OVERRIDE;
 };
 
 #endif
@@ -34,10 +34,8 @@ bool goods_reader_t::successfully_loaded() const
 }
 
 
-obj_desc_t * goods_reader_t::read_node(FILE *fp, obj_node_info_t &node)
+obj_desc_t * goods_reader_t::read_node(char *desc_buf, obj_node_info_t &/*node*/)
 {
-	ALLOCA(char, desc_buf, node.size);
-
 	goods_desc_t *desc = new goods_desc_t();
 
 	// some defaults
@@ -45,9 +43,6 @@ obj_desc_t * goods_reader_t::read_node(FILE *fp, obj_node_info_t &node)
 	desc->weight_per_unit = 100;
 	desc->color = 255;
 
-	// Hajo: Read data
-	fread(desc_buf, node.size, 1, fp);
-
 	char * p = desc_buf;
 
 	// Hajo: old versions of PAK files have no version stamp.
@@ -40,14 +40,10 @@ bool groundobj_reader_t::successfully_loaded() const
 }
 
 
-obj_desc_t * groundobj_reader_t::read_node(FILE *fp, obj_node_info_t &node)
+obj_desc_t * groundobj_reader_t::read_node(char *desc_buf, obj_node_info_t &/*node*/)
 {
-	ALLOCA(char, desc_buf, node.size);
-
 	groundobj_desc_t *desc = new groundobj_desc_t();
 
-	// Hajo: Read data
-	fread(desc_buf, node.size, 1, fp);
 
 	char * p = desc_buf;
 
@@ -24,13 +24,10 @@
 #define skip_reading_pixels_if_no_graphics goto adjust_image
 #endif
 
-obj_desc_t *image_reader_t::read_node(FILE *fp, obj_node_info_t &node)
+obj_desc_t *image_reader_t::read_node(char *desc_buf, obj_node_info_t &node)
 {
-	ALLOCA(char, desc_buf, node.size);
 	image_t* desc=NULL;
 
-	// Hajo: Read data
-	fread(desc_buf, node.size, 1, fp);
 	char * p = desc_buf+6;
 
 	// always zero in old version, since length was always less than 65535
@@ -96,15 +93,25 @@ obj_desc_t *image_reader_t::read_node(FILE *fp, obj_node_info_t &node)
 		desc->w = decode_sint16(p);
 		p++; // skip version information
 		desc->h = decode_sint16(p);
-		desc->alloc((node.size - 10) / 2); // len
+		const size_t len = (node.size - 10) / 2;
 		desc->zoomable = decode_uint8(p);
 		desc->imageid = IMG_EMPTY;
 
 		skip_reading_pixels_if_no_graphics;
-		uint16* dest = desc->data;
-		if (desc->h > 0) {
-			for (uint i = 0; i < desc->len; i++) {
-				*dest++ = decode_uint16(p);
+#ifndef SIM_BIG_ENDIAN
+		if(  ((size_t)p & 1) == 0  ) {
+			// the pixels are stored like in memory, so use them straight from the pak file
+			desc->set_mapped_data( (PIXVAL *)p, len );
+		}
+		else
+#endif
+		{
+			desc->alloc(len);
+			uint16* dest = desc->data;
+			if (desc->h > 0) {
+				for (uint i = 0; i < desc->len; i++) {
+					*dest++ = decode_uint16(p);
+				}
 			}
 		}
 	}
@@ -161,6 +168,9 @@ adjust_image:
 		}
 	}
 
+	// check it here, since desc may be replaced by an identical image below
+	const bool mapped = desc->mapped;
+
 	if (desc->len != 0) {
 		// get the adler hash (since we have zlib on board anyway ... )
 		bool do_register_image = true;
@@ -197,5 +207,9 @@ adjust_image:
 		}
 	}
 
+	if(  mapped  ) {
+		keep_file_data();
+	}
+
 	return desc;
 }
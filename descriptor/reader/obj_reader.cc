@@ -27,7 +27,13 @@
 #include "../../tpl/inthashtable_tpl.h"
 #include "../../tpl/ptrhashtable_tpl.h"
 #include "../../tpl/stringhashtable_tpl.h"
+#include "../../tpl/vector_tpl.h"
 #include "../../simdebug.h"
+#include "../../simconst.h"
+
+#ifdef MULTI_THREAD
+#include "../../utils/simthread.h"
+#endif
 
 #include "../obj_desc.h"
 #include "../obj_node_info.h"
@@ -39,6 +45,72 @@ obj_reader_t::obj_map*                                         obj_reader_t::obj
 inthashtable_tpl<obj_type, stringhashtable_tpl<obj_desc_t*> > obj_reader_t::loaded;
 obj_reader_t::unresolved_map                                   obj_reader_t::unresolved;
 ptrhashtable_tpl<obj_desc_t**, int>                           obj_reader_t::fatals;
+bool                                                           obj_reader_t::keep_data = false;
+
+
+/// a pak file in memory
+struct mapped_pak_t
+{
+	char *data;
+	size_t size;
+	bool ready;
+};
+
+
+#ifdef MULTI_THREAD
+/*
+ * The pak files are mapped and paged in by worker threads, while the main
+ * thread reads their nodes in the original order. The readers register
+ * their objects in global tables, so only the i/o runs concurrently, and the
+ * order of registration (which decides which pak of the same name wins) is
+ * the same as when loading serially.
+ */
+
+// how many files the workers may map ahead of the main thread
+#define MAX_PAKS_MAPPED_AHEAD (64)
+
+static struct pak_prefetch_t
+{
+	vector_tpl<const char *> const *names;
+	mapped_pak_t *files;
+	uint32 next_to_map;
+	uint32 reading;
+	pthread_mutex_t mutex;
+	pthread_cond_t mapped_cond;
+	pthread_cond_t read_cond;
+} pak_prefetch;
+
+
+static void *map_paks_thread(void *)
+{
+	pthread_mutex_lock( &pak_prefetch.mutex );
+	while(  pak_prefetch.next_to_map < pak_prefetch.names->get_count()  ) {
+		if(  pak_prefetch.next_to_map >= pak_prefetch.reading + MAX_PAKS_MAPPED_AHEAD  ) {
+			pthread_cond_wait( &pak_prefetch.read_cond, &pak_prefetch.mutex );
+			continue;
+		}
+		const uint32 i = pak_prefetch.next_to_map++;
+		pthread_mutex_unlock( &pak_prefetch.mutex );
+
+		size_t size;
+		char *data = dr_map_file( (*pak_prefetch.names)[i], size );
+		// touch every page, so the main thread does not wait for the disk
+		volatile char sum = 0;
+		for(  size_t ofs = 0;  ofs < size;  ofs += 4096  ) {
+			sum += data[ofs];
+		}
+		(void)sum;
+
+		pthread_mutex_lock( &pak_prefetch.mutex );
+		pak_prefetch.files[i].data = data;
+		pak_prefetch.files[i].size = size;
+		pak_prefetch.files[i].ready = true;
+		pthread_cond_broadcast( &pak_prefetch.mapped_cond );
+	}
+	pthread_mutex_unlock( &pak_prefetch.mutex );
+	return NULL;
+}
+#endif
 
 void obj_reader_t::register_reader()
 {
@@ -147,15 +219,76 @@ DBG_MESSAGE("obj_reader_t::load()","big logo %p", skinverwaltung_t::biglogosymbo
 
 DBG_MESSAGE("obj_reader_t::load()", "reading from '%s'", name.c_str());
 
-		uint n = 0;
-		FORX(searchfolder_t, const& i, find, ++n) {
-			read_file(i);
+		vector_tpl<const char *> names( max );
+		FOR(searchfolder_t, const& i, find) {
+			names.append( i );
+		}
+
+		mapped_pak_t *files = new mapped_pak_t[names.get_count()];
+		for(  uint32 n = 0;  n < names.get_count();  n++  ) {
+			files[n].ready = false;
+		}
+
+#ifdef MULTI_THREAD
+		const int max_threads = min( clamp( env_t::num_threads, 1, MAX_THREADS ), (int)names.get_count() );
+		int num_threads = 0;
+		pthread_t threads[MAX_THREADS];
+		pak_prefetch.names = &names;
+		pak_prefetch.files = files;
+		pak_prefetch.next_to_map = 0;
+		pak_prefetch.reading = 0;
+		pthread_mutex_init( &pak_prefetch.mutex, NULL );
+		pthread_cond_init( &pak_prefetch.mapped_cond, NULL );
+		pthread_cond_init( &pak_prefetch.read_cond, NULL );
+		while(  num_threads < max_threads  ) {
+			if(  int rc = pthread_create( &threads[num_threads], NULL, map_paks_thread, NULL )  ) {
+				// the files not yet mapped by the others are mapped below
+				dbg->warning("obj_reader_t::load()", "cannot create pak mapping thread #%i, error %d", num_threads+1, rc );
+				break;
+			}
+			num_threads++;
+		}
+#endif
+
+		for(  uint32 n = 0;  n < names.get_count();  n++  ) {
+#ifdef MULTI_THREAD
+			if(  num_threads > 0  ) {
+				pthread_mutex_lock( &pak_prefetch.mutex );
+				pak_prefetch.reading = n;
+				pthread_cond_broadcast( &pak_prefetch.read_cond );
+				while(  !files[n].ready  ) {
+					pthread_cond_wait( &pak_prefetch.mapped_cond, &pak_prefetch.mutex );
+				}
+				pthread_mutex_unlock( &pak_prefetch.mutex );
+			}
+			else
+#endif
+			{
+				files[n].data = dr_map_file( names[n], files[n].size );
+			}
+			DBG_DEBUG("obj_reader_t::load()", "filename='%s'", names[n]);
+			if(  files[n].data == NULL  ) {
+				dbg->error("obj_reader_t::load()", "reading '%s' failed!", names[n]);
+			}
+			else if(  !read_file_data( names[n], files[n].data, files[n].size )  ) {
+				dr_unmap_file( files[n].data, files[n].size );
+			}
 			if ((n & step) == 0 && drawing) {
 				ls.set_progress(n);
 			}
 		}
 		ls.set_progress(max);
 
+#ifdef MULTI_THREAD
+		for(  int t = 0;  t < num_threads;  t++  ) {
+			pthread_join( threads[t], NULL );
+		}
+		pthread_cond_destroy( &pak_prefetch.read_cond );
+		pthread_cond_destroy( &pak_prefetch.mapped_cond );
+		pthread_mutex_destroy( &pak_prefetch.mutex );
+#endif
+		delete [] files;
+
 		return find.begin()!=find.end();
 	}
 	return false;
@@ -167,81 +300,89 @@ void obj_reader_t::read_file(const char *name)
 	// Hajo: added trace
 	DBG_DEBUG("obj_reader_t::read_file()", "filename='%s'", name);
 
-	if (FILE* const fp = fopen(name, "rb")) {
-		sint32 n = 0;
+	size_t size;
+	if (char* const data = dr_map_file(name, size)) {
+		if(  !read_file_data(name, data, size)  ) {
+			dr_unmap_file(data, size);
+		}
+	}
+	else {
+		// Hajo: added error check
+		dbg->error("obj_reader_t::read_file()", "reading '%s' failed!", name);
+	}
+}
 
-		// This is the normal header reading code
-		int c;
-		do {
-			c = fgetc(fp);
-			n ++;
-		} while(!feof(fp) && c != 0x1a);
 
-		if(feof(fp)) {
-			// Hajo: added error check
-			dbg->error("obj_reader_t::read_file()",	"unexpected end of file after %d bytes while reading '%s'!",n, name);
-		}
-		else {
-//			DBG_DEBUG("obj_reader_t::read_file()", "skipped %d header bytes", n);
-		}
+bool obj_reader_t::read_file_data(const char *name, char *data, size_t size)
+{
+	const char *const end = data + size;
+	char *p = data;
 
-		// Compiled Version
-		uint32 version = 0;
-		char dummy[4], *p;
-		p = dummy;
+	// This is the normal header reading code
+	while(  p < end  &&  *p != 0x1a  ) {
+		p++;
+	}
 
-		n = fread(dummy, 4, 1, fp);
-		version = decode_uint32(p);
+	if(  end - p < 5  ) {
+		// Hajo: added error check
+		dbg->error("obj_reader_t::read_file()",	"unexpected end of file after %d bytes while reading '%s'!", (int)(p - data), name);
+		return false;
+	}
+	p++;
 
-		DBG_DEBUG("obj_reader_t::read_file()", "read %d blocks, file version is %x", n, version);
+	// Compiled Version
+	const uint32 version = decode_uint32(p);
 
-		if(version <= COMPILER_VERSION_CODE) {
-			obj_desc_t *data = NULL;
-			read_nodes(fp, data, 0, version );
-		}
-		else {
-			DBG_DEBUG("obj_reader_t::read_file()","version of '%s' is too old, %d instead of %d", name, version, COMPILER_VERSION_CODE );
-		}
-		fclose(fp);
+	DBG_DEBUG("obj_reader_t::read_file()", "file version is %x", version);
+
+	keep_data = false;
+	if(version <= COMPILER_VERSION_CODE) {
+		obj_desc_t *desc = NULL;
+		read_nodes(p, end, desc, 0, version );
 	}
 	else {
-		// Hajo: added error check
-		dbg->error("obj_reader_t::read_file()", "reading '%s' failed!", name);
+		DBG_DEBUG("obj_reader_t::read_file()","version of '%s' is too old, %d instead of %d", name, version, COMPILER_VERSION_CODE );
 	}
+	return keep_data;
 }
 
 
-static void read_node_info(obj_node_info_t& node, FILE* const f, uint32 const version)
+static void read_node_info(obj_node_info_t& node, char *&p, const char *end, uint32 const version)
 {
-	char data[EXT_OBJ_NODE_INFO_SIZE];
-
-	char* p = data;
-	fread(p, OBJ_NODE_INFO_SIZE, 1, f);
+	if(  end - p < OBJ_NODE_INFO_SIZE  ) {
+		dbg->fatal("obj_reader_t::read_nodes()", "unexpected end of file");
+	}
 	node.type     = decode_uint32(p);
 	node.children = decode_uint16(p);
 	node.size     = decode_uint16(p);
 	// can have larger records
 	if (version != COMPILER_VERSION_CODE_11 && node.size == LARGE_RECORD_SIZE) {
-		fread(p, sizeof(data) - OBJ_NODE_INFO_SIZE, 1, f);
+		if(  end - p < EXT_OBJ_NODE_INFO_SIZE - OBJ_NODE_INFO_SIZE  ) {
+			dbg->fatal("obj_reader_t::read_nodes()", "unexpected end of file");
+		}
 		node.size = decode_uint32(p);
 	}
+	if(  (size_t)(end - p) < node.size  ) {
+		dbg->fatal("obj_reader_t::read_nodes()", "unexpected end of file in %.4s-node of length %u", reinterpret_cast<const char *>(&node.type), node.size);
+	}
 }
 
 
-void obj_reader_t::read_nodes(FILE* fp, obj_desc_t*& data, int register_nodes, uint32 version )
+void obj_reader_t::read_nodes(char *&p, const char *end, obj_desc_t*& data, int register_nodes, uint32 version )
 {
 	obj_node_info_t node;
-	read_node_info(node, fp, version);
+	read_node_info(node, p, end, version);
 
 	obj_reader_t *reader = obj_reader->get(static_cast<obj_type>(node.type));
 	if(reader) {
 
 //DBG_DEBUG("obj_reader_t::read_nodes()","Reading %.4s-node of length %d with '%s'",	reinterpret_cast<const char *>(&node.type),	node.size,	reader->get_type_name());
-		data = reader->read_node(fp, node);
+		data = reader->read_node(p, node);
+		p += node.size;
 		if (node.children != 0) {
 			data->children = new obj_desc_t*[node.children];
 			for (int i = 0; i < node.children; i++) {
-				read_nodes(fp, data->children[i], register_nodes + 1, version);
+				read_nodes(p, end, data->children[i], register_nodes + 1, version);
 			}
 		}
 
@@ -254,23 +395,23 @@ void obj_reader_t::read_nodes(FILE* fp, obj_desc_t*& data, int register_nodes, u
 	else {
 		// no reader found ...
 		dbg->warning("obj_reader_t::read_nodes()","skipping unknown %.4s-node\n",reinterpret_cast<const char *>(&node.type));
-		fseek(fp, node.size, SEEK_CUR);
+		p += node.size;
 		for(int i = 0; i < node.children; i++) {
-			skip_nodes(fp,version);
+			skip_nodes(p, end, version);
 		}
 		data = NULL;
 	}
 }
 
 
-void obj_reader_t::skip_nodes(FILE *fp,uint32 version)
+void obj_reader_t::skip_nodes(char *&p, const char *end, uint32 version)
 {
 	obj_node_info_t node;
-	read_node_info(node, fp, version);
+	read_node_info(node, p, end, version);
 
-	fseek(fp, node.size, SEEK_CUR);
+	p += node.size;
 	for(int i = 0; i < node.children; i++) {
-		skip_nodes(fp,version);
+		skip_nodes(p, end, version);
 	}
 }
 
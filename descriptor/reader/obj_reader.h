@@ -82,8 +82,17 @@ class obj_reader_t
 	static unresolved_map unresolved;
 	static ptrhashtable_tpl<obj_desc_t **, int>  fatals;
 
-	static void read_nodes(FILE* fp, obj_desc_t*& data, int register_nodes,uint32 version);
-	static void skip_nodes(FILE *fp,uint32 version);
+	static void read_nodes(char *&p, const char *end, obj_desc_t*& data, int register_nodes,uint32 version);
+	static void skip_nodes(char *&p, const char *end, uint32 version);
+
+	/// set when a reader keeps pointers into the file being read
+	static bool keep_data;
+
+	/**
+	 * Reads all nodes of a pak file in memory
+	 * @return true if the data must stay in memory
+	 */
+	static bool read_file_data(const char *name, char *data, size_t size);
 
 protected:
 	obj_reader_t() { /* Beware: Cannot register here! */}
@@ -93,7 +102,17 @@ protected:
 	static void xref_to_resolve(obj_type type, const char *name, obj_desc_t **dest, bool fatal);
 	static void resolve_xrefs();
 
-	virtual obj_desc_t* read_node(FILE* fp, obj_node_info_t& node) = 0;
+	/**
+	 * Must be called by a reader, if its objects keep pointing into the data
+	 * given to read_node(). Then the file stays in memory forever.
+	 */
+	static void keep_file_data() { keep_data = true; }
+
+	/**
+	 * @param desc_buf the node.size bytes of the node. They point into the
+	 * mapped pak file, so there is no alignment guaranteed.
+	 */
+	virtual obj_desc_t* read_node(char *desc_buf, obj_node_info_t& node) = 0;
 	virtual void register_obj(obj_desc_t *&/*data*/) {}
 	virtual bool successfully_loaded() const { return true; }
 
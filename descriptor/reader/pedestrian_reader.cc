@@ -41,14 +41,10 @@ bool pedestrian_reader_t::successfully_loaded() const
  * compatibility transformations.
  * @author Hj. Malthaner
  */
-obj_desc_t * pedestrian_reader_t::read_node(FILE *fp, obj_node_info_t &node)
+obj_desc_t * pedestrian_reader_t::read_node(char *desc_buf, obj_node_info_t &/*node*/)
 {
-	ALLOCA(char, desc_buf, node.size);
-
 	pedestrian_desc_t *desc = new pedestrian_desc_t();
 
-	// Hajo: Read data
-	fread(desc_buf, node.size, 1, fp);
 	char * p = desc_buf;
 
 	// Hajo: old versions of PAK files have no version stamp.
@@ -26,7 +26,7 @@ public:
 
 	obj_type get_type() const OVERRIDE { return obj_pedestrian; }
 	char const* get_type_name() const OVERRIDE { return "pedestrian"; }
-	obj_desc_t* read_node(FILE*, obj_node_info_t&) OVERRIDE;
+	obj_desc_t* read_node(char*, obj_node_info_t&) OVERRIDE;
 };
 
 #endif
@@ -16,7 +16,7 @@ class root_reader_t : public obj_reader_t {
 public:
 	static root_reader_t*instance() { return &the_instance; }
 
-	obj_desc_t* read_node(FILE*, obj_node_info_t&) OVERRIDE;
+	obj_desc_t* read_node(char*, obj_node_info_t&) OVERRIDE;
 
 	obj_type get_type() const OVERRIDE { return obj_root; }
 	char const* get_type_name() const OVERRIDE { return "root"; }
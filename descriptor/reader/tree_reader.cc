@@ -33,15 +33,10 @@ bool tree_reader_t::successfully_loaded() const
 }
 
 
-obj_desc_t * tree_reader_t::read_node(FILE *fp, obj_node_info_t &node)
+obj_desc_t * tree_reader_t::read_node(char *desc_buf, obj_node_info_t &/*node*/)
 {
-	ALLOCA(char, desc_buf, node.size);
-
 	tree_desc_t *desc = new tree_desc_t();
 
-	// Hajo: Read data
-	fread(desc_buf, node.size, 1, fp);
-
 	char * p = desc_buf;
 
 	// Hajo: old versions of PAK files have no version stamp.
@@ -66,12 +61,11 @@ obj_desc_t * tree_reader_t::read_node(FILE *fp, obj_node_info_t &node)
 		desc->distribution_weight = 3;
 	}
 	DBG_DEBUG("tree_reader_t::read_node()",
-		"version=%i, climates=$%X, seasons=%i, chance=%i (node.size=%i)",
+		"version=%i, climates=$%X, seasons=%i, chance=%i",
 		version,
 		desc->allowed_climates,
 		desc->number_of_seasons,
-		desc->distribution_weight,
-		node.size);
+		desc->distribution_weight);
 
 	return desc;
 }
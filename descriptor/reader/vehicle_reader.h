@@ -28,7 +28,7 @@ public:
 	/* Read a node. Does version check and compatibility transformations.
 	 * @author Hj. Malthaner
 	 */
-	obj_desc_t* read_node(FILE*, obj_node_info_t&) OVERRIDE;
+	obj_desc_t* read_node(char*, obj_node_info_t&) OVERRIDE;
 };
 
 #endif
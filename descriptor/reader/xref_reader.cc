@@ -3,7 +3,7 @@
  * (see LICENSE.txt)
  */
 
-#include <stdio.h>
+#include <string.h>
 #include "../../simdebug.h"
 #include "../xref_desc.h"
 #include "xref_reader.h"
@@ -11,16 +11,14 @@
 #include "../obj_node_info.h"
 
 
-obj_desc_t * xref_reader_t::read_node(FILE *fp, obj_node_info_t &node)
+obj_desc_t * xref_reader_t::read_node(char *desc_buf, obj_node_info_t &node)
 {
 	xref_desc_t* desc = new(node.size - 4 - 1) xref_desc_t();
 
-	char buf[4 + 1];
-	fread(buf, 1, 5, fp);
-	char* p = buf;
+	char* p = desc_buf;
 	desc->type = static_cast<obj_type>(decode_uint32(p));
 	desc->fatal = (decode_uint8(p) != 0);
-	fread(desc->name, 1, node.size - 4 - 1, fp);
+	memcpy(desc->name, p, node.size - 4 - 1);
 
 //	DBG_DEBUG("xref_reader_t::read_node()", "%s",desc->get_text() );
 
@@ -160,6 +160,8 @@ void display_mark_img_dirty(image_id image, KOORD_VAL x, KOORD_VAL y);
 void mark_rect_dirty_wc(KOORD_VAL x1, KOORD_VAL y1, KOORD_VAL x2, KOORD_VAL y2); // clips to screen only
 void mark_rect_dirty_clip(KOORD_VAL x1, KOORD_VAL y1, KOORD_VAL x2, KOORD_VAL y2  CLIP_NUM_DEF); // clips to clip_rect
 void mark_screen_dirty();
+// screen columns starting at multiples of this width never share a byte of the dirty bitmap
+KOORD_VAL display_get_dirty_column_width();
 
 KOORD_VAL display_get_width();
 KOORD_VAL display_get_height();
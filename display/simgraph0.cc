@@ -61,6 +61,11 @@ void mark_screen_dirty()
 {
 }
 
+KOORD_VAL display_get_dirty_column_width()
+{
+	return 1;
+}
+
 void display_mark_img_dirty(image_id, KOORD_VAL, KOORD_VAL)
 {
 }
@@ -44,12 +44,22 @@
 # endif
 #endif
 
+// SSE2 is there on every x86-64 cpu, AVX2 is only used when the cpu reports it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define USE_SSE2
+# include <emmintrin.h>
+# if defined(__GNUC__) && !defined(__EMSCRIPTEN__)
+#  define USE_AVX2
+#  define AVX2_TARGET __attribute__((target("avx2")))
+#  include <immintrin.h>
+# endif
+#endif
+
 #ifdef MULTI_THREAD
 #include "../utils/simthread.h"
 
 // currently just redrawing/rezooming
 static pthread_mutex_t rezoom_img_mutex[MAX_THREADS];
-static pthread_mutex_t recode_img_mutex;
 #endif
 
 // to pass the extra clipnum when not needed use this
@@ -1055,6 +1065,16 @@ void mark_screen_dirty()
 }
 
 
+/**
+* Each row of tile_dirty starts at a word boundary, so threads drawing columns
+* aligned to eight dirty tiles set bits in different bytes and lose no marks.
+*/
+KOORD_VAL display_get_dirty_column_width()
+{
+	return 8 * DIRTY_TILE_SIZE;
+}
+
+
 /**
 * the area of this image need update
 * @author Hj. Malthaner
@@ -1198,9 +1218,11 @@ static void recode()
 
 /**
 * Convert a certain image data to actual output data
+* The 16 player colors are taken from player_colors instead of rgbmap_day_night,
+* so several threads can recode images of different players at the same time.
 * @author prissi
 */
-static void recode_img_src_target(KOORD_VAL h, PIXVAL *src, PIXVAL *target)
+static void recode_img_src_target(KOORD_VAL h, PIXVAL *src, PIXVAL *target, const PIXVAL *player_colors)
 {
 	if (h > 0) {
 		do {
@@ -1214,7 +1236,7 @@ static void recode_img_src_target(KOORD_VAL h, PIXVAL *src, PIXVAL *target)
 					while (runlen--) {
 						if (*src < 0x8020 + (31 * 16)) {
 							// expand transparent player color
-							PIXVAL rgb565 = rgbmap_day_night[(*src - 0x8020) / 31 + 0x8000];
+							PIXVAL rgb565 = player_colors[(*src - 0x8020) / 31];
 							PIXVAL alpha = (*src - 0x8020) % 31;
 							PIXVAL pix = ((rgb565 >> 6) & 0x0380) | ((rgb565 >> 3) & 0x0078) | ((rgb565 >> 2) & 0x07);
 							*target++ = 0x8020 + 31 * 31 + pix * 31 + alpha;
@@ -1228,7 +1250,8 @@ static void recode_img_src_target(KOORD_VAL h, PIXVAL *src, PIXVAL *target)
 				else {
 					// now just convert the color pixels
 					while (runlen--) {
-						*target++ = rgbmap_day_night[*src++];
+						const PIXVAL pix = *src++;
+						*target++ = (pix & 0xFFF0) == 0x8000 ? player_colors[pix & 0x000F] : rgbmap_day_night[pix];
 					}
 				}
 				// next clear run or zero = end
@@ -1252,10 +1275,12 @@ static void recode_img(const image_id n, const sint8 player_nr)
 {
 	// Hajo: may this image be zoomed
 #ifdef MULTI_THREAD
-	pthread_mutex_lock(&recode_img_mutex);
+	// same lock as rezoom_img(), so only images sharing a lock wait for each other
+	pthread_mutex_t *const img_mutex = &rezoom_img_mutex[n % env_t::num_threads];
+	pthread_mutex_lock(img_mutex);
 	if ((images[n].player_flags & (1 << player_nr)) == 0) {
 		// other thread did already the re-code...
-		pthread_mutex_unlock(&recode_img_mutex);
+		pthread_mutex_unlock(img_mutex);
 		return;
 	}
 #endif
@@ -1264,12 +1289,16 @@ static void recode_img(const image_id n, const sint8 player_nr)
 	if (images[n].data[player_nr] == NULL) {
 		images[n].data[player_nr] = MALLOCN(PIXVAL, images[n].len);
 	}
-	// contains now the player color ...
-	activate_player_color(player_nr, true);
-	recode_img_src_target(images[n].h, src, images[n].data[player_nr]);
+	// the player colors for this image; the shared rgbmap_day_night is left alone
+	PIXVAL player_colors[16];
+	for (int i = 0; i < 8; i++) {
+		player_colors[i] = specialcolormap_day_night[player_offsets[player_nr][0] + i];
+		player_colors[i + 8] = specialcolormap_day_night[player_offsets[player_nr][1] + i];
+	}
+	recode_img_src_target(images[n].h, src, images[n].data[player_nr], player_colors);
 	images[n].player_flags &= ~(1 << player_nr);
 #ifdef MULTI_THREAD
-	pthread_mutex_unlock(&recode_img_mutex);
+	pthread_mutex_unlock(img_mutex);
 #endif
 }
 
@@ -3117,10 +3146,50 @@ static void pix_outline25_16(PIXVAL *dest, const PIXVAL *, const PIXVAL colour,
 }
 
 
+/// blends a run with a colour by alpha/64, for the uneven percentages of display_blend_wh_rgb()
+typedef void(*blend_rgb_proc)(PIXVAL *dest, const PIXVAL colour, const PIXVAL alpha, const PIXVAL len);
+
+static void pix_blend_rgb_15(PIXVAL *dest, const PIXVAL colour, const PIXVAL alpha, const PIXVAL len)
+{
+	const PIXVAL r_src = (colour >> 10) & 0x1F;
+	const PIXVAL g_src = (colour >> 5) & 0x1F;
+	const PIXVAL b_src = colour & 0x1F;
+	const PIXVAL *const end = dest + len;
+	while (dest < end) {
+		const PIXVAL r_dest = (*dest >> 10) & 0x1F;
+		const PIXVAL g_dest = (*dest >> 5) & 0x1F;
+		const PIXVAL b_dest = (*dest & 0x1F);
+		const PIXVAL r = r_dest + (((r_src - r_dest) * alpha) >> 6);
+		const PIXVAL g = g_dest + (((g_src - g_dest) * alpha) >> 6);
+		const PIXVAL b = b_dest + (((b_src - b_dest) * alpha) >> 6);
+		*dest++ = (r << 10) | (g << 5) | b;
+	}
+}
+
+
+static void pix_blend_rgb_16(PIXVAL *dest, const PIXVAL colour, const PIXVAL alpha, const PIXVAL len)
+{
+	const PIXVAL r_src = (colour >> 11);
+	const PIXVAL g_src = (colour >> 5) & 0x3F;
+	const PIXVAL b_src = colour & 0x1F;
+	const PIXVAL *const end = dest + len;
+	while (dest < end) {
+		const PIXVAL r_dest = (*dest >> 11);
+		const PIXVAL g_dest = (*dest >> 5) & 0x3F;
+		const PIXVAL b_dest = (*dest & 0x1F);
+		const PIXVAL r = r_dest + (((r_src - r_dest) * alpha) >> 6);
+		const PIXVAL g = g_dest + (((g_src - g_dest) * alpha) >> 6);
+		const PIXVAL b = b_dest + (((b_src - b_dest) * alpha) >> 6);
+		*dest++ = (r << 11) | (g << 5) | b;
+	}
+}
+
+
 // will kept the actual values
 static blend_proc blend[3];
 static blend_proc blend_recode[3];
 static blend_proc outline[3];
+static blend_rgb_proc blend_rgb;
 
 
 /**
@@ -3155,43 +3224,8 @@ void display_blend_wh_rgb(KOORD_VAL xp, KOORD_VAL yp, KOORD_VAL w, KOORD_VAL h,
 
 		default:
 			// any percentage blending: SLOW!
-			if (blend[0] == pix_blend25_15) {
-				// 555 BITMAPS
-				const PIXVAL r_src = (colval >> 10) & 0x1F;
-				const PIXVAL g_src = (colval >> 5) & 0x1F;
-				const PIXVAL b_src = colval & 0x1F;
-				for (; h>0; yp++, h--) {
-					PIXVAL *dest = textur + yp*disp_width + xp;
-					const PIXVAL *const end = dest + w;
-					while (dest < end) {
-						const PIXVAL r_dest = (*dest >> 10) & 0x1F;
-						const PIXVAL g_dest = (*dest >> 5) & 0x1F;
-						const PIXVAL b_dest = (*dest & 0x1F);
-						const PIXVAL r = r_dest + (((r_src - r_dest) * alpha) >> 6);
-						const PIXVAL g = g_dest + (((g_src - g_dest) * alpha) >> 6);
-						const PIXVAL b = b_dest + (((b_src - b_dest) * alpha) >> 6);
-						*dest++ = (r << 10) | (g << 5) | b;
-					}
-				}
-			}
-			else {
-				// 565 BITMAPS
-				const PIXVAL r_src = (colval >> 11);
-				const PIXVAL g_src = (colval >> 5) & 0x3F;
-				const PIXVAL b_src = colval & 0x1F;
-				for (; h>0; yp++, h--) {
-					PIXVAL *dest = textur + yp*disp_width + xp;
-					const PIXVAL *const end = dest + w;
-					while (dest < end) {
-						const PIXVAL r_dest = (*dest >> 11);
-						const PIXVAL g_dest = (*dest >> 5) & 0x3F;
-						const PIXVAL b_dest = (*dest & 0x1F);
-						const PIXVAL r = r_dest + (((r_src - r_dest) * alpha) >> 6);
-						const PIXVAL g = g_dest + (((g_src - g_dest) * alpha) >> 6);
-						const PIXVAL b = b_dest + (((b_src - b_dest) * alpha) >> 6);
-						*dest++ = (r << 11) | (g << 5) | b;
-					}
-				}
+			for (; h>0; yp++, h--) {
+				blend_rgb(textur + yp*disp_width + xp, colval, alpha, w);
 			}
 			break;
 		}
@@ -3410,6 +3444,434 @@ static void pix_alpha_recode_16(PIXVAL *dest, const PIXVAL *src, const PIXVAL *a
 }
 
 
+#ifdef USE_SSE2
+/*
+ * SSE2 and AVX2 versions of the run routines above. They do the very same
+ * 16 bit arithmetic on 8 or 16 pixels at once and leave the last pixels of
+ * a run to the scalar routine, so the output is identical pixel by pixel.
+ * Recoding through rgbmap_current stays a table lookup per pixel, as there
+ * is no gather for 16 bit values.
+ */
+
+static inline __m128i recode_sse2(const PIXVAL *src)
+{
+	return _mm_setr_epi16(
+		(short)rgbmap_current[src[0]], (short)rgbmap_current[src[1]], (short)rgbmap_current[src[2]], (short)rgbmap_current[src[3]],
+		(short)rgbmap_current[src[4]], (short)rgbmap_current[src[5]], (short)rgbmap_current[src[6]], (short)rgbmap_current[src[7]] );
+}
+
+
+/// quarters/4 of s plus (4-quarters)/4 of d, as in pix_blend25_16() and friends
+template<int quarters, PIXVAL one_out, PIXVAL two_out>
+static inline __m128i blend_quarters_sse2(const __m128i s, const __m128i d)
+{
+	if (quarters == 2) {
+		const __m128i mask = _mm_set1_epi16((short)one_out);
+		return _mm_add_epi16(_mm_and_si128(_mm_srli_epi16(s, 1), mask), _mm_and_si128(_mm_srli_epi16(d, 1), mask));
+	}
+	const __m128i mask = _mm_set1_epi16((short)two_out);
+	const __m128i s4 = _mm_and_si128(_mm_srli_epi16(s, 2), mask);
+	const __m128i d4 = _mm_and_si128(_mm_srli_epi16(d, 2), mask);
+	if (quarters == 1) {
+		return _mm_add_epi16(s4, _mm_add_epi16(d4, _mm_add_epi16(d4, d4)));
+	}
+	return _mm_add_epi16(d4, _mm_add_epi16(s4, _mm_add_epi16(s4, s4)));
+}
+
+
+template<int quarters, PIXVAL one_out, PIXVAL two_out, blend_proc scalar>
+static void pix_blend_sse2(PIXVAL *dest, const PIXVAL *src, const PIXVAL colour, const PIXVAL len)
+{
+	PIXVAL n = len;
+	for (; n >= 8; n -= 8, dest += 8, src += 8) {
+		const __m128i s = _mm_loadu_si128((const __m128i *)src);
+		const __m128i d = _mm_loadu_si128((const __m128i *)dest);
+		_mm_storeu_si128((__m128i *)dest, blend_quarters_sse2<quarters, one_out, two_out>(s, d));
+	}
+	scalar(dest, src, colour, n);
+}
+
+
+template<int quarters, PIXVAL one_out, PIXVAL two_out, blend_proc scalar>
+static void pix_blend_recode_sse2(PIXVAL *dest, const PIXVAL *src, const PIXVAL colour, const PIXVAL len)
+{
+	PIXVAL n = len;
+	for (; n >= 8; n -= 8, dest += 8, src += 8) {
+		const __m128i d = _mm_loadu_si128((const __m128i *)dest);
+		_mm_storeu_si128((__m128i *)dest, blend_quarters_sse2<quarters, one_out, two_out>(recode_sse2(src), d));
+	}
+	scalar(dest, src, colour, n);
+}
+
+
+template<int quarters, PIXVAL one_out, PIXVAL two_out, blend_proc scalar>
+static void pix_outline_sse2(PIXVAL *dest, const PIXVAL *src, const PIXVAL colour, const PIXVAL len)
+{
+	const __m128i c = _mm_set1_epi16((short)colour);
+	PIXVAL n = len;
+	for (; n >= 8; n -= 8, dest += 8) {
+		const __m128i d = _mm_loadu_si128((const __m128i *)dest);
+		_mm_storeu_si128((__m128i *)dest, blend_quarters_sse2<quarters, one_out, two_out>(c, d));
+	}
+	scalar(dest, src, colour, n);
+}
+
+
+/// s*a/32 + d*(32-a)/32 for each colour channel, like the scalar pix_alpha routines
+template<int red_shift, PIXVAL green_mask>
+static inline __m128i alpha_mix_sse2(const __m128i s, const __m128i d, const __m128i a)
+{
+	const __m128i five_bits = _mm_set1_epi16(0x1F);
+	const __m128i g_bits = _mm_set1_epi16((short)green_mask);
+	const __m128i na = _mm_sub_epi16(_mm_set1_epi16(32), a);
+	const __m128i r = _mm_srli_epi16(_mm_add_epi16(
+		_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(s, red_shift), five_bits), a),
+		_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(d, red_shift), five_bits), na)), 5);
+	const __m128i g = _mm_srli_epi16(_mm_add_epi16(
+		_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(s, 5), g_bits), a),
+		_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(d, 5), g_bits), na)), 5);
+	const __m128i b = _mm_srli_epi16(_mm_add_epi16(
+		_mm_mullo_epi16(_mm_and_si128(s, five_bits), a),
+		_mm_mullo_epi16(_mm_and_si128(d, five_bits), na)), 5);
+	return _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, red_shift), _mm_slli_epi16(g, 5)), b);
+}
+
+
+template<int red_shift, PIXVAL green_mask, bool recode, alpha_proc scalar>
+static void pix_alpha_sse2(PIXVAL *dest, const PIXVAL *src, const PIXVAL *alphamap, const unsigned alpha_flags, const PIXVAL colour, const PIXVAL len)
+{
+	const __m128i rmask = _mm_set1_epi16(alpha_flags & ALPHA_RED ? 0x7c00 : 0);
+	const __m128i gmask = _mm_set1_epi16(alpha_flags & ALPHA_GREEN ? 0x03e0 : 0);
+	const __m128i bmask = _mm_set1_epi16(alpha_flags & ALPHA_BLUE ? 0x001f : 0);
+
+	PIXVAL n = len;
+	for (; n >= 8; n -= 8, dest += 8, src += 8, alphamap += 8) {
+		// read mask components - always 15bpp
+		const __m128i am = _mm_loadu_si128((const __m128i *)alphamap);
+		__m128i a = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(am, bmask), _mm_srli_epi16(_mm_and_si128(am, gmask), 5)), _mm_srli_epi16(_mm_and_si128(am, rmask), 10));
+		const __m128i opaque = _mm_cmpgt_epi16(a, _mm_set1_epi16(30));
+		const __m128i clear = _mm_cmpeq_epi16(a, _mm_setzero_si128());
+		a = _mm_sub_epi16(a, _mm_cmpgt_epi16(a, _mm_set1_epi16(15)));
+
+		const __m128i s = recode ? recode_sse2(src) : _mm_loadu_si128((const __m128i *)src);
+		const __m128i d = _mm_loadu_si128((const __m128i *)dest);
+		const __m128i mixed = alpha_mix_sse2<red_shift, green_mask>(s, d, a);
+		const __m128i translucent = _mm_or_si128(_mm_and_si128(clear, d), _mm_andnot_si128(clear, mixed));
+		_mm_storeu_si128((__m128i *)dest, _mm_or_si128(_mm_and_si128(opaque, s), _mm_andnot_si128(opaque, translucent)));
+	}
+	scalar(dest, src, alphamap, alpha_flags, colour, n);
+}
+
+
+template<int red_shift, PIXVAL green_mask, blend_rgb_proc scalar>
+static void pix_blend_rgb_sse2(PIXVAL *dest, const PIXVAL colour, const PIXVAL alpha, const PIXVAL len)
+{
+	const __m128i five_bits = _mm_set1_epi16(0x1F);
+	const __m128i g_bits = _mm_set1_epi16((short)green_mask);
+	const __m128i a = _mm_set1_epi16((short)alpha);
+	const __m128i r_src = _mm_set1_epi16((short)((colour >> red_shift) & 0x1F));
+	const __m128i g_src = _mm_set1_epi16((short)((colour >> 5) & green_mask));
+	const __m128i b_src = _mm_set1_epi16((short)(colour & 0x1F));
+
+	PIXVAL n = len;
+	for (; n >= 8; n -= 8, dest += 8) {
+		const __m128i d = _mm_loadu_si128((const __m128i *)dest);
+		const __m128i r_dest = _mm_and_si128(_mm_srli_epi16(d, red_shift), five_bits);
+		const __m128i g_dest = _mm_and_si128(_mm_srli_epi16(d, 5), g_bits);
+		const __m128i b_dest = _mm_and_si128(d, five_bits);
+		const __m128i r = _mm_add_epi16(r_dest, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(r_src, r_dest), a), 6));
+		const __m128i g = _mm_add_epi16(g_dest, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(g_src, g_dest), a), 6));
+		const __m128i b = _mm_add_epi16(b_dest, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(b_src, b_dest), a), 6));
+		_mm_storeu_si128((__m128i *)dest, _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, red_shift), _mm_slli_epi16(g, 5)), b));
+	}
+	scalar(dest, colour, alpha, n);
+}
+
+
+#ifdef USE_AVX2
+// the same with 16 pixels at once
+
+AVX2_TARGET static inline __m256i recode_avx2(const PIXVAL *src)
+{
+	return _mm256_inserti128_si256(_mm256_castsi128_si256(recode_sse2(src)), recode_sse2(src + 8), 1);
+}
+
+
+template<int quarters, PIXVAL one_out, PIXVAL two_out>
+AVX2_TARGET static inline __m256i blend_quarters_avx2(const __m256i s, const __m256i d)
+{
+	if (quarters == 2) {
+		const __m256i mask = _mm256_set1_epi16((short)one_out);
+		return _mm256_add_epi16(_mm256_and_si256(_mm256_srli_epi16(s, 1), mask), _mm256_and_si256(_mm256_srli_epi16(d, 1), mask));
+	}
+	const __m256i mask = _mm256_set1_epi16((short)two_out);
+	const __m256i s4 = _mm256_and_si256(_mm256_srli_epi16(s, 2), mask);
+	const __m256i d4 = _mm256_and_si256(_mm256_srli_epi16(d, 2), mask);
+	if (quarters == 1) {
+		return _mm256_add_epi16(s4, _mm256_add_epi16(d4, _mm256_add_epi16(d4, d4)));
+	}
+	return _mm256_add_epi16(d4, _mm256_add_epi16(s4, _mm256_add_epi16(s4, s4)));
+}
+
+
+template<int quarters, PIXVAL one_out, PIXVAL two_out, blend_proc scalar>
+AVX2_TARGET static void pix_blend_avx2(PIXVAL *dest, const PIXVAL *src, const PIXVAL colour, const PIXVAL len)
+{
+	PIXVAL n = len;
+	for (; n >= 16; n -= 16, dest += 16, src += 16) {
+		const __m256i s = _mm256_loadu_si256((const __m256i *)src);
+		const __m256i d = _mm256_loadu_si256((const __m256i *)dest);
+		_mm256_storeu_si256((__m256i *)dest, blend_quarters_avx2<quarters, one_out, two_out>(s, d));
+	}
+	scalar(dest, src, colour, n);
+}
+
+
+template<int quarters, PIXVAL one_out, PIXVAL two_out, blend_proc scalar>
+AVX2_TARGET static void pix_blend_recode_avx2(PIXVAL *dest, const PIXVAL *src, const PIXVAL colour, const PIXVAL len)
+{
+	PIXVAL n = len;
+	for (; n >= 16; n -= 16, dest += 16, src += 16) {
+		const __m256i d = _mm256_loadu_si256((const __m256i *)dest);
+		_mm256_storeu_si256((__m256i *)dest, blend_quarters_avx2<quarters, one_out, two_out>(recode_avx2(src), d));
+	}
+	scalar(dest, src, colour, n);
+}
+
+
+template<int quarters, PIXVAL one_out, PIXVAL two_out, blend_proc scalar>
+AVX2_TARGET static void pix_outline_avx2(PIXVAL *dest, const PIXVAL *src, const PIXVAL colour, const PIXVAL len)
+{
+	const __m256i c = _mm256_set1_epi16((short)colour);
+	PIXVAL n = len;
+	for (; n >= 16; n -= 16, dest += 16) {
+		const __m256i d = _mm256_loadu_si256((const __m256i *)dest);
+		_mm256_storeu_si256((__m256i *)dest, blend_quarters_avx2<quarters, one_out, two_out>(c, d));
+	}
+	scalar(dest, src, colour, n);
+}
+
+
+template<int red_shift, PIXVAL green_mask>
+AVX2_TARGET static inline __m256i alpha_mix_avx2(const __m256i s, const __m256i d, const __m256i a)
+{
+	const __m256i five_bits = _mm256_set1_epi16(0x1F);
+	const __m256i g_bits = _mm256_set1_epi16((short)green_mask);
+	const __m256i na = _mm256_sub_epi16(_mm256_set1_epi16(32), a);
+	const __m256i r = _mm256_srli_epi16(_mm256_add_epi16(
+		_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(s, red_shift), five_bits), a),
+		_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(d, red_shift), five_bits), na)), 5);
+	const __m256i g = _mm256_srli_epi16(_mm256_add_epi16(
+		_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(s, 5), g_bits), a),
+		_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(d, 5), g_bits), na)), 5);
+	const __m256i b = _mm256_srli_epi16(_mm256_add_epi16(
+		_mm256_mullo_epi16(_mm256_and_si256(s, five_bits), a),
+		_mm256_mullo_epi16(_mm256_and_si256(d, five_bits), na)), 5);
+	return _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(r, red_shift), _mm256_slli_epi16(g, 5)), b);
+}
+
+
+template<int red_shift, PIXVAL green_mask, bool recode, alpha_proc scalar>
+AVX2_TARGET static void pix_alpha_avx2(PIXVAL *dest, const PIXVAL *src, const PIXVAL *alphamap, const unsigned alpha_flags, const PIXVAL colour, const PIXVAL len)
+{
+	const __m256i rmask = _mm256_set1_epi16(alpha_flags & ALPHA_RED ? 0x7c00 : 0);
+	const __m256i gmask = _mm256_set1_epi16(alpha_flags & ALPHA_GREEN ? 0x03e0 : 0);
+	const __m256i bmask = _mm256_set1_epi16(alpha_flags & ALPHA_BLUE ? 0x001f : 0);
+
+	PIXVAL n = len;
+	for (; n >= 16; n -= 16, dest += 16, src += 16, alphamap += 16) {
+		// read mask components - always 15bpp
+		const __m256i am = _mm256_loadu_si256((const __m256i *)alphamap);
+		__m256i a = _mm256_add_epi16(_mm256_add_epi16(_mm256_and_si256(am, bmask), _mm256_srli_epi16(_mm256_and_si256(am, gmask), 5)), _mm256_srli_epi16(_mm256_and_si256(am, rmask), 10));
+		const __m256i opaque = _mm256_cmpgt_epi16(a, _mm256_set1_epi16(30));
+		const __m256i clear = _mm256_cmpeq_epi16(a, _mm256_setzero_si256());
+		a = _mm256_sub_epi16(a, _mm256_cmpgt_epi16(a, _mm256_set1_epi16(15)));
+
+		const __m256i s = recode ? recode_avx2(src) : _mm256_loadu_si256((const __m256i *)src);
+		const __m256i d = _mm256_loadu_si256((const __m256i *)dest);
+		const __m256i mixed = alpha_mix_avx2<red_shift, green_mask>(s, d, a);
+		const __m256i translucent = _mm256_blendv_epi8(mixed, d, clear);
+		_mm256_storeu_si256((__m256i *)dest, _mm256_blendv_epi8(translucent, s, opaque));
+	}
+	scalar(dest, src, alphamap, alpha_flags, colour, n);
+}
+
+
+template<int red_shift, PIXVAL green_mask, blend_rgb_proc scalar>
+AVX2_TARGET static void pix_blend_rgb_avx2(PIXVAL *dest, const PIXVAL colour, const PIXVAL alpha, const PIXVAL len)
+{
+	const __m256i five_bits = _mm256_set1_epi16(0x1F);
+	const __m256i g_bits = _mm256_set1_epi16((short)green_mask);
+	const __m256i a = _mm256_set1_epi16((short)alpha);
+	const __m256i r_src = _mm256_set1_epi16((short)((colour >> red_shift) & 0x1F));
+	const __m256i g_src = _mm256_set1_epi16((short)((colour >> 5) & green_mask));
+	const __m256i b_src = _mm256_set1_epi16((short)(colour & 0x1F));
+
+	PIXVAL n = len;
+	for (; n >= 16; n -= 16, dest += 16) {
+		const __m256i d = _mm256_loadu_si256((const __m256i *)dest);
+		const __m256i r_dest = _mm256_and_si256(_mm256_srli_epi16(d, red_shift), five_bits);
+		const __m256i g_dest = _mm256_and_si256(_mm256_srli_epi16(d, 5), g_bits);
+		const __m256i b_dest = _mm256_and_si256(d, five_bits);
+		const __m256i r = _mm256_add_epi16(r_dest, _mm256_srai_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(r_src, r_dest), a), 6));
+		const __m256i g = _mm256_add_epi16(g_dest, _mm256_srai_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(g_src, g_dest), a), 6));
+		const __m256i b = _mm256_add_epi16(b_dest, _mm256_srai_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(b_src, b_dest), a), 6));
+		_mm256_storeu_si256((__m256i *)dest, _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi16(r, red_shift), _mm256_slli_epi16(g, 5)), b));
+	}
+	scalar(dest, colour, alpha, n);
+}
+#endif
+
+
+/*
+ * Before a vector routine replaces a scalar one, both run on the same random
+ * runs of all lengths up to some vectors, and it is only used if every pixel
+ * is the same. Uses its own random numbers, as simrand() must not change here.
+ */
+#define SIMD_CHECK_LEN (67)
+
+static uint32 simd_check_seed = 12345;
+
+static void simd_check_fill(PIXVAL *buf, int len, PIXVAL mask)
+{
+	for (int i = 0; i < len; i++) {
+		simd_check_seed = simd_check_seed * 1103515245u + 12345u;
+		buf[i] = (PIXVAL)(simd_check_seed >> 12) & mask;
+	}
+}
+
+
+static bool simd_check_blend(blend_proc simd, blend_proc scalar, PIXVAL src_mask)
+{
+	PIXVAL src[SIMD_CHECK_LEN], dest[SIMD_CHECK_LEN], expected[SIMD_CHECK_LEN], colour;
+	for (int len = 0; len <= SIMD_CHECK_LEN; len++) {
+		simd_check_fill(src, SIMD_CHECK_LEN, src_mask);
+		simd_check_fill(dest, SIMD_CHECK_LEN, 0xFFFF);
+		simd_check_fill(&colour, 1, 0xFFFF);
+		memcpy(expected, dest, sizeof(dest));
+		scalar(expected, src, colour, len);
+		simd(dest, src, colour, len);
+		if (memcmp(expected, dest, sizeof(dest)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static bool simd_check_alpha(alpha_proc simd, alpha_proc scalar, PIXVAL src_mask)
+{
+	PIXVAL src[SIMD_CHECK_LEN], dest[SIMD_CHECK_LEN], expected[SIMD_CHECK_LEN], alphamap[SIMD_CHECK_LEN];
+	for (int len = 0; len <= SIMD_CHECK_LEN; len++) {
+		simd_check_fill(src, SIMD_CHECK_LEN, src_mask);
+		simd_check_fill(dest, SIMD_CHECK_LEN, 0xFFFF);
+		simd_check_fill(alphamap, SIMD_CHECK_LEN, 0x7FFF);
+		const unsigned alpha_flags = 1 + len % 7;
+		memcpy(expected, dest, sizeof(dest));
+		scalar(expected, src, alphamap, alpha_flags, 0, len);
+		simd(dest, src, alphamap, alpha_flags, 0, len);
+		if (memcmp(expected, dest, sizeof(dest)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+static bool simd_check_blend_rgb(blend_rgb_proc simd, blend_rgb_proc scalar)
+{
+	PIXVAL dest[SIMD_CHECK_LEN], expected[SIMD_CHECK_LEN], colour;
+	for (int len = 0; len <= SIMD_CHECK_LEN; len++) {
+		simd_check_fill(dest, SIMD_CHECK_LEN, 0xFFFF);
+		simd_check_fill(&colour, 1, 0xFFFF);
+		const PIXVAL alpha = 1 + len % 63;
+		memcpy(expected, dest, sizeof(dest));
+		scalar(expected, colour, alpha, len);
+		simd(dest, colour, alpha, len);
+		if (memcmp(expected, dest, sizeof(dest)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/// all routines for one pixel format and instruction set, in the order of the arrays
+struct simd_pixel_procs_t
+{
+	const char *name;
+	blend_proc blend[3];
+	blend_proc blend_recode[3];
+	blend_proc outline[3];
+	alpha_proc alpha;
+	alpha_proc alpha_recode;
+	blend_rgb_proc blend_rgb;
+};
+
+#define SIMD_PIXEL_PROCS(name, isa, red_shift, green_mask, one_out, two_out, fmt) \
+	{ name, \
+	{ pix_blend_##isa<1, one_out, two_out, pix_blend25_##fmt>, pix_blend_##isa<2, one_out, two_out, pix_blend50_##fmt>, pix_blend_##isa<3, one_out, two_out, pix_blend75_##fmt> }, \
+	{ pix_blend_recode_##isa<1, one_out, two_out, pix_blend_recode25_##fmt>, pix_blend_recode_##isa<2, one_out, two_out, pix_blend_recode50_##fmt>, pix_blend_recode_##isa<3, one_out, two_out, pix_blend_recode75_##fmt> }, \
+	{ pix_outline_##isa<1, one_out, two_out, pix_outline25_##fmt>, pix_outline_##isa<2, one_out, two_out, pix_outline50_##fmt>, pix_outline_##isa<3, one_out, two_out, pix_outline75_##fmt> }, \
+	pix_alpha_##isa<red_shift, green_mask, false, pix_alpha_##fmt>, \
+	pix_alpha_##isa<red_shift, green_mask, true, pix_alpha_recode_##fmt>, \
+	pix_blend_rgb_##isa<red_shift, green_mask, pix_blend_rgb_##fmt> }
+
+
+/**
+ * Replaces the scalar routines in blend[], blend_recode[], outline[], alpha,
+ * alpha_recode and blend_rgb with the widest vector versions the cpu runs.
+ * Must be called after these were set to the scalar ones of the pixel format.
+ */
+static void select_simd_pixel_procs(const bool is_15bit)
+{
+	static const simd_pixel_procs_t sse2_procs[2] = {
+		SIMD_PIXEL_PROCS("SSE2", sse2, 11, 0x3F, ONE_OUT_16, TWO_OUT_16, 16),
+		SIMD_PIXEL_PROCS("SSE2", sse2, 10, 0x1F, ONE_OUT_15, TWO_OUT_15, 15)
+	};
+	const simd_pixel_procs_t *procs = &sse2_procs[is_15bit];
+#ifdef USE_AVX2
+	static const simd_pixel_procs_t avx2_procs[2] = {
+		SIMD_PIXEL_PROCS("AVX2", avx2, 11, 0x3F, ONE_OUT_16, TWO_OUT_16, 16),
+		SIMD_PIXEL_PROCS("AVX2", avx2, 10, 0x1F, ONE_OUT_15, TWO_OUT_15, 15)
+	};
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		procs = &avx2_procs[is_15bit];
+	}
+#endif
+
+	// the recoding routines read through rgbmap_current
+	PIXVAL *const old_rgbmap = rgbmap_current;
+	rgbmap_current = rgbmap_day_night;
+	bool same = true;
+	for (int i = 0; i < 3; i++) {
+		same &= simd_check_blend(procs->blend[i], blend[i], 0xFFFF);
+		same &= simd_check_blend(procs->blend_recode[i], blend_recode[i], 0x7FFF);
+		same &= simd_check_blend(procs->outline[i], outline[i], 0xFFFF);
+	}
+	same &= simd_check_alpha(procs->alpha, alpha, 0xFFFF);
+	same &= simd_check_alpha(procs->alpha_recode, alpha_recode, 0x7FFF);
+	same &= simd_check_blend_rgb(procs->blend_rgb, blend_rgb);
+	rgbmap_current = old_rgbmap;
+
+	if (!same) {
+		dbg->warning("select_simd_pixel_procs()", "%s routines differ from the scalar ones, not using them", procs->name);
+		return;
+	}
+	for (int i = 0; i < 3; i++) {
+		blend[i] = procs->blend[i];
+		blend_recode[i] = procs->blend_recode[i];
+		outline[i] = procs->outline[i];
+	}
+	alpha = procs->alpha;
+	alpha_recode = procs->alpha_recode;
+	blend_rgb = procs->blend_rgb;
+	dbg->message("select_simd_pixel_procs()", "using %s for blending", procs->name);
+}
+#endif
+
+
 static void display_img_alpha_wc(KOORD_VAL h, const KOORD_VAL xp, const KOORD_VAL yp, const PIXVAL *sp, const PIXVAL *alphamap, const uint8 alpha_flags, int colour, alpha_proc p  CLIP_NUM_DEF)
 {
 	if (h > 0) {
@@ -5150,10 +5612,6 @@ void simgraph_init(KOORD_VAL width, KOORD_VAL height, int full_screen)
 	disp_actual_width = width;
 	disp_height = height;
 
-#ifdef MULTI_THREAD
-	pthread_mutex_init(&recode_img_mutex, NULL);
-#endif
-
 	// init rezoom_img()
 	for (int i = 0; i < MAX_THREADS; i++) {
 #ifdef MULTI_THREAD
@@ -5230,6 +5688,7 @@ void simgraph_init(KOORD_VAL width, KOORD_VAL height, int full_screen)
 			outline[2] = pix_outline75_15;
 			alpha = pix_alpha_15;
 			alpha_recode = pix_alpha_recode_15;
+			blend_rgb = pix_blend_rgb_15;
 		}
 		else {
 			blend[0] = pix_blend25_16;
@@ -5243,7 +5702,11 @@ void simgraph_init(KOORD_VAL width, KOORD_VAL height, int full_screen)
 			outline[2] = pix_outline75_16;
 			alpha = pix_alpha_16;
 			alpha_recode = pix_alpha_recode_16;
+			blend_rgb = pix_blend_rgb_16;
 		}
+#ifdef USE_SSE2
+		select_simd_pixel_procs(c == 31);
+#endif
 	}
 
 	printf("Init done.\n");
@@ -5277,7 +5740,6 @@ void simgraph_exit()
 	tile_dirty = tile_dirty_old = NULL;
 	images = NULL;
 #ifdef MULTI_THREAD
-	pthread_mutex_destroy(&recode_img_mutex);
 	for (int i = 0; i < MAX_THREADS; i++) {
 		pthread_mutex_destroy(&rezoom_img_mutex[i]);
 	}
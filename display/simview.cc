@@ -53,41 +53,78 @@ bool spawned_threads=false; // global job indicator array
 static simthread_barrier_t display_barrier_start;
 static simthread_barrier_t display_barrier_end;
 
+/* The following mutex is only needed for smart cursor */
+// mutex for changing settings on hiding buildings/trees
+static pthread_mutex_t hide_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool threads_req_pause = false;  // set true to pause all threads to display smartcursor region single threaded
+static uint8 num_threads_paused = 0; // number of threads in the paused state
+static pthread_cond_t hiding_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t waiting_cond = PTHREAD_COND_INITIALIZER;
+
 // to start a thread
 typedef struct{
 	main_view_t *show_routine;
-	koord   lt_cl, wh_cl; // pos/size of clipping rect for this thread
-	koord   lt, wh;       // pos/size of region to display. set larger than clipping for correct display of trees at thread seams
-	sint16  y_min;
-	sint16  y_max;
 	sint8   thread_num;
 } display_region_param_t;
 
-// now the parameters
-static display_region_param_t ka[MAX_THREADS];
+/*
+ * The screen is cut into more columns than there are threads, and each thread
+ * draws the next column nobody has taken yet. So a thread over a busy city does
+ * not hold up the others, which just take more of the remaining columns.
+ */
+static struct {
+	koord  lt, wh;        // clipping rect of the whole view
+	KOORD_VAL width;      // of a column, multiple of display_get_dirty_column_width()
+	sint16 count;
+	sint16 next;          // next column to draw, protected by column_mutex
+	sint16 y_min, y_max;
+} display_columns;
+
+static pthread_mutex_t column_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void display_columns_region( main_view_t *show_routine, const sint8 thread_num )
+{
+	const sint16 IMG_SIZE = get_tile_raster_width();
+	while(  true  ) {
+		pthread_mutex_lock( &column_mutex );
+		const sint16 column = display_columns.next++;
+		pthread_mutex_unlock( &column_mutex );
+		if(  column >= display_columns.count  ) {
+			break;
+		}
+
+		const KOORD_VAL lt_x = display_columns.lt.x + column * display_columns.width;
+		const KOORD_VAL wh_x = min( display_columns.width, display_columns.lt.x + display_columns.wh.x - lt_x );
+		clear_all_poly_clip( thread_num );
+		display_set_clip_wh( lt_x, display_columns.lt.y, wh_x, display_columns.wh.y, thread_num );
+		// process tiles IMG_SIZE/2 outside clipping range for correct tree display at column seams
+		show_routine->display_region( koord( lt_x - IMG_SIZE / 2, display_columns.lt.y ), koord( wh_x + IMG_SIZE, display_columns.wh.y ), display_columns.y_min, display_columns.y_max, false, true, thread_num );
+	}
+
+	// show thread as paused when finished
+	pthread_mutex_lock( &hide_mutex  );
+	num_threads_paused++;
+	pthread_cond_broadcast( &waiting_cond );
+	pthread_mutex_unlock( &hide_mutex  );
+}
+
 
 void *display_region_thread( void *ptr )
 {
 	display_region_param_t *view = reinterpret_cast<display_region_param_t *>(ptr);
 	while(true) {
 		simthread_barrier_wait( &display_barrier_start ); // wait for all to start
-		clear_all_poly_clip( view->thread_num );
-		display_set_clip_wh( view->lt_cl.x, view->lt_cl.y, view->wh_cl.x, view->wh_cl.y, view->thread_num );
-		view->show_routine->display_region( view->lt, view->wh, view->y_min, view->y_max, false, true, view->thread_num );
+		display_columns_region( view->show_routine, view->thread_num );
 		simthread_barrier_wait( &display_barrier_end ); // wait for all to finish
 	}
 	return ptr;
 }
 
-/* The following mutex is only needed for smart cursor */
-// mutex for changing settings on hiding buildings/trees
-static pthread_mutex_t hide_mutex = PTHREAD_MUTEX_INITIALIZER;
-static bool threads_req_pause = false;  // set true to pause all threads to display smartcursor region single threaded
-static uint8 num_threads_paused = 0; // number of threads in the paused state
-static pthread_cond_t hiding_cond = PTHREAD_COND_INITIALIZER;
-static pthread_cond_t waiting_cond = PTHREAD_COND_INITIALIZER;
-
 #if COLOUR_DEPTH != 0
+// now the parameters
+static display_region_param_t ka[MAX_THREADS];
+
 static bool can_multithreading = true;
 #endif
 #endif
@@ -212,20 +249,23 @@ void main_view_t::display(bool force_dirty)
 		}
 
 		// set parameter for each thread
-		const KOORD_VAL wh_x = disp_width / env_t::num_threads;
-		KOORD_VAL lt_x = 0;
 		for(  int t = 0;  t < env_t::num_threads - 1;  t++  ) {
-		   	ka[t].show_routine = this;
-			ka[t].lt_cl = koord( lt_x, menu_height );
-			ka[t].wh_cl = koord( wh_x, disp_height - menu_height );
-			ka[t].lt = ka[t].lt_cl - koord( IMG_SIZE/2, 0 ); // process tiles IMG_SIZE/2 outside clipping range for correct tree display at thread seams
-			ka[t].wh = ka[t].wh_cl + koord( IMG_SIZE, 0 );
-			ka[t].y_min = y_min;
-			ka[t].y_max = dpy_height + 4 * 4;
+			ka[t].show_routine = this;
 			ka[t].thread_num = t;
-			lt_x += wh_x;
 		}
 
+		// about four columns per thread, but each at least two tiles wide, since every column redraws half a tile on either side
+		const KOORD_VAL align = display_get_dirty_column_width();
+		KOORD_VAL column_width = max( disp_width / (env_t::num_threads * 4), 2 * IMG_SIZE );
+		column_width = ((column_width + align - 1) / align) * align;
+		display_columns.lt = koord( 0, menu_height );
+		display_columns.wh = koord( disp_width, disp_height - menu_height );
+		display_columns.width = column_width;
+		display_columns.count = (disp_width + column_width - 1) / column_width;
+		display_columns.next = 0;
+		display_columns.y_min = y_min;
+		display_columns.y_max = dpy_height + 4 * 4;
+
 		// init variables required to draw smart cursor
 		threads_req_pause = false;
 		num_threads_paused = 0;
@@ -233,10 +273,8 @@ void main_view_t::display(bool force_dirty)
 		// and start drawing
 		simthread_barrier_wait( &display_barrier_start );
 
-		// the last we can run ourselves, setting clip_wh to the screen edge instead of wh_x (in case disp_width % num_threads != 0)
-		clear_all_poly_clip( env_t::num_threads - 1 );
-		display_set_clip_wh( lt_x, menu_height, disp_width - lt_x, disp_height - menu_height, env_t::num_threads - 1 );
- 		display_region( koord( lt_x - IMG_SIZE / 2, menu_height ), koord( disp_width - lt_x + IMG_SIZE, disp_height - menu_height ), y_min, dpy_height + 4 * 4, false, true, env_t::num_threads - 1 );
+		// we take columns ourselves too
+		display_columns_region( this, env_t::num_threads - 1 );
 
 		simthread_barrier_wait( &display_barrier_end );
 
@@ -347,6 +385,8 @@ void main_view_t::display_region( koord lt, koord wh, sint16 y_min, sint16 y_max
 	const int const_y_off = viewport->get_y_off();
 
 	const int dpy_width = display_get_width() / IMG_SIZE + 2;
+	// tiles left of this column are not drawn, so the x loops can start just before lt.x
+	const int x_first = (lt.x - IMG_SIZE - const_x_off) / (IMG_SIZE / 2) - 1;
 
 	// to save calls to grund_t::get_disp_height
 	const sint8 hmax_ground = (grund_t::underground_mode == grund_t::ugm_level) ? grund_t::underground_level : 127;
@@ -360,7 +400,11 @@ void main_view_t::display_region( koord lt, koord wh, sint16 y_min, sint16 y_max
 		// plotted = we plotted something
 		bool plotted = false;
 
-		for(  sint16 x = -2 - ((y  +dpy_width) & 1);  (x * (IMG_SIZE / 2) + const_x_off) < (lt.x + wh.x);  x += 2  ) {
+		sint16 x = -2 - ((y + dpy_width) & 1);
+		if(  x < x_first  ) {
+			x += (x_first - x) & ~1;
+		}
+		for(  ;  (x * (IMG_SIZE / 2) + const_x_off) < (lt.x + wh.x);  x += 2  ) {
 			const sint16 i = ((y + x) >> 1) + i_off;
 			const sint16 j = ((y - x) >> 1) + j_off;
 			const sint16 xpos = x * (IMG_SIZE / 2) + const_x_off;
@@ -436,7 +480,11 @@ void main_view_t::display_region( koord lt, koord wh, sint16 y_min, sint16 y_max
 	for(  int y = y_min;  y < y_max;  y++  ) {
 		const sint16 ypos = y * (IMG_SIZE / 4) + const_y_off;
 
-		for(  sint16 x = -2 - ((y + dpy_width) & 1);  (x * (IMG_SIZE / 2) + const_x_off) < (lt.x + wh.x);  x += 2  ) {
+		sint16 x = -2 - ((y + dpy_width) & 1);
+		if(  x < x_first  ) {
+			x += (x_first - x) & ~1;
+		}
+		for(  ;  (x * (IMG_SIZE / 2) + const_x_off) < (lt.x + wh.x);  x += 2  ) {
 			const int i = ((y + x) >> 1) + i_off;
 			const int j = ((y - x) >> 1) + j_off;
 			const int xpos = x * (IMG_SIZE / 2) + const_x_off;
@@ -547,15 +595,6 @@ void main_view_t::display_region( koord lt, koord wh, sint16 y_min, sint16 y_max
 			}
 		}
 	}
-#ifdef MULTI_THREAD
-	// show thread as paused when finished
-	if(  threaded  ) {
-		pthread_mutex_lock( &hide_mutex  );
-		num_threads_paused++;
-		pthread_cond_broadcast( &waiting_cond );
-		pthread_mutex_unlock( &hide_mutex  );
-	}
-#endif
 }
 
 
@@ -33,6 +33,7 @@
 #include "../display/viewport.h"
 #include "../utils/simrandom.h"
 #include "../player/simplay.h"
+#include "../sys/simsys.h"
 
 #include "../tpl/inthashtable_tpl.h"
 #include "../tpl/slist_tpl.h"
@@ -52,6 +53,16 @@ static sint32 max_service = 1;
 
 static sint32 max_building_level = 0;
 
+// milliseconds per frame spent on recalculating tile colours
+#define MAP_SLICE_MS (8)
+
+// modes showing statistics of the last month, which must be recalculated each month
+static const uint32 MAP_MONTHLY_MODES =
+	reliefkarte_t::MAP_FREIGHT | reliefkarte_t::MAP_TRAFFIC | reliefkarte_t::MAP_STATION_COVERAGE | reliefkarte_t::MAP_CONDITION |
+	reliefkarte_t::MAP_CONGESTION | reliefkarte_t::MAP_POWERLINES | reliefkarte_t::MAP_LEVEL | reliefkarte_t::MAP_TOURIST |
+	reliefkarte_t::MAP_ACCESSIBILITY_COMMUTING | reliefkarte_t::MAP_ACCESSIBILITY_TRIP | reliefkarte_t::MAP_STAFF_FULFILLMENT |
+	reliefkarte_t::MAP_MAIL_DELIVERY;
+
 reliefkarte_t * reliefkarte_t::single_instance = NULL;
 karte_ptr_t reliefkarte_t::welt;
 reliefkarte_t::MAP_MODES reliefkarte_t::mode = MAP_TOWN;
@@ -589,10 +600,16 @@ void reliefkarte_t::set_relief_farbe(koord k_, const int color)
 	// if map is in normal mode, set new color for map
 	// otherwise do nothing
 	// result: convois will not "paint over" special maps
-	if (relief==NULL  ||  !welt->is_within_limits(k_)) {
+	if (relief==NULL  ||  tile_colors==NULL  ||  !welt->is_within_limits(k_)  ||  (uint32)k_.x >= tile_colors->get_width()  ||  (uint32)k_.y >= tile_colors->get_height()) {
 		return;
 	}
+	tile_colors->at(k_) = color;
+	set_relief_pixel(k_, color);
+}
+
 
+void reliefkarte_t::set_relief_pixel(koord k_, const uint8 color)
+{
 	scr_coord c = karte_to_screen(k_);
 	c -= cur_off;
 
@@ -1128,11 +1145,18 @@ void reliefkarte_t::calc_map_size()
 		size.x += zoom_in*2;
 	}
 	set_size( scr_size(size.x, size.y) ); // of the gui_komponete to adjust scroll bars
-	needs_redraw = true;
+	relief_outdated = true;
 }
 
 
 void reliefkarte_t::calc_map()
+{
+	next_tile_colors_row = 0;
+	relief_outdated = true;
+}
+
+
+void reliefkarte_t::update_relief()
 {
 	// only use bitmap size like screen size
 	scr_size relief_size( min( get_size().w, new_size.w ), min( get_size().h, new_size.h ) );
@@ -1141,9 +1165,15 @@ void reliefkarte_t::calc_map()
 		delete relief;
 		relief = new array2d_tpl<unsigned char> (relief_size.w,relief_size.h);
 	}
+	if(  tile_colors==NULL  ||  (sint16)tile_colors->get_width()!=welt->get_size().x  ||  (sint16)tile_colors->get_height()!=welt->get_size().y  ) {
+		delete tile_colors;
+		tile_colors = new array2d_tpl<uint8>( welt->get_size().x, welt->get_size().y );
+		tile_colors->init( COL_BLACK );
+		next_tile_colors_row = 0;
+	}
 	cur_off = new_off;
 	cur_size = new_size;
-	needs_redraw = false;
+	relief_outdated = false;
 	is_visible = true;
 
 	// redraw the map
@@ -1153,23 +1183,61 @@ void reliefkarte_t::calc_map()
 		koord end_off = start_off+koord( (relief->get_width()*zoom_out)/zoom_in+1, (relief->get_height()*zoom_out)/zoom_in+1 );
 		for(  k.y=start_off.y;  k.y<end_off.y;  k.y+=zoom_out  ) {
 			for(  k.x=start_off.x;  k.x<end_off.x;  k.x+=zoom_out  ) {
-				calc_map_pixel(k);
+				if(  k.y >= next_tile_colors_row  ) {
+					// not recalculated yet, but visible, so do it now
+					calc_map_pixel(k);
+				}
+				else if(  welt->is_within_limits(k)  ) {
+					set_relief_pixel( k, tile_colors->at(k) );
+				}
 			}
 		}
 	}
 	else {
-		// always the whole map ...
-		if(isometric) {
-			relief->init( COL_BLACK );
-		}
+		relief->init( COL_BLACK );
+		// only the tiles which end up within the relief, plus two tiles for rounding
+		const sint32 size_y = welt->get_size().y;
 		koord k;
 		for(  k.y=0;  k.y < welt->get_size().y;  k.y++  ) {
-			for(  k.x=0;  k.x < welt->get_size().x;  k.x++  ) {
-				calc_map_pixel(k);
+			// screen y is (x+y)*zoom_in/2/zoom_out, screen x is ((size_y-y+x)*zoom_in-1)/zoom_out
+			sint32 x_min = max( (2*cur_off.y*zoom_out)/zoom_in - k.y, (cur_off.x*zoom_out)/zoom_in - size_y + k.y ) - 2;
+			sint32 x_max = min( (2*(cur_off.y+(sint32)relief->get_height())*zoom_out)/zoom_in - k.y, ((cur_off.x+(sint32)relief->get_width())*zoom_out)/zoom_in - size_y + k.y ) + 2;
+			x_min = max( x_min, 0 );
+			x_max = min( x_max, welt->get_size().x-1 );
+			for(  k.x=x_min;  k.x <= x_max;  k.x++  ) {
+				set_relief_pixel( k, tile_colors->at(k) );
 			}
 		}
 	}
 
+	calc_map_markers();
+}
+
+
+void reliefkarte_t::calc_tile_colors_slice()
+{
+	if(  tile_colors==NULL  ||  next_tile_colors_row >= welt->get_size().y  ) {
+		return;
+	}
+
+	const uint32 end_time = dr_time() + MAP_SLICE_MS;
+	do {
+		// calc_map_pixel() may restart at row zero, when a maximum is initialised
+		const sint16 y = next_tile_colors_row++;
+		for(  koord k(0,y);  k.x < welt->get_size().x;  k.x++  ) {
+			calc_map_pixel(k);
+		}
+	} while(  next_tile_colors_row < welt->get_size().y  &&  (sint32)(end_time - dr_time()) > 0  );
+
+	if(  next_tile_colors_row >= welt->get_size().y  ) {
+		// the rows painted over the markers
+		calc_map_markers();
+	}
+}
+
+
+void reliefkarte_t::calc_map_markers()
+{
 	// since we do iterate the tourist info list, this must be done here
 	// find tourist spots
 	if(mode==MAP_TOURIST) {
@@ -1218,6 +1286,9 @@ void reliefkarte_t::calc_map()
 reliefkarte_t::reliefkarte_t()
 {
 	relief = NULL;
+	tile_colors = NULL;
+	next_tile_colors_row = 0;
+	relief_outdated = true;
 	zoom_in = 1;
 	zoom_out = 1;
 	isometric = false;
@@ -1234,6 +1305,7 @@ reliefkarte_t::reliefkarte_t()
 reliefkarte_t::~reliefkarte_t()
 {
 	delete relief;
+	delete tile_colors;
 }
 
 
@@ -1250,6 +1322,8 @@ void reliefkarte_t::init()
 {
 	delete relief;
 	relief = NULL;
+	delete tile_colors;
+	tile_colors = NULL;
 	needs_redraw = true;
 	is_visible = false;
 	show_buildings = true;
@@ -1271,7 +1345,10 @@ void reliefkarte_t::set_mode(MAP_MODES new_mode)
 
 void reliefkarte_t::new_month()
 {
-	needs_redraw = true;
+	// the other modes are kept up to date by calc_map_pixel()
+	if(  mode & MAP_MONTHLY_MODES  ) {
+		needs_redraw = true;
+	}
 }
 
 void reliefkarte_t::invalidate_map_lines_cache()
@@ -1390,10 +1467,14 @@ void reliefkarte_t::draw(scr_coord pos)
 		last_mode = mode;
 	}
 
-	if(  needs_redraw  ||  cur_off!=new_off  ||  cur_size!=new_size  ) {
+	if(  needs_redraw  ) {
 		calc_map();
 		needs_redraw = false;
 	}
+	if(  relief_outdated  ||  cur_off!=new_off  ||  cur_size!=new_size  ) {
+		update_relief();
+	}
+	calc_tile_colors_slice();
 
 	if(relief==NULL) {
 		return;
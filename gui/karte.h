@@ -87,8 +87,22 @@ private:
 	// the terrain map
 	array2d_tpl<uint8> *relief;
 
+	/**
+	 * Colour of every tile of the world in the current mode. The relief is
+	 * only a view of this, so scrolling and zooming need no recalculation.
+	 * It is kept up to date by calc_map_pixel() calls from the game, and
+	 * recalculated a few rows per frame by calc_tile_colors_slice().
+	 */
+	array2d_tpl<uint8> *tile_colors;
+
+	// rows of tile_colors below this are not recalculated yet
+	sint16 next_tile_colors_row;
+
 	void set_relief_color_clip( sint16 x, sint16 y, uint8 color );
 
+	// paints the relief at k only, without changing tile_colors
+	void set_relief_pixel( koord k, uint8 color );
+
 	// all stuff connected with schedule display
 	class line_segment_t
 	{
@@ -160,6 +174,18 @@ private:
 	// true, if full redraw is needed
 	bool needs_redraw;
 
+	// true, if the relief must be drawn again from tile_colors
+	bool relief_outdated;
+
+	// draws the relief for cur_off/cur_size from tile_colors
+	void update_relief();
+
+	// recalculates rows of tile_colors for a few milliseconds
+	void calc_tile_colors_slice();
+
+	// marks attractions, factories and depots in their modes
+	void calc_map_markers();
+
 	const fabrik_t* get_fab(koord pos, bool large_area) const;
 
 	const fabrik_t* draw_fab_connections(uint8 colour, scr_coord pos) const;
@@ -232,6 +258,7 @@ public:
 	// update color with render mode (but few are ignored ... )
 	void calc_map_pixel(const koord k);
 
+	// recalculates the whole map, over the next frames
 	void calc_map();
 
 	// calculates the current size of the map (but do not change anything else)
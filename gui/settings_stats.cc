@@ -110,7 +110,11 @@ static const char *revision_ex[] =
 	"27",
 	"28",
 	"29",
-	"30"
+	"30",
+	"31",
+	"32",
+	"33",
+	"34"
 };
 
 // just free memory
@@ -879,6 +883,7 @@ void settings_routing_stats_t::init(settings_t const* const sets)
 	SEPERATOR
 	INIT_NUM( "max_route_steps", sets->get_max_route_steps(), 0, 0x7FFFFFFFul, gui_numberinput_t::POWER2, false );
 	INIT_NUM( "max_choose_route_steps", sets->get_max_choose_route_steps(), 0, 0x7FFFFFFFul, gui_numberinput_t::POWER2, false );
+	INIT_NUM( "way_graph_min_distance", sets->get_way_graph_min_distance(), 0, 65535, gui_numberinput_t::POWER2, false );
 	INIT_NUM( "max_hops", sets->get_max_hops(), 100, 65000, gui_numberinput_t::POWER2, false );
 	INIT_NUM( "max_transfers", sets->get_max_transfers(), 1, 100, gui_numberinput_t::AUTOLINEAR, false );
 	SEPERATOR
@@ -905,6 +910,7 @@ void settings_routing_stats_t::read(settings_t* const sets)
 	READ_BOOL_VALUE( sets->avoid_overcrowding );
 	READ_NUM_VALUE( sets->max_route_steps );
 	READ_NUM_VALUE( sets->max_choose_route_steps );
+	READ_NUM_VALUE( sets->way_graph_min_distance );
 	READ_NUM_VALUE( sets->max_hops );
 	READ_NUM_VALUE( sets->max_transfers );
 
@@ -791,6 +791,7 @@ void network_reset_server()
 	socket_list_t::reset_clients();
 #ifndef NETTOOL
 	nwc_ready_t::clear_map_counters();
+	nwc_frame_t::clear();
 #endif
 }
 
@@ -63,7 +63,7 @@ typedef int SOCKET;
 
 #include "../simtypes.h"
 // version of network protocol code
-#define NETWORK_VERSION (1)
+#define NETWORK_VERSION (3)
 
 class network_command_t;
 class gameinfo_t;
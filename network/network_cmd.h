@@ -39,6 +39,7 @@ enum {
 	NWC_SCENARIO_RULES,
 	NWC_STEP,
 	NWC_ROUTESEARCH,
+	NWC_FRAME,
 	NWC_COUNT
 };
 
@@ -3,6 +3,9 @@
  * (see LICENSE.txt)
  */
 
+#include <string.h>
+#include <zlib.h>
+
 #include "network_cmd_ingame.h"
 #include "network.h"
 #include "network_file_transfer.h"
@@ -56,6 +59,7 @@ network_command_t* network_command_t::read_from_packet(packet_t *p)
 		                      nwc = new nwc_scenario_rules_t(); break;
 		case NWC_ROUTESEARCH: nwc = new nwc_routesearch_t(); break;
 		case NWC_STEP:        nwc = new nwc_step_t(); break;
+		case NWC_FRAME:       nwc = new nwc_frame_t(); break;
 		default:
 			dbg->warning("network_command_t::read_from_socket", "received unknown packet id %d", p->get_id());
 	}
@@ -486,6 +490,7 @@ bool nwc_ready_t::execute(karte_t *welt)
 			const int offset = welt->get_checklist_at(sync_step).print(buf, "server");
 			checklist.print(buf + offset, "client");
 			dbg->warning("nwc_ready_t::execute", "disconnect client due to checklist mismatch : sync_step=%u %s", sync_step, buf);
+			welt->report_world_hash_mismatch(sync_step, checklist, "server");
 			return true;
 		}
 		// check the validity of the map counter
@@ -696,7 +701,7 @@ void nwc_sync_t::do_command(karte_t *welt)
 		bool old_restore_UI = env_t::restore_UI;
 		env_t::restore_UI = true;
 
-		welt->save( fn, loadsave_t::autosave_mode, SERVER_SAVEGAME_VER_NR, EXTENDED_VER_NR, EXTENDED_REVISION_NR, false );
+		welt->save( fn, loadsave_t::autosave_mode, SERVER_SAVEGAME_VER_NR, EXTENDED_VER_NR, EXTENDED_REVISION_NR, false, true );
 		uint32 old_sync_steps = welt->get_sync_steps();
 		welt->load( fn );
 		env_t::restore_UI = old_restore_UI;
@@ -735,26 +740,11 @@ void nwc_sync_t::do_command(karte_t *welt)
 			}
 		}
 
-		// save game
+		// save game: the joining client loads it while it arrives, so use the fast format
 		sprintf( fn, "server%d-network.sve", env_t::server );
 		bool old_restore_UI = env_t::restore_UI;
 		env_t::restore_UI = true;
-		welt->save( fn, loadsave_t::save_mode, SERVER_SAVEGAME_VER_NR, EXTENDED_VER_NR, EXTENDED_REVISION_NR, false );
-
-		// ok, now sending game
-		// this sends nwc_game_t
-		const char *err = network_send_file( client_id, fn );
-		if (err) {
-			dbg->warning("nwc_sync_t::do_command","send game failed with: %s", err);
-		}
-
-		else {
-			// Knightly : synchronise the iteration limits
-			SOCKET sock = socket_list_t::get_socket(client_id);
-			if(  sock==INVALID_SOCKET  ||  !nwc_routesearch_t::transmit_active_limit_set(sock, welt->get_sync_steps(), new_map_counter)  ) {
-				dbg->warning("nwc_sync_t::do_command", "send of NWC_ROUTESEARCH failed");
-			}
-		}
+		welt->save( fn, loadsave_t::autosave_mode, SERVER_SAVEGAME_VER_NR, EXTENDED_VER_NR, EXTENDED_REVISION_NR, false, true );
 
 		uint32 old_sync_steps = welt->get_sync_steps();
 		welt->load( fn );
@@ -766,29 +756,38 @@ void nwc_sync_t::do_command(karte_t *welt)
 		// apply new map counter
 		welt->set_map_counter(new_map_counter);
 
-		// unpause the client that received the game
-		// we do not want to wait for him (maybe loading failed due to pakset-errors)
-		SOCKET sock = socket_list_t::get_socket(client_id);
-		if(  sock != INVALID_SOCKET  ) {
+		// Now queue the game for the joining client (this sends nwc_game_t).
+		// It is sent in the background while the game goes on, so the other
+		// clients need not wait for the transfer. All commands sent to the
+		// clients from now on are queued behind the game, and the new client
+		// catches up with them after loading.
+		const char *err = network_send_file( client_id, fn );
+		if (err) {
+			dbg->warning("nwc_sync_t::do_command","send game failed with: %s", err);
+			nwc_join_t::pending_join_client = INVALID_SOCKET;
+		}
+		else {
+			// Knightly : synchronise the iteration limits
+			nwc_routesearch_t::transmit_active_limit_set(client_id, old_sync_steps, new_map_counter);
+
+			// unpause the client that received the game
+			// we do not want to wait for him (maybe loading failed due to pakset-errors)
+			socket_info_t &info = socket_list_t::get_client(client_id);
 			nwc_ready_t nwc( old_sync_steps, welt->get_map_counter(), welt->get_checklist_at(old_sync_steps) );
-			if (nwc.send(sock)) {
-				socket_list_t::change_state( client_id, socket_info_t::playing);
-				if (socket_list_t::is_valid_client_id(client_id)) {
-					socket_list_t::get_client(client_id).player_unlocked = unlocked_players;
-					// send information about locked state
-					nwc_auth_player_t nwc;
-					nwc.player_unlocked = unlocked_players;
-					nwc.send(sock);
-
-					// welcome message
-					nwc_nick_t::server_tools(welt, client_id, nwc_nick_t::WELCOME, NULL);
-				}
-			}
-			else {
-				dbg->warning( "nwc_sync_t::do_command", "send of NWC_READY failed" );
-			}
+			nwc.prepare_to_send();
+			info.send_queue_append( nwc.copy_packet() );
+			socket_list_t::change_state( client_id, socket_info_t::playing);
+			info.player_unlocked = unlocked_players;
+			// send information about locked state
+			nwc_auth_player_t nwc_auth;
+			nwc_auth.player_unlocked = unlocked_players;
+			nwc_auth.prepare_to_send();
+			info.send_queue_append( nwc_auth.copy_packet() );
+
+			// welcome message
+			nwc_nick_t::server_tools(welt, client_id, nwc_nick_t::WELCOME, NULL);
+			// pending_join_client is reset when the game is sent
 		}
-		nwc_join_t::pending_join_client = INVALID_SOCKET;
 	}
 	// restore screen coordinates & offsets
 	welt->get_viewport()->change_world_position(ij, xoff, yoff);
@@ -893,19 +892,19 @@ void nwc_routesearch_t::check_for_transmission(karte_t *world)
 }
 
 
-bool nwc_routesearch_t::transmit_active_limit_set(SOCKET client_socket, uint32 sync_step, uint32 map_counter)
+void nwc_routesearch_t::transmit_active_limit_set(uint32 client_id, uint32 sync_step, uint32 map_counter)
 {
 	// check if the active limit set is valid -> if not, initialise the active limit set
 	if(  active_limit_set==path_explorer_t::limit_set_t()  ) {
 		active_limit_set = path_explorer_t::get_active_limits();
 	}
-	// now send out the active limit set
+	// now queue the active limit set
 	nwc_routesearch_t nwrs(sync_step, map_counter, active_limit_set, true);
-	const bool success = nwrs.send(client_socket);
-	dbg->warning("nwc_routesearch_t::transmit_active_limit_set", "transmit %s sync_step=%u map_counter=%u limits=(%u, %u, %u, %llu, %u)",
-		success ? "succeeded" : "failed", sync_step, map_counter, active_limit_set.rebuild_connexions, active_limit_set.filter_eligible,
+	nwrs.prepare_to_send();
+	socket_list_t::get_client(client_id).send_queue_append( nwrs.copy_packet() );
+	dbg->warning("nwc_routesearch_t::transmit_active_limit_set", "queued sync_step=%u map_counter=%u limits=(%u, %u, %u, %llu, %u)",
+		sync_step, map_counter, active_limit_set.rebuild_connexions, active_limit_set.filter_eligible,
 		active_limit_set.fill_matrix, active_limit_set.explore_paths, active_limit_set.reroute_goods);
-	return success;
 }
 
 
@@ -1002,8 +1001,9 @@ bool network_broadcast_world_command_t::execute(karte_t *welt)
 		// next call to execute will put it in command queue
 		nwc->exec = true;
 		nwc->sync_step = welt->get_sync_steps() + 1;
-		// broadcast
-		network_send_all(nwc, false);
+		// broadcast with the next frame, and execute on the server
+		nwc_frame_t::append(nwc, welt->get_sync_steps(), welt->get_map_counter());
+		network_send_server(nwc);
 		// return true to delete this command only if clone() returned something new
 		return true;
 	}
@@ -1014,6 +1014,171 @@ bool network_broadcast_world_command_t::execute(karte_t *welt)
 }
 
 
+nwc_frame_t *nwc_frame_t::pending = NULL;
+uint32 nwc_frame_t::pending_since = 0;
+nwc_frame_t::stats_t nwc_frame_t::stats = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+
+nwc_frame_t::~nwc_frame_t()
+{
+	FOR(vector_tpl<network_command_t *>, nwc, commands) {
+		delete nwc;
+	}
+}
+
+
+void nwc_frame_t::rdwr()
+{
+	network_world_command_t::rdwr();
+	packet->rdwr_short(count);
+	packet->rdwr_short(data_size);
+	if (data_size > MAX_DATA_SIZE) {
+		packet->failed();
+		return;
+	}
+
+	// compress if it saves space: commands of one player often look alike
+	uint8 zipped[MAX_DATA_SIZE];
+	uLongf zipped_size = sizeof(zipped);
+	bool compressed = false;
+	if (packet->is_saving()) {
+		compressed = compress2(zipped, &zipped_size, data, data_size, Z_BEST_SPEED) == Z_OK  &&  zipped_size < data_size;
+	}
+	packet->rdwr_bool(compressed);
+	uint16 stored_size = compressed ? (uint16)zipped_size : data_size;
+	packet->rdwr_short(stored_size);
+	if (stored_size > MAX_DATA_SIZE) {
+		packet->failed();
+		return;
+	}
+	uint8 *stored = compressed ? zipped : data;
+	for(  uint16 i = 0;  i < stored_size;  i++  ) {
+		packet->rdwr_byte(stored[i]);
+	}
+
+	if (packet->is_loading()  &&  !packet->has_failed()) {
+		if (compressed) {
+			uLongf size = data_size;
+			if (uncompress(data, &size, zipped, stored_size) != Z_OK  ||  size != data_size) {
+				dbg->warning("nwc_frame_t::rdwr", "could not uncompress frame");
+				packet->failed();
+				return;
+			}
+		}
+		// unpack the commands
+		uint16 offset = 0;
+		for(  uint16 i = 0;  i < count;  i++  ) {
+			uint16 id = 0, len = 0;
+			memory_rw_t header(data + offset, 4, false);
+			header.rdwr_short(id);
+			header.rdwr_short(len);
+			if (header.is_overflow()  ||  offset + 4 + len > data_size) {
+				packet->failed();
+				return;
+			}
+			network_command_t *nwc = read_from_packet( new packet_t(packet->get_sender(), id, data + offset + 4, len) );
+			if (nwc == NULL) {
+				packet->failed();
+				return;
+			}
+			commands.append(nwc);
+			offset += 4 + len;
+		}
+	}
+}
+
+
+bool nwc_frame_t::execute(karte_t *welt)
+{
+	FOR(vector_tpl<network_command_t *>, nwc, commands) {
+		// network_world_command_t's will be appended to command queue in execute
+		if (nwc->execute(welt)) {
+			delete nwc;
+		}
+	}
+	commands.clear();
+	return true;
+}
+
+
+void nwc_frame_t::append(network_world_command_t *nwc, uint32 sync_steps, uint32 map_counter)
+{
+	nwc->prepare_to_send();
+	const packet_t *p = nwc->get_packet();
+	uint16 len = p->get_data_size();
+
+	if (4 + len > MAX_DATA_SIZE) {
+		// does not fit into a frame: send on its own, after the queued commands
+		flush(sync_steps, map_counter, false);
+		socket_list_t::send_all(nwc, true);
+		return;
+	}
+	if (pending  &&  pending->data_size + 4 + len > MAX_DATA_SIZE) {
+		flush(sync_steps, map_counter, false);
+	}
+	if (pending == NULL) {
+		pending = new nwc_frame_t(sync_steps, map_counter);
+		pending_since = dr_time();
+	}
+
+	uint16 id = nwc->get_id();
+	memory_rw_t header(pending->data + pending->data_size, 4, true);
+	header.rdwr_short(id);
+	header.rdwr_short(len);
+	memcpy(pending->data + pending->data_size + 4, p->get_data(), len);
+	pending->data_size += 4 + len;
+	pending->count++;
+}
+
+
+void nwc_frame_t::flush(uint32 sync_steps, uint32 map_counter, bool heartbeat)
+{
+	if (heartbeat) {
+		stats.steps++;
+	}
+	if (pending == NULL) {
+		if (heartbeat) {
+			nwc_step_t *nwcstep = new nwc_step_t(sync_steps, map_counter);
+			nwcstep->prepare_to_send();
+			stats.sent_bytes += nwcstep->get_packet()->get_current_index();
+			network_send_all(nwcstep, true);
+		}
+		return;
+	}
+
+	// the frame tells the clients how far they may advance, like nwc_step_t
+	pending->sync_step = sync_steps;
+	pending->map_counter = map_counter;
+	pending->prepare_to_send();
+	socket_list_t::send_all(pending, true);
+
+	const uint32 latency = dr_time() - pending_since;
+	const uint32 frame_bytes = pending->get_packet()->get_current_index();
+	stats.frames++;
+	stats.commands += pending->count;
+	stats.raw_bytes += pending->data_size;
+	stats.frame_bytes += frame_bytes;
+	stats.sent_bytes += frame_bytes;
+	stats.total_latency_ms += latency;
+	stats.max_latency_ms = max(stats.max_latency_ms, latency);
+	if ((stats.frames & 255) == 0) {
+		dbg->message("nwc_frame_t::flush", "%u steps, %u frames with %u commands: %llu bytes per step, %llu bytes per frame (commands %llu bytes uncompressed), commands waited %llu ms on average, %u ms max",
+			stats.steps, stats.frames, stats.commands, stats.sent_bytes / max(stats.steps, 1u), stats.frame_bytes / stats.frames, stats.raw_bytes / stats.frames,
+			stats.total_latency_ms / stats.frames, stats.max_latency_ms);
+	}
+
+	delete pending;
+	pending = NULL;
+}
+
+
+void nwc_frame_t::clear()
+{
+	delete pending;
+	pending = NULL;
+}
+
+
 nwc_chg_player_t::~nwc_chg_player_t()
 {
 	delete pending_company_creator;
@@ -9,6 +9,7 @@
 
 #include "network_cmd.h"
 #include "memory_rw.h"
+#include "network_packet.h"
 #include "../simworld.h"
 #include "../tpl/slist_tpl.h"
 #include "../utils/plainstring.h"
@@ -236,7 +237,7 @@ public:
 	virtual void do_command(karte_t *world);
 
 	static void check_for_transmission(karte_t *world);
-	static bool transmit_active_limit_set(SOCKET client_socket, uint32 sync_step, uint32 map_counter);
+	static void transmit_active_limit_set(uint32 client_id, uint32 sync_step, uint32 map_counter);
 	static void remove_client_entry(uint32 client_id);
 	static void reset();
 private:
@@ -420,4 +421,69 @@ public:
 	virtual const char* get_name() { return "nwc_step_t"; }
 };
 
+/**
+ * nwc_frame_t
+ * @from-server:
+ *		@data the broadcast commands (tools, player changes ...) of one sync step,
+ *       compressed if this saves space
+ *		@data the current sync_steps of the server, like nwc_step_t
+ *		clients execute the contained commands in order.
+ * The server sends one frame per sync step instead of a packet per command,
+ * and a plain nwc_step_t in steps without commands.
+ */
+class nwc_frame_t : public network_world_command_t {
+public:
+	nwc_frame_t() : network_world_command_t(NWC_FRAME, 0, 0), count(0), data_size(0) { }
+	virtual ~nwc_frame_t();
+	virtual void rdwr();
+	// executes the contained commands, the frame itself is not queued
+	virtual bool execute(karte_t *);
+	virtual const char* get_name() { return "nwc_frame_t"; }
+
+	/**
+	 * Server: queue a broadcast command for the next frame.
+	 * The command itself is not changed, so it can still be executed by the server.
+	 */
+	static void append(network_world_command_t *nwc, uint32 sync_steps, uint32 map_counter);
+
+	/**
+	 * Server: send the queued commands to all playing clients.
+	 * If nothing is queued, sends a nwc_step_t if heartbeat is true, otherwise nothing.
+	 */
+	static void flush(uint32 sync_steps, uint32 map_counter, bool heartbeat);
+
+	static void clear();
+
+	struct stats_t {
+		uint32 steps;             ///< calls of flush() with heartbeat
+		uint32 frames;            ///< frames sent
+		uint32 commands;          ///< commands in these frames
+		uint64 raw_bytes;         ///< command data before compression
+		uint64 frame_bytes;       ///< size of the frames as sent
+		uint64 sent_bytes;        ///< bytes sent to each client, including plain heartbeats
+		uint64 total_latency_ms;  ///< sum over all frames of the time their oldest command waited
+		uint32 max_latency_ms;
+	};
+	static const stats_t &get_stats() { return stats; }
+
+private:
+	// room for the command data in one packet
+	enum { MAX_DATA_SIZE = MAX_PACKET_LEN - HEADER_SIZE - 32 };
+
+	nwc_frame_t(uint32 sync_steps, uint32 map_counter) : network_world_command_t(NWC_FRAME, sync_steps, map_counter), count(0), data_size(0) { }
+
+	// transferred data: count times id, length, packet data
+	uint16 count;
+	uint16 data_size;
+	uint8 data[MAX_DATA_SIZE];
+
+	// received commands
+	vector_tpl<network_command_t *> commands;
+
+	// commands queued for the next frame
+	static nwc_frame_t *pending;
+	static uint32 pending_since;
+	static stats_t stats;
+};
+
 #endif
@@ -35,12 +35,12 @@ char const* network_receive_file( SOCKET const s, char const* const save_as, sin
 #endif
 
 		// good place to show a progress bar
-		char rbuf[4096];
+		char rbuf[32768];
 		sint32 length_read = 0;
 		if (FILE* const f = fopen(save_as, "wb")) {
 			while(length_read < length) {
 				if(  timeout > 0  ) {
-					/** 10s for 4096 bytes:
+					/** 10s for the next bytes:
 					 * As long as you are not connected with less than 1200 Baud that should be fine
 					 * otherwise upgrade you acustic coppler to 56k ...
 					 */
@@ -57,7 +57,7 @@ char const* network_receive_file( SOCKET const s, char const* const save_as, sin
 					}
 				}
 				// ok, now here should be something new to read
-				int i = recv(s, rbuf, length_read + 4096 < length ? 4096 : length - length_read, 0);
+				int i = recv(s, rbuf, length_read + (sint32)sizeof(rbuf) < length ? sizeof(rbuf) : length - length_read, 0);
 				if (i > 0) {
 					fwrite(rbuf, 1, i, f);
 					length_read += i;
@@ -157,7 +157,12 @@ const char *network_gameinfo(const char *cp, gameinfo_t *gi)
 }
 
 
-// connect to address (cp), receive game, save to client%i-network.sve
+// the connection to the server and the length of the game it sends, between network_connect() and network_finish_connect()
+static SOCKET joining_socket = INVALID_SOCKET;
+static sint32 joining_game_length = 0;
+
+
+// connect to address (cp), wait until the server sends the game
 const char *network_connect(const char *cp, karte_t *world)
 {
 	// open from network
@@ -229,28 +234,119 @@ const char *network_connect(const char *cp, karte_t *world)
 			err = "Protocol error (expected NWC_GAME)";
 			goto end;
 		}
-		int len = ((nwc_game_t*)nwc)->len;
-		// guaranteed individual file name ...
-		char filename[256];
-		sprintf( filename, "client%i-network.sve", network_get_client_id() );
-		if(  (err = network_receive_file( my_client_socket, filename, len )) != NULL  ) {
-			goto end;
+		// the game follows, it is read by network_open_game()
+		joining_socket = my_client_socket;
+		joining_game_length = ((nwc_game_t*)nwc)->len;
+	}
+end:
+	if(err) {
+		dbg->warning("network_connect", err);
+		if (!socket_list_t::remove_client(my_client_socket)) {
+			network_close_socket( my_client_socket );
 		}
+	}
+	return err;
+}
+
+
+network_game_source_t::network_game_source_t(SOCKET s, const char *save_as, sint32 length) :
+	s(s),
+	length(length),
+	length_read(0),
+	failed(false)
+{
+	remove(save_as);
+	file = fopen(save_as, "wb");
+}
+
+
+network_game_source_t::~network_game_source_t()
+{
+	if(  file  ) {
+		fclose(file);
+	}
+}
+
+
+size_t network_game_source_t::read(void *buf, size_t len)
+{
+	if(  failed  ||  length_read>=length  ) {
+		return 0;
+	}
+	// 10s for the next bytes, as in network_receive_file()
+	fd_set fds;
+	FD_ZERO(&fds);
+	FD_SET(s,&fds);
+	struct timeval tv;
+	tv.tv_sec = 10;
+	tv.tv_usec = 0;
+	if(  select( FD_SETSIZE, &fds, NULL, NULL, &tv )!=1  ) {
+		failed = true;
+		return 0;
+	}
+	const int i = recv(s, (char *)buf, (size_t)(length - length_read) < len ? length - length_read : len, 0);
+	if(  i<=0  ) {
+		failed = true;
+		return 0;
+	}
+	if(  file  ) {
+		fwrite(buf, 1, i, file);
+	}
+	length_read += i;
+	return i;
+}
+
+
+const char *network_game_source_t::finish()
+{
+	char rbuf[32768];
+	while(  read(rbuf, sizeof(rbuf))>0  ) {
+	}
+	if(  file  ) {
+		fclose(file);
+		file = NULL;
+	}
+	if(  length_read<length  ) {
+		dbg->warning("network_game_source_t::finish", "only %i of %i bytes transferred", length_read, length);
+		return "Not enough bytes transferred";
+	}
+	return NULL;
+}
+
+
+network_game_source_t *network_open_game(const char *save_as)
+{
+	DBG_MESSAGE("network_open_game", "File size %li", joining_game_length);
+	return new network_game_source_t(joining_socket, save_as, joining_game_length);
+}
+
+
+const char *network_finish_connect(karte_t *world, network_game_source_t *game)
+{
+	const SOCKET my_client_socket = joining_socket;
+	joining_socket = INVALID_SOCKET;
+
+	// the loader may not have needed the last bytes of the game
+	const char *err = game->finish();
+	delete game;
+	if(  err==NULL  ) {
 		// Knightly : update iteration limits
 		// wait for routesearch command (tolerate some wrong commands)
+		network_command_t *nwc = NULL;
 		for(  uint8 i=0;  i<5;  ++i  ) {
 			nwc = network_check_activity( NULL, 10000 );
 			if(  nwc  &&  nwc->get_id()==NWC_ROUTESEARCH  ) break;
 		}
 		if(  nwc==NULL  ||  nwc->get_id()!=NWC_ROUTESEARCH  ) {
 			err = "Protocol error (expected NWC_ROUTESEARCH)";
-			goto end;
 		}
-		((nwc_routesearch_t*)nwc)->do_command(world);
+		else {
+			((nwc_routesearch_t*)nwc)->do_command(world);
+		}
 	}
-end:
-	if(err) {
-		dbg->warning("network_connect", err);
+
+	if(  err  ) {
+		dbg->warning("network_finish_connect", err);
 		if (!socket_list_t::remove_client(my_client_socket)) {
 			network_close_socket( my_client_socket );
 		}
@@ -265,50 +361,27 @@ end:
 
 const char *network_send_file( uint32 client_id, const char *filename )
 {
+	if(  socket_list_t::get_socket(client_id) == INVALID_SOCKET  ) {
+		return "Client closed connection during transfer";
+	}
 	FILE *fp = fopen(filename,"rb");
 	if (fp == NULL) {
 		dbg->warning("network_send_file", "could not open file %s", filename);
 		return "Could not open file";
 	}
-	char buffer[1024];
 
 	// find out length
 	fseek(fp, 0, SEEK_END);
 	long length = (long)ftell(fp);
 	rewind(fp);
-	sint32 bytes_sent = 0;
 
-	// send size of file
+	// size of file, then the file itself
 	nwc_game_t nwc(length);
-	SOCKET s = socket_list_t::get_socket(client_id);
-	if (s==INVALID_SOCKET  ||  !nwc.send(s)) {
-		goto error;
-	}
-
-	// good place to show a progress bar
-	if(length>0) {
-		loadingscreen_t ls( translator::translate("Transferring game ..."), length, true, true );
-
-		while(  !feof(fp)  ) {
-			int bytes_read = (int)fread( buffer, 1, sizeof(buffer), fp );
-			uint16 dummy;
-			if( !network_send_data(s, buffer, bytes_read, dummy, 250) ) {
-				socket_list_t::remove_client(s);
-				goto error;
-			}
-			bytes_sent += bytes_read;
-			ls.set_progress( bytes_sent );
-		}
-
-	}
-
-	// ok, new client has savegame
-	fclose(fp);
+	nwc.prepare_to_send();
+	socket_info_t &info = socket_list_t::get_client(client_id);
+	info.send_queue_append( nwc.copy_packet() );
+	info.send_queue_append_file( fp, length );
 	return NULL;
-error:
-	// an error occurred: close file
-	fclose(fp);
-	return "Client closed connection during transfer";
 }
 
 /*
@@ -13,6 +13,7 @@
  */
 
 #include "network.h"
+#include "../dataobj/loadsave.h"
 
 class cbuffer_t;
 class karte_t;
@@ -21,10 +22,40 @@ class gameinfo_t;
 // connect to address (cp), receive gameinfo, close
 const char *network_gameinfo(const char *cp, gameinfo_t *gi);
 
-// connects to server at (cp), receives game, save to client%i-network.sve
+// connects to server at (cp) and waits until it sends the game, which is then read by network_open_game()
 const char* network_connect(const char *cp, karte_t *world);
 
-// sending file over network
+/**
+ * The game sent to a joining client, read from the socket while it is loaded.
+ * Everything received is also written to a file, which is loaded instead if the
+ * game is not in a format which can be read while it arrives.
+ */
+class network_game_source_t : public loadsave_source_t
+{
+	SOCKET s;
+	FILE *file;
+	sint32 length;
+	sint32 length_read;
+	bool failed;
+
+public:
+	network_game_source_t(SOCKET s, const char *save_as, sint32 length);
+	~network_game_source_t();
+
+	size_t read(void *buf, size_t len) OVERRIDE;
+
+	/// receives the rest of the game into the file and closes it, @returns NULL or the error
+	const char *finish();
+};
+
+// after network_connect(): the game sent by the server, written to save_as while it is read
+network_game_source_t *network_open_game(const char *save_as);
+
+// after the game was loaded: receives the rest of the game and the commands which follow it, deletes game
+const char *network_finish_connect(karte_t *world, network_game_source_t *game);
+
+// sending file over network: queued, the file is sent in the background
+// by network_process_send_queues() before any command queued later
 const char *network_send_file( uint32 client_id, const char *filename );
 
 // receive file (directly to disk)
@@ -3,6 +3,8 @@
  * (see LICENSE.txt)
  */
 
+#include <string.h>
+
 #include "../simdebug.h"
 #include "network_packet.h"
 #include "network_socket_list.h"
@@ -60,6 +62,25 @@ packet_t::packet_t(SOCKET sender) : memory_rw_t(buf,MAX_PACKET_LEN,false)
 }
 
 
+packet_t::packet_t(SOCKET sender, uint16 id_, const uint8 *data, uint16 len) : memory_rw_t(buf,MAX_PACKET_LEN,false)
+{
+	error = ( HEADER_SIZE + len > MAX_PACKET_LEN );
+	version = NETWORK_VERSION;
+	id = id_;
+	sock = sender;
+	size = 0;
+	count = 0;
+	ready = !error;
+	if (ready) {
+		memcpy(buf + HEADER_SIZE, data, len);
+		size = HEADER_SIZE + len;
+		count = size;
+		set_max_size(size);
+		set_index(HEADER_SIZE);
+	}
+}
+
+
 void packet_t::recv()
 {
 	if (error  ||  ready) {
@@ -54,6 +54,13 @@ public:
 	 */
 	packet_t(SOCKET s);
 
+	/**
+	 * constructor: packet is in loading-mode and fully received
+	 * @param data the packet without header (see get_data())
+	 * @see nwc_frame_t
+	 */
+	packet_t(SOCKET sender, uint16 id, const uint8 *data, uint16 len);
+
 	/**
 	 * start/continue sending
 	 * sets bools ready or error
@@ -79,6 +86,10 @@ public:
 
 	SOCKET get_sender() { return sock; }
 
+	/// the data written so far, without header (only if saving)
+	const uint8 *get_data() const { return buf + HEADER_SIZE; }
+	uint16 get_data_size() const { return get_current_index() - HEADER_SIZE; }
+
 	/**
 	 * mark this packet as sent by the server
 	 * @see network_send_server
@@ -13,6 +13,17 @@
 #endif
 
 
+struct socket_info_t::pending_file_t
+{
+	FILE *fp;
+	uint32 left;           ///< bytes not yet read from fp
+	uint32 packets_before; ///< queued packets to be sent before the file
+	uint16 count;          ///< bytes in buffer
+	uint16 sent;           ///< bytes of buffer already sent
+	char buffer[32768];
+};
+
+
 bool connection_info_t::operator==(const connection_info_t& other) const
 {
 	return (address.get_ip() == other.address.get_ip())  &&  ( strcmp(nickname.c_str(), other.nickname.c_str())==0 );
@@ -27,6 +38,11 @@ void socket_info_t::reset()
 		packet_t *p = send_queue.remove_first();
 		delete p;
 	}
+	if (pending_file) {
+		fclose(pending_file->fp);
+		delete pending_file;
+		pending_file = NULL;
+	}
 	if (socket != INVALID_SOCKET) {
 		network_close_socket(socket);
 	}
@@ -64,9 +80,61 @@ network_command_t* socket_info_t::receive_nwc()
 }
 
 
+bool socket_info_t::process_pending_file()
+{
+	pending_file_t *const f = pending_file;
+	while(true) {
+		if (f->sent == f->count) {
+			if (f->left == 0) {
+				// transfer finished
+				dbg->message("socket_info_t::process_pending_file", "file sent to [%d]", socket);
+				fclose(f->fp);
+				delete f;
+				pending_file = NULL;
+#ifndef NETTOOL
+				// now the next client may join
+				if (socket == nwc_join_t::pending_join_client) {
+					nwc_join_t::pending_join_client = INVALID_SOCKET;
+				}
+#endif
+				return true;
+			}
+			f->count = (uint16)fread(f->buffer, 1, min(f->left, (uint32)sizeof(f->buffer)), f->fp);
+			f->sent = 0;
+			if (f->count == 0) {
+				dbg->warning("socket_info_t::process_pending_file", "could not read file for [%d]", socket);
+				socket_list_t::remove_client(socket);
+				return false;
+			}
+			f->left -= f->count;
+		}
+		uint16 sent;
+		if (!network_send_data(socket, f->buffer + f->sent, f->count - f->sent, sent, 0)) {
+			// close this client, this also ends the transfer
+			socket_list_t::remove_client(socket);
+			return false;
+		}
+		f->sent += sent;
+		if (f->sent < f->count) {
+			// socket is full, continue later
+			return false;
+		}
+	}
+}
+
+
 void socket_info_t::process_send_queue()
 {
-	while(!send_queue.empty()) {
+	while(true) {
+		if (pending_file  &&  pending_file->packets_before == 0) {
+			if (!process_pending_file()) {
+				break;
+			}
+			continue;
+		}
+		if (send_queue.empty()) {
+			break;
+		}
 		packet_t *p = send_queue.front();
 		p->send(socket, false);
 		if (p->has_failed()) {
@@ -78,6 +146,9 @@ void socket_info_t::process_send_queue()
 			// packet complete sent, remove from queue
 			send_queue.remove_first();
 			delete p;
+			if (pending_file) {
+				pending_file->packets_before--;
+			}
 			// proceed with next packet
 		}
 		else {
@@ -99,6 +170,22 @@ void socket_info_t::send_queue_append(packet_t *p)
 	}
 }
 
+void socket_info_t::send_queue_append_file(FILE *fp, uint32 length)
+{
+	if (pending_file) {
+		dbg->error("socket_info_t::send_queue_append_file", "already sending a file to [%d]", socket);
+		fclose(fp);
+		return;
+	}
+	pending_file = new pending_file_t;
+	pending_file->fp = fp;
+	pending_file->left = length;
+	pending_file->packets_before = send_queue.get_count();
+	pending_file->count = 0;
+	pending_file->sent = 0;
+}
+
+
 void socket_info_t::rdwr(packet_t *p)
 {
 	address.rdwr(p);
@@ -50,6 +50,15 @@ private:
 	packet_t *packet;
 	slist_tpl<packet_t *> send_queue;
 
+	/// a file sent in the background between the packets of the send queue
+	struct pending_file_t;
+	pending_file_t *pending_file;
+
+	/**
+	 * continues sending the pending file
+	 * @return true if the file is sent completely
+	 */
+	bool process_pending_file();
 
 public:
 	enum {
@@ -64,7 +73,7 @@ public:
 
 	SOCKET socket;
 
-	socket_info_t() : connection_info_t(), packet(0), send_queue(), state(inactive), socket(INVALID_SOCKET), player_unlocked(0) {}
+	socket_info_t() : connection_info_t(), packet(0), send_queue(), pending_file(NULL), state(inactive), socket(INVALID_SOCKET), player_unlocked(0) {}
 
 	~socket_info_t();
 
@@ -90,6 +99,15 @@ public:
 
 	void send_queue_append(packet_t *p);
 
+	/**
+	 * Sends the raw contents of @p fp after the packets queued so far.
+	 * Packets appended later are held back until the file is sent.
+	 * Takes ownership of @p fp.
+	 */
+	void send_queue_append_file(FILE *fp, uint32 length);
+
+	bool is_sending_file() const { return pending_file != NULL; }
+
 	/**
 	 * rdwr client information to packet
 	 */
@@ -3,9 +3,13 @@
  * (see LICENSE.txt)
  */
 
+#include <algorithm>
+
 #include "path_explorer.h"
 
 #include "tpl/slist_tpl.h"
+#include "tpl/binary_heap_tpl.h"
+#include "utils/simthread.h"
 #include "dataobj/translator.h"
 #include "bauer/goods_manager.h"
 #include "descriptor/goods_desc.h"
@@ -493,6 +497,10 @@ path_explorer_t::compartment_t::compartment_t()
 	transfer_list = NULL;
 	transfer_count = 0;
 
+	incremental_repair = false;
+	repair_jobs_prepared = false;
+	incremental_repair_count = 0;
+
 	catg = 255;
 	g_class = 255;
 	catg_name = NULL;
@@ -527,11 +535,7 @@ path_explorer_t::compartment_t::~compartment_t()
 {
 	if (finished_matrix)
 	{
-		for (uint16 i = 0; i < finished_halt_count; ++i)
-		{
-			delete[] finished_matrix[i];
-		}
-		delete[] finished_matrix;
+		delete finished_matrix;
 	}
 	if (finished_halt_index_map)
 	{
@@ -541,11 +545,7 @@ path_explorer_t::compartment_t::~compartment_t()
 
 	if (working_matrix)
 	{
-		for (uint16 i = 0; i < working_halt_count; ++i)
-		{
-			delete[] working_matrix[i];
-		}
-		delete[] working_matrix;
+		delete working_matrix;
 	}
 	if (transport_index_map)
 	{
@@ -553,11 +553,7 @@ path_explorer_t::compartment_t::~compartment_t()
 	}
 	if (transport_matrix)
 	{
-		for (uint16 i = 0; i < working_halt_count; ++i)
-		{
-			delete[] transport_matrix[i];
-		}
-		delete[] transport_matrix;
+		delete transport_matrix;
 	}
 	if (working_halt_index_map)
 	{
@@ -609,11 +605,7 @@ void path_explorer_t::compartment_t::reset(const bool reset_finished_set)
 	{
 		if (finished_matrix)
 		{
-			for (uint16 i = 0; i < finished_halt_count; ++i)
-			{
-				delete[] finished_matrix[i];
-			}
-			delete[] finished_matrix;
+			delete finished_matrix;
 			finished_matrix = NULL;
 		}
 		if (finished_halt_index_map)
@@ -622,18 +614,21 @@ void path_explorer_t::compartment_t::reset(const bool reset_finished_set)
 			finished_halt_index_map = NULL;
 		}
 		finished_halt_count = 0;
+
+		finished_edge_offsets.clear();
+		finished_edges.clear();
+		finished_transfers.clear();
+		incremental_repair_count = 0;
 	}
 
 
 	if (working_matrix)
 	{
-		for (uint16 i = 0; i < working_halt_count; ++i)
-		{
-			delete[] working_matrix[i];
-		}
-		delete[] working_matrix;
+		delete working_matrix;
 		working_matrix = NULL;
 	}
+	working_edge_offsets.clear();
+	working_edges.clear();
 	if (transport_index_map)
 	{
 		delete[] transport_index_map;
@@ -641,11 +636,7 @@ void path_explorer_t::compartment_t::reset(const bool reset_finished_set)
 	}
 	if (transport_matrix)
 	{
-		for (uint16 i = 0; i < working_halt_count; ++i)
-		{
-			delete[] transport_matrix[i];
-		}
-		delete[] transport_matrix;
+		delete transport_matrix;
 		transport_matrix = NULL;
 	}
 	if (working_halt_index_map)
@@ -695,6 +686,14 @@ void path_explorer_t::compartment_t::reset(const bool reset_finished_set)
 	}
 	process_next_transfer = true;
 
+	incremental_repair = false;
+	repair_jobs_prepared = false;
+	repair_rows.clear();
+	repair_vias.clear();
+	repair_edges.clear();
+	repair_edge_origins.clear();
+	working_transfer_flags.clear();
+
 #ifdef DEBUG_COMPARTMENT_STEP
 	step_count = 0;
 #endif
@@ -1388,18 +1387,10 @@ void path_explorer_t::compartment_t::step()
 				if (working_halt_count > 0)
 				{
 					// build working matrix
-					working_matrix = new path_element_t*[working_halt_count];
-					for (uint16 i = 0; i < working_halt_count; ++i)
-					{
-						working_matrix[i] = new path_element_t[working_halt_count];
-					}
+					working_matrix = new path_matrix_t(working_halt_count);
 
 					// build transport matrix
-					transport_matrix = new transport_element_t*[working_halt_count];
-					for (uint16 i = 0; i < working_halt_count; ++i)
-					{
-						transport_matrix[i] = new transport_element_t[working_halt_count];
-					}
+					transport_matrix = new transport_matrix_t(working_halt_count);
 
 					// build transfer list
 					transfer_list = new uint16[working_halt_count];
@@ -1418,6 +1409,9 @@ void path_explorer_t::compartment_t::step()
 			{
 				current_halt = working_halt_list[phase_counter];
 
+				// start a new row of direct connexions
+				working_edge_offsets.append( working_edges.get_count() );
+
 				// halts may be removed during the process of refresh
 				if ( ! current_halt.is_bound() )
 				{
@@ -1447,20 +1441,24 @@ void path_explorer_t::compartment_t::step()
 
 					// validate transport and determine transport index
 					uint16 transport_idx;
+					uint32 transport;
 					if ( current_connexion->best_line.is_null() && current_connexion->best_convoy.is_null() )
 					{
 						// passengers walking between 2 halts
+						transport = 0;
 						transport_idx = 0;
 					}
 					else if ( current_connexion->best_line.is_bound() )
 					{
 						// valid line
-						transport_idx = transport_index_map[ current_connexion->best_line.get_id() ];
+						transport = current_connexion->best_line.get_id();
+						transport_idx = transport_index_map[transport];
 					}
 					else if ( current_connexion->best_convoy.is_bound() )
 					{
 						// valid lineless convoy
-						transport_idx = transport_index_map[ 65536u + current_connexion->best_convoy.get_id() ];
+						transport = 65536u + current_connexion->best_convoy.get_id();
+						transport_idx = transport_index_map[transport];
 					}
 					else
 					{
@@ -1477,18 +1475,26 @@ void path_explorer_t::compartment_t::step()
 					}
 
 					// update corresponding matrix element
-					working_matrix[phase_counter][reachable_halt_index].next_transfer = reachable_halt;
-					working_matrix[phase_counter][reachable_halt_index].aggregate_time = current_connexion->waiting_time + current_connexion->journey_time + current_connexion->transfer_time;
-					transport_matrix[phase_counter][reachable_halt_index].first_transport
-						= transport_matrix[phase_counter][reachable_halt_index].last_transport
+					working_matrix->next_transfer(phase_counter, reachable_halt_index) = reachable_halt;
+					working_matrix->aggregate_time(phase_counter, reachable_halt_index) = current_connexion->waiting_time + current_connexion->journey_time + current_connexion->transfer_time;
+					transport_matrix->first_transport(phase_counter, reachable_halt_index)
+						= transport_matrix->last_transport(phase_counter, reachable_halt_index)
 						= transport_idx;
 
+					// keep the direct connexion as baseline for later incremental repairs
+					direct_edge_t edge;
+					edge.target_index = reachable_halt_index;
+					edge.target_halt = reachable_halt;
+					edge.aggregate_time = working_matrix->aggregate_time(phase_counter, reachable_halt_index);
+					edge.transport = transport;
+					working_edges.append(edge);
+
 					// Debug journey times
-					// printf("\n%s -> %s : %lu \n",current_halt->get_name(), reachable_halt->get_name(), working_matrix[phase_counter][reachable_halt_index].journey_time);
+					// printf("\n%s -> %s : %lu \n",current_halt->get_name(), reachable_halt->get_name(), working_matrix->aggregate_time(phase_counter, reachable_halt_index));
 				}
 
 				// Special case
-				working_matrix[phase_counter][phase_counter].aggregate_time = 0;
+				working_matrix->aggregate_time(phase_counter, phase_counter) = 0;
 
 				++phase_counter;
 
@@ -1558,6 +1564,21 @@ void path_explorer_t::compartment_t::step()
 					transport_index_map = NULL;
 				}
 
+				// close the last row of direct connexions
+				working_edge_offsets.append( working_edges.get_count() );
+
+				// if only a few connexions have changed, repair a copy of the finished matrix instead of searching all paths again
+				incremental_repair = prepare_incremental_repair();
+				if ( incremental_repair )
+				{
+					working_matrix->copy_from(*finished_matrix);
+				}
+
+#ifdef DEBUG_COMPARTMENT_STEP
+				printf("\tIncremental Repair :  %s (rows %u, vias %u, edges %u) \n", incremental_repair ? "yes" : "no",
+					   repair_rows.get_count(), repair_vias.get_count(), repair_edges.get_count());
+#endif
+
 				current_phase = phase_explore_paths;	// proceed to the next phase
 				phase_counter = 0;	// reset counter
 
@@ -1584,10 +1605,59 @@ void path_explorer_t::compartment_t::step()
 			printf("\t\tCurrent Step : %lu \n", step_count);
 #endif
 			// temporary variables
-			uint32 combined_time;
-			uint32 target_member_index;
 			uint64 iterations_processed = 0;
 
+			if ( incremental_repair )
+			{
+				// the job lists are not saved, so they have to be rebuilt when resuming after loading
+				// -> the transports were checked when the repair was chosen, and older games do not record them
+				if ( !repair_jobs_prepared )
+				{
+					prepare_incremental_repair(false);
+				}
+
+				start = dr_time();	// start timing
+
+				const uint32 row_jobs = repair_rows.get_count();
+				const uint32 via_jobs = repair_vias.get_count();
+				const uint32 job_count = get_repair_job_count();
+				const uint64 relaxation_cost = (uint64)working_halt_count * (uint64)working_halt_count;
+
+				// repair affected origins first, then relax over new transfers and new or faster connexions
+				while ( phase_counter < job_count )
+				{
+					uint64 job_cost;
+					if ( phase_counter < row_jobs )
+					{
+						repair_origin_row( repair_rows[phase_counter] );
+						job_cost = (uint64)working_halt_count + (uint64)working_edges.get_count();
+					}
+					else if ( phase_counter < row_jobs + via_jobs )
+					{
+						relax_via_halt( repair_vias[phase_counter - row_jobs] );
+						job_cost = relaxation_cost;
+					}
+					else
+					{
+						const uint32 edge_job = phase_counter - row_jobs - via_jobs;
+						relax_direct_edge( repair_edge_origins[edge_job], working_edges[ repair_edges[edge_job] ] );
+						job_cost = relaxation_cost;
+					}
+
+					++phase_counter;
+
+					// iteration control
+					iterations_processed += job_cost;
+					total_iterations += (uint32)job_cost;
+					if ( use_limits && iterations_processed >= limit_explore_paths )
+					{
+						break;
+					}
+				}
+
+				goto loop_termination;
+			}
+
 			// initialize only when not resuming
 			if ( via_index == 0 && origin_cluster_index == 0 && target_cluster_index == 0 && origin_member_index == 0 )
 			{
@@ -1611,10 +1681,10 @@ void path_explorer_t::compartment_t::step()
 					// identify halts which are connected with the current transfer halt
 					for ( uint16 idx = 0; idx < working_halt_count; ++idx )
 					{
-						if ( working_matrix[via][idx].aggregate_time != UINT32_MAX_VALUE && via != idx )
+						if ( working_matrix->aggregate_time(via, idx) != UINT32_MAX_VALUE && via != idx )
 						{
-							inbound_connections->register_connection( transport_matrix[idx][via].last_transport, idx );
-							outbound_connections->register_connection( transport_matrix[via][idx].first_transport, idx );
+							inbound_connections->register_connection( transport_matrix->last_transport(idx, via), idx );
+							outbound_connections->register_connection( transport_matrix->first_transport(via, idx), idx );
 						}
 					}
 
@@ -1623,69 +1693,60 @@ void path_explorer_t::compartment_t::step()
 					total_iterations += (uint32)working_halt_count + ( inbound_connections->get_total_member_count() << 1 );
 				}
 
-				// for each origin cluster
-				while ( origin_cluster_index < inbound_connections->get_cluster_count() )
+				// collect a batch of origins, in cluster order, which fits into the iteration limit
+				// -> paths between different origin/target pairs are independent within one transfer, so the batch can be processed in any order
+				explore_batch.clear();
+				bool limit_reached = false;
+				while ( origin_cluster_index < inbound_connections->get_cluster_count() && !limit_reached )
 				{
 					const connection_t::connection_cluster_t &origin_cluster = (*inbound_connections)[origin_cluster_index];
 					const uint16 inbound_transport = origin_cluster.transport;
 					const vector_tpl<uint16> &origin_halt_list = origin_cluster.connected_halts;
 
-					// for each target cluster
-					while ( target_cluster_index < outbound_connections->get_cluster_count() )
+					// count the targets which are served by a different transport at this transfer
+					uint32 eligible_target_count = 0;
+					for ( uint32 t = 0; t < outbound_connections->get_cluster_count(); ++t )
 					{
-						const connection_t::connection_cluster_t &target_cluster = (*outbound_connections)[target_cluster_index];
-						const uint16 outbound_transport = target_cluster.transport;
-						if ( inbound_transport == outbound_transport && inbound_transport != 0u )
+						const connection_t::connection_cluster_t &target_cluster = (*outbound_connections)[t];
+						if ( target_cluster.transport != inbound_transport || inbound_transport == 0u )
 						{
-							++target_cluster_index;
-							continue;
+							eligible_target_count += target_cluster.connected_halts.get_count();
 						}
-						const vector_tpl<uint16> &target_halt_list = target_cluster.connected_halts;
+					}
 
-						// for each origin cluster member
-						while ( origin_member_index < origin_halt_list.get_count() )
-						{
-							const uint16 origin = origin_halt_list[origin_member_index];
+					// for each origin cluster member
+					while ( origin_member_index < origin_halt_list.get_count() )
+					{
+						explore_origin_t batch_entry;
+						batch_entry.origin = origin_halt_list[origin_member_index];
+						batch_entry.transport = inbound_transport;
+						explore_batch.append(batch_entry);
 
-							// for each target cluster member
-							for ( target_member_index = 0; target_member_index < target_halt_list.get_count(); ++target_member_index )
-							{
-								const uint16 target = target_halt_list[target_member_index];
-
-								if ( ( combined_time = working_matrix[origin][via].aggregate_time
-													 + working_matrix[via][target].aggregate_time )
-											< working_matrix[origin][target].aggregate_time			   )
-								{
-									working_matrix[origin][target].aggregate_time = combined_time;
-									working_matrix[origin][target].next_transfer = working_matrix[origin][via].next_transfer;
-									transport_matrix[origin][target].first_transport = transport_matrix[origin][via].first_transport;
-									transport_matrix[origin][target].last_transport = transport_matrix[via][target].last_transport;
-								}
-							}	// loop : target cluster member
-
-							++origin_member_index;
-
-							// iteration control
-							iterations_processed += target_halt_list.get_count();
-							total_iterations += target_halt_list.get_count();
-							if ( use_limits && iterations_processed >= limit_explore_paths )
-							{
-								goto loop_termination;
-							}
+						++origin_member_index;
 
-						}	// loop : origin cluster member
+						// iteration control
+						iterations_processed += eligible_target_count;
+						total_iterations += eligible_target_count;
+						if ( use_limits && iterations_processed >= limit_explore_paths )
+						{
+							limit_reached = true;
+							break;
+						}
+					}
 
+					if ( origin_member_index == origin_halt_list.get_count() )
+					{
 						origin_member_index = 0;
+						++origin_cluster_index;
+					}
+				}	// loop : origin cluster
 
-						++target_cluster_index;
-
-					}	// loop : target cluster
-
-					target_cluster_index = 0;
-
-					++origin_cluster_index;
+				explore_paths_over_transfer(via);
 
-				}	// loop : origin cluster
+				if ( limit_reached && origin_cluster_index < inbound_connections->get_cluster_count() )
+				{
+					goto loop_termination;
+				}
 
 				origin_cluster_index = 0;
 
@@ -1695,6 +1756,11 @@ void path_explorer_t::compartment_t::step()
 				process_next_transfer = true;
 
 				++via_index;
+
+				if ( limit_reached )
+				{
+					break;
+				}
 			}	// loop : transfer
 
 		loop_termination :
@@ -1713,7 +1779,7 @@ void path_explorer_t::compartment_t::step()
 			printf("\t\t\tPath searching -> %lu iterations takes :  %lu ms \n", static_cast<unsigned long>(iterations_processed), diff);
 #endif
 
-			if (via_index == transfer_count)
+			if ( incremental_repair ? phase_counter == get_repair_job_count() : via_index == transfer_count )
 			{
 				// iteration limit adjustment
 				if ( catg == representative_category )
@@ -1749,11 +1815,7 @@ void path_explorer_t::compartment_t::step()
 				// path search completed -> delete old path info
 				if (finished_matrix)
 				{
-					for (uint16 i = 0; i < finished_halt_count; ++i)
-					{
-						delete[] finished_matrix[i];
-					}
-					delete[] finished_matrix;
+					delete finished_matrix;
 					finished_matrix = NULL;
 				}
 				if (finished_halt_index_map)
@@ -1770,14 +1832,13 @@ void path_explorer_t::compartment_t::step()
 				finished_halt_count = working_halt_count;
 				// working_halt_count is reset below after deleting transport matrix
 
+				// keep the direct connexions of the new finished matrix for the next incremental repair
+				commit_direct_connexions();
+
 				// path search completed -> delete auxilliary data structures
 				if (transport_matrix)
 				{
-					for (uint16 i = 0; i < working_halt_count; ++i)
-					{
-						delete[] transport_matrix[i];
-					}
-					delete[] transport_matrix;
+					delete transport_matrix;
 					transport_matrix = NULL;
 				}
 				working_halt_count = 0;
@@ -1810,6 +1871,7 @@ void path_explorer_t::compartment_t::step()
 				origin_cluster_index = 0;
 				target_cluster_index = 0;
 				origin_member_index = 0;
+				phase_counter = 0;
 
 				paths_available = true;
 			}
@@ -1941,7 +2003,7 @@ void path_explorer_t::compartment_t::step()
 }
 
 
-void path_explorer_t::compartment_t::enumerate_all_paths(const path_element_t *const *const matrix, const halthandle_t *const halt_list,
+void path_explorer_t::compartment_t::enumerate_all_paths(const path_matrix_t *const matrix, const halthandle_t *const halt_list,
 														 const uint16 *const halt_map, const uint16 halt_count)
 {
 	// Debugging code : Enumerate all paths for validation
@@ -1956,9 +2018,9 @@ void path_explorer_t::compartment_t::enumerate_all_paths(const path_element_t *c
 				// print origin
 				printf("\n\nOrigin :  %s\n", halt_list[x]->get_name());
 
-				transfer_halt = matrix[x][y].next_transfer;
+				transfer_halt = matrix->next_transfer(x, y);
 
-				if (matrix[x][y].aggregate_time == UINT32_MAX_VALUE)
+				if (matrix->aggregate_time(x, y) == UINT32_MAX_VALUE)
 				{
 					printf("\t\t\t\t******** No Route ********\n");
 				}
@@ -1970,7 +2032,7 @@ void path_explorer_t::compartment_t::enumerate_all_paths(const path_element_t *c
 
 						if ( halt_map[transfer_halt.get_id()] != 65535)
 						{
-							transfer_halt = matrix[ halt_map[transfer_halt.get_id()] ][y].next_transfer;
+							transfer_halt = matrix->next_transfer(halt_map[transfer_halt.get_id()], y);
 						}
 						else
 						{
@@ -1997,10 +2059,10 @@ bool path_explorer_t::compartment_t::get_path_between(const halthandle_t origin_
 	if ( paths_available /*&& origin_halt.is_bound() && target_halt.is_bound()*/
 			&& ( origin_index = finished_halt_index_map[ origin_halt.get_id() ] ) != 65535
 			&& ( target_index = finished_halt_index_map[ target_halt.get_id() ] ) != 65535
-			&& finished_matrix[origin_index][target_index].next_transfer.is_bound() )
+			&& finished_matrix->next_transfer(origin_index, target_index).is_bound() )
 	{
-		aggregate_time = finished_matrix[origin_index][target_index].aggregate_time;
-		next_transfer = finished_matrix[origin_index][target_index].next_transfer;
+		aggregate_time = finished_matrix->aggregate_time(origin_index, target_index);
+		next_transfer = finished_matrix->next_transfer(origin_index, target_index);
 		return true;
 	}
 
@@ -2011,6 +2073,526 @@ bool path_explorer_t::compartment_t::get_path_between(const halthandle_t origin_
 }
 
 
+#ifdef MULTI_THREAD
+static bool spawned_explore_threads = false;
+static uint8 explore_thread_count = 0;
+static simthread_barrier_t explore_barrier_start;
+static simthread_barrier_t explore_barrier_end;
+
+// to hand the work of one batch to a thread
+typedef struct {
+	void *compartment;
+	uint16 via;
+	uint32 first;
+	uint32 last;
+} explore_thread_param_t;
+
+static explore_thread_param_t explore_thread_param[MAX_THREADS];
+
+
+void *path_explorer_t::compartment_t::explore_paths_thread(void *ptr)
+{
+	explore_thread_param_t *param = reinterpret_cast<explore_thread_param_t *>(ptr);
+	while(true)
+	{
+		simthread_barrier_wait( &explore_barrier_start );	// wait for all to start
+		static_cast<compartment_t *>(param->compartment)->explore_origin_range(param->via, param->first, param->last);
+		simthread_barrier_wait( &explore_barrier_end );	// wait for all to finish
+	}
+	return ptr;
+}
+#endif
+
+
+void path_explorer_t::compartment_t::explore_paths_over_transfer(const uint16 via)
+{
+	const uint32 batch_count = explore_batch.get_count();
+	if ( batch_count == 0 )
+	{
+		return;
+	}
+
+#ifdef MULTI_THREAD
+	// Each origin only updates its own matrix row and reads the row of the transfer, which does not change while exploring it.
+	// So the result does not depend on how the batch is split, and is identical to the single threaded one.
+	const uint64 combinations = (uint64)batch_count * (uint64)outbound_connections->get_total_member_count();
+	if(  env_t::num_threads > 1  &&  combinations >= explore_parallel_threshold  &&  batch_count >= env_t::num_threads  )
+	{
+		if(  !spawned_explore_threads  )
+		{
+			explore_thread_count = env_t::num_threads;
+
+			pthread_attr_t attr;
+			pthread_attr_init( &attr );
+			pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+			simthread_barrier_init( &explore_barrier_start, NULL, explore_thread_count );
+			simthread_barrier_init( &explore_barrier_end, NULL, explore_thread_count );
+
+			for(  uint8 t = 0;  t < explore_thread_count - 1;  t++  )
+			{
+				pthread_t thread;
+				if(  pthread_create( &thread, &attr, explore_paths_thread, (void *)&explore_thread_param[t] )  )
+				{
+					dbg->fatal( "path_explorer_t::compartment_t::explore_paths_over_transfer()", "cannot multithread, error at thread #%i", t+1 );
+				}
+			}
+			spawned_explore_threads = true;
+			pthread_attr_destroy( &attr );
+		}
+
+		for(  uint8 t = 0;  t < explore_thread_count;  t++  )
+		{
+			explore_thread_param[t].compartment = this;
+			explore_thread_param[t].via = via;
+			explore_thread_param[t].first = (uint32)( ( (uint64)t * batch_count ) / explore_thread_count );
+			explore_thread_param[t].last = (uint32)( ( (uint64)(t + 1) * batch_count ) / explore_thread_count );
+		}
+
+		simthread_barrier_wait( &explore_barrier_start );
+		// the last share we run ourselves
+		explore_origin_range( via, explore_thread_param[explore_thread_count - 1].first, explore_thread_param[explore_thread_count - 1].last );
+		simthread_barrier_wait( &explore_barrier_end );
+		return;
+	}
+#endif
+
+	explore_origin_range(via, 0, batch_count);
+}
+
+
+void path_explorer_t::compartment_t::explore_origin_range(const uint16 via, const uint32 first, const uint32 last)
+{
+	const uint32 *const via_times = working_matrix->get_times(via);
+	const uint16 *const via_last_transports = transport_matrix->get_last(via);
+
+	// origins are processed in tiles against blocks of targets, so that both stay in cache
+	for ( uint32 tile_begin = first; tile_begin < last; tile_begin += explore_tile_size )
+	{
+		const uint32 tile_end = min(tile_begin + explore_tile_size, last);
+
+		for ( uint32 c = 0; c < outbound_connections->get_cluster_count(); ++c )
+		{
+			const connection_t::connection_cluster_t &target_cluster = (*outbound_connections)[c];
+			const uint16 outbound_transport = target_cluster.transport;
+			const uint16 *const target_list = target_cluster.connected_halts.begin();
+			const uint32 target_count = target_cluster.connected_halts.get_count();
+
+			for ( uint32 block_begin = 0; block_begin < target_count; block_begin += explore_tile_size )
+			{
+				const uint32 block_end = min(block_begin + explore_tile_size, target_count);
+
+				for ( uint32 b = tile_begin; b < tile_end; ++b )
+				{
+					const explore_origin_t &entry = explore_batch[b];
+					if ( entry.transport == outbound_transport && entry.transport != 0u )
+					{
+						// no point in changing to the same line or lineless convoy
+						continue;
+					}
+
+					uint32 *const origin_times = working_matrix->get_times(entry.origin);
+					halthandle_t *const origin_transfers = working_matrix->get_transfers(entry.origin);
+					uint16 *const origin_first_transports = transport_matrix->get_first(entry.origin);
+					uint16 *const origin_last_transports = transport_matrix->get_last(entry.origin);
+					const uint32 time_to_via = origin_times[via];
+
+					for ( uint32 m = block_begin; m < block_end; ++m )
+					{
+						const uint16 target = target_list[m];
+						const uint32 combined_time = time_to_via + via_times[target];
+						if ( combined_time < origin_times[target] )
+						{
+							origin_times[target] = combined_time;
+							origin_transfers[target] = origin_transfers[via];
+							origin_first_transports[target] = origin_first_transports[via];
+							origin_last_transports[target] = via_last_transports[target];
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+
+bool path_explorer_t::compartment_t::prepare_incremental_repair(const bool check_transports)
+{
+	repair_jobs_prepared = true;
+	repair_rows.clear();
+	repair_vias.clear();
+	repair_edges.clear();
+	repair_edge_origins.clear();
+
+	// transfer flags of the working set are used by the repair jobs themselves
+	working_transfer_flags.clear();
+	working_transfer_flags.resize(working_halt_count);
+	for (uint16 i = 0; i < working_halt_count; ++i)
+	{
+		working_transfer_flags.append(0);
+	}
+	for (uint16 i = 0; i < transfer_count; ++i)
+	{
+		working_transfer_flags[ transfer_list[i] ] = 1;
+	}
+
+	// a repair needs the baseline of the finished matrix, which must cover exactly the same halts at the same matrix indices
+	if ( !paths_available || !finished_matrix || !finished_halt_index_map || transfer_count == 0
+		 || finished_halt_count != working_halt_count || finished_edge_offsets.get_count() != (uint32)finished_halt_count + 1u
+		 || incremental_repair_count >= max_incremental_repairs )
+	{
+		return false;
+	}
+	for (uint32 i = 0; i < 65536; ++i)
+	{
+		if ( finished_halt_index_map[i] != working_halt_index_map[i] )
+		{
+			return false;
+		}
+	}
+
+	// halts which have become transfers only add new paths -> relax over them
+	// halts which are no longer transfers may invalidate any path -> not repairable
+	vector_tpl<uint8> finished_transfer_flags(working_halt_count);
+	for (uint16 i = 0; i < working_halt_count; ++i)
+	{
+		finished_transfer_flags.append(0);
+	}
+	FOR(vector_tpl<uint16>, const idx, finished_transfers)
+	{
+		finished_transfer_flags[idx] = 1;
+	}
+	for (uint16 i = 0; i < working_halt_count; ++i)
+	{
+		if ( finished_transfer_flags[i] && !working_transfer_flags[i] )
+		{
+			return false;
+		}
+		if ( !finished_transfer_flags[i] && working_transfer_flags[i] )
+		{
+			repair_vias.append(i);
+		}
+	}
+
+	const uint32 row_limit = working_halt_count / incremental_repair_divisor;
+	const uint32 relaxation_limit = transfer_count / incremental_repair_divisor;
+	if ( repair_vias.get_count() > relaxation_limit )
+	{
+		return false;
+	}
+
+	// compare the direct connexions row by row
+	uint32 *const finished_time = new uint32[working_halt_count];
+	uint32 *const working_time = new uint32[working_halt_count];
+	uint8 *const affected = new uint8[working_halt_count];
+	for (uint16 i = 0; i < working_halt_count; ++i)
+	{
+		finished_time[i] = UINT32_MAX_VALUE;
+		working_time[i] = UINT32_MAX_VALUE;
+		affected[i] = 0;
+	}
+
+	bool repairable = true;
+	for (uint16 u = 0; u < working_halt_count && repairable; ++u)
+	{
+		const uint32 finished_begin = finished_edge_offsets[u];
+		const uint32 finished_end = finished_edge_offsets[u + 1];
+		const uint32 working_begin = working_edge_offsets[u];
+		const uint32 working_end = working_edge_offsets[u + 1];
+
+		for (uint32 e = finished_begin; e < finished_end; ++e)
+		{
+			if ( check_transports && finished_edges[e].transport == unknown_transport )
+			{
+				// baseline from an older game -> the same transport rule cannot be checked
+				repairable = false;
+			}
+			finished_time[ finished_edges[e].target_index ] = finished_edges[e].aggregate_time;
+		}
+		for (uint32 e = working_begin; e < working_end; ++e)
+		{
+			working_time[ working_edges[e].target_index ] = working_edges[e].aggregate_time;
+		}
+
+		// removed or slower connexions : mark all origins whose current paths may run over them
+		// -> the comparison is deliberately conservative, as the matrix is not necessarily exact in the presence of same-transport pruning
+		// -> a path which runs over the connexion to another destination may still be missed, which the enforced full search corrects
+		for (uint32 e = finished_begin; e < finished_end && repairable; ++e)
+		{
+			const direct_edge_t &edge = finished_edges[e];
+			if ( working_time[edge.target_index] <= edge.aggregate_time )
+			{
+				continue;
+			}
+
+			for (uint16 i = 0; i < working_halt_count; ++i)
+			{
+				if ( affected[i] || ( i != u && !finished_transfer_flags[u] ) )
+				{
+					continue;
+				}
+				const uint32 time_to_origin = finished_matrix->aggregate_time(i, u);
+				if ( i == u || ( time_to_origin != UINT32_MAX_VALUE
+								 && (uint64)time_to_origin + (uint64)edge.aggregate_time <= (uint64)finished_matrix->aggregate_time(i, edge.target_index) ) )
+				{
+					affected[i] = 1;
+					repair_rows.append(i);
+				}
+			}
+			if ( repair_rows.get_count() > row_limit )
+			{
+				repairable = false;
+			}
+		}
+
+		// new or faster connexions : these can only shorten existing paths
+		for (uint32 e = working_begin; e < working_end; ++e)
+		{
+			if ( working_edges[e].aggregate_time < finished_time[ working_edges[e].target_index ] )
+			{
+				repair_edges.append(e);
+				repair_edge_origins.append(u);
+			}
+		}
+		if ( repair_vias.get_count() + repair_edges.get_count() > relaxation_limit )
+		{
+			repairable = false;
+		}
+
+		for (uint32 e = finished_begin; e < finished_end; ++e)
+		{
+			finished_time[ finished_edges[e].target_index ] = UINT32_MAX_VALUE;
+		}
+		for (uint32 e = working_begin; e < working_end; ++e)
+		{
+			working_time[ working_edges[e].target_index ] = UINT32_MAX_VALUE;
+		}
+	}
+
+	delete[] finished_time;
+	delete[] working_time;
+	delete[] affected;
+
+	// The full search never changes between two connexions of the same transport at a transfer
+	// (see explore_origin_range()). repair_origin_row() applies this rule itself, but relax_via_halt()
+	// and relax_direct_edge() combine whole paths whose transports are not known. So they are only
+	// used where the rule cannot apply: where no transport both arrives at and departs from the
+	// transfer at which they join the paths.
+	if ( repairable && check_transports && ( !repair_vias.empty() || !repair_edges.empty() ) )
+	{
+		// (halt index, transport) of all connexions arriving at a halt by some transport
+		vector_tpl<uint64> arrivals( working_edges.get_count() );
+		for (uint16 u = 0; u < working_halt_count; ++u)
+		{
+			for (uint32 e = working_edge_offsets[u]; e < working_edge_offsets[u + 1]; ++e)
+			{
+				if ( working_edges[e].transport != 0 )
+				{
+					arrivals.append( ( (uint64)working_edges[e].target_index << 32 ) | working_edges[e].transport );
+				}
+			}
+		}
+		std::sort( arrivals.begin(), arrivals.end() );
+
+		FOR(vector_tpl<uint16>, const via, repair_vias)
+		{
+			for (uint32 e = working_edge_offsets[via]; e < working_edge_offsets[via + 1] && repairable; ++e)
+			{
+				const uint32 transport = working_edges[e].transport;
+				if ( transport != 0 && std::binary_search( arrivals.begin(), arrivals.end(), ( (uint64)via << 32 ) | transport ) )
+				{
+					repairable = false;
+				}
+			}
+		}
+
+		for (uint32 i = 0; i < repair_edges.get_count() && repairable; ++i)
+		{
+			const uint16 u = repair_edge_origins[i];
+			const direct_edge_t &edge = working_edges[ repair_edges[i] ];
+			if ( edge.transport == 0 )
+			{
+				continue;
+			}
+			if ( working_transfer_flags[u] && std::binary_search( arrivals.begin(), arrivals.end(), ( (uint64)u << 32 ) | edge.transport ) )
+			{
+				repairable = false;
+			}
+			if ( working_transfer_flags[edge.target_index] )
+			{
+				const uint16 v = edge.target_index;
+				for (uint32 e = working_edge_offsets[v]; e < working_edge_offsets[v + 1] && repairable; ++e)
+				{
+					if ( working_edges[e].transport == edge.transport )
+					{
+						repairable = false;
+					}
+				}
+			}
+		}
+	}
+
+	if ( !repairable )
+	{
+		repair_rows.clear();
+		repair_vias.clear();
+		repair_edges.clear();
+		repair_edge_origins.clear();
+	}
+	return repairable;
+}
+
+
+void path_explorer_t::compartment_t::repair_origin_row(const uint16 origin)
+{
+	// single origin search over the working connexions, where only transfers may be passed through
+	// -> the buffers keep their size, so that only the first row allocates
+	repair_best_time.set_count(working_halt_count);
+	repair_first_transfer.set_count(working_halt_count);
+	repair_arrival_transport.set_count(working_halt_count);
+	repair_nodes.set_count( working_edges.get_count() + 1u );
+	uint32 *const best_time = repair_best_time.begin();
+	halthandle_t *const first_transfer = repair_first_transfer.begin();
+	uint32 *const arrival_transport = repair_arrival_transport.begin();
+	repair_node_t *const nodes = repair_nodes.begin();
+	for (uint16 i = 0; i < working_halt_count; ++i)
+	{
+		best_time[i] = UINT32_MAX_VALUE;
+		first_transfer[i] = halthandle_t();
+	}
+	best_time[origin] = 0;
+	arrival_transport[origin] = 0;
+
+	uint32 node_count = 0;
+	repair_open.clear();
+
+	nodes[node_count].aggregate_time = 0;
+	nodes[node_count].index = origin;
+	repair_open.insert( &nodes[node_count++] );
+
+	while ( !repair_open.empty() )
+	{
+		const repair_node_t *const current = repair_open.pop();
+		const uint16 via = current->index;
+		if ( current->aggregate_time != best_time[via] || ( via != origin && !working_transfer_flags[via] ) )
+		{
+			// either outdated, or passengers/goods cannot change to another transport here
+			continue;
+		}
+
+		for (uint32 e = working_edge_offsets[via]; e < working_edge_offsets[via + 1]; ++e)
+		{
+			const direct_edge_t &edge = working_edges[e];
+			if ( via != origin && edge.transport != 0 && edge.transport == arrival_transport[via] )
+			{
+				// no point in changing to the same line or lineless convoy, as in the full search
+				continue;
+			}
+			const uint64 combined_time = (uint64)current->aggregate_time + (uint64)edge.aggregate_time;
+			if ( combined_time < (uint64)best_time[edge.target_index] )
+			{
+				best_time[edge.target_index] = (uint32)combined_time;
+				first_transfer[edge.target_index] = ( via == origin ? edge.target_halt : first_transfer[via] );
+				arrival_transport[edge.target_index] = edge.transport;
+				nodes[node_count].aggregate_time = (uint32)combined_time;
+				nodes[node_count].index = edge.target_index;
+				repair_open.insert( &nodes[node_count++] );
+			}
+		}
+	}
+
+	for (uint16 i = 0; i < working_halt_count; ++i)
+	{
+		working_matrix->aggregate_time(origin, i) = best_time[i];
+		working_matrix->next_transfer(origin, i) = ( i == origin ? halthandle_t() : first_transfer[i] );
+	}
+}
+
+
+void path_explorer_t::compartment_t::relax_via_halt(const uint16 via)
+{
+	for (uint16 origin = 0; origin < working_halt_count; ++origin)
+	{
+		const uint32 time_to_via = working_matrix->aggregate_time(origin, via);
+		if ( origin == via || time_to_via == UINT32_MAX_VALUE )
+		{
+			continue;
+		}
+
+		for (uint16 target = 0; target < working_halt_count; ++target)
+		{
+			const uint32 time_from_via = working_matrix->aggregate_time(via, target);
+			if ( target != via && time_from_via != UINT32_MAX_VALUE
+				 && (uint64)time_to_via + (uint64)time_from_via < (uint64)working_matrix->aggregate_time(origin, target) )
+			{
+				working_matrix->aggregate_time(origin, target) = time_to_via + time_from_via;
+				working_matrix->next_transfer(origin, target) = working_matrix->next_transfer(origin, via);
+			}
+		}
+	}
+}
+
+
+void path_explorer_t::compartment_t::relax_direct_edge(const uint16 origin, const direct_edge_t &edge)
+{
+	// extend all paths ending at the origin of the connexion with the connexion itself and all paths starting at its target
+	const bool origin_is_transfer = working_transfer_flags[origin] != 0;
+	const bool target_is_transfer = working_transfer_flags[edge.target_index] != 0;
+	for (uint16 i = 0; i < working_halt_count; ++i)
+	{
+		if ( i != origin && !origin_is_transfer )
+		{
+			continue;
+		}
+		const uint32 time_to_origin = ( i == origin ? 0 : working_matrix->aggregate_time(i, origin) );
+		if ( time_to_origin == UINT32_MAX_VALUE )
+		{
+			continue;
+		}
+		const uint64 time_to_target = (uint64)time_to_origin + (uint64)edge.aggregate_time;
+		const halthandle_t first_transfer = ( i == origin ? edge.target_halt : working_matrix->next_transfer(i, origin) );
+
+		for (uint16 j = 0; j < working_halt_count; ++j)
+		{
+			if ( j == i || ( j != edge.target_index && !target_is_transfer ) )
+			{
+				continue;
+			}
+			const uint32 time_from_target = ( j == edge.target_index ? 0 : working_matrix->aggregate_time(edge.target_index, j) );
+			if ( time_from_target != UINT32_MAX_VALUE && time_to_target + (uint64)time_from_target < (uint64)working_matrix->aggregate_time(i, j) )
+			{
+				working_matrix->aggregate_time(i, j) = (uint32)( time_to_target + time_from_target );
+				working_matrix->next_transfer(i, j) = first_transfer;
+			}
+		}
+	}
+}
+
+
+void path_explorer_t::compartment_t::commit_direct_connexions()
+{
+	finished_edge_offsets.clear();
+	finished_edges.clear();
+	finished_transfers.clear();
+	swap(finished_edge_offsets, working_edge_offsets);
+	swap(finished_edges, working_edges);
+	finished_transfers.resize(transfer_count);
+	for (uint16 i = 0; i < transfer_count; ++i)
+	{
+		finished_transfers.append( transfer_list[i] );
+	}
+
+	incremental_repair_count = incremental_repair ? incremental_repair_count + 1 : 0;
+
+	incremental_repair = false;
+	repair_jobs_prepared = false;
+	repair_rows.clear();
+	repair_vias.clear();
+	repair_edges.clear();
+	repair_edge_origins.clear();
+	working_transfer_flags.clear();
+}
+
+
 void path_explorer_t::compartment_t::set_category(uint8 category)
 {
 	catg = category;
@@ -2122,8 +2704,8 @@ void path_explorer_t::compartment_t::rdwr(loadsave_t* file)
 				//  This is a 2 dimensional array
 				for (uint32 j = 0; j < finished_halt_count; j++)
 				{
-					file->rdwr_long(finished_matrix[i][j].aggregate_time);
-					tmp_idx = finished_matrix[i][j].next_transfer.get_id();
+					file->rdwr_long(finished_matrix->aggregate_time(i, j));
+					tmp_idx = finished_matrix->next_transfer(i, j).get_id();
 					file->rdwr_short(tmp_idx);
 				}
 			}
@@ -2135,20 +2717,16 @@ void path_explorer_t::compartment_t::rdwr(loadsave_t* file)
 			{
 				// Build the (empty) finished matrix
 				uint16 tmp_idx;
-				finished_matrix = new path_element_t*[finished_halt_count];
-				for (uint16 i = 0; i < finished_halt_count; ++i)
-				{
-					finished_matrix[i] = new path_element_t[finished_halt_count];
-				}
+				finished_matrix = new path_matrix_t(finished_halt_count);
 
 				// Now load them. These are 2 dimensional arrays.
 				for (uint16 i = 0; i < finished_halt_count; i++)
 				{
 					for (uint32 j = 0; j < finished_halt_count; j++)
 					{
-						file->rdwr_long(finished_matrix[i][j].aggregate_time);
+						file->rdwr_long(finished_matrix->aggregate_time(i, j));
 						file->rdwr_short(tmp_idx);
-						finished_matrix[i][j].next_transfer.set_id(tmp_idx);
+						finished_matrix->next_transfer(i, j).set_id(tmp_idx);
 					}
 				}
 			}
@@ -2170,12 +2748,12 @@ void path_explorer_t::compartment_t::rdwr(loadsave_t* file)
 			{
 				for (uint32 j = 0; j < working_halt_count; j++)
 				{
-					file->rdwr_long(working_matrix[i][j].aggregate_time);
-					tmp_idx = working_matrix[i][j].next_transfer.get_id();
+					file->rdwr_long(working_matrix->aggregate_time(i, j));
+					tmp_idx = working_matrix->next_transfer(i, j).get_id();
 					file->rdwr_short(tmp_idx);
 
-					file->rdwr_short(transport_matrix[i][j].first_transport);
-					file->rdwr_short(transport_matrix[i][j].last_transport);
+					file->rdwr_short(transport_matrix->first_transport(i, j));
+					file->rdwr_short(transport_matrix->last_transport(i, j));
 				}
 			}
 		}
@@ -2187,31 +2765,22 @@ void path_explorer_t::compartment_t::rdwr(loadsave_t* file)
 			{
 				// build working matrix
 				uint16 tmp_idx;
-				working_matrix = new path_element_t*[working_halt_count];
-				for (uint16 i = 0; i < working_halt_count; ++i)
-				{
-					working_matrix[i] = new path_element_t[working_halt_count];
-
-				}
+				working_matrix = new path_matrix_t(working_halt_count);
 
 				// build transport matrix
-				transport_matrix = new transport_element_t*[working_halt_count];
-				for (uint16 i = 0; i < working_halt_count; ++i)
-				{
-					transport_matrix[i] = new transport_element_t[working_halt_count];
-				}
+				transport_matrix = new transport_matrix_t(working_halt_count);
 
 				// Now load them. These are 2 dimensional arrays.
 				for (uint16 i = 0; i < working_halt_count; i++)
 				{
 					for (uint32 j = 0; j < working_halt_count; j++)
 					{
-						file->rdwr_long(working_matrix[i][j].aggregate_time);
+						file->rdwr_long(working_matrix->aggregate_time(i, j));
 						file->rdwr_short(tmp_idx);
-						working_matrix[i][j].next_transfer.set_id(tmp_idx);
+						working_matrix->next_transfer(i, j).set_id(tmp_idx);
 
-						file->rdwr_short(transport_matrix[i][j].first_transport);
-						file->rdwr_short(transport_matrix[i][j].last_transport);
+						file->rdwr_short(transport_matrix->first_transport(i, j));
+						file->rdwr_short(transport_matrix->last_transport(i, j));
 					}
 				}
 			}
@@ -2377,6 +2946,13 @@ void path_explorer_t::compartment_t::rdwr(loadsave_t* file)
 	file->rdwr_long(origin_cluster_index);
 	file->rdwr_long(target_cluster_index);
 	file->rdwr_long(origin_member_index);
+	if (file->is_loading() && target_cluster_index != 0)
+	{
+		// Older versions could stop within an origin cluster part way through the target clusters.
+		// Relaxing paths over the same transfer again is harmless, so just restart the origin cluster.
+		target_cluster_index = 0;
+		origin_member_index = 0;
+	}
 
 	bool inbound_connections_live = inbound_connections != NULL;
 	file->rdwr_bool(inbound_connections_live);
@@ -2406,6 +2982,89 @@ void path_explorer_t::compartment_t::rdwr(loadsave_t* file)
 
 	file->rdwr_long(statistic_duration);
 	file->rdwr_long(statistic_iteration);
+
+	if (file->get_extended_version() >= 15 || (file->get_extended_version() == 14 && file->get_extended_revision() >= 32))
+	{
+		// The baseline for incremental repair must be identical on server and clients.
+		rdwr_direct_connexions(file, finished_edge_offsets, finished_edges);
+		rdwr_direct_connexions(file, working_edge_offsets, working_edges);
+
+		uint32 finished_transfer_count = finished_transfers.get_count();
+		file->rdwr_long(finished_transfer_count);
+		if (file->is_loading())
+		{
+			finished_transfers.clear();
+			finished_transfers.resize(finished_transfer_count);
+		}
+		for (uint32 i = 0; i < finished_transfer_count; i++)
+		{
+			uint16 idx = file->is_saving() ? finished_transfers[i] : 0;
+			file->rdwr_short(idx);
+			if (file->is_loading())
+			{
+				finished_transfers.append(idx);
+			}
+		}
+
+		file->rdwr_bool(incremental_repair);
+		file->rdwr_byte(incremental_repair_count);
+	}
+	if (file->is_loading())
+	{
+		// The repair jobs are derived data and are rebuilt when needed
+		repair_jobs_prepared = false;
+	}
+}
+
+void path_explorer_t::compartment_t::rdwr_direct_connexions(loadsave_t* file, vector_tpl<uint32> &offsets, vector_tpl<direct_edge_t> &edges)
+{
+	uint32 offset_count = offsets.get_count();
+	uint32 edge_count = edges.get_count();
+	file->rdwr_long(offset_count);
+	file->rdwr_long(edge_count);
+	if (file->is_loading())
+	{
+		offsets.clear();
+		offsets.resize(offset_count);
+		edges.clear();
+		edges.resize(edge_count);
+	}
+
+	for (uint32 i = 0; i < offset_count; i++)
+	{
+		uint32 offset = file->is_saving() ? offsets[i] : 0;
+		file->rdwr_long(offset);
+		if (file->is_loading())
+		{
+			offsets.append(offset);
+		}
+	}
+
+	for (uint32 i = 0; i < edge_count; i++)
+	{
+		direct_edge_t edge;
+		if (file->is_saving())
+		{
+			edge = edges[i];
+		}
+		uint16 halt_id = edge.target_halt.get_id();
+		file->rdwr_short(edge.target_index);
+		file->rdwr_short(halt_id);
+		file->rdwr_long(edge.aggregate_time);
+		if (file->get_extended_version() >= 15 || (file->get_extended_version() == 14 && file->get_extended_revision() >= 34))
+		{
+			file->rdwr_long(edge.transport);
+		}
+		else
+		{
+			edge.transport = unknown_transport;
+		}
+		if (file->is_loading())
+		{
+			edge.target_halt.set_id(halt_id);
+			edges.append(edge);
+		}
+	}
 }
 
 void path_explorer_t::compartment_t::connection_t::rdwr(loadsave_t* file)
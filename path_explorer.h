@@ -18,6 +18,7 @@
 #include "simdebug.h"
 
 #include "tpl/vector_tpl.h"
+#include "tpl/binary_heap_tpl.h"
 #include "tpl/quickstone_hashtable_tpl.h"
 
 
@@ -107,22 +108,112 @@ private:
 
 	private:
 
-		// element used during path search and for storing calculated paths
-		struct path_element_t
+		// matrix used during path search and for storing calculated paths
+		// -> rows are stored contiguously, with aggregate times and next transfers kept in separate arrays
+		class path_matrix_t
 		{
-			uint32 aggregate_time;
-			halthandle_t next_transfer;
+		private:
+			uint32 halt_count;
+			uint32 *aggregate_times;
+			halthandle_t *next_transfers;
+
+			path_matrix_t(const path_matrix_t &);
+			path_matrix_t& operator=(const path_matrix_t &);
+
+		public:
+			explicit path_matrix_t(const uint16 count) : halt_count(count)
+			{
+				const uint32 element_count = halt_count * halt_count;
+				aggregate_times = new uint32[element_count];
+				next_transfers = new halthandle_t[element_count];
+				for (uint32 i = 0; i < element_count; ++i)
+				{
+					aggregate_times[i] = UINT32_MAX_VALUE;
+				}
+			}
+
+			~path_matrix_t()
+			{
+				delete[] aggregate_times;
+				delete[] next_transfers;
+			}
+
+			void copy_from(const path_matrix_t &other)
+			{
+				assert( halt_count == other.halt_count );
+				const uint32 element_count = halt_count * halt_count;
+				for (uint32 i = 0; i < element_count; ++i)
+				{
+					aggregate_times[i] = other.aggregate_times[i];
+					next_transfers[i] = other.next_transfers[i];
+				}
+			}
+
+			uint32 *get_times(const uint16 row) { return aggregate_times + row * halt_count; }
+			const uint32 *get_times(const uint16 row) const { return aggregate_times + row * halt_count; }
+			halthandle_t *get_transfers(const uint16 row) { return next_transfers + row * halt_count; }
+			const halthandle_t *get_transfers(const uint16 row) const { return next_transfers + row * halt_count; }
+
+			uint32 &aggregate_time(const uint16 row, const uint16 col) { return aggregate_times[row * halt_count + col]; }
+			uint32 aggregate_time(const uint16 row, const uint16 col) const { return aggregate_times[row * halt_count + col]; }
+			halthandle_t &next_transfer(const uint16 row, const uint16 col) { return next_transfers[row * halt_count + col]; }
+			halthandle_t next_transfer(const uint16 row, const uint16 col) const { return next_transfers[row * halt_count + col]; }
+		};
+
+		// matrix used during path search only for storing best lines/convoys
+		// -> stored like path_matrix_t, with first and last transports kept in separate arrays
+		class transport_matrix_t
+		{
+		private:
+			uint32 halt_count;
+			uint16 *first_transports;
+			uint16 *last_transports;
 
-			path_element_t() : aggregate_time(UINT32_MAX_VALUE) { }
+			transport_matrix_t(const transport_matrix_t &);
+			transport_matrix_t& operator=(const transport_matrix_t &);
+
+		public:
+			explicit transport_matrix_t(const uint16 count) : halt_count(count)
+			{
+				const uint32 element_count = halt_count * halt_count;
+				first_transports = new uint16[element_count]();
+				last_transports = new uint16[element_count]();
+			}
+
+			~transport_matrix_t()
+			{
+				delete[] first_transports;
+				delete[] last_transports;
+			}
+
+			uint16 *get_first(const uint16 row) { return first_transports + row * halt_count; }
+			const uint16 *get_first(const uint16 row) const { return first_transports + row * halt_count; }
+			uint16 *get_last(const uint16 row) { return last_transports + row * halt_count; }
+			const uint16 *get_last(const uint16 row) const { return last_transports + row * halt_count; }
+
+			uint16 &first_transport(const uint16 row, const uint16 col) { return first_transports[row * halt_count + col]; }
+			uint16 &last_transport(const uint16 row, const uint16 col) { return last_transports[row * halt_count + col]; }
 		};
 
-		// element used during path search only for storing best lines/convoys
-		struct transport_element_t
+		// element used for storing the direct connexions of a matrix row, which serve as the baseline for incremental repair
+		struct direct_edge_t
 		{
-			uint16 first_transport;
-			uint16 last_transport;
+			uint16 target_index;
+			halthandle_t target_halt;
+			uint32 aggregate_time;
+			uint32 transport;	// 0 for walking, line id, or 65536 + lineless convoy id (see unknown_transport)
+		};
+
+		// transport of direct connexions loaded from games saved before it was recorded
+		static const uint32 unknown_transport = UINT32_MAX_VALUE;
 
-			transport_element_t() : first_transport(0), last_transport(0) { }
+		// element used by the single origin search during incremental repair
+		struct repair_node_t
+		{
+			uint32 aggregate_time;
+			uint16 index;
+
+			bool operator <= (const repair_node_t &other) const { return aggregate_time <= other.aggregate_time; }
 		};
 
 		// structure used for storing indices of halts connected to a transfer, grouped by transport
@@ -234,6 +325,13 @@ private:
 			void rdwr(loadsave_t* file);
 		};
 
+		// element used for storing an origin halt to be explored over the current transfer, together with its inbound transport
+		struct explore_origin_t
+		{
+			uint16 origin;
+			uint16 transport;
+		};
+
 		// data structure for temporarily storing lines and lineless conovys
 		struct linkage_t
 		{
@@ -245,14 +343,14 @@ private:
 		sint64 refresh_start_time;
 
 		// set of variables for finished path data
-		path_element_t **finished_matrix;
+		path_matrix_t *finished_matrix;
 		uint16 *finished_halt_index_map;
 		uint16 finished_halt_count;
 
 		// set of variables for working path data
-		path_element_t **working_matrix;
+		path_matrix_t *working_matrix;
 		uint16 *transport_index_map;
-		transport_element_t **transport_matrix;
+		transport_matrix_t *transport_matrix;
 		uint16 *working_halt_index_map;
 		halthandle_t *working_halt_list;
 		uint16 working_halt_count;
@@ -268,6 +366,33 @@ private:
 		uint16 *transfer_list;
 		uint16 transfer_count;
 
+		// direct connexions (in compressed row format) and transfers from which the finished matrix was built
+		vector_tpl<uint32> finished_edge_offsets;
+		vector_tpl<direct_edge_t> finished_edges;
+		vector_tpl<uint16> finished_transfers;
+
+		// direct connexions (in compressed row format) of the working matrix, collected while filling it
+		vector_tpl<uint32> working_edge_offsets;
+		vector_tpl<direct_edge_t> working_edges;
+
+		// set of variables for incremental repair of the finished matrix
+		// -> the job lists are derived from the data above and are rebuilt on demand after loading
+		bool incremental_repair;
+		bool repair_jobs_prepared;
+		vector_tpl<uint16> repair_rows;		// origins whose paths may use a removed or slowed down connexion
+		vector_tpl<uint16> repair_vias;		// halts which have newly become transfers
+		vector_tpl<uint32> repair_edges;	// indices of new or faster connexions in working_edges
+		vector_tpl<uint16> repair_edge_origins;	// matrix rows of the above connexions
+		vector_tpl<uint8> working_transfer_flags;
+		uint8 incremental_repair_count;		// number of consecutive incremental repairs since the last full search
+
+		// buffers of repair_origin_row(), kept to avoid allocations for every row
+		vector_tpl<uint32> repair_best_time;
+		vector_tpl<halthandle_t> repair_first_transfer;
+		vector_tpl<uint32> repair_arrival_transport;
+		vector_tpl<repair_node_t> repair_nodes;
+		binary_heap_tpl<repair_node_t*> repair_open;
+
 		uint8 catg;				// category managed by this compartment
 		uint8 g_class;			// Class managed by this compartment
 		const char *catg_name;	// Name of the category
@@ -290,13 +415,14 @@ private:
 		// phase counters for path searching
 		uint16 via_index;
 		uint32 origin_cluster_index;
-		uint32 target_cluster_index;
+		uint32 target_cluster_index;	// always 0 now that each origin is explored against all target clusters at once; kept for saved games
 		uint32 origin_member_index;
 
 		// variables for limiting search around transfers
 		connection_t *inbound_connections;		// relative to the current transfer
 		connection_t *outbound_connections;		// relative to the current transfer
 		bool process_next_transfer;
+		vector_tpl<explore_origin_t> explore_batch;	// origins to be explored over the current transfer in this step
 
 		// statistics for determining limits
 		uint32 statistic_duration;
@@ -367,7 +493,33 @@ private:
 		static const uint32 percent_lower_limit = 100 - percent_deviation;
 		static const uint32 percent_upper_limit = 100 + percent_deviation;
 
-		void enumerate_all_paths(const path_element_t *const *const matrix, const halthandle_t *const halt_list,
+		// number of origins and targets per tile in the path search kernel
+		static const uint32 explore_tile_size = 256;
+		// minimum number of path combinations in a batch before the path search is spread across threads
+		static const uint32 explore_parallel_threshold = 0x00040000;
+
+		// path search kernel
+		void explore_paths_over_transfer(const uint16 via);
+		void explore_origin_range(const uint16 via, const uint32 first, const uint32 last);
+#ifdef MULTI_THREAD
+		static void *explore_paths_thread(void *ptr);
+#endif
+
+		// incremental repair is only used while its estimated cost stays below 1/divisor of a full path search
+		static const uint32 incremental_repair_divisor = 4;
+		// a full search is enforced after this many consecutive repairs, so that estimates cannot drift indefinitely
+		static const uint8 max_incremental_repairs = 8;
+
+		// incremental repair of the finished matrix
+		bool prepare_incremental_repair(const bool check_transports = true);
+		void repair_origin_row(const uint16 origin);
+		void relax_via_halt(const uint16 via);
+		void relax_direct_edge(const uint16 origin, const direct_edge_t &edge);
+		void commit_direct_connexions();
+		static void rdwr_direct_connexions(loadsave_t* file, vector_tpl<uint32> &offsets, vector_tpl<direct_edge_t> &edges);
+		uint32 get_repair_job_count() const { return repair_rows.get_count() + repair_vias.get_count() + repair_edges.get_count(); }
+
+		void enumerate_all_paths(const path_matrix_t *const matrix, const halthandle_t *const halt_list,
 								 const uint16 *const halt_map, const uint16 halt_count);
 
 	public:
@@ -2746,32 +2746,61 @@ void stadt_t::check_all_private_car_routes()
 	const grund_t* gr = plan ? plan->get_kartenboden() : NULL;
 	const koord3d origin = gr ? gr->get_pos() : koord3d::invalid;
 
-#ifdef MULTI_THREAD
-	int error = pthread_mutex_lock(&karte_t::private_car_route_mutex);
-	assert(error == 0);
-	(void)error;
-#endif
-	connected_cities.clear();
-	connected_industries.clear();
-	connected_attractions.clear();
-#ifdef MULTI_THREAD
-	error = pthread_mutex_unlock(&karte_t::private_car_route_mutex);
-	assert(error == 0);
-	(void)error;
-#endif
+	// Only this search writes to the pending results, so these need no mutex.
+	pending_connected_cities.clear();
+	pending_connected_industries.clear();
+	pending_connected_attractions.clear();
+	pending_private_car_routes.clear();
+
+	// This will find the fastest route from the townhall road to *all* other townhall roads, industries and attractions.
+	route_t private_car_route;
+	road_vehicle_t checker;
+	private_car_destination_finder_t finder(welt, &checker, this);
+	weg_t::private_car_route_outbox = &pending_private_car_routes;
+	private_car_route.find_route(welt, origin, &finder, welt->get_citycar_speed_average(), ribi_t::all, 1, 1, 1, depth, false, route_t::private_car_checker);
+	weg_t::private_car_route_outbox = NULL;
+
+	private_car_routes_pending = true;
+}
 
+void stadt_t::commit_private_car_routes()
+{
+	if (!private_car_routes_pending)
+	{
+		return;
+	}
+	private_car_routes_pending = false;
 
+	const grund_t* gr = welt->lookup_kartenboden(townhall_road);
 	weg_t* const w = gr ? gr->get_weg(road_wt) : NULL;
 	if (w)
 	{
 		w->delete_all_routes_from_here();
 	}
+	weg_t::commit_private_car_routes(pending_private_car_routes);
 
-	// This will find the fastest route from the townhall road to *all* other townhall roads, industries and attractions.
-	route_t private_car_route;
-	road_vehicle_t checker;
-	private_car_destination_finder_t finder(welt, &checker, this);
-	private_car_route.find_route(welt, origin, &finder, welt->get_citycar_speed_average(), ribi_t::all, 1, 1, 1, depth, false, route_t::private_car_checker);
+	connected_cities.clear();
+	FOR(connexion_map, const& iter, pending_connected_cities)
+	{
+		connected_cities.set(iter.key, iter.value);
+	}
+	connected_industries.clear();
+	FOR(connexion_map, const& iter, pending_connected_industries)
+	{
+		connected_industries.set(iter.key, iter.value);
+	}
+	connected_attractions.clear();
+	FOR(connexion_map, const& iter, pending_connected_attractions)
+	{
+		connected_attractions.set(iter.key, iter.value);
+	}
+
+	pending_connected_cities.clear();
+	pending_connected_industries.clear();
+	pending_connected_attractions.clear();
+	// Release the memory: these can hold millions of routes on large maps.
+	vector_tpl<weg_t::pending_private_car_route_t> empty;
+	swap(pending_private_car_routes, empty);
 }
 
 void stadt_t::calc_traffic_level()
@@ -3241,18 +3270,18 @@ uint32 stadt_t::check_road_connexion_to(const gebaeude_t* attraction) const
 
 void stadt_t::add_road_connexion(uint32 journey_time_per_tile, const stadt_t* city)
 {
-	connected_cities.set(city->get_pos(), journey_time_per_tile);
+	pending_connected_cities.set(city->get_pos(), journey_time_per_tile);
 }
 
 void stadt_t::add_road_connexion(uint32 journey_time_per_tile, const fabrik_t* industry)
 {
-	connected_industries.set(industry->get_pos().get_2d(), journey_time_per_tile);
+	pending_connected_industries.set(industry->get_pos().get_2d(), journey_time_per_tile);
 }
 
 void stadt_t::add_road_connexion(uint32 journey_time_per_tile, const gebaeude_t* attraction)
 {
 	const koord3d attraction_pos = attraction->get_pos();
-	connected_attractions.set(attraction_pos.get_2d(), journey_time_per_tile);
+	pending_connected_attractions.set(attraction_pos.get_2d(), journey_time_per_tile);
 
 	// Add all tiles of an attraction here.
 	if(!attraction->get_tile() || attraction_pos == koord3d::invalid)
@@ -3275,7 +3304,7 @@ void stadt_t::add_road_connexion(uint32 journey_time_per_tile, const gebaeude_t*
 				// there may be buildings with holes
 				if(gb_part && gb_part->get_tile()->get_desc() == bdsc)
 				{
-					connected_attractions.set(gb_part->get_pos().get_2d(), journey_time_per_tile);
+					pending_connected_attractions.set(gb_part->get_pos().get_2d(), journey_time_per_tile);
 				}
 			}
 		}
@@ -6085,6 +6114,7 @@ void stadt_t::remove_connected_city(stadt_t* city)
 	if(city)
 	{
 		connected_cities.remove(city->get_pos());
+		pending_connected_cities.remove(city->get_pos());
 	}
 }
 
@@ -6092,11 +6122,13 @@ void stadt_t::remove_connected_city(stadt_t* city)
 void stadt_t::remove_connected_industry(fabrik_t* fab)
 {
 	connected_industries.remove(fab->get_pos().get_2d());
+	pending_connected_industries.remove(fab->get_pos().get_2d());
 }
 
 void stadt_t::remove_connected_attraction(gebaeude_t* attraction)
 {
 	connected_attractions.remove(attraction->get_pos().get_2d());
+	pending_connected_attractions.remove(attraction->get_pos().get_2d());
 }
 
 double stadt_t::get_land_area() const
@@ -17,6 +17,7 @@
 #include "tpl/array2d_tpl.h"
 #include "tpl/slist_tpl.h"
 #include "tpl/koordhashtable_tpl.h"
+#include "boden/wege/weg.h"
 
 #include "vehicle/simroadtraffic.h"
 #include "tpl/sparse_tpl.h"
@@ -28,7 +29,6 @@ class karte_ptr_t;
 class player_t;
 class fabrik_t;
 class rule_t;
-struct route_range_specification;
 
 // For private subroutines
 class building_desc_t;
@@ -286,6 +286,18 @@ private:
 	connexion_map connected_industries;
 	connexion_map connected_attractions;
 
+	// Results of the private car route search from this city, which are only
+	// made visible by commit_private_car_routes() so that searches running
+	// in parallel are committed in a deterministic order.
+	connexion_map pending_connected_cities;
+	connexion_map pending_connected_industries;
+	connexion_map pending_connected_attractions;
+	vector_tpl<weg_t::pending_private_car_route_t> pending_private_car_routes;
+	bool private_car_routes_pending = false;
+
+	// Position of this city in the current private car route refresh cycle.
+	uint32 private_car_route_sequence = 0;
+
 	vector_tpl<senke_t*> substations;
 
 	sint32 number_of_cars;
@@ -639,7 +651,14 @@ public:
 	void add_road_connexion(uint32 journey_time_per_tile, const fabrik_t* industry);
 	void add_road_connexion(uint32 journey_time_per_tile, const gebaeude_t* attraction);
 
+	/// Finds the private car routes from this city. The results are held back
+	/// until commit_private_car_routes() is called from a single threaded context.
 	void check_all_private_car_routes();
+	void commit_private_car_routes();
+	bool has_pending_private_car_routes() const { return private_car_routes_pending; }
+
+	uint32 get_private_car_route_sequence() const { return private_car_route_sequence; }
+	void set_private_car_route_sequence(uint32 value) { private_car_route_sequence = value; }
 
 	// Checks to see whether this town is connected
 	// by road to each other town.
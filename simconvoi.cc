@@ -69,9 +69,6 @@
 #ifdef MULTI_THREAD
 #include "utils/simthread.h"
 static pthread_mutex_t step_convois_mutex = PTHREAD_MUTEX_INITIALIZER;
-static vector_tpl<pthread_t> unreserve_threads;
-waytype_t convoi_t::current_waytype = road_wt;
-uint16 convoi_t::current_unreserver = 0;
 #endif
 
 //#if _MSC_VER
@@ -322,6 +319,9 @@ DBG_MESSAGE("convoi_t::~convoi_t()", "destroying %d, %p", self.get_id(), this);
 	// @author hsiegeln - deregister from line (again) ...
 	unset_line();
 
+	// no tile may remain reserved by a handle, which could be reused
+	release_reserved_tiles();
+
 	self.detach();
 }
 
@@ -352,55 +352,35 @@ bool convoi_t::is_waypoint( koord3d ziel ) const
 	return !haltestelle_t::get_halt(ziel,get_owner()).is_bound();
 }
 
-#ifdef MULTI_THREAD
-
-void convoi_t::unreserve_route_range(route_range_specification range)
+void convoi_t::release_reserved_tiles()
 {
-	const vector_tpl<weg_t *> &all_ways = weg_t::get_alle_wege();
-	for (uint32 i = range.start; i <= range.end; i++)
-	{
-		weg_t* const way = all_ways[i];
-		//schiene_t* const sch = obj_cast<schiene_t>(way);
-		schiene_t* const sch = way->is_rail_type() || way->get_waytype() == air_wt ? (schiene_t*)way : NULL;
-		if (sch && sch->get_reserved_convoi().get_id() == convoi_t::current_unreserver)
-		{
-			convoihandle_t ch;
-			ch.set_id(convoi_t::current_unreserver);
-			sch->unreserve(ch);
+	while(  !reserved_tiles.empty()  ) {
+		// unreserving removes the tile from reserved_tiles
+		schiene_t *const sch = reserved_tiles.back();
+		if(  !sch->unreserve(self)  ) {
+			dbg->error("convoi_t::release_reserved_tiles()", "%s: tile %s in the reservation index is not reserved by this convoy", get_name(), sch->get_pos().get_str());
+			reserved_tiles.pop_back();
 		}
 	}
 }
 
-#endif
-
 /**
  * unreserves the whole remaining route
  */
 void convoi_t::unreserve_route()
 {
 	// Clears all reserved tiles on the whole map belonging to this convoy.
-#ifdef MULTI_THREAD_ROUTE_UNRESERVER
+	release_reserved_tiles();
 
-	current_unreserver = self.get_id();
-	current_waytype = front()->get_waytype();
-
-	simthread_barrier_wait(&karte_t::unreserve_route_barrier);
-	simthread_barrier_wait(&karte_t::unreserve_route_barrier);
-
-	current_unreserver = 0;
-	current_waytype = invalid_wt;
-
-#else
+#ifdef DEBUG
+	// cross-check the reservation index against the whole map
 	FOR(vector_tpl<weg_t*>, const way, weg_t::get_alle_wege())
 	{
-		if(way->get_waytype() == front()->get_waytype())
+		schiene_t* const sch = way->is_rail_type() || way->get_waytype() == air_wt ? (schiene_t*)way : NULL;
+		if(sch && sch->get_reserved_convoi() == self)
 		{
-			//schiene_t* const sch = obj_cast<schiene_t>(way);
-			schiene_t* const sch = way->is_rail_type() ? (schiene_t*)way : NULL;
-			if(sch && sch->get_reserved_convoi() == self)
-			{
-				sch->unreserve(front());
-			}
+			dbg->error("convoi_t::unreserve_route()", "%s: reserved tile %s missing in the reservation index", get_name(), way->get_pos().get_str());
+			sch->unreserve(self);
 		}
 	}
 #endif
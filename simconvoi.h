@@ -40,6 +40,7 @@
 #define MAX_MONTHS               12 // Max history
 
 class weg_t;
+class schiene_t;
 class depot_t;
 class karte_ptr_t;
 class player_t;
@@ -57,14 +58,6 @@ class departure_point_t;
 */
 typedef koordhashtable_tpl<id_pair, average_tpl<uint32> > journey_times_map;
 
-#ifdef MULTI_THREAD
-struct route_range_specification
-{
-	uint32 start;
-	uint32 end;
-};
-#endif
-
 /**
  * Base class for all vehicle consists. Convoys can be referenced by handles, see halthandle_t.
  *
@@ -819,14 +812,18 @@ public:
 	*/
 	void hat_gehalten(halthandle_t halt);
 
-#ifdef MULTI_THREAD
 private:
-	static void unreserve_route_range(route_range_specification range);
-	friend void *unreserve_route_threaded(void* args);
-	static waytype_t current_waytype;
-	static uint16 current_unreserver;
+	/**
+	 * All rails and runways reserved by this convoy, so that unreserve_route()
+	 * does not need to search the whole map. Maintained by schiene_t.
+	 */
+	vector_tpl<schiene_t *> reserved_tiles;
+
+	/// releases every tile in reserved_tiles
+	void release_reserved_tiles();
+
 public:
-#endif
+	vector_tpl<schiene_t *> &access_reserved_tiles() { return reserved_tiles; }
 
 	/**
 	 * remove all track reservations (trains only)
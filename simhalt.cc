@@ -78,6 +78,82 @@ uint8 haltestelle_t::reconnect_counter = 0;
 // controls the halt iterator in step_all():
 static bool restart_halt_iterator = true;
 
+
+class haltestelle_t::reroute_outbox_t
+{
+private:
+	enum effect_type_t { DELIVER, PEDESTRIANS, REMOVE_TRANSIT };
+
+	struct effect_t
+	{
+		effect_type_t type;
+		koord3d pos;
+		ware_t ware;
+	};
+
+	vector_tpl<effect_t> effects;
+
+	void append(effect_type_t type, koord3d pos, const ware_t &ware)
+	{
+		effect_t e;
+		e.type = type;
+		e.pos = pos;
+		e.ware = ware;
+		effects.append(e);
+	}
+
+public:
+	/// liefere_an() at the next transfer of ware, which the passengers walk to
+	void deliver(const ware_t &ware) { append(DELIVER, koord3d::invalid, ware); }
+
+	void generate_pedestrians(koord3d pos, const ware_t &ware) { append(PEDESTRIANS, pos, ware); }
+
+	/// ware will not arrive at its factory any more
+	void remove_transit(const ware_t &ware) { append(REMOVE_TRANSIT, koord3d::invalid, ware); }
+
+	/// Applies and clears all effects. Must run on the main thread.
+	void apply()
+	{
+		FOR(vector_tpl<effect_t>, const& e, effects)
+		{
+			switch(e.type)
+			{
+				case DELIVER:
+					e.ware.get_zwischenziel()->liefere_an(e.ware, 1); // start counting walking steps at 1 again
+					break;
+				case PEDESTRIANS:
+					pedestrian_t::generate_pedestrians_at(e.pos, e.ware.menge);
+					break;
+				case REMOVE_TRANSIT:
+					fabrik_t::update_transit(e.ware, false);
+					break;
+			}
+		}
+		effects.clear();
+	}
+};
+
+
+// One shard of the halts stepped in step_all(): a range of halts and its outbox.
+struct reroute_shard_t
+{
+	const halthandle_t *halts;
+	uint32 count;
+	haltestelle_t::reroute_outbox_t *outbox;
+};
+
+static void reroute_shard(uint32 shard_num, void *shards)
+{
+	const reroute_shard_t &shard = ((const reroute_shard_t *)shards)[shard_num];
+	for (uint32 i = 0; i < shard.count; i++)
+	{
+		shard.halts[i]->reroute_requested_goods(*shard.outbox);
+	}
+}
+
+static haltestelle_t::reroute_outbox_t reroute_outboxes[MAX_THREADS];
+
+
 void haltestelle_t::step_all()
 {
 	const uint32 count = alle_haltestellen.get_count();
@@ -85,6 +161,8 @@ void haltestelle_t::step_all()
 	{
 		const uint32 loops = min(count, 256u);
 		static vector_tpl<halthandle_t>::iterator iter;
+		static vector_tpl<halthandle_t> halts;
+		halts.clear();
 		for (uint32 i = 0; i < loops; ++i)
 		{
 			if (restart_halt_iterator || iter == alle_haltestellen.end())
@@ -92,7 +170,63 @@ void haltestelle_t::step_all()
 				restart_halt_iterator = false;
 				iter = alle_haltestellen.begin();
 			}
-			(*iter++)->step();
+			halts.append(*iter++);
+		}
+
+		// Rerouting is the expensive part after the path explorer has finished a
+		// category. It only reads the finished paths and writes to the halt's own
+		// cargo, so the halts are split into shards of about equal numbers of packets.
+		uint64 total_packets = 0;
+		static vector_tpl<uint64> packets;
+		packets.clear();
+		FOR(vector_tpl<halthandle_t>, const halt, halts)
+		{
+			uint64 n = 0;
+			FOR(vector_tpl<uint8>, const catg, halt->categories_to_refresh_next_step)
+			{
+				n += halt->cargo[catg] ? halt->cargo[catg]->get_count() + 1 : 1;
+			}
+			packets.append(n);
+			total_packets += n;
+		}
+
+		if (total_packets > 0)
+		{
+#ifdef MULTI_THREAD
+			const uint32 max_shards = (uint32)clamp(welt->get_parallel_operations(), 1, MAX_THREADS);
+#else
+			const uint32 max_shards = 1;
+#endif
+			reroute_shard_t shards[MAX_THREADS];
+			uint32 shard_count = 0;
+			uint32 first = 0;
+			uint64 packets_so_far = 0;
+			for (uint32 i = 0; i < loops && shard_count < max_shards; i++)
+			{
+				packets_so_far += packets[i];
+				if (i == loops - 1 || packets_so_far * max_shards >= total_packets * (shard_count + 1))
+				{
+					shards[shard_count].halts = halts.begin() + first;
+					shards[shard_count].count = i + 1 - first;
+					shards[shard_count].outbox = &reroute_outboxes[shard_count];
+					shard_count++;
+					first = i + 1;
+				}
+			}
+			// the rounding might leave a tail for the last shard
+			shards[shard_count - 1].count = loops - (uint32)(shards[shard_count - 1].halts - halts.begin());
+
+			welt->run_shards(shard_count, &reroute_shard, shards);
+			// The shards hold consecutive halts, so this is the order of a single thread.
+			for (uint32 i = 0; i < shard_count; i++)
+			{
+				shards[i].outbox->apply();
+			}
+		}
+
+		FOR(vector_tpl<halthandle_t>, const halt, halts)
+		{
+			halt->step();
 		}
 	}
 }
@@ -1272,11 +1406,7 @@ void haltestelle_t::step()
 
 	COLOR_VAL old_status_color = status_color;
 
-	FOR(vector_tpl<uint8>, catg, categories_to_refresh_next_step)
-	{
-		reroute_goods(catg);
-	}
-	categories_to_refresh_next_step.clear();
+	// rerouting has been done by step_all()
 
 	check_transferring_cargoes();
 
@@ -1441,6 +1571,13 @@ void haltestelle_t::step()
  * @author Hj. Malthaner
  */
 void haltestelle_t::new_month()
+{
+	new_month_local();
+	new_month_shared();
+}
+
+
+void haltestelle_t::new_month_shared()
 {
 	if(  welt->get_active_player()==owner  &&  status_color==COL_RED  ) {
 		cbuffer_t buf;
@@ -1449,6 +1586,18 @@ void haltestelle_t::new_month()
 		enables &= (PAX|POST|WARE);
 	}
 
+	FOR(vector_tpl<unknown_service_frequency_t>, const& unknown, unknown_service_frequencies)
+	{
+		log_unknown_service_frequency(unknown.destination, unknown.category);
+	}
+	unknown_service_frequencies.clear();
+
+	check_nearby_halts();
+}
+
+
+void haltestelle_t::new_month_local()
+{
 	// If the waiting times have not been updated for too long, gradually re-set them; also increment the timing records.
 	for (uint8 category = 0; category < goods_manager_t::get_max_catg_index(); category++)
 	{
@@ -1467,9 +1616,9 @@ void haltestelle_t::new_month()
 					halthandle_t check_halt;
 					check_halt.set_id(iter.key);
 
-					const uint32 service_frequency = get_service_frequency(check_halt, category); // Note that service frequency is currently class agnostic
+					const uint32 service_frequency = get_service_frequency(check_halt, category, &unknown_service_frequencies); // Note that service frequency is currently class agnostic
 					const uint32 estimated_waiting_time = service_frequency / 2;
-					const uint32 average_waiting_time = get_average_waiting_time(check_halt, category, g_class);
+					const uint32 average_waiting_time = get_average_waiting_time(check_halt, category, g_class, &unknown_service_frequencies);
 
 					if (average_waiting_time > service_frequency)
 					{
@@ -1493,8 +1642,6 @@ void haltestelle_t::new_month()
 		}
 	}
 
-	check_nearby_halts();
-
 	// hsiegeln: roll financial history
 	for (int j = 0; j<MAX_HALT_COST; j++) {
 		for (int k = MAX_MONTHS-1; k>0; k--) {
@@ -1507,10 +1654,20 @@ void haltestelle_t::new_month()
 }
 
 
+void haltestelle_t::reroute_requested_goods(reroute_outbox_t &outbox)
+{
+	FOR(vector_tpl<uint8>, catg, categories_to_refresh_next_step)
+	{
+		reroute_goods(catg, outbox);
+	}
+	categories_to_refresh_next_step.clear();
+}
+
+
 // Added by		: Knightly
 // Adapted from : reroute_goods()
 // Purpose		: re-route goods of a single ware category
-uint32 haltestelle_t::reroute_goods(const uint8 catg)
+uint32 haltestelle_t::reroute_goods(const uint8 catg, reroute_outbox_t &outbox)
 {
 	if(cargo[catg])
 	{
@@ -1559,8 +1716,8 @@ uint32 haltestelle_t::reroute_goods(const uint8 catg)
 			   && !get_preferred_convoy(ware.get_zwischenziel(), 0, ware.get_class()).is_bound()
 			   && !get_preferred_line(ware.get_zwischenziel(), 0, ware.get_class()).is_bound())
 			{
-				pedestrian_t::generate_pedestrians_at(get_basis_pos3d(), ware.menge);
-				ware.get_zwischenziel()->liefere_an(ware, 1); // start counting walking steps at 1 again
+				outbox.generate_pedestrians(get_basis_pos3d(), ware);
+				outbox.deliver(ware);
 				continue;
 			}
 
@@ -1594,7 +1751,7 @@ uint32 haltestelle_t::reroute_goods(const uint8 catg)
 								const fabrik_t* fab = building ? building->get_fabrik() : NULL;
 								if (fab)
 								{
-									fab->update_transit(ware, false);
+									outbox.remove_transit(ware);
 								}
 							}
 						}
@@ -1747,7 +1904,7 @@ sint8 haltestelle_t::is_connected(halthandle_t halt, uint8 catg_index) const
 	return linka->get(halt)  ||  linkb->get(self) ? 1 : 0;
 }
 
-uint32 haltestelle_t::get_average_waiting_time(halthandle_t halt, uint8 category, uint8 g_class)
+uint32 haltestelle_t::get_average_waiting_time(halthandle_t halt, uint8 category, uint8 g_class, vector_tpl<unknown_service_frequency_t> *unknown)
 {
 	inthashtable_tpl<uint32, haltestelle_t::waiting_time_set> * const wt = waiting_times[category][g_class];
 	if(wt->is_contained((halt.get_id())))
@@ -1795,7 +1952,7 @@ uint32 haltestelle_t::get_average_waiting_time(halthandle_t halt, uint8 category
 	// because the time that passengers, goods, etc. wait is, on average,
 	// half the interval between services, because they do not all arrive
 	// just after the previous service has departed.
-	uint32 service_frequency = get_service_frequency(halt, category);
+	uint32 service_frequency = get_service_frequency(halt, category, unknown);
 	const uint32 estimated_waiting_time = service_frequency / 2;
 	fixed_list_tpl<uint32, 32> tmp;
 	waiting_time_set set;
@@ -1820,7 +1977,7 @@ uint32 haltestelle_t::get_average_waiting_time(halthandle_t halt, uint8 category
 	return estimated_waiting_time;
 }
 
-uint32 haltestelle_t::get_service_frequency(halthandle_t destination, uint8 category) const
+uint32 haltestelle_t::get_service_frequency(halthandle_t destination, uint8 category, vector_tpl<unknown_service_frequency_t> *unknown) const
 {
 	// Check whether the value is in the hashtable. If not, calculate it.
 
@@ -1842,13 +1999,26 @@ uint32 haltestelle_t::get_service_frequency(halthandle_t destination, uint8 cate
 		return service_frequencies.get(spec);
 	}
 
+	if(unknown) {
+		unknown_service_frequency_t u;
+		u.destination = destination;
+		u.category = category;
+		unknown->append(u);
+	}
+	else {
+		log_unknown_service_frequency(destination, category);
+	}
+
+	return calc_service_frequency(destination, category);
+}
+
+void haltestelle_t::log_unknown_service_frequency(halthandle_t destination, uint8 category) const
+{
 	if(destination.is_bound()) {
 		dbg->message("uint32 haltestelle_t::get_service_frequency(halthandle_t destination, uint8 category) const", "Unknown frequency for %s from %s to %s", translator::translate(goods_manager_t::get_info_catg_index(category)->get_catg_name()), get_name(), destination->get_name());
 	} else {
 		dbg->warning("uint32 haltestelle_t::get_service_frequency(halthandle_t destination, uint8 category) const", "Tried to calculate frequency for %s from %s to missing halt", translator::translate(goods_manager_t::get_info_catg_index(category)->get_catg_name()), get_name());
 	}
-
-	return calc_service_frequency(destination, category);
 }
 
 uint32 haltestelle_t::calc_service_frequency(halthandle_t destination, uint8 category) const
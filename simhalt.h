@@ -98,6 +98,14 @@ public:
 	//13-Jan-02     Markus Weber    Added
 	enum stationtyp {invalid=0, loadingbay=1, railstation = 2, dock = 4, busstop = 8, airstop = 16, monorailstop = 32, tramstop = 64, maglevstop=128, narrowgaugestop=256 }; //could be combined with or!
 
+	/**
+	 * Effects of rerouting on anything but the rerouting halt itself, in the
+	 * order they happened. The halts of one step are rerouted concurrently in
+	 * shards (see step_all()), each shard collecting into its own outbox, and
+	 * the outboxes are applied in the order of the halts afterwards.
+	 */
+	class reroute_outbox_t;
+
 private:
 	/**
 	 * Manche Methoden mssen auf all Haltestellen angewandt werden
@@ -485,6 +493,18 @@ private:
 	// recent (or any) waiting time data are available.
 	koordhashtable_tpl<service_frequency_specifier, uint32> service_frequencies;
 
+	struct unknown_service_frequency_t
+	{
+		halthandle_t destination;
+		uint8 category;
+	};
+
+	// The service frequencies which new_month_local() had to calculate. They are
+	// logged by new_month_shared(), as the log must not be written from the shards.
+	vector_tpl<unknown_service_frequency_t> unknown_service_frequencies;
+
+	void log_unknown_service_frequency(halthandle_t destination, uint8 category) const;
+
 	static const sint64 waiting_multiplication_factor = 3ll;
 	static const sint64 waiting_tolerance_ratio = 50ll;
 
@@ -544,7 +564,14 @@ public:
 
 	// Added by : Knightly
 	// Purpose	: Re-routing goods of a single ware category
-	uint32 reroute_goods(uint8 catg);
+	// Effects on other halts and factories go to outbox.
+	uint32 reroute_goods(uint8 catg, reroute_outbox_t &outbox);
+
+	/**
+	 * Reroutes the categories requested by set_reroute_goods_next_step().
+	 * Only changes this halt, so different halts may run concurrently.
+	 */
+	void reroute_requested_goods(reroute_outbox_t &outbox);
 
 
 	/**
@@ -614,6 +641,16 @@ public:
 	 */
 	void new_month();
 
+	/**
+	 * The part of new_month() which only changes this halt: ages the waiting
+	 * times and rolls the financial history. Safe to run for several halts at
+	 * once; new_month_shared() must follow on the main thread.
+	 */
+	void new_month_local();
+
+	/// The part of new_month() which touches messages and other halts.
+	void new_month_shared();
+
 	// @author: jamespetts, although much is borrowed from suche_route
 	// Returns the journey time of the best possible route from this halt. Time == UINT32_MAX_VALUE when there is no route.
 	uint32 find_route(ware_t &ware, const uint32 journey_time = UINT32_MAX_VALUE) const;
@@ -942,7 +979,9 @@ public:
 
 	// Getting and setting average waiting times in minutes
 	// @author: jamespetts
-	uint32 get_average_waiting_time(halthandle_t halt, uint8 category, uint8 g_class);
+	// If unknown is given, a service frequency which has to be calculated is appended
+	// there instead of being logged.
+	uint32 get_average_waiting_time(halthandle_t halt, uint8 category, uint8 g_class, vector_tpl<unknown_service_frequency_t> *unknown = NULL);
 
 	void add_waiting_time(uint32 time, halthandle_t halt, uint8 category, uint8 g_class, bool do_not_reset_month = false);
 
@@ -1012,8 +1051,9 @@ public:
 
 	/**
 	* The average time in 10ths of minutes between convoys to this destination
+	* If unknown is given, a frequency which has to be calculated is appended there instead of being logged.
 	*/
-	uint32 get_service_frequency(halthandle_t destination, uint8 category) const;
+	uint32 get_service_frequency(halthandle_t destination, uint8 category, vector_tpl<unknown_service_frequency_t> *unknown = NULL) const;
 
 	uint32 calc_service_frequency(halthandle_t destination, uint8 category) const;
 
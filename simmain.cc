@@ -3,6 +3,7 @@
  * (see LICENSE.txt)
  */
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <string>
 #include <new>
@@ -57,6 +58,7 @@
 #include "network/network.h"	// must be before any "windows.h" is included via bzlib2.h ...
 #include "dataobj/loadsave.h"
 #include "dataobj/environment.h"
+#include "dataobj/route.h"
 #include "dataobj/tabfile.h"
 #include "dataobj/settings.h"
 #include "dataobj/translator.h"
@@ -70,6 +72,7 @@
 #include "sound/sound.h"
 
 #include "utils/cbuffer_t.h"
+#include "utils/csv.h"
 #include "utils/simrandom.h"
 
 #include "bauer/vehikelbauer.h"
@@ -193,9 +196,92 @@ static void show_times(karte_t *welt, main_view_t *view)
  	}
 	dbg->message( "welt->sync_step/step(200,1,1)", "%i iterations took %li ms", i, dr_time() - ms );
 }
+
+
+// route search tests: record the next queries of the running game and replay them
+static void show_route_times(karte_t *welt, uint32 queries)
+{
+	welt->set_fast_forward(true);
+	intr_disable();
+
+	dbg->message( "show_route_times()", "recording %u route searches", queries );
+	route_t::record_queries(queries);
+	long ms = dr_time();
+	int i;
+	for (i = 0;  i < 20000  &&  route_t::get_recorded_query_count() < queries;  i++) {
+		welt->sync_step(200,true,false);
+		welt->step();
+	}
+	const uint32 recorded = route_t::get_recorded_query_count();
+	dbg->message( "show_route_times()", "%u searches recorded in %i steps (%li ms)", recorded, i, dr_time() - ms );
+
+	route_t::replay_recorded_queries(welt, 10);
+	route_t::record_queries(0);
+}
 #endif
 
 
+static void add_benchmark_row(CSV_t &csv, const char *metric, const char *format, ...)
+{
+	char value[64];
+	va_list argptr;
+	va_start(argptr, format);
+	vsnprintf(value, lengthof(value), format, argptr);
+	va_end(argptr);
+	csv.add_field(metric);
+	csv.add_field(value);
+	csv.new_line();
+}
+
+
+// headless benchmark: runs a fixed number of steps of the loaded game and reports the time of each phase
+static void run_benchmark(karte_t *welt, uint32 steps, const char *report)
+{
+	welt->set_fast_forward(true);
+	intr_disable();
+
+	dbg->message( "run_benchmark()", "running %u steps", steps );
+	welt->set_profile_step_phases(true);
+	const uint32 ms = dr_time();
+	for(  uint32 i = 0;  i < steps;  i++  ) {
+		welt->sync_step(200,true,false);
+		welt->step();
+	}
+	const uint32 wall_time = dr_time() - ms;
+
+	CSV_t csv;
+	csv.add_field("metric");
+	csv.add_field("value");
+	csv.new_line();
+	add_benchmark_row( csv, "steps", "%u", steps );
+	add_benchmark_row( csv, "wall_time_ms", "%u", wall_time );
+	for(  int p = 0;  p < karte_t::MAX_STEP_PHASES;  p++  ) {
+		const karte_t::step_phase_t phase = (karte_t::step_phase_t)p;
+		char metric[64];
+		sprintf( metric, "%s_ms", karte_t::get_step_phase_name(phase) );
+		add_benchmark_row( csv, metric, "%.3f", welt->get_step_phase_time(phase) / 1000.0 );
+	}
+	add_benchmark_row( csv, "peak_rss_kb", "%u", (uint32)(dr_get_peak_memory() / 1024) );
+	add_benchmark_row( csv, "checksum", "%08X", welt->get_state_checksum() );
+	welt->set_profile_step_phases(false);
+
+	if(  report  ) {
+		FILE *f = fopen( report, "w" );
+		if(  f  ) {
+			fputs( csv.get_str(), f );
+			fclose( f );
+		}
+		else {
+			dbg->warning( "run_benchmark()", "cannot write report to %s", report );
+		}
+	}
+	else {
+		fputs( csv.get_str(), stdout );
+	}
+	dbg->message( "run_benchmark()", "%u steps took %u ms", steps, wall_time );
+}
+
+
 void modal_dialogue( gui_frame_t *gui, ptrdiff_t magic, karte_t *welt, bool (*quit)() )
 {
 	if(  display_get_width()==0  ) {
@@ -428,6 +514,9 @@ int simu_main(int argc, char** argv)
 			"command line parameters available: \n"
 			" -addons             loads also addons (with -objects)\n"
 			" -async              asynchronous images, only for SDL\n"
+			" -benchmark N        runs N steps of the loaded game, reports the time of\n"
+			"                     each phase as CSV and quits\n"
+			" -benchmark_report F writes the -benchmark report to file F\n"
 			" -use_hw             hardware double buffering, only for SDL\n"
 			" -debug NUM          enables debugging (1..5)\n"
 			" -freeplay           play with endless money\n"
@@ -469,6 +558,7 @@ int simu_main(int argc, char** argv)
 #endif
 			" -timeline           enables timeline\n"
 #if defined DEBUG || defined PROFILE
+			" -route_times N      replays the next N route searches for profiling\n"
 			" -times              does some simple profiling\n"
 			" -until YEAR.MONTH   quits when MONTH of YEAR starts\n"
 #endif
@@ -1303,6 +1393,10 @@ DBG_MESSAGE("simmain","demo file not found at %s",buf.get_str() );
 		show_times(welt, view);
 	}
 
+	if(  const char *ref_str = gimme_arg(argc, argv, "-route_times", 1)  ) {
+		show_route_times(welt, max(1, atoi(ref_str)));
+	}
+
 	// finish after a certain month? (must be entered decimal, i.e. 12*year+month
 	if(  gimme_arg(argc, argv, "-until", 0) != NULL  ) {
 		const char *until = gimme_arg(argc, argv, "-until", 1);
@@ -1317,6 +1411,11 @@ DBG_MESSAGE("simmain","demo file not found at %s",buf.get_str() );
 	}
 #endif
 
+	if(  const char *ref_str = gimme_arg(argc, argv, "-benchmark", 1)  ) {
+		run_benchmark( welt, max(1, atoi(ref_str)), gimme_arg(argc, argv, "-benchmark_report", 1) );
+		env_t::quit_simutrans = true;
+	}
+
 	welt->reset_timer();
 	if(  !env_t::networkmode  &&  !env_t::server  &&  new_world  ) {
 #ifdef display_in_main
@@ -555,7 +555,7 @@ DBG_MESSAGE("tool_remover()",  "removing roadsign at (%s)", pos.get_str());
 		weg->count_sign();
 		if(weg->get_waytype() == road_wt)
 		{
-			welt->set_recheck_road_connexions();
+			welt->set_recheck_road_connexions(gr->get_pos().get_2d());
 		}
 		return true;
 	}
@@ -610,7 +610,7 @@ DBG_MESSAGE("tool_remover()",  "removing bridge from %d,%d,%d",gr->get_pos().x,
 
 		if(br->get_desc()->get_waytype() == road_wt)
 		{
-			welt->set_recheck_road_connexions();
+			welt->set_recheck_road_connexions(gr->get_pos().get_2d());
 		}
 		msg = bridge_builder_t::remove(player, gr->get_pos(), br->get_desc()->get_waytype());
 		return msg == NULL;
@@ -631,7 +631,7 @@ DBG_MESSAGE("tool_remover()",  "removing tunnel  from %d,%d,%d",gr->get_pos().x,
 
 		if(gr->get_weg_nr(0)->get_waytype() == road_wt)
 		{
-			welt->set_recheck_road_connexions();
+			welt->set_recheck_road_connexions(gr->get_pos().get_2d());
 		}
 		waytype_t wegtyp =  gr->get_leitung() ? powerline_wt : gr->get_weg_nr(0)->get_waytype();
 		msg = tunnel_builder_t::remove(player, gr->get_pos(), wegtyp, is_ctrl_pressed());
@@ -834,7 +834,7 @@ DBG_MESSAGE("tool_remover()", "removing way");
 					return false;
 				}
 			}
-			welt->set_recheck_road_connexions();
+			welt->set_recheck_road_connexions(pos);
 		}
 
 		wt = w->get_desc()->get_finance_waytype();
@@ -856,7 +856,7 @@ DBG_MESSAGE("tool_remover()", "removing way");
 		if(  weg_t *weg = gr->get_weg_nr(0)  ) {
 			if(gr->get_weg_nr(0)->get_waytype() == road_wt)
 			{
-				welt->set_recheck_road_connexions();
+				welt->set_recheck_road_connexions(gr->get_pos().get_2d());
 			}
 			gr->remove_everything_from_way(player, weg->get_waytype(), ribi_t::none);
 		}
@@ -3789,7 +3789,7 @@ const char *tool_wayremover_t::do_work( player_t *player, const koord3d &start,
 							return "Cannot delete a road where to do so would leave a city building unconnected by road.";
 						}
 					}
-					welt->set_recheck_road_connexions();
+					welt->set_recheck_road_connexions(pos);
 				}
 
 				// now the tricky part: delete just part of a way (or everything, if possible)
@@ -6301,7 +6301,7 @@ built_sign:
 			}
 			if(desc->get_wtyp() == road_wt)
 			{
-				welt->set_recheck_road_connexions();
+				welt->set_recheck_road_connexions(gr->get_pos().get_2d());
 			}
 			error = NULL;
 		}
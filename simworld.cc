@@ -3,6 +3,7 @@
  * (see LICENSE.txt)
  */
 
+#include <chrono>
 #include <algorithm>
 #include <limits>
 #include <functional>
@@ -90,6 +91,7 @@
 #include "dataobj/environment.h"
 #include "dataobj/powernet.h"
 #include "dataobj/marker.h"
+#include "dataobj/way_graph.h"
 
 #include "utils/cbuffer_t.h"
 #include "utils/simrandom.h"
@@ -124,7 +126,6 @@
 #include "utils/simthread.h"
 
 static vector_tpl<pthread_t> private_car_route_threads;
-static vector_tpl<pthread_t> unreserve_route_threads;
 static vector_tpl<pthread_t> step_passengers_and_mail_threads;
 static vector_tpl<pthread_t> individual_convoy_step_threads;
 static vector_tpl<pthread_t> path_explorer_threads;
@@ -137,16 +138,13 @@ static pthread_mutexattr_t mutex_attributes;
 //static pthread_mutex_t private_car_route_mutex = PTHREAD_MUTEX_INITIALIZER;
 //pthread_mutex_t karte_t::step_passengers_and_mail_mutex = PTHREAD_MUTEX_INITIALIZER;
 //static pthread_mutex_t path_explorer_await_mutex = PTHREAD_MUTEX_INITIALIZER;
-//pthread_mutex_t karte_t::unreserve_route_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 pthread_mutex_t karte_t::private_car_route_mutex;
 bool karte_t::private_car_route_mutex_initialised;
 pthread_mutex_t karte_t::step_passengers_and_mail_mutex;
 static pthread_mutex_t path_explorer_await_mutex;
-pthread_mutex_t karte_t::unreserve_route_mutex;
 
 simthread_barrier_t karte_t::private_car_barrier;
-simthread_barrier_t karte_t::unreserve_route_barrier;
 static simthread_barrier_t step_passengers_and_mail_barrier;
 static simthread_barrier_t path_explorer_barrier;
 static simthread_barrier_t step_convoys_barrier_internal;
@@ -166,9 +164,11 @@ vector_tpl<private_car_t*> *karte_t::private_cars_added_threaded;
 #ifdef MULTI_THREAD
 vector_tpl<nearby_halt_t> *karte_t::start_halts;
 vector_tpl<halthandle_t> *karte_t::destination_list;
+passenger_generation_log_t *karte_t::passenger_generation_logs;
 #else
 vector_tpl<nearby_halt_t> karte_t::start_halts;
 vector_tpl<halthandle_t> karte_t::destination_list;
+passenger_generation_log_t karte_t::passenger_generation_logs[1];
 #endif
 
 // advance 201 ms per sync_step in fast forward mode
@@ -359,18 +359,22 @@ void checklist_t::rdwr(memory_rw_t *buffer)
 	for(  uint8 i = 0;  i < CHK_DEBUG_SUMS;  i++  ) {
 		buffer->rdwr_long(debug_sum[i]);
 	}
+	for(  uint8 i = 0;  i < CHK_WORLD_HASHES;  i++  ) {
+		buffer->rdwr_long(world_hash[i]);
+	}
 }
 
 
 
 int checklist_t::print(char *buffer, const char *entity) const
 {
-	return sprintf(buffer, "%s=[ss=%u st=%u nfc=%u rand=%u halt=%u line=%u cnvy=%u\n\tssr=%u,%u,%u,%u,%u,%u,%u,%u\n\tstr=%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n\texr=%u,%u,%u,%u,%u,%u,%u,%u\n\tsums=%u,%u,%u,%u,%u,%u,%u,%u]\n",
+	return sprintf(buffer, "%s=[ss=%u st=%u nfc=%u rand=%u halt=%u line=%u cnvy=%u\n\tssr=%u,%u,%u,%u,%u,%u,%u,%u\n\tstr=%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n\texr=%u,%u,%u,%u,%u,%u,%u,%u\n\tsums=%u,%u,%u,%u,%u,%u,%u,%u\n\thash=%08x,%08x,%08x,%08x,%08x,%08x]\n",
 		entity, ss, st, nfc, random_seed, halt_entry, line_entry, convoy_entry,
 		rand[0], rand[1], rand[2], rand[3], rand[4], rand[5], rand[6], rand[7],
 		rand[8], rand[9], rand[10], rand[11], rand[12], rand[13], rand[14], rand[15], rand[16], rand[17], rand[18], rand[19], rand[20], rand[21], rand[22], rand[23],
 		rand[24], rand[25], rand[26], rand[27], rand[28], rand[29], rand[30], rand[31],
-		debug_sum[0], debug_sum[1], debug_sum[2], debug_sum[3], debug_sum[4], debug_sum[5], debug_sum[6], debug_sum[7]
+		debug_sum[0], debug_sum[1], debug_sum[2], debug_sum[3], debug_sum[4], debug_sum[5], debug_sum[6], debug_sum[7],
+		world_hash[0], world_hash[1], world_hash[2], world_hash[3], world_hash[4], world_hash[5]
 	);
 }
 
@@ -566,6 +570,8 @@ void karte_t::destroy()
 	passenger_origins.clear();
 	mail_origins_and_targets.clear();
 
+	way_graph_t::reset();
+
 	for (uint8 i = 0; i < goods_manager_t::passengers->get_number_of_classes(); i++)
 	{
 		commuter_targets[i].clear();
@@ -766,7 +772,8 @@ void karte_t::init_tiles()
 
 	uint32 const x = get_size().x;
 	uint32 const y = get_size().y;
-	plan      = new planquadrat_t[x * y];
+	plan      = new planquadrat_t[get_plan_tile_count(x, y)];
+	plan_chunks_x = get_plan_chunks(x);
 	grid_hgts = new sint8[(x + 1) * (y + 1)];
 	max_height = min_height = 0;
 	MEMZERON(grid_hgts, (x + 1) * (y + 1));
@@ -917,7 +924,115 @@ void karte_t::create_rivers( sint16 number )
 
 void karte_t::remove_queued_city(stadt_t* city)
 {
+#ifdef MULTI_THREAD
+	if (private_car_route_checks_in_progress > 0)
+	{
+		// A route search from this city may still be running.
+		suspend_private_car_threads();
+	}
+#endif
 	cities_awaiting_private_car_route_check.remove(city);
+	cities_with_edited_roads.remove(city);
+	if (cities_awaiting_private_car_route_commit.remove(city))
+	{
+		private_car_route_checks_in_progress--;
+	}
+}
+
+void karte_t::commit_private_car_routes()
+{
+	// The searches may finish in any order, so commit them in the order in which they were started.
+	// There are never more of these than private car threads, so an insertion sort will do.
+	for (uint32 i = 1; i < cities_awaiting_private_car_route_commit.get_count(); i++)
+	{
+		stadt_t* const city = cities_awaiting_private_car_route_commit[i];
+		uint32 j = i;
+		for (; j > 0 && cities_awaiting_private_car_route_commit[j - 1]->get_private_car_route_sequence() > city->get_private_car_route_sequence(); j--)
+		{
+			cities_awaiting_private_car_route_commit[j] = cities_awaiting_private_car_route_commit[j - 1];
+		}
+		cities_awaiting_private_car_route_commit[j] = city;
+	}
+
+	FOR(vector_tpl<stadt_t*>, city, cities_awaiting_private_car_route_commit)
+	{
+		city->commit_private_car_routes();
+		private_car_route_checks_in_progress--;
+		private_car_route_cities_refreshed++;
+	}
+	cities_awaiting_private_car_route_commit.clear();
+}
+
+void karte_t::set_recheck_road_connexions(koord pos)
+{
+	recheck_road_connexions = true;
+	stadt_t* city = find_nearest_city(pos);
+	if (city)
+	{
+		cities_with_edited_roads.append_unique(city);
+	}
+}
+
+void karte_t::refresh_private_car_routes()
+{
+	if (stadt.empty() || settings.get_assume_everywhere_connected_by_road())
+	{
+		return;
+	}
+
+#ifdef MULTI_THREAD
+	// Finish and commit the searches which are under way.
+	suspend_private_car_threads();
+#endif
+	private_car_route_cycle_start_time = dr_time();
+
+	cities_awaiting_private_car_route_check.clear();
+	FOR(weighted_vector_tpl<stadt_t*>, const city, stadt)
+	{
+		cities_awaiting_private_car_route_check.append(city);
+	}
+
+#ifdef MULTI_THREAD
+	if (!private_car_route_threads.empty())
+	{
+		// Run rounds on all private car threads until every city has been searched.
+		// Each round is committed in city order, so the result does not depend on the number of threads.
+		int error = pthread_mutex_lock(&karte_t::private_car_route_mutex);
+		assert(error == 0);
+		route_t::suspend_private_car_routing = false;
+		error = pthread_mutex_unlock(&karte_t::private_car_route_mutex);
+		assert(error == 0);
+		(void)error;
+
+		while (!cities_awaiting_private_car_route_check.empty())
+		{
+			cities_to_process = min(cities_awaiting_private_car_route_check.get_count(), private_car_route_threads.get_count());
+			start_private_car_threads(true);
+			await_private_car_threads(true);
+		}
+	}
+#endif
+	while (!cities_awaiting_private_car_route_check.empty())
+	{
+		stadt_t* city = cities_awaiting_private_car_route_check.remove_first();
+		city->set_private_car_route_sequence(private_car_route_sequence++);
+		private_car_route_checks_in_progress++;
+		city->check_all_private_car_routes();
+		cities_awaiting_private_car_route_commit.append(city);
+		commit_private_car_routes();
+	}
+
+	// Make the new routes visible, and start the next refresh cycle straight away
+	// so that the next step does not swap back to the old routes.
+	weg_t::swap_private_car_routes_currently_reading_element();
+	dbg->message("karte_t::refresh_private_car_routes()", "Refreshed the private car routes of %u cities in %u ms", stadt.get_count(), dr_time() - private_car_route_cycle_start_time);
+
+	FOR(weighted_vector_tpl<stadt_t*>, const city, stadt)
+	{
+		cities_awaiting_private_car_route_check.append(city);
+	}
+	private_car_route_cycle_start_time = dr_time();
+	private_car_route_cities_refreshed = 0;
 }
 
 void karte_t::add_queued_city(stadt_t* city)
@@ -1610,6 +1725,9 @@ DBG_DEBUG("karte_t::init()","built timeline");
 #else
 	transferring_cargoes = new vector_tpl<transferring_cargo_t>[1];
 #endif
+
+	// Otherwise it takes a full refresh cycle until the cities know their road connexions.
+	refresh_private_car_routes();
 }
 
 void karte_t::recalc_passenger_destination_weights()
@@ -1660,17 +1778,30 @@ void *check_road_connexions_threaded(void *args)
 			stadt_t* city;
 			city = world()->cities_awaiting_private_car_route_check.remove_first();
 			karte_t::cities_to_process--;
+			const bool check_city = city && !world()->get_settings().get_assume_everywhere_connected_by_road();
+			if (check_city)
+			{
+				city->set_private_car_route_sequence(world()->private_car_route_sequence++);
+				world()->private_car_route_checks_in_progress++;
+			}
 			int error = pthread_mutex_unlock(&karte_t::private_car_route_mutex);
 			assert(error == 0);
 			(void)error;
 
-			if (!city || world()->get_settings().get_assume_everywhere_connected_by_road())
+			if (!check_city)
 			{
 				continue;
 			}
 
 			city->check_all_private_car_routes();
 
+			// The results are committed by the main thread in await_private_car_threads().
+			error = pthread_mutex_lock(&karte_t::private_car_route_mutex);
+			assert(error == 0);
+			world()->cities_awaiting_private_car_route_commit.append(city);
+			error = pthread_mutex_unlock(&karte_t::private_car_route_mutex);
+			assert(error == 0);
+
 			simthread_barrier_wait(&karte_t::private_car_barrier);
 		}
 		else
@@ -1711,23 +1842,29 @@ uint32 passengers_travelled_this_month_with_tolerance_of_under_10_minutes = 0;
 uint32 total_journey_times_this_month = 0;
 #endif
 
+/**
+ * The part of budget which passenger generation thread thread_number (1 to
+ * threads) spends in this step. This only depends on the budget, so that all
+ * clients in a network game generate the same packets in each thread.
+ */
+static sint32 get_generation_share(sint32 budget, sint32 interval, uint32 thread_number, uint32 threads)
+{
+	const sint32 share = budget / (sint32)threads;
+	if (share < interval)
+	{
+		// In case of very small numbers, generate everything in the first thread, or else rounding errors would prevent any generation.
+		return thread_number == 1 ? budget : 0;
+	}
+	return thread_number == 1 ? share + budget % (sint32)threads : share;
+}
+
 void *step_passengers_and_mail_threaded(void* args)
 {
 	const uint32* thread_number_ptr = (const uint32*)args;
 	karte_t::passenger_generation_thread_number = *thread_number_ptr;
-	const uint32 seed_base = karte_t::world->get_settings().get_random_counter();
-
-	// This may easily overflow, but this is irrelevant for the purposes of a random seed
-	// (so long as both server and client are using the same size of integer)
-
-	const uint32 seed = 325651 + seed_base * karte_t::passenger_generation_thread_number;
 
 	delete thread_number_ptr;
 
-	// The random seed is now thread local, so this must be initialised here
-	// with values that will be deterministic between different clients in
-	// a networked multi-player setup.
-	setsimrand(seed, 0xFFFFFFFFu);
 	set_random_mode(STEP_RANDOM);
 
 	sint32 next_step_passenger_this_thread;
@@ -1738,106 +1875,54 @@ void *step_passengers_and_mail_threaded(void* args)
 
 	while (true)
 	{
-	top:
 		simthread_barrier_wait(&step_passengers_and_mail_barrier);
 		if (karte_t::world->is_terminating_threads())
 		{
 			break;
 		}
 
+		// The random numbers of each thread must not depend on what it did in earlier
+		// steps (e.g. before a client joined), so start a fresh substream every step.
+		setsimrand_stream(karte_t::world->passenger_generation_seed, karte_t::passenger_generation_thread_number);
+
 		// The generate passengers function is called many times (often well > 100) each step; the mail version is called only once or twice each step, sometimes not at all.
 		sint32 units_this_step = 0;
 		total_units_passenger = 0;
 		total_units_mail = 0;
 
 #ifndef FIXED_PASSENGER_NUMBERS_PER_STEP_FOR_TESTING
-		next_step_passenger_this_thread = karte_t::world->next_step_passenger / (karte_t::world->get_parallel_operations());
-
-		next_step_mail_this_thread = karte_t::world->next_step_mail / (karte_t::world->get_parallel_operations());
+		// There is one thread more than parallel operations (see init_threads()).
+		const uint32 threads = karte_t::world->get_parallel_operations() + 1;
+		next_step_passenger_this_thread = get_generation_share(karte_t::world->next_step_passenger, karte_t::world->passenger_step_interval, karte_t::passenger_generation_thread_number, threads);
+		next_step_mail_this_thread = get_generation_share(karte_t::world->next_step_mail, karte_t::world->mail_step_interval, karte_t::passenger_generation_thread_number, threads);
 
 #ifdef FORBID_PARALLELL_PASSENGER_GENERATION_IN_NETWORK_MODE
 		if (env_t::networkmode)
 		{
-			if (karte_t::passenger_generation_thread_number == 0)
-			{
-				next_step_passenger_this_thread = karte_t::world->next_step_passenger;
-			}
-			else
-			{
-				next_step_passenger_this_thread = 0;
-			}
-		}
-		else
-		{
-#else
-
-			if (next_step_passenger_this_thread < karte_t::world->passenger_step_interval && karte_t::world->next_step_passenger > karte_t::world->passenger_step_interval)
-			{
-				if (karte_t::passenger_generation_thread_number == 0)
-				{
-					// In case of very small numbers, make this effectively single threaded, or else rounding errors will prevent any passenger generation.
-					next_step_passenger_this_thread = karte_t::world->next_step_passenger;
-				}
-				else
-				{
-					next_step_passenger_this_thread = 0;
-				}
-			}
-			else if (karte_t::passenger_generation_thread_number == 0)
-			{
-				next_step_passenger_this_thread += karte_t::world->next_step_passenger % (karte_t::world->get_parallel_operations());
-			}
-
-			if (next_step_mail_this_thread < karte_t::world->mail_step_interval && karte_t::world->next_step_mail > karte_t::world->mail_step_interval)
-			{
-				if (karte_t::passenger_generation_thread_number == 0)
-				{
-					// In case of very small numbers, make this effectively single threaded, or else rounding errors will prevent any mail generation.
-					next_step_mail_this_thread = karte_t::world->next_step_mail;
-				}
-				else
-				{
-					next_step_mail_this_thread = 0;
-				}
-			}
-			else if (karte_t::passenger_generation_thread_number == 0)
-			{
-				next_step_mail_this_thread += karte_t::world->next_step_mail % (karte_t::world->get_parallel_operations());
-			}
-#endif
-
-#ifdef FORBID_PARALLELL_PASSENGER_GENERATION_IN_NETWORK_MODE
+			const bool first_thread = karte_t::passenger_generation_thread_number == 1;
+			next_step_passenger_this_thread = first_thread ? karte_t::world->next_step_passenger : 0;
+			next_step_mail_this_thread = first_thread ? karte_t::world->next_step_mail : 0;
 		}
 #endif
 
-		if (karte_t::world->passenger_step_interval <= next_step_passenger_this_thread)
+		if (karte_t::world->passenger_origins.get_count() > 0)
 		{
-			do
+			while (karte_t::world->passenger_step_interval <= next_step_passenger_this_thread)
 			{
-				if (karte_t::world->passenger_origins.get_count() == 0)
-				{
-					goto top;
-				}
 				units_this_step = karte_t::world->generate_passengers_or_mail(goods_manager_t::passengers);
 				total_units_passenger += units_this_step;
 				next_step_passenger_this_thread -= (karte_t::world->passenger_step_interval * units_this_step);
-
-			} while (karte_t::world->passenger_step_interval <= next_step_passenger_this_thread);
+			}
 		}
 
-		if (karte_t::world->mail_step_interval <= next_step_mail_this_thread)
+		if (karte_t::world->mail_origins_and_targets.get_count() > 0)
 		{
-			do
+			while (karte_t::world->mail_step_interval <= next_step_mail_this_thread)
 			{
-				if (karte_t::world->mail_origins_and_targets.get_count() == 0)
-				{
-					goto top;
-				}
 				units_this_step = karte_t::world->generate_passengers_or_mail(goods_manager_t::mail);
 				total_units_mail += units_this_step;
 				next_step_mail_this_thread -= (karte_t::world->mail_step_interval * units_this_step);
-
-			} while (karte_t::world->mail_step_interval <= next_step_mail_this_thread);
+			}
 		}
 #else
 		for (uint32 i = 0; i < 2; i++)
@@ -1884,6 +1969,7 @@ void karte_t::await_passengers_and_mail_threads()
 			simthread_barrier_wait(&step_passengers_and_mail_barrier);
 			simthread_barrier_wait(&step_passengers_and_mail_barrier);
 			passengers_and_mail_threads_working = false;
+			apply_passenger_generation_logs();
 		}
 #ifdef FORBID_MULTI_THREAD_PASSENGER_GENERATION_IN_NETWORK_MODE
 	}
@@ -1988,6 +2074,9 @@ void karte_t::await_private_car_threads(bool override_suspend)
 	{
 		simthread_barrier_wait(&private_car_barrier);
 		private_car_threads_working = false;
+
+		// The private car threads are now waiting at the barrier, so the routes they found can be committed.
+		commit_private_car_routes();
 	}
 }
 
@@ -2066,53 +2155,6 @@ void karte_t::start_path_explorer()
 #endif
 }
 
-void* unreserve_route_threaded(void* args)
-{
-	const uint32* thread_number_ptr = (const uint32*)args;
-	const uint32 thread_number = *thread_number_ptr;
-	delete thread_number_ptr;
-
-	do
-	{
-		simthread_barrier_wait(&karte_t::unreserve_route_barrier);
-
-		if (karte_t::world->is_terminating_threads())
-		{
-			break;
-		}
-		if (convoi_t::current_unreserver == 0)
-		{
-			int error = pthread_mutex_unlock(&karte_t::unreserve_route_mutex);
-			assert(error == 0);
-			(void)error;
-
-			continue;
-		}
-
-		const uint32 max_count = weg_t::get_all_ways_count() - 1;
-		const uint32 fraction = max_count / karte_t::world->get_parallel_operations();
-
-		route_range_specification range;
-
-		range.start = thread_number * fraction;
-		if (thread_number == karte_t::world->get_parallel_operations() - 1)
-		{
-			range.end = max_count;
-		}
-		else
-		{
-			range.end = min(((thread_number + 1) * fraction - 1), max_count);
-		}
-
-		convoi_t::unreserve_route_range(range);
-
-		simthread_barrier_wait(&karte_t::unreserve_route_barrier);
-
-	} while (!karte_t::world->is_terminating_threads());
-
-	pthread_exit(NULL);
-	return args;
-}
 #endif
 
 void karte_t::await_all_threads()
@@ -2142,6 +2184,7 @@ void karte_t::init_threads()
 
 	start_halts = new vector_tpl<nearby_halt_t>[parallel_operations + 2];
 	destination_list = new vector_tpl<halthandle_t>[parallel_operations + 2];
+	passenger_generation_logs = new passenger_generation_log_t[parallel_operations + 2];
 
 	pthread_attr_init(&thread_attributes);
 	pthread_attr_setdetachstate(&thread_attributes, PTHREAD_CREATE_JOINABLE);
@@ -2153,8 +2196,7 @@ void karte_t::init_threads()
 #endif
 
 	simthread_barrier_init(&private_car_barrier, NULL, one_private_car_thread ? 2 : parallel_operations + 1);
-	simthread_barrier_init(&karte_t::unreserve_route_barrier, NULL, parallel_operations + 2); // This and the next does not run concurrently with anything significant on the main thread, so the number of parallel operations need to be +1 compared to the others.
-	simthread_barrier_init(&step_passengers_and_mail_barrier, NULL, parallel_operations + 2);
+	simthread_barrier_init(&step_passengers_and_mail_barrier, NULL, parallel_operations + 2); // This does not run concurrently with anything significant on the main thread, so the number of parallel operations need to be +1 compared to the others.
 	simthread_barrier_init(&step_convoys_barrier_external, NULL, 2);
 	simthread_barrier_init(&step_convoys_barrier_internal, NULL, parallel_operations + 1);
 	simthread_barrier_init(&path_explorer_barrier, NULL, 2);
@@ -2168,7 +2210,6 @@ void karte_t::init_threads()
 
 	pthread_mutex_init(&step_passengers_and_mail_mutex, &mutex_attributes);
 	pthread_mutex_init(&path_explorer_await_mutex, &mutex_attributes);
-	pthread_mutex_init(&unreserve_route_mutex, &mutex_attributes);
 
 	pthread_t thread;
 
@@ -2189,19 +2230,7 @@ void karte_t::init_threads()
 			}
 			private_car_threads_working = false;
 		}
-		// The next two need an extra thread compared with the others, as they do not run concurrently with anything non-trivial on the main thread
-		sint32* thread_number_unres = new sint32;
-		*thread_number_unres = i;
-		rc = pthread_create(&thread, &thread_attributes, &unreserve_route_threaded, (void*)thread_number_unres);
-		if (rc)
-		{
-			dbg->fatal("void karte_t::init_threads()", "Failed to create private car thread, error %d. See here for a translation of the error numbers: http://epydoc.sourceforge.net/stdlib/errno-module.html", rc);
-		}
-		else
-		{
-			unreserve_route_threads.append(thread);
-		}
-
+		// The next one needs an extra thread compared with the others, as it does not run concurrently with anything non-trivial on the main thread
 #ifdef MULTI_THREAD_PASSENGER_GENERATION
 		sint32* thread_number_pass = new sint32;
 		*thread_number_pass = i + 1; // +1 because we need thread number 0 to represent the main thread.
@@ -2287,7 +2316,6 @@ void karte_t::destroy_threads()
 		await_private_car_threads();
 		simthread_barrier_wait(&private_car_barrier);
 
-		simthread_barrier_wait(&unreserve_route_barrier);
 #ifdef MULTI_THREAD_PATH_EXPLORER
 		simthread_barrier_wait(&path_explorer_barrier);
 		pthread_join(path_explorer_thread, 0);
@@ -2304,8 +2332,6 @@ void karte_t::destroy_threads()
 		step_passengers_and_mail_threads.clear();
 #endif
 
-		clean_threads(&unreserve_route_threads);
-		unreserve_route_threads.clear();
 #ifdef MULTI_THREAD_CONVOYS
 		simthread_barrier_destroy(&step_convoys_barrier_external);
 		simthread_barrier_destroy(&step_convoys_barrier_internal);
@@ -2314,7 +2340,6 @@ void karte_t::destroy_threads()
 		simthread_barrier_destroy(&step_passengers_and_mail_barrier);
 #endif
 		simthread_barrier_destroy(&private_car_barrier);
-		simthread_barrier_destroy(&unreserve_route_barrier);
 
 #ifdef MULTI_THREAD_PATH_EXPLORER
 		simthread_barrier_destroy(&path_explorer_barrier);
@@ -2325,7 +2350,6 @@ void karte_t::destroy_threads()
 		private_car_route_mutex_initialised = false;
 		pthread_mutex_destroy(&step_passengers_and_mail_mutex);
 		pthread_mutex_destroy(&path_explorer_await_mutex);
-		pthread_mutex_destroy(&unreserve_route_mutex);
 
 		pthread_mutexattr_destroy(&mutex_attributes);
 	}
@@ -2342,6 +2366,8 @@ void karte_t::destroy_threads()
 	start_halts = NULL;
 	delete[] destination_list;
 	destination_list = NULL;
+	delete[] passenger_generation_logs;
+	passenger_generation_logs = NULL;
 
 	threads_initialised = false;
 	terminating_threads = false;
@@ -2376,6 +2402,78 @@ sint32 karte_t::get_parallel_operations() const
 #endif
 }
 
+
+#ifdef MULTI_THREAD
+static bool spawned_shard_threads = false;
+static uint32 shard_thread_count = 0; // including the main thread
+static simthread_barrier_t shard_barrier_start;
+static simthread_barrier_t shard_barrier_end;
+
+// the current call of run_shards()
+static struct {
+	void (*run)(uint32 shard, void *param);
+	void *param;
+	uint32 count;
+} shard_job;
+
+
+static void run_shards_of_thread(uint32 thread_num)
+{
+	for(  uint32 shard = thread_num;  shard < shard_job.count;  shard += shard_thread_count  ) {
+		shard_job.run(shard, shard_job.param);
+	}
+}
+
+
+static void *shard_thread(void *ptr)
+{
+	const uint32 thread_num = (uint32)(size_t)ptr;
+	while(true) {
+		simthread_barrier_wait( &shard_barrier_start ); // wait for all to start
+		run_shards_of_thread(thread_num);
+		simthread_barrier_wait( &shard_barrier_end ); // wait for all to finish
+	}
+	return ptr;
+}
+#endif
+
+
+void karte_t::run_shards(uint32 count, void (*run)(uint32 shard, void *param), void *param)
+{
+#ifdef MULTI_THREAD
+	if(  count > 1  &&  env_t::num_threads > 1  ) {
+		if(  !spawned_shard_threads  ) {
+			shard_thread_count = env_t::num_threads;
+			pthread_t thread;
+			pthread_attr_t attr;
+			pthread_attr_init( &attr );
+			pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+			simthread_barrier_init( &shard_barrier_start, NULL, shard_thread_count );
+			simthread_barrier_init( &shard_barrier_end, NULL, shard_thread_count );
+			for(  uint32 t = 1;  t < shard_thread_count;  t++  ) {
+				if(  pthread_create( &thread, &attr, shard_thread, (void *)(size_t)t )  ) {
+					dbg->fatal( "karte_t::run_shards()", "cannot multithread, error at thread #%i", t );
+				}
+			}
+			spawned_shard_threads = true;
+			pthread_attr_destroy( &attr );
+		}
+
+		shard_job.run = run;
+		shard_job.param = param;
+		shard_job.count = count;
+
+		simthread_barrier_wait( &shard_barrier_start );
+		run_shards_of_thread(0);
+		simthread_barrier_wait( &shard_barrier_end );
+		return;
+	}
+#endif
+	for(  uint32 shard = 0;  shard < count;  shard++  ) {
+		run(shard, param);
+	}
+}
+
 #define array_koord(px,py) (px + py * get_size().x)
 
 
@@ -2453,8 +2551,10 @@ void karte_t::create_lakes(  int xoff, int yoff  )
 	delete [] new_stage;
 	delete [] local_stage;
 
-	for (planquadrat_t *pl = plan; pl < (plan + size_x * size_y); pl++) {
-		pl->correct_water();
+	for(  sint16 y = 0;  y < size_y;  y++  ) {
+		for(  sint16 x = 0;  x < size_x;  x++  ) {
+			access_nocheck(x, y)->correct_water();
+		}
 	}
 }
 
@@ -2688,7 +2788,8 @@ void karte_t::enlarge_map(settings_t const* sets, sint8 const* const h_field)
 		grund_t::enlarge_map( new_size_x, new_size_y );
 	}
 
-	planquadrat_t *new_plan = new planquadrat_t[new_size_x*new_size_y];
+	planquadrat_t *new_plan = new planquadrat_t[get_plan_tile_count(new_size_x, new_size_y)];
+	const uint32 new_plan_chunks_x = get_plan_chunks(new_size_x);
 	sint8 *new_grid_hgts = new sint8[(new_size_x + 1) * (new_size_y + 1)];
 	sint8 *new_water_hgts = new sint8[new_size_x * new_size_y];
 
@@ -2726,7 +2827,7 @@ void karte_t::enlarge_map(settings_t const* sets, sint8 const* const h_field)
 			for (sint16 ix = 0; ix<old_x; ix++) {
 				uint32 nr = ix+(iy*old_x);
 				uint32 nnr = ix+(iy*new_size_x);
-				swap(new_plan[nnr], plan[nr]);
+				swap(new_plan[get_plan_index(ix, iy, new_plan_chunks_x)], plan[get_plan_index(ix, iy)]);
 				new_water_hgts[nnr] = water_hgts[nr];
 			}
 		}
@@ -2746,6 +2847,7 @@ void karte_t::enlarge_map(settings_t const* sets, sint8 const* const h_field)
 
 	delete [] plan;
 	plan = new_plan;
+	plan_chunks_x = new_plan_chunks_x;
 	delete [] grid_hgts;
 	grid_hgts = new_grid_hgts;
 	delete [] water_hgts;
@@ -2934,18 +3036,18 @@ void karte_t::enlarge_map(settings_t const* sets, sint8 const* const h_field)
 
 	for (uint8 i = 0; i < goods_manager_t::passengers->get_number_of_classes(); i++)
 	{
-		FOR(weighted_vector_tpl<gebaeude_t*>, const target, commuter_targets[i])
+		FOR(fenwick_weighted_vector_tpl<gebaeude_t*>, const target, commuter_targets[i])
 		{
 			target->set_building_tiles();
 		}
 
-		FOR(weighted_vector_tpl<gebaeude_t*>, const target, visitor_targets[i])
+		FOR(fenwick_weighted_vector_tpl<gebaeude_t*>, const target, visitor_targets[i])
 		{
 			target->set_building_tiles();
 		}
 	}
 
-	FOR(weighted_vector_tpl<gebaeude_t*>, const target, mail_origins_and_targets)
+	FOR(fenwick_weighted_vector_tpl<gebaeude_t*>, const target, mail_origins_and_targets)
 	{
 		target->set_building_tiles();
 	}
@@ -3074,8 +3176,10 @@ karte_t::karte_t() :
 	sync_steps_barrier = sync_steps;
 	next_step_passenger = 0;
 	next_step_mail = 0;
+	passenger_generation_seed = 0;
 	destroying = false;
 	transferring_cargoes = NULL;
+	set_profile_step_phases(false);
 #ifdef MULTI_THREAD
 	cities_to_process = 0;
 	terminating_threads = false;
@@ -3104,6 +3208,10 @@ karte_t::karte_t() :
 	nosave_warning = nosave = false;
 
 	recheck_road_connexions = true;
+	private_car_route_checks_in_progress = 0;
+	private_car_route_sequence = 0;
+	private_car_route_cycle_start_time = 0;
+	private_car_route_cities_refreshed = 0;
 	actual_industry_density = industry_density_proportion = 0;
 
 	loaded_rotation = 0;
@@ -3151,8 +3259,8 @@ karte_t::karte_t() :
 	parallel_operations = -1;
 
 	const uint8 number_of_passenger_classes = goods_manager_t::passengers->get_number_of_classes();
-	commuter_targets = new weighted_vector_tpl<gebaeude_t*>[number_of_passenger_classes];
-	visitor_targets = new weighted_vector_tpl<gebaeude_t*>[number_of_passenger_classes];
+	commuter_targets = new fenwick_weighted_vector_tpl<gebaeude_t*>[number_of_passenger_classes];
+	visitor_targets = new fenwick_weighted_vector_tpl<gebaeude_t*>[number_of_passenger_classes];
 
 #ifdef MULTI_THREAD
 	passengers_and_mail_threads_working = false;
@@ -4349,6 +4457,7 @@ sint8 karte_t::max_hgt(const koord k) const
 
 
 planquadrat_t *rotate90_new_plan;
+uint32 rotate90_new_plan_chunks_x;
 sint8 *rotate90_new_water;
 
 void karte_t::rotate90_plans(sint16 x_min, sint16 x_max, sint16 y_min, sint16 y_max)
@@ -4359,8 +4468,8 @@ void karte_t::rotate90_plans(sint16 x_min, sint16 x_max, sint16 y_min, sint16 y_
 			for(  int xx = x_min;  xx < x_max;  xx += LOOP_BLOCK  ) {
 				for(  int y = yy;  y < min(yy + LOOP_BLOCK, y_max);  y++  ) {
 					for(  int x = xx;  x < min(xx + LOOP_BLOCK, x_max);  x++  ) {
-						const int nr = x + (y * cached_grid_size.x);
-						const int new_nr = (cached_size.y - y) + (x * cached_grid_size.y);
+						const uint32 nr = get_plan_index(x, y);
+						const uint32 new_nr = get_plan_index(cached_size.y - y, x, rotate90_new_plan_chunks_x);
 						// first rotate everything on the ground(s)
 						for(  uint i = 0;  i < plan[nr].get_boden_count();  i++  ) {
 							plan[nr].get_boden_bei(i)->rotate90();
@@ -4382,8 +4491,8 @@ void karte_t::rotate90_plans(sint16 x_min, sint16 x_max, sint16 y_min, sint16 y_
 					for(  int y=yy;  y < min(yy + LOOP_BLOCK, y_max);  y++  ) {
 						// rotate climate transitions
 						rotate_transitions( koord( x, y ) );
-						const int nr = x + (y * cached_grid_size.x);
-						const int new_nr = (cached_size.y - y) + (x * cached_grid_size.y);
+						const uint32 nr = get_plan_index(x, y);
+						const uint32 new_nr = get_plan_index(cached_size.y - y, x, rotate90_new_plan_chunks_x);
 						swap(rotate90_new_plan[new_nr], plan[nr]);
 					}
 				}
@@ -4394,7 +4503,7 @@ void karte_t::rotate90_plans(sint16 x_min, sint16 x_max, sint16 y_min, sint16 y_
 			for(  int yy = y_min;  yy < y_max;  yy += LOOP_BLOCK  ) {
 				for(  int x = xx;  x < min(xx + LOOP_BLOCK, x_max);  x++  ) {
 					for(  int y = yy;  y < min(yy + LOOP_BLOCK, y_max);  y++  ) {
-						const int new_nr = (cached_size.y - y) + (x * cached_grid_size.y);
+						const uint32 new_nr = get_plan_index(cached_size.y - y, x, rotate90_new_plan_chunks_x);
 						for(  uint i = 0;  i < rotate90_new_plan[new_nr].get_boden_count();  i++  ) {
 							rotate90_new_plan[new_nr].get_boden_bei(i)->rotate90();
 						}
@@ -4427,6 +4536,9 @@ DBG_MESSAGE( "karte_t::rotate90()", "called" );
 	// Wait for any threaded work
 	await_all_threads();
 
+	// all positions change: the graphs are built again in the next step
+	way_graph_t::reset();
+
 	// assume we can save this rotation
 	nosave_warning = nosave = false;
 
@@ -4447,7 +4559,8 @@ DBG_MESSAGE( "karte_t::rotate90()", "called" );
 	}
 
 	//rotate plans in parallel posix thread ...
-	rotate90_new_plan = new planquadrat_t[cached_grid_size.y * cached_grid_size.x];
+	rotate90_new_plan = new planquadrat_t[get_plan_tile_count(cached_grid_size.y, cached_grid_size.x)];
+	rotate90_new_plan_chunks_x = get_plan_chunks(cached_grid_size.y);
 	rotate90_new_water = new sint8[cached_grid_size.y * cached_grid_size.x];
 
 	world_xy_loop(&karte_t::rotate90_plans, 0);
@@ -4456,6 +4569,7 @@ DBG_MESSAGE( "karte_t::rotate90()", "called" );
 
 	delete [] plan;
 	plan = rotate90_new_plan;
+	plan_chunks_x = rotate90_new_plan_chunks_x;
 	delete [] water_hgts;
 	water_hgts = rotate90_new_water;
 
@@ -4524,20 +4638,20 @@ DBG_MESSAGE( "karte_t::rotate90()", "called" );
 
 	for (uint8 i = 0; i < goods_manager_t::passengers->get_number_of_classes(); i++)
 	{
-		FOR(weighted_vector_tpl<gebaeude_t*>, const building, visitor_targets[i])
+		FOR(fenwick_weighted_vector_tpl<gebaeude_t*>, const building, visitor_targets[i])
 		{
 			building->set_building_tiles();
 		}
-		FOR(weighted_vector_tpl<gebaeude_t*>, const building, commuter_targets[i])
+		FOR(fenwick_weighted_vector_tpl<gebaeude_t*>, const building, commuter_targets[i])
 		{
 			building->set_building_tiles();
 		}
 	}
-	FOR(weighted_vector_tpl<gebaeude_t*>, const building, passenger_origins)
+	FOR(fenwick_weighted_vector_tpl<gebaeude_t*>, const building, passenger_origins)
 	{
 		building->set_building_tiles();
 	}
-	FOR(weighted_vector_tpl<gebaeude_t*>, const building, mail_origins_and_targets)
+	FOR(fenwick_weighted_vector_tpl<gebaeude_t*>, const building, mail_origins_and_targets)
 	{
 		building->set_building_tiles();
 	}
@@ -4874,6 +4988,7 @@ void karte_t::sync_step(uint32 delta_t, bool do_sync_step, bool display )
 		 * foundations etc are added removed frequently during city growth
 		 * => they are now in a hastable!
 		 */
+		uint64 phase_start = get_step_phase_clock();
 		sync_eyecandy.sync_step( delta_t );
 
 		rands[2] = get_random_seed();
@@ -4882,12 +4997,15 @@ void karte_t::sync_step(uint32 delta_t, bool do_sync_step, bool display )
 		 * => they are now in a hastable!
 		 */
 		sync_way_eyecandy.sync_step( delta_t );
+		add_step_phase_time(PHASE_SYNC_EYECANDY, phase_start);
 
 		rands[3] = get_random_seed();
 
 		clear_random_mode( INTERACTIVE_RANDOM );
 
+		phase_start = get_step_phase_clock();
 		sync.sync_step( delta_t );
+		add_step_phase_time(PHASE_SYNC, phase_start);
 
 		rands[4] = get_random_seed();
 	}
@@ -5059,6 +5177,64 @@ inline sint32 get_population(stadt_t const* const c)
 }
 
 
+// The month end stages which only change the object itself (see weg_t::new_month_local()
+// and haltestelle_t::new_month_local()) run on consecutive shards of their lists.
+struct month_shards_t
+{
+	void (*run)(uint32 shard, uint32 first, uint32 last);
+	uint32 count;
+	uint32 shard_count;
+};
+
+static void run_month_shard(uint32 shard, void *param)
+{
+	const month_shards_t &shards = *(const month_shards_t *)param;
+	const uint32 first = (uint32)(((uint64)shards.count * shard) / shards.shard_count);
+	const uint32 last = (uint32)(((uint64)shards.count * (shard + 1)) / shards.shard_count);
+	shards.run(shard, first, last);
+}
+
+static uint32 run_month_shards(uint32 count, void (*run)(uint32 shard, uint32 first, uint32 last))
+{
+	month_shards_t shards;
+	shards.run = run;
+	shards.count = count;
+#ifdef MULTI_THREAD
+	// Small lists are not worth waking the threads for.
+	shards.shard_count = max(1u, min((uint32)clamp(world()->get_parallel_operations(), 1, MAX_THREADS), count / 1024u));
+#else
+	shards.shard_count = 1;
+#endif
+	world()->run_shards(shards.shard_count, &run_month_shard, &shards);
+	return shards.shard_count;
+}
+
+/// Ways whose monthly wear renews or degrades them, by shard
+static vector_tpl<weg_t*> month_worn_ways[MAX_THREADS];
+
+static void new_month_ways(uint32 shard, uint32 first, uint32 last)
+{
+	const vector_tpl<weg_t*> &ways = weg_t::get_alle_wege();
+	month_worn_ways[shard].clear();
+	for (uint32 i = first; i < last; i++)
+	{
+		if (!ways[i]->new_month_local())
+		{
+			month_worn_ways[shard].append(ways[i]);
+		}
+	}
+}
+
+static void new_month_halts(uint32, uint32 first, uint32 last)
+{
+	const vector_tpl<halthandle_t> &halts = haltestelle_t::get_alle_haltestellen();
+	for (uint32 i = first; i < last; i++)
+	{
+		halts[i]->new_month_local();
+	}
+}
+
+
 void karte_t::new_month()
 {
 	update_history();
@@ -5082,8 +5258,16 @@ void karte_t::new_month()
 
 	// this should be done before a map update, since the map may want an update of the way usage
 //	DBG_MESSAGE("karte_t::new_month()","ways");
-	FOR(vector_tpl<weg_t*>, const w, weg_t::get_alle_wege()) {
-		w->new_month();
+	// The statistics and the wear of the ways are updated in parallel; renewing or degrading
+	// a worn way charges its owner, so these follow here in the order of the way list.
+	const uint32 way_shards = run_month_shards(weg_t::get_alle_wege().get_count(), &new_month_ways);
+	for (uint32 i = 0; i < way_shards; i++)
+	{
+		FOR(vector_tpl<weg_t*>, const w, month_worn_ways[i])
+		{
+			w->wear_way(w->get_desc()->get_monthly_base_wear());
+		}
+		month_worn_ways[i].clear();
 	}
 
 	// Update the maximum vehicle speed records to calibrate when passengers should not burden the journey time database.
@@ -5225,8 +5409,11 @@ void karte_t::new_month()
 	INT_CHECK("simworld 3130");
 
 //	DBG_MESSAGE("karte_t::new_month()","halts");
+	// The waiting times and the statistics of the halts are updated in parallel,
+	// then the messages and the walking connexions on this thread.
+	run_month_shards(haltestelle_t::get_alle_haltestellen().get_count(), &new_month_halts);
 	FOR(vector_tpl<halthandle_t>, const s, haltestelle_t::get_alle_haltestellen()) {
-		s->new_month();
+		s->new_month_shared();
 		INT_CHECK("simworld 1877");
 	}
 
@@ -5282,7 +5469,7 @@ void karte_t::new_month()
 	if( !env_t::networkmode && env_t::autosave>0 && last_month%env_t::autosave==0 && !win_get_magic(magic_welt_gui_t) ) {
 		char buf[128];
 		sprintf( buf, "save/autosave%02i.sve", last_month+1 );
-		save( buf, loadsave_t::autosave_mode, env_t::savegame_version_str, env_t::savegame_ex_version_str, env_t::savegame_ex_revision_str, true );
+		save( buf, loadsave_t::autosave_mode, env_t::savegame_version_str, env_t::savegame_ex_version_str, env_t::savegame_ex_revision_str, true, true );
 	}
 
 	recalc_passenger_destination_weights();
@@ -5476,6 +5663,66 @@ void karte_t::set_schedule_counter()
 	schedule_counter++;
 }
 
+void karte_t::set_profile_step_phases(bool on)
+{
+	profile_step_phases = on;
+	for(  int i = 0;  i < MAX_STEP_PHASES;  i++  ) {
+		step_phase_time[i] = 0;
+	}
+}
+
+
+uint64 karte_t::get_step_phase_clock() const
+{
+	if(  !profile_step_phases  ) {
+		return 0;
+	}
+	return (uint64)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+const char *karte_t::get_step_phase_name(step_phase_t phase)
+{
+	static const char *const names[MAX_STEP_PHASES] = {
+		"new_month",
+		"path_explorer",
+		"convoys_threaded_step",
+		"convoys_step",
+		"cities",
+		"passenger_generation",
+		"factories",
+		"halts",
+		"sync_eyecandy",
+		"sync"
+	};
+	return names[phase];
+}
+
+
+uint32 karte_t::get_state_checksum() const
+{
+	// FNV-1a
+	uint32 hash = 2166136261u;
+	uint32 values[CHK_RANDS + CHK_DEBUG_SUMS + 1];
+	uint32 n = 0;
+	values[n++] = get_random_seed();
+	for(  uint8 i = 0;  i < CHK_RANDS;  i++  ) {
+		values[n++] = rands[i];
+	}
+	for(  uint8 i = 0;  i < CHK_DEBUG_SUMS;  i++  ) {
+		// debug_sums[4] is the number of threads
+		values[n++] = i == 4 ? 0 : debug_sums[i];
+	}
+	for(  uint32 i = 0;  i < n;  i++  ) {
+		for(  int b = 0;  b < 32;  b += 8  ) {
+			hash ^= (values[i] >> b) & 0xFF;
+			hash *= 16777619u;
+		}
+	}
+	return hash;
+}
+
+
 void karte_t::step()
 {
 	rands[8] = get_random_seed();
@@ -5502,7 +5749,9 @@ void karte_t::step()
 		next_month_ticks += karte_t::ticks_per_world_month;
 
 		DBG_DEBUG4("karte_t::step", "calling new_month");
+		const uint64 phase_start = get_step_phase_clock();
 		new_month();
+		add_step_phase_time(PHASE_NEW_MONTH, phase_start);
 	}
 	rands[9] = get_random_seed();
 
@@ -5572,8 +5821,15 @@ void karte_t::step()
 	{
 		const sint32 parallel_operations = get_parallel_operations();
 
-		if (cities_awaiting_private_car_route_check.empty())
+		if (cities_awaiting_private_car_route_check.empty() && private_car_route_checks_in_progress == 0)
 		{
+			if (private_car_route_cycle_start_time)
+			{
+				dbg->message("karte_t::step()", "Refreshed the private car routes of %u cities in %u ms", private_car_route_cities_refreshed, dr_time() - private_car_route_cycle_start_time);
+			}
+			private_car_route_cycle_start_time = dr_time();
+			private_car_route_cities_refreshed = 0;
+
 			weg_t::swap_private_car_routes_currently_reading_element();
 			FOR(weighted_vector_tpl<stadt_t*>, const i, stadt)
 			{
@@ -5581,6 +5837,14 @@ void karte_t::step()
 			}
 		}
 
+		// The threads are idle here, so the order of the queue is the same on all clients.
+		while (!cities_with_edited_roads.empty())
+		{
+			stadt_t* city = cities_with_edited_roads.pop_back();
+			cities_awaiting_private_car_route_check.remove(city);
+			cities_awaiting_private_car_route_check.insert(city);
+		}
+
 #ifdef MULTI_THREAD
 		// This cannot be started at the end of the step, as we will not know at that point whether we need to call this at all.
 		// There can be many mutex clashes with this; however, processing only one city at a time can make it take an unfeasible amount of time to refresh all routes.
@@ -5593,8 +5857,12 @@ void karte_t::step()
 		for (sint32 j = 0; j < cities_to_process; j++)
 		{
 			stadt_t* city = cities_awaiting_private_car_route_check.remove_first();
+			city->set_private_car_route_sequence(private_car_route_sequence++);
+			private_car_route_checks_in_progress++;
 			city->check_all_private_car_routes();
+			cities_awaiting_private_car_route_commit.append(city);
 		}
+		commit_private_car_routes();
 #endif
 	}
 
@@ -5607,7 +5875,9 @@ void karte_t::step()
 	if(  season_change  ||  snowline_change  ) {
 		DBG_DEBUG4("karte_t::step", "pending_season_change");
 		// process
-		const uint32 end_count = min( cached_grid_size.x * cached_grid_size.y,  tile_counter + max( 16384, cached_grid_size.x * cached_grid_size.y / 16 ) );
+		// the padding tiles of the chunks are empty and cost next to nothing
+		const uint32 tile_count = get_plan_tile_count(cached_grid_size.x, cached_grid_size.y);
+		const uint32 end_count = min( tile_count,  tile_counter + max( 16384u, tile_count / 16 ) );
 		while(  tile_counter < end_count  ) {
 			plan[tile_counter].check_season_snowline( season_change, snowline_change );
 			tile_counter++;
@@ -5616,7 +5886,7 @@ void karte_t::step()
 			}
 		}
 
-		if(  tile_counter >= (uint32)cached_grid_size.x * (uint32)cached_grid_size.y  ) {
+		if(  tile_counter >= tile_count  ) {
 			if(  season_change ) {
 				pending_season_change--;
 			}
@@ -5632,6 +5902,7 @@ void karte_t::step()
 	// to make sure the tick counter will be updated
 	INT_CHECK("karte_t::step 1");
 
+	uint64 phase_start = get_step_phase_clock();
 #ifdef MULTI_THREAD_PATH_EXPLORER
 	// Stop the path explorer before we use its results.
 	await_path_explorer();
@@ -5639,26 +5910,33 @@ void karte_t::step()
 	// Knightly : calling global path explorer
 	path_explorer_t::step();
 #endif
+	add_step_phase_time(PHASE_PATH_EXPLORER, phase_start);
 	rands[12] = get_random_seed();
 
 	INT_CHECK("karte_t::step 2");
 
+	phase_start = get_step_phase_clock();
 #ifdef MULTI_THREAD_CONVOYS
 	// Finish the threaded part of the convoys' steps: this is mainly route searches. Block reservation, etc., is in the single threaded part.
 	await_convoy_threads();
+	// No convoy is searching now: bring the junction graphs up to date with the ways.
+	way_graph_t::update(this);
 #else
+	way_graph_t::update(this);
 	for (uint32 i = convoi_array.get_count(); i-- != 0;)
 	{
 		convoihandle_t cnv = convoi_array[i];
 		cnv->threaded_step();
 	}
 #endif
+	add_step_phase_time(PHASE_CONVOYS_THREADED, phase_start);
 
 	rands[13] = get_random_seed();
 
 	// The more computationally intensive parts of this have been extracted and made multi-threaded.
 	DBG_DEBUG4("karte_t::step 4", "step %d convois", convoi_array.get_count());
 	// since convois will be deleted during stepping, we need to step backwards
+	phase_start = get_step_phase_clock();
 	for (uint32 i = convoi_array.get_count(); i-- != 0;) {
 		convoihandle_t cnv = convoi_array[i];
 		cnv->step();
@@ -5666,6 +5944,7 @@ void karte_t::step()
 			INT_CHECK("karte_t::step 3");
 		}
 	}
+	add_step_phase_time(PHASE_CONVOYS, phase_start);
 
 	rands[14] = get_random_seed();
 
@@ -5683,10 +5962,12 @@ void karte_t::step()
 #ifndef CONCURRENT_ROUTE_PROCESSING
 	uint32 step_cities_count = 0;
 #endif
+	phase_start = get_step_phase_clock();
 	FOR(weighted_vector_tpl<stadt_t*>, const i, stadt)
 	{
 		i->step(delta_t);
 	}
+	add_step_phase_time(PHASE_CITIES, phase_start);
 
 	rands[15] = get_random_seed();
 
@@ -5696,7 +5977,9 @@ void karte_t::step()
 	// The placement of this method call must be before any code that in any way relies on the private car routes between cities, most especially the mail and passenger generation (step_passengers_and_mail(delta_t)).
 	if (check_city_routes)
 	{
+		phase_start = get_step_phase_clock();
 		await_private_car_threads();
+		add_step_phase_time(PHASE_CITIES, phase_start);
 	}
 #endif
 
@@ -5721,9 +6004,11 @@ void karte_t::step()
 	po = 1;
 #endif
 
+	phase_start = get_step_phase_clock();
+
 	// This is quite computationally intensive, but not as much as the path explorer. It can be more or less than the convoys, depending on the map.
-	// Multi-threading the passenger and mail generation is currently not working well as dividing the number of passengers/mail to be generated per
-	//step by the number of parallel operations introduces significant rounding errors.
+	// Each generation thread gets a fixed share of the packets to be generated and its own random numbers, and
+	// records its effects in a log which is applied when the threads are awaited, so this is deterministic.
 #ifdef MULTI_THREAD_PASSENGER_GENERATION
 
 #ifdef FORBID_MULTI_THREAD_PASSENGER_GENERATION_IN_NETWORK_MODE
@@ -5752,6 +6037,9 @@ void karte_t::step()
 			debug_sums[6] += transferring_cargoes[i].get_count();
 		}
 
+		// Does not draw from the random numbers of the main thread, which are the same on all clients anyway.
+		passenger_generation_seed = get_random_seed() ^ (uint32)steps;
+
 		start_passengers_and_mail_threads();
 
 #ifdef FORBID_MULTI_THREAD_PASSENGER_GENERATION_IN_NETWORK_MODE
@@ -5765,6 +6053,7 @@ void karte_t::step()
 	step_passengers_and_mail(delta_t);
 #endif
 	DBG_DEBUG4("karte_t::step", "step generate passengers and mail");
+	add_step_phase_time(PHASE_PASSENGERS, phase_start);
 
 	rands[17] = get_random_seed();
 
@@ -5790,6 +6079,7 @@ void karte_t::step()
 	INT_CHECK("karte_t::step 4");
 
 	// This does nothing if the threading is disabled.
+	phase_start = get_step_phase_clock();
 	await_passengers_and_mail_threads();
 
 	rands[19] = get_random_seed();
@@ -5858,12 +6148,15 @@ void karte_t::step()
 	}
 #endif
 #endif
+	add_step_phase_time(PHASE_PASSENGERS, phase_start);
 	INT_CHECK("karte_t::step 5");
 
 	DBG_DEBUG4("karte_t::step", "step factories");
+	phase_start = get_step_phase_clock();
 	FOR(vector_tpl<fabrik_t*>, const f, fab_list) {
 		f->step(delta_t);
 	}
+	add_step_phase_time(PHASE_FACTORIES, phase_start);
 	rands[20] = get_random_seed();
 
 	finance_history_year[0][WORLD_FACTORIES] = finance_history_month[0][WORLD_FACTORIES] = fab_list.get_count();
@@ -5892,7 +6185,9 @@ void karte_t::step()
 
 	// This is not computationally intensive
 	DBG_DEBUG4("karte_t::step", "step halts");
+	phase_start = get_step_phase_clock();
 	haltestelle_t::step_all();
+	add_step_phase_time(PHASE_HALTS, phase_start);
 	rands[23] = get_random_seed();
 
 	// Re-check paths if the time has come.
@@ -6043,6 +6338,7 @@ void karte_t::step_passengers_and_mail(uint32 delta_t)
 			return;
 		}
 		units_this_step = generate_passengers_or_mail(goods_manager_t::passengers);
+		apply_passenger_generation_logs();
 		next_step_passenger -= (passenger_step_interval * units_this_step);
 
 	}
@@ -6054,6 +6350,7 @@ void karte_t::step_passengers_and_mail(uint32 delta_t)
 			return;
 		}
 		units_this_step = generate_passengers_or_mail(goods_manager_t::mail);
+		apply_passenger_generation_logs();
 		next_step_mail -= (mail_step_interval * units_this_step);
 	}
 }
@@ -6223,9 +6520,59 @@ void karte_t::deposit_ware_at_destination(ware_t ware)
 	}
 }
 
+void passenger_generation_log_t::apply(karte_t *welt)
+{
+	FOR(vector_tpl<effect_t>, const& e, effects)
+	{
+		switch(e.type)
+		{
+		case city_generated:               e.city->set_generated_passengers(e.amount, e.arg); break;
+		case city_destination:             e.city->merke_passagier_ziel(e.pos, e.arg); break;
+		case city_private_car_trip:        e.city->set_private_car_trip(e.amount, e.destination_town); break;
+		case city_transported_mail:        e.city->add_transported_mail(e.amount); break;
+		case city_walking:                 e.city->add_walking_passengers(e.amount); break;
+		case building_generated_commuting: e.building->add_passengers_generated_commuting(e.amount); break;
+		case building_generated_visiting:  e.building->add_passengers_generated_visiting(e.amount); break;
+		case building_mail_generated:      e.building->add_mail_generated(e.amount); break;
+		case building_succeeded_commuting: e.building->add_passengers_succeeded_commuting(e.amount); break;
+		case building_succeeded_visiting:  e.building->add_passengers_succeeded_visiting(e.amount); break;
+		case building_mail_succeeded:      e.building->add_mail_delivery_succeeded(e.amount); break;
+		case halt_unhappy:                 e.halt->add_pax_unhappy(e.amount); break;
+		case halt_too_slow:                e.halt->add_pax_too_slow(e.amount); break;
+		case halt_no_route:                e.halt->add_pax_no_route(e.amount); break;
+		case halt_mail_no_route:           e.halt->add_mail_no_route(e.amount); break;
+		case halt_start_route:             e.halt->starte_mit_route(wares[e.amount], e.pos); break;
+		case factory_stat:                 e.fab->book_stat(e.amount, e.arg); break;
+		case debug_sum:                    welt->add_to_debug_sums(e.arg, e.amount); break;
+		}
+	}
+	effects.clear();
+	wares.clear();
+}
+
+void karte_t::apply_passenger_generation_logs()
+{
+#ifdef MULTI_THREAD
+	if (!passenger_generation_logs)
+	{
+		return;
+	}
+	const sint32 po = get_parallel_operations() + 2;
+#else
+	const sint32 po = 1;
+#endif
+	// Always in the order of the threads, never in the order in which they finished
+	for (sint32 i = 0; i < po; i++)
+	{
+		passenger_generation_logs[i].apply(this);
+	}
+}
+
 sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 {
 	const city_cost history_type = (wtyp == goods_manager_t::passengers) ? HIST_PAS_TRANSPORTED : HIST_MAIL_TRANSPORTED;
+	// Everything which other generation threads might read or write goes here
+	passenger_generation_log_t &effects = get_passenger_generation_log();
 	const uint32 units_this_step = simrand((uint32)settings.get_passenger_routing_packet_size(), "void karte_t::generate_passengers_and_mail(uint32 delta_t) passenger/mail packet size") + 1;
 	// Pick the building from which to generate passengers/mail
 	gebaeude_t* gb;
@@ -6251,18 +6598,8 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 	{
 		// Mail is generated in non-city buildings such as attractions.
 		// That will be the only legitimate case in which this condition is not fulfilled.
-#ifdef MULTI_THREAD
-		int mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-		assert(mutex_error == 0);
-		(void)mutex_error;
-#endif
-		city->set_generated_passengers(units_this_step, history_type + 1);
-		add_to_debug_sums(5, units_this_step);
-#ifdef MULTI_THREAD
-		mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-		assert(mutex_error == 0);
-		(void)mutex_error;
-#endif
+		effects.set_generated_passengers(city, units_this_step, history_type + 1);
+		effects.add_to_debug_sums(5, units_this_step);
 	}
 
 	koord3d origin_pos = gb->get_pos();
@@ -6431,17 +6768,7 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			// Added here as the original journey had its generated passengers set much earlier, outside the for loop.
 			if(city)
 			{
-#ifdef MULTI_THREAD
-				int mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-				assert(mutex_error == 0);
-				(void)mutex_error;
-#endif
-				city->set_generated_passengers(units_this_step, history_type + 1);
-#ifdef MULTI_THREAD
-				mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-				assert(mutex_error == 0);
-				(void)mutex_error;
-#endif
+				effects.set_generated_passengers(city, units_this_step, history_type + 1);
 			}
 
 			if(route_status != private_car)
@@ -6485,46 +6812,17 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 
 		if(trip == commuting_trip)
 		{
-#ifdef MULTI_THREAD
-			int mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-			(void)mutex_error;
-#endif
-			first_origin->add_passengers_generated_commuting(units_this_step);
-#ifdef MULTI_THREAD
-			mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-			(void)mutex_error;
-#endif
+			effects.add_passengers_generated_commuting(first_origin, units_this_step);
 		}
 
 		else if(trip == visiting_trip)
 		{
-#ifdef MULTI_THREAD
-			int mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-			(void)mutex_error;
-#endif
-			first_origin->add_passengers_generated_visiting(units_this_step);
-#ifdef MULTI_THREAD
-			mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-			(void)mutex_error;
-#endif
+			effects.add_passengers_generated_visiting(first_origin, units_this_step);
 		}
 
 		else if (trip == mail_trip)
 		{
-#ifdef MULTI_THREAD
-			int mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-			(void)mutex_error;
-#endif
-			first_origin->add_mail_generated(units_this_step);
-#ifdef MULTI_THREAD
-			mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-#endif
+			effects.add_mail_generated(first_origin, units_this_step);
 		}
 
 		/**
@@ -7084,33 +7382,19 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 		bool set_return_trip = false;
 		stadt_t* destination_town;
 
-#ifdef MULTI_THREAD
-		int mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-		assert(mutex_error == 0);
-		(void)mutex_error;
-#endif
-
 		switch(route_status)
 		{
 		case public_transport:
-#ifdef MULTI_THREAD
-			mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-#endif
 			if(tolerance < UINT32_MAX_VALUE)
 			{
 				tolerance -= best_journey_time;
 				walking_tolerance -= best_journey_time;
 			}
 			pax.set_origin(start_halt);
-			start_halt->starte_mit_route(pax, origin_pos.get_2d());
-#ifdef MULTI_THREAD
-			mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-#endif
+			effects.starte_mit_route(start_halt, pax, origin_pos.get_2d());
 			if(city && wtyp == goods_manager_t::passengers)
 			{
-				city->merke_passagier_ziel(destination_pos, COL_YELLOW);
+				effects.merke_passagier_ziel(city, destination_pos, COL_YELLOW);
 			}
 			set_return_trip = true;
 			// create pedestrians in the near area?
@@ -7122,7 +7406,7 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			// However, as for the destination, this can be set when the passengers arrive.
 			if(trip == commuting_trip && first_origin)
 			{
-				first_origin->add_passengers_succeeded_commuting(units_this_step);
+				effects.add_passengers_succeeded_commuting(first_origin, units_this_step);
 #ifdef DEBUG_MARCHETTI_CONSTANT
 				if (trip_count == 0)
 				{
@@ -7137,7 +7421,7 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			}
 			else if(trip == visiting_trip && first_origin)
 			{
-				first_origin->add_passengers_succeeded_visiting(units_this_step);
+				effects.add_passengers_succeeded_visiting(first_origin, units_this_step);
 #ifdef DEBUG_MARCHETTI_CONSTANT
 				if (trip_count == 0)
 				{
@@ -7152,7 +7436,7 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			}
 			else if (trip == mail_trip && first_origin)
 			{
-				first_origin->add_mail_delivery_succeeded(units_this_step);
+				effects.add_mail_delivery_succeeded(first_origin, units_this_step);
 			}
 		break;
 
@@ -7172,13 +7456,13 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 				city->generate_private_cars(origin_pos.get_2d(), car_minutes, adjusted_destination_pos, units_this_step);
 				if(wtyp == goods_manager_t::passengers)
 				{
-					city->set_private_car_trip(units_this_step, destination_town);
-					city->merke_passagier_ziel(destination_pos, COL_TURQUOISE);
+					effects.set_private_car_trip(city, units_this_step, destination_town);
+					effects.merke_passagier_ziel(city, destination_pos, COL_TURQUOISE);
 				}
 				else
 				{
 					// Mail
-					city->add_transported_mail(units_this_step);
+					effects.add_transported_mail(city, units_this_step);
 				}
 			}
 
@@ -7187,7 +7471,7 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			// We cannot do this on arrival, as the ware packets do not remember their origin building.
 			if(trip == commuting_trip)
 			{
-				first_origin->add_passengers_succeeded_commuting(units_this_step);
+				effects.add_passengers_succeeded_commuting(first_origin, units_this_step);
 #ifdef DEBUG_MARCHETTI_CONSTANT
 				if (trip_count == 0)
 				{
@@ -7202,7 +7486,7 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			}
 			else if(trip == visiting_trip)
 			{
-				first_origin->add_passengers_succeeded_visiting(units_this_step);
+				effects.add_passengers_succeeded_visiting(first_origin, units_this_step);
 #ifdef DEBUG_MARCHETTI_CONSTANT
 				if (trip_count == 0)
 				{
@@ -7217,17 +7501,9 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			}
 			else if(trip == mail_trip)
 			{
-				first_origin->add_mail_delivery_succeeded(units_this_step);
+				effects.add_mail_delivery_succeeded(first_origin, units_this_step);
 			}
-#ifdef MULTI_THREAD
-			mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-#endif
 			add_to_waiting_list(pax, origin_pos.get_2d());
-#ifdef MULTI_THREAD
-			mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-#endif
 			break;
 
 		case on_foot:
@@ -7251,13 +7527,13 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			{
 				if(wtyp == goods_manager_t::passengers)
 				{
-					city->merke_passagier_ziel(destination_pos, COL_DARK_YELLOW);
-					city->add_walking_passengers(units_this_step);
+					effects.merke_passagier_ziel(city, destination_pos, COL_DARK_YELLOW);
+					effects.add_walking_passengers(city, units_this_step);
 				}
 				else
 				{
 					// Mail
-					city->add_transported_mail(units_this_step);
+					effects.add_transported_mail(city, units_this_step);
 				}
 			}
 			set_return_trip = true;
@@ -7265,7 +7541,7 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			// We cannot do this on arrival, as the ware packets do not remember their origin building.
 			if(trip == commuting_trip)
 			{
-				first_origin->add_passengers_succeeded_commuting(units_this_step);
+				effects.add_passengers_succeeded_commuting(first_origin, units_this_step);
 #ifdef DEBUG_MARCHETTI_CONSTANT
 				if (trip_count == 0)
 				{
@@ -7280,7 +7556,7 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			}
 			else if(trip == visiting_trip)
 			{
-				first_origin->add_passengers_succeeded_visiting(units_this_step);
+				effects.add_passengers_succeeded_visiting(first_origin, units_this_step);
 #ifdef DEBUG_MARCHETTI_CONSTANT
 				if (trip_count == 0)
 				{
@@ -7295,28 +7571,17 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			}
 			else if (trip == mail_trip)
 			{
-				first_origin->add_mail_delivery_succeeded(units_this_step);
+				effects.add_mail_delivery_succeeded(first_origin, units_this_step);
 			}
-#ifdef MULTI_THREAD
-			mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-
-			// Prevent deadlocks because of double-locking:
-			// there is already a mutex lock in the add_to_waiting_list
-#endif
 			add_to_waiting_list(pax, origin_pos.get_2d());
 			// Do nothing if trip == mail.
-#ifdef MULTI_THREAD
-			mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-			assert(mutex_error == 0);
-#endif
 			break;
 
 		case overcrowded:
 
 			if(city && wtyp == goods_manager_t::passengers)
 			{
-				city->merke_passagier_ziel(best_bad_destination, COL_RED);
+				effects.merke_passagier_ziel(city, best_bad_destination, COL_RED);
 			}
 #ifdef MULTI_THREAD
 			if(start_halts[passenger_generation_thread_number].get_count() > 0)
@@ -7329,7 +7594,7 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 #endif
 				if(start_halt.is_bound())
 				{
-					start_halt->add_pax_unhappy(units_this_step);
+					effects.add_pax_unhappy(start_halt, units_this_step);
 				}
 			}
 
@@ -7340,11 +7605,11 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 			{
 				if(car_minutes >= best_journey_time)
 				{
-					city->merke_passagier_ziel(best_bad_destination, COL_PURPLE);
+					effects.merke_passagier_ziel(city, best_bad_destination, COL_PURPLE);
 				}
 				else if(car_minutes < UINT32_MAX_VALUE)
 				{
-					city->merke_passagier_ziel(best_bad_destination, COL_LIGHT_PURPLE);
+					effects.merke_passagier_ziel(city, best_bad_destination, COL_LIGHT_PURPLE);
 				}
 				else
 				{
@@ -7367,7 +7632,7 @@ sint32 karte_t::generate_passengers_or_mail(const goods_desc_t * wtyp)
 #endif
 			if(start_halt.is_bound() && best_journey_time < UINT32_MAX_VALUE)
 			{
-				start_halt->add_pax_too_slow(units_this_step);
+				effects.add_pax_too_slow(start_halt, units_this_step);
 			}
 			break;
 
@@ -7379,11 +7644,11 @@ no_route:
 			{
 				if(route_status == destination_unavailable)
 				{
-					city->merke_passagier_ziel(first_destination.location, COL_DARK_RED);
+					effects.merke_passagier_ziel(city, first_destination.location, COL_DARK_RED);
 				}
 				else
 				{
-					city->merke_passagier_ziel(first_destination.location, COL_DARK_ORANGE);
+					effects.merke_passagier_ziel(city, first_destination.location, COL_DARK_ORANGE);
 				}
 			}
 #ifdef MULTI_THREAD
@@ -7399,20 +7664,16 @@ no_route:
 				{
 					if (trip == mail_trip)
 					{
-						start_halt->add_mail_no_route(units_this_step);
+						effects.add_mail_no_route(start_halt, units_this_step);
 					}
 					else
 					{
-						start_halt->add_pax_no_route(units_this_step);
+						effects.add_pax_no_route(start_halt, units_this_step);
 					}
 				}
 			}
 		};
 
-#ifdef MULTI_THREAD
-		mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-		assert(mutex_error == 0);
-#endif
 #ifdef FORBID_RETURN_TRIPS
 		if(false)
 #else
@@ -7431,29 +7692,13 @@ no_route:
 			if(destination_town)
 			{
 #ifndef FORBID_SET_GENERATED_PASSENGERS
-#ifdef MULTI_THREAD
-				mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-				assert(mutex_error == 0);
-#endif
-				destination_town->set_generated_passengers(units_this_step, history_type + 1);
-#ifdef MULTI_THREAD
-				mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-				assert(mutex_error == 0);
-#endif
+				effects.set_generated_passengers(destination_town, units_this_step, history_type + 1);
 #endif
 			}
 			else if(city)
 			{
 #ifndef FORBID_SET_GENERATED_PASSENGERS
-#ifdef MULTI_THREAD
-				mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-				assert(mutex_error == 0);
-#endif
-				city->set_generated_passengers(units_this_step, history_type + 1);
-#ifdef MULTI_THREAD
-				mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-				assert(mutex_error == 0);
-#endif
+				effects.set_generated_passengers(city, units_this_step, history_type + 1);
 #endif
 				// Cannot add success figures for buildings here as cannot get a building from a koord.
 				// However, this should not matter much, as equally not recording generated passengers
@@ -7557,25 +7802,17 @@ no_route:
 						if (!return_halt_is_overcrowded)
 						{
 #ifndef FORBID_STARTE_MIT_ROUTE_FOR_RETURNING_PASSENGERS
-							ret_halt->starte_mit_route(return_passengers, pax.get_zielpos());
+							effects.starte_mit_route(ret_halt, return_passengers, pax.get_zielpos());
 #endif
 							if (current_destination.type == factory && (trip == commuting_trip || trip == mail_trip))
 							{
 								// This is somewhat anomalous, as we are recording that the passengers have departed, not arrived, whereas for cities, we record
 								// that they have successfully arrived. However, this is not easy to implement for factories, as passengers do not store their ultimate
 								// origin, so the origin factory is not known by the time that the passengers reach the end of their journey.
-#ifdef MULTI_THREAD
-								mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-								assert(mutex_error == 0);
-#endif
 								if (trip == mail_trip)
 								{
-									current_destination.building->get_fabrik()->book_stat(units_this_step, FAB_MAIL_DEPARTED);
+									effects.book_stat(current_destination.building->get_fabrik(), units_this_step, FAB_MAIL_DEPARTED);
 								}
-#ifdef MULTI_THREAD
-								mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-								assert(mutex_error == 0);
-#endif
 							}
 						}
 						else
@@ -7587,15 +7824,7 @@ no_route:
 							}
 							else
 							{
-#ifdef MULTI_THREAD
-								mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-								assert(mutex_error == 0);
-#endif
-								ret_halt->add_pax_unhappy(units_this_step);
-#ifdef MULTI_THREAD
-								mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-								assert(mutex_error == 0);
-#endif
+								effects.add_pax_unhappy(ret_halt, units_this_step);
 							}
 						}
 					}
@@ -7610,25 +7839,13 @@ no_route:
 					}
 					else
 					{
-#ifdef MULTI_THREAD
-						mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-						assert(mutex_error == 0);
-#endif
-						ret_halt->add_pax_no_route(units_this_step);
-#ifdef MULTI_THREAD
-						mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-						assert(mutex_error == 0);
-#endif
+						effects.add_pax_no_route(ret_halt, units_this_step);
 					}
 				}
 			}
 
 			if(return_in_private_car)
 			{
-#ifdef MULTI_THREAD
-				mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-				assert(mutex_error == 0);
-#endif
 				if(car_minutes < UINT32_MAX_VALUE)
 				{
 					// Do not check tolerance, as they must come back!
@@ -7636,12 +7853,12 @@ no_route:
 					{
 						if(destination_town)
 						{
-							destination_town->set_private_car_trip(units_this_step, city);
+							effects.set_private_car_trip(destination_town, units_this_step, city);
 						}
 						else
 						{
 							// Industry, attraction or local
-							city->set_private_car_trip(units_this_step, NULL);
+							effects.set_private_car_trip(city, units_this_step, NULL);
 						}
 					}
 					else
@@ -7649,11 +7866,11 @@ no_route:
 						// Mail
 						if(destination_town)
 						{
-							destination_town->add_transported_mail(units_this_step);
+							effects.add_transported_mail(destination_town, units_this_step);
 						}
 						else if(city)
 						{
-							city->add_transported_mail(units_this_step);
+							effects.add_transported_mail(city, units_this_step);
 						}
 					}
 					const grund_t* gr_origin = lookup(origin_pos);
@@ -7670,32 +7887,24 @@ no_route:
 					city->generate_private_cars(current_destination.location, car_minutes, adjusted_return_pos, units_this_step);
 					if(current_destination.type == factory && trip == mail_trip)
 					{
-						current_destination.building->get_fabrik()->book_stat(units_this_step, FAB_MAIL_DEPARTED);
+						effects.book_stat(current_destination.building->get_fabrik(), units_this_step, FAB_MAIL_DEPARTED);
 					}
 				}
 				else
 				{
 					if(ret_halt.is_bound())
 					{
-						ret_halt->add_pax_no_route(units_this_step);
+						effects.add_pax_no_route(ret_halt, units_this_step);
 					}
 					if(city)
 					{
-						city->merke_passagier_ziel(origin_pos.get_2d(), COL_DARK_ORANGE);
+						effects.merke_passagier_ziel(city, origin_pos.get_2d(), COL_DARK_ORANGE);
 					}
 				}
-#ifdef MULTI_THREAD
-				mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-				assert(mutex_error == 0);
-#endif
 			}
 return_on_foot:
 			if(return_on_foot)
 			{
-#ifdef MULTI_THREAD
-				mutex_error = pthread_mutex_lock(&karte_t::step_passengers_and_mail_mutex);
-				assert(mutex_error == 0);
-#endif
 				if(wtyp == goods_manager_t::passengers)
 				{
 					if (settings.get_random_pedestrians())
@@ -7708,13 +7917,13 @@ return_on_foot:
 					}
 					if(destination_town)
 					{
-						destination_town->add_walking_passengers(units_this_step);
+						effects.add_walking_passengers(destination_town, units_this_step);
 					}
 					else if(city)
 					{
 						// Local, attraction or industry.
-						city->merke_passagier_ziel(origin_pos.get_2d(), COL_DARK_YELLOW);
-						city->add_walking_passengers(units_this_step);
+						effects.merke_passagier_ziel(city, origin_pos.get_2d(), COL_DARK_YELLOW);
+						effects.add_walking_passengers(city, units_this_step);
 					}
 				}
 				else
@@ -7722,21 +7931,17 @@ return_on_foot:
 					// Mail
 					if(destination_town)
 					{
-						destination_town->add_transported_mail(units_this_step);
+						effects.add_transported_mail(destination_town, units_this_step);
 					}
 					else if(city)
 					{
-						city->add_transported_mail(units_this_step);
+						effects.add_transported_mail(city, units_this_step);
 					}
 				}
 				if(current_destination.type == factory && trip == mail_trip)
 				{
-					current_destination.building->get_fabrik()->book_stat(units_this_step, FAB_MAIL_DEPARTED);
+					effects.book_stat(current_destination.building->get_fabrik(), units_this_step, FAB_MAIL_DEPARTED);
 				}
-#ifdef MULTI_THREAD
-				mutex_error = pthread_mutex_unlock(&karte_t::step_passengers_and_mail_mutex);
-				assert(mutex_error == 0);
-#endif
 			}
 
 		} // Set return trip
@@ -8293,7 +8498,7 @@ bool karte_t::play_sound_area_clipped(koord const k, uint16 const idx, waytype_t
 }
 
 
-void karte_t::save(const char *filename, loadsave_t::mode_t savemode, const char *version_str, const char *ex_version_str, const char* ex_revision_str, bool silent )
+void karte_t::save(const char *filename, loadsave_t::mode_t savemode, const char *version_str, const char *ex_version_str, const char* ex_revision_str, bool silent, bool fast )
 {
 DBG_MESSAGE("karte_t::save()", "saving game to '%s'", filename);
 	loadsave_t  file;
@@ -8304,8 +8509,10 @@ DBG_MESSAGE("karte_t::save()", "saving game to '%s'", filename);
 	if(env_t::networkmode && !env_t::server && savemode == loadsave_t::bzip2)
 	{
 		// Make local saving/loading faster in network mode.
-		savemode = loadsave_t::zipped;
+		savemode = loadsave_t::is_mode_supported(loadsave_t::zstd) ? loadsave_t::zstd : loadsave_t::zipped;
 	}
+	// the saves of network clients are only used locally, so they must be fast rather than small
+	file.set_zstd_level(fast  ||  (env_t::networkmode  &&  !env_t::server) ? loadsave_t::autosave_zstd_level : loadsave_t::save_zstd_level);
 	if(!file.wr_open( savename.c_str(), savemode, env_t::objfilename.c_str(), version_str, ex_version_str, ex_revision_str )) {
 		create_win(new news_img("Kann Spielstand\nnicht speichern.\n"), w_info, magic_none);
 		dbg->error("karte_t::save()","cannot open file for writing! check permissions!");
@@ -8367,6 +8574,9 @@ DBG_MESSAGE("karte_t::save(loadsave_t *file)", "start");
 		dbg->error( "karte_t::save()","Some buildings may be broken by saving!" );
 	}
 
+	// clients build the junction graph when loading: it must be complete here as well
+	way_graph_t::update(this);
+
 	/* If the current tool is a two_click_tool, call cleanup() in order to delete dummy grounds (tunnel + monorail preview)
 	 * THIS MUST NOT BE DONE IN NETWORK MODE!
 	 */
@@ -8434,7 +8644,7 @@ DBG_MESSAGE("karte_t::save(loadsave_t *file)", "saved cities ok");
 
 	for(int j=0; j<get_size().y; j++) {
 		for(int i=0; i<get_size().x; i++) {
-			plan[i+j*cached_grid_size.x].rdwr(file, koord(i,j) );
+			plan[get_plan_index(i, j)].rdwr(file, koord(i,j) );
 		}
 		if(silent) {
 			INT_CHECK("saving");
@@ -8788,6 +8998,10 @@ bool karte_t::load(const char *filename)
 	display_show_load_pointer(true);
 	loadsave_t file;
 	cities_awaiting_private_car_route_check.clear();
+	cities_awaiting_private_car_route_commit.clear();
+	cities_with_edited_roads.clear();
+	private_car_route_checks_in_progress = 0;
+	private_car_route_cycle_start_time = 0;
 	time_interval_signals_to_check.clear();
 
 	// clear hash table with missing paks (may cause some small memory loss though)
@@ -8798,6 +9012,9 @@ bool karte_t::load(const char *filename)
 	// reloading same game? Remember pos
 	const koord oldpos = settings.get_filename()[0]>0  &&  strncmp(filename,settings.get_filename(),strlen(settings.get_filename()))==0 ? viewport->get_world_position() : koord::invalid;
 
+	// the game sent by the server when joining, loaded while it arrives
+	network_game_source_t *game = NULL;
+
 	if(  strstart(filename, "net:")  ) {
 		// probably finish network mode?
 		if(  env_t::networkmode  ) {
@@ -8818,6 +9035,7 @@ bool karte_t::load(const char *filename)
 			if(  !restore_player_nr  ) {
 				last_network_game = filename;
 			}
+			game = network_open_game( name );
 		}
 	}
 	else {
@@ -8853,7 +9071,19 @@ bool karte_t::load(const char *filename)
 		name.append(filename);
 	}
 
-	if(!file.rd_open(name)) {
+	bool opened;
+	if(  game  ) {
+		opened = file.rd_open( game );
+		if(  !opened  ) {
+			// not a format which can be read while it arrives, so receive it completely first
+			opened = game->finish()==NULL  &&  file.rd_open( name );
+		}
+	}
+	else {
+		opened = file.rd_open( name );
+	}
+
+	if(!opened) {
 
 		if(  (sint32)file.get_version()==-1  ||  file.get_version()>loadsave_t::int_version(SAVEGAME_VER_NR, NULL, NULL).version  ) {
 			dbg->warning("karte_t::load()", translator::translate("WRONGSAVE") );
@@ -8987,6 +9217,12 @@ DBG_MESSAGE("karte_t::load()","Savegame version is %d", file.get_version());
 		set_tool( tool_t::general_tool[TOOL_QUERY], get_active_player() );
 	}
 
+	if(  game  ) {
+		if(  const char *err = network_finish_connect( this, game )  ) {
+			create_win( new news_img(err), w_info, magic_none );
+		}
+	}
+
 	settings.set_filename(filename);
 	display_show_load_pointer(false);
 
@@ -9065,6 +9301,31 @@ void karte_t::clear_checklist_history()
 	for(  int i=0;  i<LAST_CHECKLISTS_COUNT;  ++i  ) {
 		last_checklists[i] = checklist_t();
 	}
+	world_hashes[0] = world_hash_t();
+	world_hashes[1] = world_hash_t();
+}
+
+void karte_t::report_world_hash_mismatch(const uint32 sync_step, const checklist_t &other, const char *entity) const
+{
+	const checklist_t &own = LCHKLST(sync_step);
+	for(  uint8 i = 0;  i < CHK_WORLD_HASHES;  i++  ) {
+		if(  own.world_hash[i] != 0  &&  other.world_hash[i] != 0  &&  own.world_hash[i] != other.world_hash[i]  ) {
+			dbg->warning("karte_t::report_world_hash_mismatch", "sync_step=%u: world hash of %s differs", sync_step, world_hash_t::get_part_name(i));
+		}
+	}
+
+	for(  int i = 0;  i < 2;  i++  ) {
+		if(  world_hashes[i].get_sync_step() == sync_step  &&  sync_step != 0  ) {
+			char filename[64];
+			sprintf(filename, "desync-%s-%u.txt", entity, sync_step);
+			if(  world_hashes[i].dump(filename)  ) {
+				dbg->warning("karte_t::report_world_hash_mismatch", "world hash written to %s", filename);
+			}
+			else {
+				dbg->warning("karte_t::report_world_hash_mismatch", "could not write %s", filename);
+			}
+		}
+	}
 }
 
 void karte_t::clear_checklist_rands()
@@ -9382,7 +9643,7 @@ DBG_MESSAGE("karte_t::load()", "init player");
 	DBG_MESSAGE("karte_t::load()","loading tiles");
 	for (int y = 0; y < get_size().y; y++) {
 		for (int x = 0; x < get_size().x; x++) {
-			plan[x+y*cached_grid_size.x].rdwr(file, koord(x,y) );
+			plan[get_plan_index(x, y)].rdwr(file, koord(x,y) );
 		}
 		if(file->is_eof()) {
 			dbg->fatal("karte_t::load()","Savegame file mangled (too short)!");
@@ -9541,6 +9802,9 @@ DBG_MESSAGE("karte_t::load()", "init player");
 	}
 DBG_MESSAGE("karte_t::load()", "%d convois/trains loaded", convoi_array.get_count());
 
+	// the tiles only know the number of their reserving convoy until now
+	schiene_t::index_loaded_reservations();
+
 	// now the player can be loaded
 	for(int i=0; i<MAX_PLAYER_COUNT; i++) {
 		if(  players[i]  ) {
@@ -9980,6 +10244,9 @@ DBG_MESSAGE("karte_t::load()", "%d factories loaded", fab_list.get_count());
 
 	calc_max_vehicle_speeds();
 
+	// the server saved a complete graph, so build it before any convoy searches
+	way_graph_t::update(this);
+
 	dbg->warning("karte_t::load()","loaded savegame from %i/%i, next month=%i, ticks=%i (per month=1<<%i)",last_month,last_year,next_month_ticks,ticks,karte_t::ticks_per_world_month_shift);
 }
 
@@ -9993,7 +10260,7 @@ void karte_t::update_map_intern(sint16 x_min, sint16 x_max, sint16 y_min, sint16
 			for(  int yy = y_min;  yy < y_max;  yy += LOOP_BLOCK  ) {
 				for(  int y = yy;  y < min(yy + LOOP_BLOCK, y_max);  y++  ) {
 					for(  int x = xx;  x < min(xx + LOOP_BLOCK, x_max);  x++  ) {
-						const int nr = y * cached_grid_size.x + x;
+						const uint32 nr = get_plan_index(x, y);
 						for(  uint i = 0;  i < plan[nr].get_boden_count();  i++  ) {
 							plan[nr].get_boden_bei(i)->calc_image();
 						}
@@ -10005,7 +10272,7 @@ void karte_t::update_map_intern(sint16 x_min, sint16 x_max, sint16 y_min, sint16
 	else {
 		for(  int y = y_min;  y < y_max;  y++  ) {
 			for(  int x = x_min;  x < x_max;  x++  ) {
-				const int nr = y * cached_grid_size.x + x;
+				const uint32 nr = get_plan_index(x, y);
 				for(  uint i = 0;  i < plan[nr].get_boden_count();  i++  ) {
 					plan[nr].get_boden_bei(i)->calc_image();
 				}
@@ -10074,7 +10341,7 @@ void karte_t::prepare_tiles(rect_t const &new_area, rect_t const &old_area) {
 
 		for (sint16 y = y_start ; y < y_end ; y++) {
 			for (sint16 x = x_start ; x < x_end ; x++) {
-				const planquadrat_t &tile = plan[y * cached_grid_size.x + x];
+				const planquadrat_t &tile = plan[get_plan_index(x, y)];
 				tile.update_underground();
 			}
 		}
@@ -10738,9 +11005,9 @@ void karte_t::process_network_commands(sint32 *ms_difference)
 	while(  nwc  ) {
 		// check timing
 		uint16 const nwcid = nwc->get_id();
-		if(  nwcid == NWC_CHECK  ||  nwcid == NWC_STEP  ) {
+		if(  nwcid == NWC_CHECK  ||  nwcid == NWC_STEP  ||  nwcid == NWC_FRAME  ) {
 			// pull out server sync step
-			const uint32 server_sync_step = nwcid == NWC_CHECK ? dynamic_cast<nwc_check_t *>(nwc)->server_sync_step : dynamic_cast<nwc_step_t *>(nwc)->get_sync_step();
+			const uint32 server_sync_step = nwcid == NWC_CHECK ? dynamic_cast<nwc_check_t *>(nwc)->server_sync_step : dynamic_cast<network_world_command_t *>(nwc)->get_sync_step();
 
 			// are we on time?
 			*ms_difference = 0;
@@ -10799,6 +11066,7 @@ void karte_t::process_network_commands(sint32 *ms_difference)
 					const int offset = LCHKLST(nwt->last_sync_step).print(buf, "server");
 					nwt->last_checklist.print(buf + offset, "initiator");
 					dbg->warning("karte_t::process_network_commands", "kicking client due to checklist mismatch : sync_step=%u %s", nwt->last_sync_step, buf);
+					report_world_hash_mismatch(nwt->last_sync_step, nwt->last_checklist, "server");
 					socket_list_t::remove_client( nwc->get_sender() );
 					delete nwc;
 					nwc = NULL;
@@ -10871,6 +11139,7 @@ void karte_t::do_network_world_command(network_world_command_t *nwc)
 		if(client_checklist != server_checklist)
 		{
 			dbg->warning("karte_t:::do_network_world_command", "disconnecting due to checklist mismatch:\n%s", buf );
+			report_world_hash_mismatch(server_sync_step, server_checklist, "client");
 			network_disconnect();
 		} else {
 			dbg->message("karte_t:::do_network_world_command", "sync_step=%u  %s", server_sync_step, buf);
@@ -10889,6 +11158,7 @@ void karte_t::do_network_world_command(network_world_command_t *nwc)
 				(void)offset2;
 
 				dbg->warning("karte_t:::do_network_world_command", "skipping command due to checklist mismatch : sync_step=%u %s", nwt->last_sync_step, buf);
+				report_world_hash_mismatch(nwt->last_sync_step, nwt->last_checklist, env_t::server ? "server" : "client");
 				if(  !env_t::server  ) {
 					network_disconnect();
 				}
@@ -11064,6 +11334,15 @@ bool karte_t::interactive(uint32 quit_month)
 					LCHKLST(sync_steps) = checklist_t(sync_steps, (uint32)steps, network_frame_count, get_random_seed(), halthandle_t::get_next_check(), linehandle_t::get_next_check(), convoihandle_t::get_next_check(),
 						rands, debug_sums
 					);
+					if(  env_t::networkmode  &&  env_t::world_hash_sync_steps > 0  &&  (sync_steps % env_t::world_hash_sync_steps) == 0  ) {
+						// the convoy threads started at the end of step() still write the convoys
+						await_convoy_threads();
+						world_hash_t &world_hash = world_hashes[(sync_steps / env_t::world_hash_sync_steps) & 1];
+						world_hash.calc(this, sync_steps);
+						for(  uint8 i = 0;  i < CHK_WORLD_HASHES;  i++  ) {
+							LCHKLST(sync_steps).world_hash[i] = world_hash.get_part_hash(i);
+						}
+					}
 
 #ifdef DEBUG_SIMRAND_CALLS
 					char buf[2048];
@@ -11082,13 +11361,14 @@ bool karte_t::interactive(uint32 quit_month)
 								dbg->warning("karte_t::interactive", "server lagging by %lli", timelag );
 							}
 
+							// the commands of this step go first
+							nwc_frame_t::flush(sync_steps, map_counter, false);
 							nwc_check_t* nwc = new nwc_check_t(sync_steps + 1, map_counter, LCHKLST(sync_steps), sync_steps);
 							network_send_all(nwc, true);
 						}
 						else {
-							// broadcast sync_step
-							nwc_step_t* nwcstep = new nwc_step_t(sync_steps, map_counter);
-							network_send_all(nwcstep, true);
+							// broadcast the commands of this step with sync_step, or only sync_step
+							nwc_frame_t::flush(sync_steps, map_counter, true);
 						}
 					}
 #if DEBUG>4
@@ -11521,13 +11801,13 @@ void karte_t::remove_building_from_world_list(gebaeude_t *gb)
 	}
 
 	// We do not need to specify the type here, as we can try removing from all lists.
-	passenger_origins.remove_all(gb);
+	passenger_origins.remove(gb);
 	for (uint8 i = 0; i < goods_manager_t::passengers->get_number_of_classes(); i++)
 	{
-		commuter_targets[i].remove_all(gb);
-		visitor_targets[i].remove_all(gb);
+		commuter_targets[i].remove(gb);
+		visitor_targets[i].remove(gb);
 	}
-	mail_origins_and_targets.remove_all(gb);
+	mail_origins_and_targets.remove(gb);
 
 	passenger_step_interval = calc_adjusted_step_interval(passenger_origins.get_sum_weight(), get_settings().get_passenger_trips_per_month_hundredths());
 	mail_step_interval = calc_adjusted_step_interval(mail_origins_and_targets.get_sum_weight(), get_settings().get_mail_packets_per_month_hundredths());
@@ -11547,7 +11827,7 @@ void karte_t::update_weight_of_building_in_world_list(gebaeude_t *gb)
 
 	if(passenger_origins.is_contained(gb))
 	{
-		passenger_origins.update_at(passenger_origins.index_of(gb), gb->get_adjusted_population());
+		passenger_origins.update(gb, gb->get_adjusted_population());
 		passenger_step_interval = calc_adjusted_step_interval(passenger_origins.get_sum_weight(), get_settings().get_passenger_trips_per_month_hundredths());
 	}
 
@@ -11555,24 +11835,24 @@ void karte_t::update_weight_of_building_in_world_list(gebaeude_t *gb)
 	{
 		if (commuter_targets[i].is_contained(gb))
 		{
-			commuter_targets[i].update_at(commuter_targets[i].index_of(gb), (gb->get_tile()->get_desc()->get_class_proportions_sum_jobs() > 0 ? (gb->get_adjusted_jobs() * gb->get_tile()->get_desc()->get_class_proportion_jobs(i)) / gb->get_tile()->get_desc()->get_class_proportions_sum_jobs() : gb->get_adjusted_jobs()));
+			commuter_targets[i].update(gb, (gb->get_tile()->get_desc()->get_class_proportions_sum_jobs() > 0 ? (gb->get_adjusted_jobs() * gb->get_tile()->get_desc()->get_class_proportion_jobs(i)) / gb->get_tile()->get_desc()->get_class_proportions_sum_jobs() : gb->get_adjusted_jobs()));
 		}
 
 		if (visitor_targets[i].is_contained(gb))
 		{
-			visitor_targets[i].update_at(visitor_targets[i].index_of(gb), (gb->get_tile()->get_desc()->get_class_proportions_sum() > 0 ? (gb->get_adjusted_visitor_demand() * gb->get_tile()->get_desc()->get_class_proportion(i)) / gb->get_tile()->get_desc()->get_class_proportions_sum() : gb->get_adjusted_visitor_demand()));
+			visitor_targets[i].update(gb, (gb->get_tile()->get_desc()->get_class_proportions_sum() > 0 ? (gb->get_adjusted_visitor_demand() * gb->get_tile()->get_desc()->get_class_proportion(i)) / gb->get_tile()->get_desc()->get_class_proportions_sum() : gb->get_adjusted_visitor_demand()));
 		}
 	}
 	if(mail_origins_and_targets.is_contained(gb))
 	{
-		mail_origins_and_targets.update_at(mail_origins_and_targets.index_of(gb), gb->get_adjusted_mail_demand());
+		mail_origins_and_targets.update(gb, gb->get_adjusted_mail_demand());
 		mail_step_interval = calc_adjusted_step_interval(mail_origins_and_targets.get_sum_weight(), get_settings().get_mail_packets_per_month_hundredths());
 	}
 }
 
 void karte_t::remove_all_building_references_to_city(stadt_t* city)
 {
-	FOR(weighted_vector_tpl <gebaeude_t *>, building, passenger_origins)
+	FOR(fenwick_weighted_vector_tpl<gebaeude_t*>, building, passenger_origins)
 	{
 		if(building->get_stadt() == city)
 		{
@@ -11580,7 +11860,7 @@ void karte_t::remove_all_building_references_to_city(stadt_t* city)
 		}
 	}
 
-	FOR(weighted_vector_tpl <gebaeude_t *>, building, mail_origins_and_targets)
+	FOR(fenwick_weighted_vector_tpl<gebaeude_t*>, building, mail_origins_and_targets)
 	{
 		if(building->get_stadt() == city)
 		{
@@ -11590,7 +11870,7 @@ void karte_t::remove_all_building_references_to_city(stadt_t* city)
 
 	for (uint8 i = 0; i < goods_manager_t::passengers->get_number_of_classes(); i++)
 	{
-		FOR(weighted_vector_tpl <gebaeude_t *>, building, commuter_targets[i])
+		FOR(fenwick_weighted_vector_tpl<gebaeude_t*>, building, commuter_targets[i])
 		{
 			if (building->get_stadt() == city)
 			{
@@ -11598,7 +11878,7 @@ void karte_t::remove_all_building_references_to_city(stadt_t* city)
 			}
 		}
 
-		FOR(weighted_vector_tpl <gebaeude_t *>, building, visitor_targets[i])
+		FOR(fenwick_weighted_vector_tpl<gebaeude_t*>, building, visitor_targets[i])
 		{
 			if (building->get_stadt() == city)
 			{
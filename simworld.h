@@ -15,6 +15,7 @@
 #include "halthandle_t.h"
 
 #include "tpl/weighted_vector_tpl.h"
+#include "tpl/fenwick_weighted_vector_tpl.h"
 #include "tpl/vector_tpl.h"
 #include "tpl/slist_tpl.h"
 #include "tpl/koordhashtable_tpl.h"
@@ -23,6 +24,7 @@
 #include "network/pwd_hash.h"
 #include "dataobj/loadsave.h"
 #include "dataobj/rect.h"
+#include "dataobj/world_hash.h"
 
 #include "simware.h"
 
@@ -41,6 +43,7 @@
 #endif
 
 struct sound_info;
+class karte_t;
 class stadt_t;
 class fabrik_t;
 class gebaeude_t;
@@ -62,6 +65,11 @@ class viewport_t;
 
 #define CHK_RANDS 32
 #define CHK_DEBUG_SUMS 8
+#define CHK_WORLD_HASHES (world_hash_t::MAX_PARTS)
+
+// the map tiles are stored in chunks of (1<<PLAN_CHUNK_SHIFT)^2 tiles
+#define PLAN_CHUNK_SHIFT (6)
+#define PLAN_CHUNK_SIZE (1<<PLAN_CHUNK_SHIFT)
 
 #ifdef MULTI_THREAD
 //#define FORBID_MULTI_THREAD_PASSENGER_GENERATION_IN_NETWORK_MODE
@@ -73,9 +81,6 @@ class viewport_t;
 #ifndef FORBID_MULTI_THREAD_PATH_EXPLORER
 #define MULTI_THREAD_PATH_EXPLORER
 #endif
-#ifndef FORBID_MULTI_THREAD_ROUTE_UNRESERVER
-#define MULTI_THREAD_ROUTE_UNRESERVER
-#endif
 #endif
 
 #ifndef FORBID_MULTI_THREAD_PASSENGER_GENERATION_IN_NETWORK_MODE
@@ -108,6 +113,8 @@ struct checklist_t
 
 	uint32 rand[CHK_RANDS];
 	uint32 debug_sum[CHK_DEBUG_SUMS];
+	/// world_hash_t part hashes, 0 if not calculated at this sync step
+	uint32 world_hash[CHK_WORLD_HASHES];
 
 
 	checklist_t(uint32 _ss, uint32 _st, uint8 _nfc, uint32 _random_seed, uint16 _halt_entry, uint16 _line_entry, uint16 _convoy_entry, uint32 *_rands, uint32 *_debug_sums);
@@ -119,6 +126,9 @@ struct checklist_t
 		for(  uint8 i = 0;  i < CHK_DEBUG_SUMS;  i++  ) {
 			debug_sum[i] = 0;
 		}
+		for(  uint8 i = 0;  i < CHK_WORLD_HASHES;  i++  ) {
+			world_hash[i] = 0;
+		}
 	}
 
 	bool operator == (const checklist_t &other) const
@@ -133,8 +143,14 @@ struct checklist_t
 			// debugs_equal = debugs_equal  &&  (debug_sum[i] == 0  ||  other.debug_sum[i] == 0  ||  debug_sum[i] == other.debug_sum[i]);
 			debugs_equal = debugs_equal  &&  debug_sum[i] == other.debug_sum[i];
 		}
+		// world hashes are optional, so only compare them if both sides calculated them
+		bool hashes_equal = true;
+		for(  uint8 i = 0;  i < CHK_WORLD_HASHES  &&  hashes_equal;  i++  ) {
+			hashes_equal = world_hash[i] == 0  ||  other.world_hash[i] == 0  ||  world_hash[i] == other.world_hash[i];
+		}
 		return ( rands_equal &&
 			debugs_equal &&
+			hashes_equal &&
 			ss == other.ss &&
 			st == other.st &&
 			nfc == other.nfc &&
@@ -179,6 +195,82 @@ public:
 	}
 };
 
+/**
+ * Effects of passenger and mail generation on state which is shared
+ * between the generation threads: statistics of cities, buildings,
+ * factories and halts, and packets starting their journey at a halt.
+ *
+ * Each generation thread records these in its own log rather than changing
+ * the state under a mutex, so no thread sees what the others have done in
+ * the same step. The logs are applied in the order of the threads once all
+ * have finished, which makes the result independent of thread timing.
+ */
+class passenger_generation_log_t
+{
+	enum effect_type {
+		city_generated, city_destination, city_private_car_trip, city_transported_mail, city_walking,
+		building_generated_commuting, building_generated_visiting, building_mail_generated,
+		building_succeeded_commuting, building_succeeded_visiting, building_mail_succeeded,
+		halt_unhappy, halt_too_slow, halt_no_route, halt_mail_no_route, halt_start_route,
+		factory_stat, debug_sum
+	};
+
+	struct effect_t
+	{
+		union {
+			stadt_t *city;
+			gebaeude_t *building;
+			fabrik_t *fab;
+		};
+		stadt_t *destination_town;
+		halthandle_t halt;
+		koord pos;
+		uint32 amount;  ///< for halt_start_route the index into wares
+		uint8 type;
+		uint8 arg;      ///< history type, colour, statistic or debug sum
+	};
+
+	vector_tpl<effect_t> effects;
+	vector_tpl<ware_t> wares;
+
+	effect_t &append(effect_type type, uint32 amount)
+	{
+		effects.append(effect_t());
+		effect_t &e = effects.back();
+		e.type = type;
+		e.amount = amount;
+		return e;
+	}
+
+public:
+	void set_generated_passengers(stadt_t *city, uint32 number, int type) { effect_t &e = append(city_generated, number); e.city = city; e.arg = (uint8)type; }
+	void merke_passagier_ziel(stadt_t *city, koord ziel, uint8 color) { effect_t &e = append(city_destination, 0); e.city = city; e.pos = ziel; e.arg = color; }
+	void set_private_car_trip(stadt_t *city, uint32 passengers, stadt_t *destination_town) { effect_t &e = append(city_private_car_trip, passengers); e.city = city; e.destination_town = destination_town; }
+	void add_transported_mail(stadt_t *city, uint32 mail) { append(city_transported_mail, mail).city = city; }
+	void add_walking_passengers(stadt_t *city, uint32 passengers) { append(city_walking, passengers).city = city; }
+
+	void add_passengers_generated_commuting(gebaeude_t *gb, uint32 number) { append(building_generated_commuting, number).building = gb; }
+	void add_passengers_generated_visiting(gebaeude_t *gb, uint32 number) { append(building_generated_visiting, number).building = gb; }
+	void add_mail_generated(gebaeude_t *gb, uint32 number) { append(building_mail_generated, number).building = gb; }
+	void add_passengers_succeeded_commuting(gebaeude_t *gb, uint32 number) { append(building_succeeded_commuting, number).building = gb; }
+	void add_passengers_succeeded_visiting(gebaeude_t *gb, uint32 number) { append(building_succeeded_visiting, number).building = gb; }
+	void add_mail_delivery_succeeded(gebaeude_t *gb, uint32 number) { append(building_mail_succeeded, number).building = gb; }
+
+	void add_pax_unhappy(halthandle_t halt, uint32 n) { append(halt_unhappy, n).halt = halt; }
+	void add_pax_too_slow(halthandle_t halt, uint32 n) { append(halt_too_slow, n).halt = halt; }
+	void add_pax_no_route(halthandle_t halt, uint32 n) { append(halt_no_route, n).halt = halt; }
+	void add_mail_no_route(halthandle_t halt, uint32 n) { append(halt_mail_no_route, n).halt = halt; }
+	void starte_mit_route(halthandle_t halt, const ware_t &ware, koord origin_pos) { effect_t &e = append(halt_start_route, wares.get_count()); e.halt = halt; e.pos = origin_pos; wares.append(ware); }
+
+	void book_stat(fabrik_t *fab, uint32 value, int stat_type) { effect_t &e = append(factory_stat, value); e.fab = fab; e.arg = (uint8)stat_type; }
+	void add_to_debug_sums(uint8 num, uint32 val) { append(debug_sum, val).arg = num; }
+
+	bool empty() const { return effects.empty(); }
+
+	/// Applies all effects in the order in which they were recorded and clears the log.
+	void apply(karte_t *welt);
+};
+
 /**
  * Threaded function caller.
  */
@@ -523,10 +615,17 @@ private:
 
 	/**
 	 * Array containing all the map tiles.
-	 * @see cached_size
+	 * The tiles are stored in square chunks of PLAN_CHUNK_SIZE tiles, so
+	 * neighbouring tiles in both directions share the same memory pages.
+	 * @see get_plan_index
 	 */
 	planquadrat_t *plan;
 
+	/**
+	 * Number of chunks of the tile array in x direction.
+	 */
+	uint32 plan_chunks_x;
+
 	/**
 	 * Array representing the height of each point of the grid.
 	 * @see cached_grid_size
@@ -625,6 +724,9 @@ private:
 	uint32 rands[CHK_RANDS];
 	uint32 debug_sums[CHK_DEBUG_SUMS];
 
+	/// the last two world hashes, kept for report_world_hash_mismatch()
+	world_hash_t world_hashes[2];
+
 
 	/// @note variable used in interactive()
 	uint8  network_frame_count;
@@ -836,6 +938,23 @@ private:
 
 	slist_tpl<stadt_t*> cities_awaiting_private_car_route_check;
 
+	// Cities near roads which players built or removed since the last step. These are moved
+	// to the front of cities_awaiting_private_car_route_check while the private car threads are idle.
+	vector_tpl<stadt_t*> cities_with_edited_roads;
+
+	// Cities whose private car route search has finished, but whose results
+	// have yet to be committed by commit_private_car_routes().
+	vector_tpl<stadt_t*> cities_awaiting_private_car_route_commit;
+	uint32 private_car_route_checks_in_progress;
+	uint32 private_car_route_sequence;
+
+	// Start (in real time ms) and progress of the current private car route refresh cycle, for the log.
+	uint32 private_car_route_cycle_start_time;
+	uint32 private_car_route_cities_refreshed;
+
+	/// Commits the finished private car route searches in the order in which they were started.
+	void commit_private_car_routes();
+
 	/**
 	 * The last time when a server announce was performed (in ms).
 	 */
@@ -861,7 +980,7 @@ private:
 	 * journeys ultimately start, weighted by their level.
 	 * @author: jamespetts
 	 */
-	weighted_vector_tpl <gebaeude_t *> passenger_origins;
+	fenwick_weighted_vector_tpl <gebaeude_t *> passenger_origins;
 
 	/**
 	 * This contains all buildings in the world to which passengers make
@@ -869,7 +988,7 @@ private:
 	 * This is an array indexed by class.
 	 * @author: jamespetts
 	 */
-	weighted_vector_tpl <gebaeude_t *> *commuter_targets;
+	fenwick_weighted_vector_tpl <gebaeude_t *> *commuter_targets;
 
 	/**
 	 * This contains all buildings in the world to which passengers make
@@ -877,7 +996,7 @@ private:
 	 * This is an array indexed by class.
 	 * @author: jamespetts
 	 */
-	weighted_vector_tpl <gebaeude_t *> *visitor_targets;
+	fenwick_weighted_vector_tpl <gebaeude_t *> *visitor_targets;
 
 	/**
 	 * This contains all buildings in the world to and from which mail
@@ -885,7 +1004,7 @@ private:
 	 * level.
 	 * @author: jamespetts
 	 */
-	weighted_vector_tpl <gebaeude_t *> mail_origins_and_targets;
+	fenwick_weighted_vector_tpl <gebaeude_t *> mail_origins_and_targets;
 
 	/** Stores the value of the next step for passenger/mail generation
 	 * purposes.
@@ -896,6 +1015,10 @@ private:
 	sint32 passenger_step_interval;
 	sint32 mail_step_interval;
 
+	/// The generation threads draw their random numbers from substreams of this,
+	/// which the main thread chooses anew in every step.
+	uint32 passenger_generation_seed;
+
 	// Signals in the time interval working method that need
 	// to be checked periodically to see whether they need
 	// to change to a less restrictive aspect.
@@ -934,9 +1057,7 @@ private:
 	bool private_car_threads_working;
 public:
 	static simthread_barrier_t step_convoys_barrier_external;
-	static simthread_barrier_t unreserve_route_barrier;
 	static simthread_barrier_t private_car_barrier;
-	static pthread_mutex_t unreserve_route_mutex;
 	static pthread_mutex_t step_passengers_and_mail_mutex;
 	static bool private_car_route_mutex_initialised;
 	static pthread_mutex_t private_car_route_mutex;
@@ -983,7 +1104,6 @@ private:
 
 #ifdef MULTI_THREAD
 	friend void *check_road_connexions_threaded(void* args);
-	friend void *unreserve_route_threaded(void* args);
 	friend void *step_passengers_and_mail_threaded(void* args);
 	friend void *step_convoys_threaded(void* args);
 	friend void *path_explorer_threaded(void* args);
@@ -1006,14 +1126,26 @@ private:
 	static vector_tpl<nearby_halt_t> *start_halts;
 	static vector_tpl<halthandle_t> *destination_list;
 
+	// One per passenger generation thread (0 being the main thread)
+	static passenger_generation_log_t *passenger_generation_logs;
+
 	private:
+	passenger_generation_log_t &get_passenger_generation_log() { return passenger_generation_logs[passenger_generation_thread_number]; }
 #else
 	public:
 	static const uint32 marker_index = UINT32_MAX_VALUE;
 	static vector_tpl<nearby_halt_t> start_halts;
 	static vector_tpl<halthandle_t> destination_list;
+	static passenger_generation_log_t passenger_generation_logs[1];
+
+	private:
+	passenger_generation_log_t &get_passenger_generation_log() { return passenger_generation_logs[0]; }
 #endif
 
+	/// Applies the effects of passenger and mail generation in thread order.
+	/// Must not run concurrently to the generation threads.
+	void apply_passenger_generation_logs();
+
 public:
 
 	static void privatecar_init(const std::string &objfilename);
@@ -1947,6 +2079,14 @@ public:
 	*/
 	sint32 get_parallel_operations() const;
 
+	/**
+	 * Calls run(shard, param) for the shards 0 to count-1 at the same time, and
+	 * returns when all have finished. The threads are started at the first call
+	 * and wait at a barrier between the calls; this thread takes shards too.
+	 * Must only be called by the main thread.
+	 */
+	void run_shards(uint32 count, void (*run)(uint32 shard, void *param), void *param);
+
 private:
 	/**
 	 * Dummy method, to generate compiler error if someone tries to call get_climate( int ),
@@ -2145,7 +2285,7 @@ private:
 	 */
 	inline grund_t *lookup_kartenboden_nocheck(const sint16 x, const sint16 y) const
 	{
-		return plan[x+y*cached_grid_size.x].get_kartenboden();
+		return plan[get_plan_index(x, y)].get_kartenboden();
 	}
 
 	inline grund_t *lookup_kartenboden_nocheck(const koord &pos) const { return lookup_kartenboden_nocheck(pos.x, pos.y); }
@@ -2156,7 +2296,7 @@ public:
 	 */
 	inline grund_t *lookup_kartenboden(const sint16 x, const sint16 y) const
 	{
-		return is_within_limits(x, y) ? plan[x+y*cached_grid_size.x].get_kartenboden() : NULL;
+		return is_within_limits(x, y) ? plan[get_plan_index(x, y)].get_kartenboden() : NULL;
 	}
 
 	inline grund_t *lookup_kartenboden(const koord &pos) const { return lookup_kartenboden(pos.x, pos.y); }
@@ -2412,16 +2552,84 @@ public:
 	 */
 	void step();
 
+	/// Phases of step() and sync_step() whose time on the main thread is measured for -benchmark
+	enum step_phase_t {
+		PHASE_NEW_MONTH,
+		PHASE_PATH_EXPLORER,
+		PHASE_CONVOYS_THREADED,
+		PHASE_CONVOYS,
+		PHASE_CITIES,
+		PHASE_PASSENGERS,
+		PHASE_FACTORIES,
+		PHASE_HALTS,
+		PHASE_SYNC_EYECANDY,
+		PHASE_SYNC,
+		MAX_STEP_PHASES
+	};
+
+	/// Starts (and resets) or stops measuring the time of the step phases
+	void set_profile_step_phases(bool on);
+
+	/// @returns the time spent in phase since profiling started, in microseconds
+	uint64 get_step_phase_time(step_phase_t phase) const { return step_phase_time[phase]; }
+
+	static const char *get_step_phase_name(step_phase_t phase);
+
+	/**
+	 * @returns a hash of the random seed and the check values of the last
+	 * step (see checklist_t). It does not depend on the number of threads,
+	 * so two runs of the same game give the same value only if they played
+	 * the same.
+	 */
+	uint32 get_state_checksum() const;
+
+private:
+	bool profile_step_phases;
+	uint64 step_phase_time[MAX_STEP_PHASES];
+
+	/// @returns the current time in microseconds if the phases are measured, else 0
+	uint64 get_step_phase_clock() const;
+
+	void add_step_phase_time(step_phase_t phase, uint64 start)
+	{
+		if(  profile_step_phases  ) {
+			step_phase_time[phase] += get_step_phase_clock() - start;
+		}
+	}
+
+public:
+	/**
+	 * @return number of tile array chunks needed for @p size tiles in one direction
+	 */
+	static inline uint32 get_plan_chunks(sint32 size) { return (uint32)(size + PLAN_CHUNK_SIZE - 1) >> PLAN_CHUNK_SHIFT; }
+
+	/**
+	 * @return number of tiles (including the padding of the last chunks) of a tile array for a map of this size
+	 */
+	static inline uint32 get_plan_tile_count(sint32 size_x, sint32 size_y) { return (get_plan_chunks(size_x) * get_plan_chunks(size_y)) << (2*PLAN_CHUNK_SHIFT); }
+
+	/**
+	 * @return index of tile (x,y) in a tile array that is @p chunks_x chunks wide
+	 */
+	static inline uint32 get_plan_index(sint32 x, sint32 y, uint32 chunks_x)
+	{
+		return ( ( ((uint32)y >> PLAN_CHUNK_SHIFT) * chunks_x + ((uint32)x >> PLAN_CHUNK_SHIFT) ) << (2*PLAN_CHUNK_SHIFT) )
+			| ( ((uint32)y & (PLAN_CHUNK_SIZE-1)) << PLAN_CHUNK_SHIFT )
+			| ( (uint32)x & (PLAN_CHUNK_SIZE-1) );
+	}
+
+	inline uint32 get_plan_index(sint32 x, sint32 y) const { return get_plan_index(x, y, plan_chunks_x); }
+
 //private:
 	inline planquadrat_t *access_nocheck(int i, int j) const {
-		return &plan[i + j*cached_grid_size.x];
+		return &plan[get_plan_index(i, j)];
 	}
 
 	inline planquadrat_t *access_nocheck(koord k) const { return access_nocheck(k.x, k.y); }
 
 //public:
 	inline planquadrat_t *access(int i, int j) const {
-		return is_within_limits(i, j) ? &plan[i + j*cached_grid_size.x] : NULL;
+		return is_within_limits(i, j) ? &plan[get_plan_index(i, j)] : NULL;
 	}
 
 	inline planquadrat_t *access(koord k) const { return access(k.x, k.y); }
@@ -2590,9 +2798,10 @@ public:
 	/**
 	 * Saves the map to a file.
 	 * @param Filename name of the file to write.
+	 * @param fast compress at the faster zstd level of the autosaves
 	 * @author Hj. Malthaner
 	 */
-	void save(const char *filename, const loadsave_t::mode_t savemode, const char *version, const char *ex_version, const char* ex_revision, bool silent);
+	void save(const char *filename, const loadsave_t::mode_t savemode, const char *version, const char *ex_version, const char* ex_revision, bool silent, bool fast = false);
 
 	/**
 	 * Loads a map from a file.
@@ -2633,6 +2842,14 @@ public:
 	const checklist_t& get_checklist_at(const uint32 sync_step) const { return LCHKLST(sync_step); }
 	void set_checklist_at(const uint32 sync_step, const checklist_t &chklst) { LCHKLST(sync_step) = chklst; }
 
+	/**
+	 * Called when the checklist at sync_step differs from the one of the other side.
+	 * Logs which parts of the world hash differ and dumps the local world hash
+	 * into a file named after entity and sync_step, to be compared with the
+	 * dump of the other side.
+	 */
+	void report_world_hash_mismatch(const uint32 sync_step, const checklist_t &other, const char *entity) const;
+
 	const checklist_t& get_last_checklist() const { return LCHKLST(sync_steps); }
 	uint32 get_last_checklist_sync_step() const { return sync_steps; }
 
@@ -2651,6 +2868,13 @@ public:
 
 	void set_recheck_road_connexions() { recheck_road_connexions = true; }
 
+	/**
+	 * As above, and searches the private car routes of the city nearest to pos
+	 * before those of the other cities in the current refresh cycle.
+	 * For roads which players build or remove.
+	 */
+	void set_recheck_road_connexions(koord pos);
+
 	/**
 	 * These methods return an estimated
 	 * road speed based on the average
@@ -2723,6 +2947,13 @@ public:
 	void remove_queued_city(stadt_t* stadt);
 	void add_queued_city(stadt_t* stadt);
 
+	/**
+	 * Recalculates the private car routes from all cities at once on the private car threads,
+	 * and makes them visible immediately. The result does not depend on the number of threads.
+	 * Runs on a new map.
+	 */
+	void refresh_private_car_routes();
+
 	sint64 get_land_value(koord3d k);
 	double get_forge_cost(waytype_t waytype, koord3d position);
 	bool is_forge_cost_reduced(waytype_t waytype, koord3d position);
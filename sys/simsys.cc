@@ -29,6 +29,8 @@
 #	include <winbase.h>
 #	include <shellapi.h>
 #	include <shlobj.h>
+#	define PSAPI_VERSION 2
+#	include <psapi.h>
 #	if !defined(__CYGWIN__)
 #		include <direct.h>
 #	else
@@ -40,6 +42,10 @@
 #	include <limits.h>
 #	if !defined __AMIGA__ && !defined __BEOS__
 #		include <unistd.h>
+#		include <fcntl.h>
+#		include <sys/mman.h>
+#		include <sys/resource.h>
+#		define SIM_SYSTEM_MMAP
 #	endif
 #endif
 
@@ -742,6 +748,114 @@ const char *dr_get_locale_string()
 
 
 
+size_t dr_get_peak_memory()
+{
+#if defined _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if(  GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof(counters) )  ) {
+		return counters.PeakWorkingSetSize;
+	}
+	return 0;
+#elif !defined __AMIGA__ && !defined __BEOS__
+	struct rusage usage;
+	if(  getrusage( RUSAGE_SELF, &usage ) != 0  ) {
+		return 0;
+	}
+#	ifdef __APPLE__
+	return (size_t)usage.ru_maxrss; // already bytes
+#	else
+	return (size_t)usage.ru_maxrss * 1024; // in kB
+#	endif
+#else
+	return 0;
+#endif
+}
+
+
+char *dr_map_file(const char *path, size_t &size)
+{
+	size = 0;
+#if defined _WIN32
+	HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+	if(  file == INVALID_HANDLE_VALUE  ) {
+		return NULL;
+	}
+	LARGE_INTEGER length;
+	char *data = NULL;
+	if(  GetFileSizeEx( file, &length )  &&  length.QuadPart > 0  &&  (ULONGLONG)length.QuadPart <= (size_t)-1  ) {
+		if(  HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_WRITECOPY, 0, 0, NULL )  ) {
+			data = (char *)MapViewOfFile( mapping, FILE_MAP_COPY, 0, 0, 0 );
+			// the view keeps the file open
+			CloseHandle( mapping );
+		}
+	}
+	CloseHandle( file );
+	if(  data  ) {
+		size = (size_t)length.QuadPart;
+	}
+	return data;
+#elif defined SIM_SYSTEM_MMAP
+	const int fd = open( path, O_RDONLY );
+	if(  fd < 0  ) {
+		return NULL;
+	}
+	struct stat st;
+	char *data = NULL;
+	if(  fstat( fd, &st ) == 0  &&  st.st_size > 0  ) {
+		void *map = mmap( NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+		if(  map != MAP_FAILED  ) {
+			data = (char *)map;
+			size = (size_t)st.st_size;
+#ifdef MADV_WILLNEED
+			madvise( map, size, MADV_WILLNEED );
+#endif
+		}
+	}
+	// the mapping keeps the file open
+	close( fd );
+	return data;
+#else
+	FILE *f = fopen( path, "rb" );
+	if(  f == NULL  ) {
+		return NULL;
+	}
+	char *data = NULL;
+	fseek( f, 0, SEEK_END );
+	const long length = ftell( f );
+	fseek( f, 0, SEEK_SET );
+	if(  length > 0  ) {
+		data = (char *)malloc( length );
+		if(  data  &&  fread( data, length, 1, f ) == 1  ) {
+			size = (size_t)length;
+		}
+		else {
+			free( data );
+			data = NULL;
+		}
+	}
+	fclose( f );
+	return data;
+#endif
+}
+
+
+void dr_unmap_file(char *data, size_t size)
+{
+	if(  data == NULL  ) {
+		return;
+	}
+#if defined _WIN32
+	(void)size;
+	UnmapViewOfFile( data );
+#elif defined SIM_SYSTEM_MMAP
+	munmap( data, size );
+#else
+	(void)size;
+	free( data );
+#endif
+}
+
+
 void dr_fatal_notify(char const* const msg)
 {
 #ifdef _WIN32
@@ -141,6 +141,20 @@ void GetEventsNoWait();
 uint32 dr_time();
 void dr_sleep(uint32 millisec);
 
+/// @returns the peak resident memory of the process in bytes, or 0 if unknown
+size_t dr_get_peak_memory();
+
+/**
+ * Maps a file copy-on-write into memory, or reads it into memory if the
+ * system cannot map files. Writing to the data never changes the file.
+ * @param size is set to the length of the file
+ * @return the contents, or NULL if the file cannot be opened or is empty
+ */
+char *dr_map_file(const char *path, size_t &size);
+
+/// Releases the data returned by dr_map_file()
+void dr_unmap_file(char *data, size_t size);
+
 // error message in case of fatal events
 void dr_fatal_notify(char const* msg);
 
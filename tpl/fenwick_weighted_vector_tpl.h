@@ -0,0 +1,528 @@
+/*
+ * This file is part of the Simutrans-Extended project under the Artistic License.
+ * (see LICENSE.txt)
+ */
+
+#ifndef TPL_FENWICK_WEIGHTED_VECTOR_TPL_H
+#define TPL_FENWICK_WEIGHTED_VECTOR_TPL_H
+
+
+#include <cstddef>
+#include <iterator>
+
+#include "../macros.h"
+#include "../simdebug.h"
+#include "../simtypes.h"
+
+
+/**
+ * Weighted vector for large lists which change all the time, like the
+ * passenger origins and targets of the world.
+ *
+ * The weights are kept in a Fenwick tree, so append, remove and changing the
+ * weight of an element are O(log n) instead of O(n) for weighted_vector_tpl.
+ * A second tree counts the elements, to find the n-th one for insert_ordered().
+ * An open addressing index maps every element to its slot, so no operation
+ * has to search the list.
+ *
+ * Removed elements leave an empty slot of weight zero behind; the slots are
+ * compacted once more than half of them are empty. The order of the elements
+ * is never changed, and at_weight() skips empty slots, so the selection is the
+ * same as that of a weighted_vector_tpl to which the same changes were made.
+ * This keeps network games in sync.
+ *
+ * Like in weighted_vector_tpl an element may be contained more than once;
+ * remove(), update() and get_weight() then use its first copy.
+ */
+template<class T> class fenwick_weighted_vector_tpl
+{
+	private:
+		struct slot_t
+		{
+			T data;
+			uint32 weight;
+			bool alive;
+		};
+
+		enum { NO_SLOT = 0xFFFFFFFFu };
+
+	public:
+		class const_iterator;
+
+		class iterator
+		{
+			public:
+				typedef std::forward_iterator_tag iterator_category;
+				typedef std::ptrdiff_t            difference_type;
+				typedef T const*                  pointer;
+				typedef T const&                  reference;
+				typedef T                         value_type;
+
+				T& operator *() const { return ptr->data; }
+
+				iterator& operator ++() { ++ptr; skip(); return *this; }
+
+				bool operator !=(const iterator& o) { return ptr != o.ptr; }
+
+			private:
+				iterator(slot_t* ptr_, slot_t* end_) : ptr(ptr_), end(end_) { skip(); }
+
+				void skip() { while(  ptr != end  &&  !ptr->alive  ) { ++ptr; } }
+
+				slot_t* ptr;
+				slot_t* end;
+
+			friend class fenwick_weighted_vector_tpl;
+			friend class const_iterator;
+		};
+
+		class const_iterator
+		{
+			public:
+				typedef std::forward_iterator_tag iterator_category;
+				typedef std::ptrdiff_t            difference_type;
+				typedef T const*                  pointer;
+				typedef T const&                  reference;
+				typedef T                         value_type;
+
+				const_iterator(const iterator& o) : ptr(o.ptr), end(o.end) {}
+
+				const T& operator *() const { return ptr->data; }
+
+				const_iterator& operator ++() { ++ptr; skip(); return *this; }
+
+				bool operator !=(const const_iterator& o) { return ptr != o.ptr; }
+
+			private:
+				const_iterator(const slot_t* ptr_, const slot_t* end_) : ptr(ptr_), end(end_) { skip(); }
+
+				void skip() { while(  ptr != end  &&  !ptr->alive  ) { ++ptr; } }
+
+				const slot_t* ptr;
+				const slot_t* end;
+
+			friend class fenwick_weighted_vector_tpl;
+		};
+
+		fenwick_weighted_vector_tpl() :
+			slots(NULL), tree(NULL), alive_tree(NULL), size(0), used(0), count(0), total_weight(0),
+			index(NULL), index_mask(0)
+		{}
+
+		~fenwick_weighted_vector_tpl()
+		{
+			delete [] slots;
+			delete [] tree;
+			delete [] alive_tree;
+			delete [] index;
+		}
+
+		/** sets the vector to empty, but keeps the memory */
+		void clear()
+		{
+			used = 0;
+			count = 0;
+			total_weight = 0;
+			if(  index  ) {
+				for(  uint32 i = 0;  i <= index_mask;  i++  ) {
+					index[i] = NO_SLOT;
+				}
+			}
+		}
+
+		/** Makes room for at least new_size elements */
+		void resize(uint32 new_size)
+		{
+			if(  new_size > size  ) {
+				grow(new_size);
+			}
+			reserve_index(new_size);
+		}
+
+		bool is_contained(const T &elem) const { return find(elem) != NO_SLOT; }
+
+		/** Appends the element at the end of the vector. */
+		bool append(T elem, uint32 weight)
+		{
+#ifdef IGNORE_ZERO_WEIGHT
+			if(  weight == 0  ) {
+				// ignore unused entries ...
+				return false;
+			}
+#endif
+			if(  used == size  ) {
+				grow(size == 0 ? 16 : size * 2);
+			}
+			reserve_index(count + 1);
+
+			const uint32 pos = used++;
+			slots[pos].data = elem;
+			slots[pos].weight = weight;
+			slots[pos].alive = true;
+			build_node(pos + 1);
+			index_insert(elem, pos);
+			count++;
+			total_weight += weight;
+			return true;
+		}
+
+		/**
+		 * Inserts `elem' with respect to ordering, at the same place as
+		 * weighted_vector_tpl would. If there is an empty slot at this place,
+		 * it is O(log^2 n). Otherwise the following elements have to move up,
+		 * and with them their nodes of the trees, so it is O(n) like for
+		 * weighted_vector_tpl.
+		 */
+		template<class StrictWeakOrdering>
+		bool insert_ordered(const T& elem, uint32 weight, StrictWeakOrdering comp)
+		{
+#ifdef IGNORE_ZERO_WEIGHT
+			if(  weight == 0  ) {
+				return false;
+			}
+#endif
+			// search by the number of the element, the empty slots do not count
+			sint32 high = count, low = -1;
+			while(  high-low>1  ) {
+				const sint32 mid = ((uint32)(high + low)) >> 1;
+				if(  comp(elem, slots[find_nth(mid)].data)  ) {
+					high = mid;
+				}
+				else {
+					low = mid;
+				}
+			}
+			if(  (uint32)high == count  ) {
+				return append(elem, weight);
+			}
+
+			reserve_index(count + 1);
+			uint32 pos = find_nth(high);
+			if(  pos > 0  &&  !slots[pos - 1].alive  ) {
+				// reuse the empty slot in front of it
+				pos--;
+				slots[pos].data = elem;
+				slots[pos].weight = weight;
+				slots[pos].alive = true;
+				add_to_tree(pos, weight, 1);
+			}
+			else {
+				if(  used == size  ) {
+					grow(size * 2);
+				}
+				// downwards, so the index never holds a slot twice
+				for(  uint32 i = used;  i-- > pos;  ) {
+					if(  slots[i].alive  ) {
+						index_move(i, i + 1);
+					}
+					slots[i + 1] = slots[i];
+				}
+				slots[pos].data = elem;
+				slots[pos].weight = weight;
+				slots[pos].alive = true;
+				used++;
+				// the nodes in front of the element still cover the same slots
+				for(  uint32 node = pos + 1;  node <= used;  node++  ) {
+					build_node(node);
+				}
+			}
+			index_insert(elem, pos);
+			count++;
+			total_weight += weight;
+			return true;
+		}
+
+		/**
+		 * Changes the weight of the element, if contained
+		 * @returns false if it is not contained
+		 */
+		bool update(const T &elem, uint32 weight)
+		{
+			const uint32 pos = find(elem);
+			if(  pos == NO_SLOT  ) {
+				return false;
+			}
+			// unsigned arithmetic wraps around, so this also works for smaller weights
+			const uint32 delta = weight - slots[pos].weight;
+			slots[pos].weight = weight;
+			add_to_tree(pos, delta, 0);
+			total_weight += delta;
+			return true;
+		}
+
+		/** @returns the weight of the element, or 0 if not contained */
+		uint32 get_weight(const T &elem) const
+		{
+			const uint32 pos = find(elem);
+			return pos == NO_SLOT ? 0 : slots[pos].weight;
+		}
+
+		/** removes element, if contained */
+		bool remove(const T &elem)
+		{
+			const uint32 pos = find(elem);
+			if(  pos == NO_SLOT  ) {
+				return false;
+			}
+			index_erase(pos);
+			add_to_tree(pos, 0 - slots[pos].weight, 0 - 1u);
+			total_weight -= slots[pos].weight;
+			slots[pos].weight = 0;
+			slots[pos].alive = false;
+			count--;
+
+			const uint32 empty_slots = used - count;
+			if(  empty_slots > 32  &&  empty_slots > count  ) {
+				compact();
+			}
+			return true;
+		}
+
+		/** Accesses the element at position i by weight */
+		const T& at_weight(const uint32 target_weight) const
+		{
+			if(  target_weight > total_weight  ||  count == 0  ) {
+				dbg->fatal("fenwick_weighted_vector_tpl<T>::at_weight()", "weight out of bounds: %i not in 0..%d", target_weight, total_weight);
+			}
+			// descend the tree to the last node whose prefix sum does not exceed the target
+			uint32 pos = 0;
+			uint32 remaining = target_weight;
+			uint32 step = 1;
+			while(  (step << 1) <= used  ) {
+				step <<= 1;
+			}
+			for(  ;  step > 0;  step >>= 1  ) {
+				if(  pos + step <= used  &&  tree[pos + step] <= remaining  ) {
+					pos += step;
+					remaining -= tree[pos];
+				}
+			}
+			// pos is now the slot of the element, unless the target is the total
+			// weight itself, for which weighted_vector_tpl returns the last element
+			if(  pos == used  ) {
+				while(  !slots[--pos].alive  ) {}
+			}
+			return slots[pos].data;
+		}
+
+		/** Gets the number of elements in the vector */
+		uint32 get_count() const { return count; }
+
+		/** Gets the total weight */
+		uint32 get_sum_weight() const { return total_weight; }
+
+		bool empty() const { return count == 0; }
+
+		iterator begin() { return iterator(slots, slots + used); }
+		iterator end()   { return iterator(slots + used, slots + used); }
+
+		const_iterator begin() const { return const_iterator(slots, slots + used); }
+		const_iterator end()   const { return const_iterator(slots + used, slots + used); }
+
+	private:
+		slot_t* slots;
+		uint32* tree;                 ///< Fenwick tree over the slot weights, 1-based
+		uint32* alive_tree;           ///< Fenwick tree counting the elements in the slots, 1-based
+		uint32 size;                  ///< Capacity
+		uint32 used;                  ///< Number of slots in use, including empty ones
+		uint32 count;                 ///< Number of elements in vector
+		uint32 total_weight;          ///< Sum of all weights
+
+		uint32* index;                ///< slot of each element, by hash of the element
+		uint32 index_mask;            ///< capacity of the index minus one
+
+		static uint32 hash(const T &elem)
+		{
+			// Fibonacci hashing spreads the aligned addresses of pointers
+			const uint64 h = (uint64)(size_t)elem * 0x9E3779B97F4A7C15ull;
+			return (uint32)(h >> 32);
+		}
+
+		void grow(uint32 new_size)
+		{
+			slot_t* new_slots = new slot_t[new_size];
+			for(  uint32 i = 0;  i < used;  i++  ) {
+				new_slots[i] = slots[i];
+			}
+			uint32* new_tree = new uint32[new_size + 1];
+			uint32* new_alive_tree = new uint32[new_size + 1];
+			for(  uint32 i = 0;  i <= used;  i++  ) {
+				new_tree[i] = tree ? tree[i] : 0;
+				new_alive_tree[i] = alive_tree ? alive_tree[i] : 0;
+			}
+			delete [] slots;
+			delete [] tree;
+			delete [] alive_tree;
+			slots = new_slots;
+			tree = new_tree;
+			alive_tree = new_alive_tree;
+			size = new_size;
+		}
+
+		void add_to_tree(uint32 pos, uint32 delta, uint32 alive_delta)
+		{
+			for(  uint32 node = pos + 1;  node <= used;  node += node & (0 - node)  ) {
+				tree[node] += delta;
+				alive_tree[node] += alive_delta;
+			}
+		}
+
+		/// @returns the slot of the element with n elements in front of it
+		uint32 find_nth(uint32 n) const
+		{
+			uint32 pos = 0;
+			uint32 step = 1;
+			while(  (step << 1) <= used  ) {
+				step <<= 1;
+			}
+			for(  ;  step > 0;  step >>= 1  ) {
+				if(  pos + step <= used  &&  alive_tree[pos + step] <= n  ) {
+					pos += step;
+					n -= alive_tree[pos];
+				}
+			}
+			return pos;
+		}
+
+		/// sets the node from its slot and the nodes below it, which must be up to date
+		void build_node(uint32 node)
+		{
+			// a node covers the nodes below it which end right before it
+			tree[node] = slots[node - 1].weight;
+			alive_tree[node] = slots[node - 1].alive;
+			for(  uint32 step = 1;  step < (node & (0 - node));  step <<= 1  ) {
+				tree[node] += tree[node - step];
+				alive_tree[node] += alive_tree[node - step];
+			}
+		}
+
+		/// rebuilds the tree and the index from the slots in O(n)
+		void rebuild()
+		{
+			tree[0] = 0;
+			alive_tree[0] = 0;
+			for(  uint32 node = 1;  node <= used;  node++  ) {
+				tree[node] = slots[node - 1].weight;
+				alive_tree[node] = slots[node - 1].alive;
+			}
+			for(  uint32 node = 1;  node <= used;  node++  ) {
+				const uint32 parent = node + (node & (0 - node));
+				if(  parent <= used  ) {
+					tree[parent] += tree[node];
+					alive_tree[parent] += alive_tree[node];
+				}
+			}
+			for(  uint32 i = 0;  i <= index_mask  &&  index;  i++  ) {
+				index[i] = NO_SLOT;
+			}
+			for(  uint32 pos = 0;  pos < used;  pos++  ) {
+				if(  slots[pos].alive  ) {
+					index_insert(slots[pos].data, pos);
+				}
+			}
+		}
+
+		/// drops the empty slots, keeping the order of the elements
+		void compact()
+		{
+			if(  used == count  ) {
+				return;
+			}
+			uint32 n = 0;
+			for(  uint32 pos = 0;  pos < used;  pos++  ) {
+				if(  slots[pos].alive  ) {
+					slots[n++] = slots[pos];
+				}
+			}
+			used = n;
+			rebuild();
+		}
+
+		/// makes sure the index is at most half full with n elements
+		void reserve_index(uint32 n)
+		{
+			if(  index  &&  n * 2 <= index_mask + 1  ) {
+				return;
+			}
+			uint32 capacity = 32;
+			while(  capacity < n * 2  ) {
+				capacity <<= 1;
+			}
+			delete [] index;
+			index = new uint32[capacity];
+			index_mask = capacity - 1;
+			for(  uint32 i = 0;  i < capacity;  i++  ) {
+				index[i] = NO_SLOT;
+			}
+			for(  uint32 pos = 0;  pos < used;  pos++  ) {
+				if(  slots[pos].alive  ) {
+					index_insert(slots[pos].data, pos);
+				}
+			}
+		}
+
+		/// @returns the first slot of the element
+		uint32 find(const T &elem) const
+		{
+			uint32 pos = NO_SLOT;
+			if(  !index  ) {
+				return pos;
+			}
+			// copies of the element are all in the same probe sequence
+			for(  uint32 i = hash(elem) & index_mask;  index[i] != NO_SLOT;  i = (i + 1) & index_mask  ) {
+				if(  slots[index[i]].data == elem  &&  index[i] < pos  ) {
+					pos = index[i];
+				}
+			}
+			return pos;
+		}
+
+		void index_insert(const T &elem, uint32 pos)
+		{
+			uint32 i = hash(elem) & index_mask;
+			while(  index[i] != NO_SLOT  ) {
+				i = (i + 1) & index_mask;
+			}
+			index[i] = pos;
+		}
+
+		/// changes the entry of the element in slot pos to new_pos
+		void index_move(uint32 pos, uint32 new_pos)
+		{
+			uint32 i = hash(slots[pos].data) & index_mask;
+			while(  index[i] != pos  ) {
+				i = (i + 1) & index_mask;
+			}
+			index[i] = new_pos;
+		}
+
+		/// removes the entry of the element in slot pos, shifting back the
+		/// following entries of the probe sequence (no tombstones needed)
+		void index_erase(uint32 pos)
+		{
+			uint32 i = hash(slots[pos].data) & index_mask;
+			while(  index[i] != pos  ) {
+				i = (i + 1) & index_mask;
+			}
+			uint32 j = i;
+			for(  ;;  ) {
+				j = (j + 1) & index_mask;
+				if(  index[j] == NO_SLOT  ) {
+					break;
+				}
+				const uint32 home = hash(slots[index[j]].data) & index_mask;
+				// move the entry back unless its home lies cyclically in (i, j]
+				if(  ((j - home) & index_mask) >= ((j - i) & index_mask)  ) {
+					index[i] = index[j];
+					i = j;
+				}
+			}
+			index[i] = NO_SLOT;
+		}
+
+		fenwick_weighted_vector_tpl(const fenwick_weighted_vector_tpl& other);
+
+		fenwick_weighted_vector_tpl& operator=( fenwick_weighted_vector_tpl const& other );
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * This file is part of the Simutrans-Extended project under the Artistic License.
+ * (see LICENSE.txt)
+ */
+
+#ifndef TPL_RADIX_HEAP_TPL_H
+#define TPL_RADIX_HEAP_TPL_H
+
+
+#include "../simtypes.h"
+#include "vector_tpl.h"
+
+
+/**
+ * Monotone radix heap with integer keys.
+ *
+ * Items are kept in 65 buckets; bucket i holds keys whose highest bit
+ * differing from the last extracted key is bit i-1 (bucket 0 holds keys
+ * equal to it). Each key is moved at most 64 times over its lifetime, so
+ * insert is O(1) and pop is amortised O(log C) without comparing items.
+ *
+ * The heap is monotone: a key smaller than the last extracted one is raised
+ * to it. For such a key the item is the minimum anyway, so the order only
+ * differs from an exact heap among items with the very same key.
+ *
+ * clear() keeps the bucket storage, so a heap which is reused for many
+ * searches stops allocating once it has seen its largest search.
+ */
+template <class T>
+class radix_heap_tpl
+{
+private:
+	struct node_t
+	{
+		uint64 key;
+		T item;
+	};
+
+	enum { BUCKETS = 65 };
+
+	vector_tpl<node_t> buckets[BUCKETS];
+	uint64 last_key;
+	uint32 node_count;
+
+	uint8 bucket_index(uint64 key) const
+	{
+		uint64 diff = key ^ last_key;
+		uint8 i = 0;
+		while(  diff  ) {
+			diff >>= 1;
+			i++;
+		}
+		return i;
+	}
+
+	/// makes sure bucket 0 holds the items with the smallest key
+	void prepare_front()
+	{
+		assert(!empty());
+		if(  !buckets[0].empty()  ) {
+			return;
+		}
+
+		uint8 i = 1;
+		while(  buckets[i].empty()  ) {
+			i++;
+		}
+
+		vector_tpl<node_t> &from = buckets[i];
+		uint64 min_key = from[0].key;
+		for(  uint32 j = 1;  j < from.get_count();  j++  ) {
+			if(  from[j].key < min_key  ) {
+				min_key = from[j].key;
+			}
+		}
+		last_key = min_key;
+
+		// all keys of this bucket now share more leading bits with last_key,
+		// so they move to strictly smaller buckets
+		for(  uint32 j = 0;  j < from.get_count();  j++  ) {
+			buckets[bucket_index(from[j].key)].append(from[j]);
+		}
+		from.clear();
+	}
+
+public:
+	radix_heap_tpl() : last_key(0), node_count(0) {}
+
+	void insert(uint64 key, const T item)
+	{
+		if(  key < last_key  ) {
+			key = last_key;
+		}
+		node_t node;
+		node.key = key;
+		node.item = item;
+		buckets[bucket_index(key)].append(node);
+		node_count++;
+	}
+
+	T pop()
+	{
+		prepare_front();
+		node_count--;
+		return buckets[0].pop_back().item;
+	}
+
+	const T& front()
+	{
+		prepare_front();
+		return buckets[0].back().item;
+	}
+
+	/// Recycles all nodes but keeps the memory. Leaves the heap empty.
+	void clear()
+	{
+		for(  uint8 i = 0;  i < BUCKETS;  i++  ) {
+			buckets[i].clear();
+		}
+		last_key = 0;
+		node_count = 0;
+	}
+
+	uint32 get_count() const { return node_count; }
+
+	bool empty() const { return node_count == 0; }
+
+private:
+	radix_heap_tpl(const radix_heap_tpl& other);
+	radix_heap_tpl& operator=( radix_heap_tpl const& other );
+};
+
+#endif
@@ -275,6 +275,19 @@ uint32 setsimrand(uint32 seed,uint32 ns)
 	return old_noise_seed;
 }
 
+void setsimrand_stream(uint32 seed, uint32 stream)
+{
+	// mix both into one well distributed seed (finaliser of MurmurHash3),
+	// so that neighbouring streams do not start from similar states
+	uint32 h = seed ^ (stream * 0x9E3779B9u);
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	init_genrand(h);
+}
+
 static double int_noise(const sint32 x, const sint32 y)
 {
 	uint32 n = (uint32)x + (uint32)y*101U + noise_seed;
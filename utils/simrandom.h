@@ -14,6 +14,13 @@ uint32 get_random_seed();
 
 uint32 setsimrand(uint32 seed, uint32 noise_seed);
 
+/* Seeds the generator of the calling thread with substream number stream
+ * of seed. Threads seeded with the same seed but different streams draw
+ * independent, reproducible sequences. Unlike setsimrand(), this does not
+ * change any state shared between threads.
+ */
+void setsimrand_stream(uint32 seed, uint32 stream);
+
 /* generates a random number on [0,max-1]-interval
  * without affecting the game state
  * Use this for UI etc.